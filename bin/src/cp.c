@@ -7,6 +7,7 @@
  */
 
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -84,6 +85,7 @@ usage:
 }
 
 #define MAXBSIZE 1000
+#define COPY_CHUNK (64 * 1024)
 static int copy(char * from, char * to)
 {
     int fold;
@@ -193,9 +195,30 @@ static int copy(char * from, char * to)
     if (exists && pflag)
         (void)fchmod(fnew, stfrom.st_mode & 07777);
 
+    /* Let the kernel copy the data if it can. */
+    do {
+        n = copy_file_range(fold, NULL, fnew, NULL, COPY_CHUNK, 0);
+    } while (n > 0);
+    if (n == 0) {
+        goto done;
+    } else if (errno != EINVAL && errno != ENOTSUP && errno != ENOSYS) {
+        cp_perror(to);
+        (void)close(fold);
+        (void)close(fnew);
+        retval = 1;
+        goto out;
+    }
+
     buf = malloc(MAXBSIZE);
+    if (!buf) {
+        cp_perror(from);
+        (void)close(fold);
+        (void)close(fnew);
+        retval = 1;
+        goto out;
+    }
     for (;;) {
-        n = read(fold, buf, sizeof(buf));
+        n = read(fold, buf, MAXBSIZE);
         if (n == 0)
             break;
         if (n < 0) {
@@ -213,6 +236,7 @@ static int copy(char * from, char * to)
             goto out;
         }
     }
+done:
     (void)close(fold);
     (void)close(fnew);
     if (pflag)
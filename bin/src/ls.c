@@ -92,22 +92,26 @@ int main(int argc, char * argv[], char * envp[])
     }
 
     while ((count = getdents(fildes, (char *)dbuf, sizeof(dbuf))) > 0) {
-        for (int i = 0; i < count; i++) {
-            if (!flags.a && dbuf[i].d_name[0] == '.')
+        struct dirent * d;
+
+        for (int off = 0; off < count; off += d->d_reclen) {
+            d = (struct dirent *)((char *)dbuf + off);
+
+            if (!flags.a && d->d_name[0] == '.')
                 continue;
 
             if (flags.l) {
                 struct stat stat;
                 char mode[12];
 
-                fstatat(fildes, dbuf[i].d_name, &stat, 0);
+                fstatat(fildes, d->d_name, &stat, 0);
                 strmode(stat.st_mode, mode);
                 printf("% 7u %s %u:%u %s\n",
-                         (unsigned)dbuf[i].d_ino, mode,
+                         (unsigned)d->d_ino, mode,
                          (unsigned)stat.st_uid, (unsigned)stat.st_gid,
-                         dbuf[i].d_name);
+                         d->d_name);
             } else {
-                printf("%s ", dbuf[i].d_name);
+                printf("%s ", d->d_name);
             }
         }
     }
@@ -94,6 +94,8 @@ int main(int argc, char * argv[], char * envp[])
     clock_t utime;
     clock_t stime;
     clock_t sutime;
+    struct kinfo_vmentry * vmmap;
+    size_t nr_entries, vsz = 0, rss = 0;
 
     if (argc < 2 || sscanf(argv[1], "%d", &pid) != 1) {
         fprintf(stderr, "usage: %s PID\n", argv[0]);
@@ -129,6 +131,18 @@ int main(int argc, char * argv[], char * envp[])
            stime / 3600, (stime % 3600) / 60, stime % 60,
            sutime / 3600, (sutime % 3600) / 60, sutime % 60);
 
+    nr_entries = pid_vmmap(&vmmap, pid);
+    for (size_t i = 0; i < nr_entries; i++) {
+        vsz += vmmap[i].reg_end - vmmap[i].reg_start + 1;
+        rss += vmmap[i].rss;
+    }
+    if (nr_entries > 0)
+        free(vmmap);
+    printf("\nMemory\n");
+    printf("     VSZ      RSS\n"
+           "%7uK %7uK\n",
+           (unsigned)(vsz / 1024), (unsigned)(rss / 1024));
+
     printf("\nSession\n");
     /* TODO */
 
@@ -42,82 +42,76 @@
 #include <unistd.h>
 #include "utils.h"
 
-static pid_t * get_pids(void)
-{
-    int mib_maxproc[] = { CTL_KERN, KERN_MAXPROC };
-    int mib[] = { CTL_KERN, KERN_PROC, KERN_PROC_PID };
-    size_t size = sizeof(size_t);
-    size_t pids_size;
-    pid_t * pids;
-
-    if (sysctl(mib_maxproc, num_elem(mib_maxproc), &pids_size, &size, 0, 0))
-        return NULL;
-    pids_size *= sizeof(pid_t);
-
-    pids = calloc(pids_size + sizeof(pid_t), 1);
-    if (!pids)
-        return NULL;
-
-    if (sysctl(mib, num_elem(mib), pids, &pids_size, 0, 0))
-        return NULL;
-
-    return pids;
-}
-
-static int pid2pstat(struct kinfo_proc * ps, pid_t pid)
+/**
+ * Get kinfo_proc of all processes with a single sysctl call.
+ * @param[out] nprocs is the number of entries returned.
+ */
+static struct kinfo_proc * get_procs(size_t * nprocs)
 {
-    int mib[5];
-    size_t size = sizeof(*ps);
-
-    mib[0] = CTL_KERN;
-    mib[1] = KERN_PROC;
-    mib[2] = KERN_PROC_PID;
-    mib[3] = pid;
-    mib[4] = KERN_PROC_PSTAT;
-
-    return sysctl(mib, num_elem(mib), ps, &size, 0, 0);
+    int mib[] = { CTL_KERN, KERN_PROC, KERN_PROC_ALL };
+    struct kinfo_proc * procs = NULL;
+    size_t size, bufsize;
+
+    do {
+        struct kinfo_proc * tmp;
+
+        if (sysctl(mib, num_elem(mib), NULL, &size, 0, 0))
+            goto fail;
+
+        /* Leave some room for processes created after the first call. */
+        bufsize = size + 4 * sizeof(struct kinfo_proc);
+        tmp = realloc(procs, bufsize);
+        if (!tmp)
+            goto fail;
+        procs = tmp;
+
+        size = bufsize;
+        if (sysctl(mib, num_elem(mib), procs, &size, 0, 0))
+            goto fail;
+    } while (size == bufsize);
+
+    *nprocs = size / sizeof(struct kinfo_proc);
+    return procs;
+fail:
+    free(procs);
+    return NULL;
 }
 
 int main(int argc, char * argv[], char * envp[])
 {
-    pid_t pid;
-    pid_t * pids;
-    pid_t * pid_iter;
+    struct kinfo_proc * procs;
+    size_t nprocs;
     long clk_tck;
 
     clk_tck = sysconf(_SC_CLK_TCK);
     init_ttydev_arr();
 
-    pids = get_pids();
-    if (!pids) {
-        perror("Failed to get PIDs");
+    procs = get_procs(&nprocs);
+    if (!procs) {
+        perror("Failed to get processes");
         return EX_OSERR;
     }
 
     printf("USER   PID TTY          TIME CMD\n");
-    pid_iter = pids;
-    while ((pid = *pid_iter++) != 0) {
-        struct kinfo_proc ps;
+    for (size_t i = 0; i < nprocs; i++) {
+        struct kinfo_proc * ps = procs + i;
         struct passwd * pw;
         char * user = "";
         clock_t sutime;
 
-        if (pid2pstat(&ps, pid) == -1)
-            continue;
-
-        pw = getpwuid(ps.euid);
+        pw = getpwuid(ps->euid);
         if (pw)
             user = pw->pw_name;
-        sutime = (ps.utime + ps.stime) / clk_tck;
+        sutime = (ps->utime + ps->stime) / clk_tck;
 
         printf("%-5s %5d %-6s   %02u:%02u:%02u %s\n",
                user,
-               ps.pid,
-               devttytostr(ps.ctty),
+               ps->pid,
+               devttytostr(ps->ctty),
                sutime / 3600, (sutime % 3600) / 60, sutime % 60,
-               ps.name);
+               ps->name);
     }
 
-    free(pids);
+    free(procs);
     return 0;
 }
@@ -1,6 +1,7 @@
 /* See LICENSE file for copyright and license details. */
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,18 +23,18 @@ recurse(const char *path, void *data, struct recursor *r)
     struct stat st;
     struct stat dst;
     DIR *dp;
-    int (*statf)(const char *, struct stat *);
     char *statf_name;
+    int statf_flag;
 
     if (r->follow == 'P' || (r->follow == 'H' && r->depth)) {
         statf_name = "lstat";
-        statf = lstat;
+        statf_flag = AT_SYMLINK_NOFOLLOW;
     } else {
         statf_name = "stat";
-        statf = stat;
+        statf_flag = 0;
     }
 
-    if (statf(path, &st) < 0) {
+    if (fstatat(AT_FDCWD, path, &st, statf_flag) < 0) {
         if (!(r->flags & SILENT)) {
             weprintf("%s %s:", statf_name, path);
             recurse_status = 1;
@@ -75,15 +76,16 @@ recurse(const char *path, void *data, struct recursor *r)
         while ((d = readdir(dp))) {
             if (r->follow == 'H') {
                 statf_name = "lstat";
-                statf = lstat;
+                statf_flag = AT_SYMLINK_NOFOLLOW;
             }
             if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
                 continue;
-            estrlcpy(subpath, path, sizeof(subpath));
+            estrlcpy(subpath, path, PATH_MAX);
             if (path[strlen(path) - 1] != '/')
-                estrlcat(subpath, "/", sizeof(subpath));
-            estrlcat(subpath, d->d_name, sizeof(subpath));
-            if (statf(subpath, &dst) < 0) {
+                estrlcat(subpath, "/", PATH_MAX);
+            estrlcat(subpath, d->d_name, PATH_MAX);
+            /* Relative to the directory to avoid resolving path again. */
+            if (fstatat(dirfd(dp), d->d_name, &dst, statf_flag) < 0) {
                 if (!(r->flags & SILENT)) {
                     weprintf("%s %s:", statf_name, subpath);
                     recurse_status = 1;
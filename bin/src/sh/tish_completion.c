@@ -104,7 +104,8 @@ static void init_path_completion(void)
         while ((d = readdir(dirp))) {
             struct stat stat;
 
-            fstatat(dirfd(dirp), d->d_name, &stat, 0);
+            if (fstatat(dirfd(dirp), d->d_name, &stat, 0))
+                continue;
             if ((stat.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) != 0) {
                 eztrie_insert(&cmd_trie, d->d_name, NULL);
             }
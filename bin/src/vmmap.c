@@ -90,13 +90,14 @@ int main(int argc, char * argv[], char * envp[])
         return EX_NOINPUT;
     }
 
-    printf("START      END        PADDR      FLAGS     UAP\n");
+    printf("START      END        PADDR           RSS FLAGS     UAP\n");
     entry = vmmap;
     for (size_t i = 0; i < n; i++) {
-        printf("0x%08x 0x%08x 0x%08x 0x%07x %s\n",
+        printf("0x%08x 0x%08x 0x%08x %7uK 0x%07x %s\n",
                entry->reg_start,
                entry->reg_end,
                entry->paddr,
+               (unsigned)(entry->rss / 1024),
                entry->flags,
                entry->uap);
         entry++;
@@ -48,9 +48,12 @@
 
 /**
  * The dirent structure.
+ * getdents() packs the entries in the buffer using only as much space as
+ * the name needs, the next entry starts d_reclen bytes after this one.
  */
 struct dirent {
     ino_t d_ino;        /*!< File serial number. */
+    uint16_t d_reclen;  /*!< Length of this record. */
     uint8_t d_type;     /*!< File type. */
     char d_name[256];   /*!< Name of entry. */
 };
@@ -102,8 +105,8 @@ struct _fs_getdents_args {
  */
 typedef struct _dirdesc {
     int dd_fd;
-    size_t dd_loc;
-    size_t dd_count;
+    size_t dd_loc;      /*!< Offset of the next entry in dd_buf. */
+    size_t dd_count;    /*!< Number of bytes in dd_buf. */
     struct dirent dd_buf[10];
 } DIR;
 
@@ -117,6 +120,8 @@ __BEGIN_DECLS
  */
 /**
  * Get directory entries.
+ * @return Returns the number of bytes of variable length directory entries
+ *         written to buf; 0 at the end of the directory; -1 on error.
  */
 int getdents(int fd, char * buf, int nbytes);
 /**
@@ -235,6 +240,13 @@ __END_DECLS
 
 #if (KERNEL_INTERNAL || _DIRENT_INTERNAL_)
 #define DIRENT_SEEK_START 0x00000000FFFFFFFF
+
+/**
+ * Length of a packed dirent record for a name of namelen characters.
+ */
+#define DIRENT_RECLEN(namelen) \
+    ((__builtin_offsetof(struct dirent, d_name) + (namelen) + 1 + \
+      sizeof(ino_t) - 1) & ~(sizeof(ino_t) - 1))
 #endif
 
 #endif /* DIRENT_H */
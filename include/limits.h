@@ -57,7 +57,9 @@
 #define PATH_MAX        4096        /*!< Maximum path length. */
 #define NGROUPS_MAX     16
 
-/* TODO PIPE_BUF */
+#define PIPE_BUF        512         /*!< Maximum number of bytes that is
+                                     *   guaranteed to be written atomically
+                                     *   to a pipe. */
 
 
 /* Runtime Increasable Values */
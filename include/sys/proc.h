@@ -69,6 +69,7 @@ struct kinfo_vmentry {
     uintptr_t paddr;
     uintptr_t reg_start;
     uintptr_t reg_end;
+    size_t rss;             /*!< Resident set size in bytes. */
     unsigned long flags;
     char uap[5];
 };
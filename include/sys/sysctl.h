@@ -245,7 +245,22 @@ struct sysctl_req {
  */
 #define SYSCTL_REQFLAG_KERNEL 0x01 /*!< Kernel request. */
 
-SLIST_HEAD(sysctl_oid_list, sysctl_oid);
+/**
+ * Number of hash buckets in each sysctl_oid_list.
+ * Must be a power of two.
+ */
+#define SYSCTL_OID_HASH_SIZE 8
+
+/**
+ * A list of child oids of a MIB node.
+ * The list is compatible with the SLIST macros and it's kept sorted by
+ * oid_number, the hash tables are used to speed up lookups by number and name.
+ */
+struct sysctl_oid_list {
+    struct sysctl_oid * slh_first; /*!< Sorted list of children. */
+    struct sysctl_oid * oidl_nhash[SYSCTL_OID_HASH_SIZE]; /*!< By number. */
+    struct sysctl_oid * oidl_shash[SYSCTL_OID_HASH_SIZE]; /*!< By name. */
+};
 
 /*
  * This describes one "oid" in the MIB tree.  Potentially more nodes can
@@ -254,6 +269,8 @@ SLIST_HEAD(sysctl_oid_list, sysctl_oid);
 struct sysctl_oid {
     struct sysctl_oid_list * oid_parent;
     SLIST_ENTRY(sysctl_oid) oid_link;
+    struct sysctl_oid * oid_nhnext; /*!< Next in the number hash chain. */
+    struct sysctl_oid * oid_shnext; /*!< Next in the name hash chain. */
     int oid_number;
     unsigned int oid_kind;
     void * oid_arg1;
@@ -525,6 +542,7 @@ SYSCTL_ALLOWED_TYPES(UINT64, uint64_t *a; unsigned long long *b; );
 #define KERN_PROC_PID           1   /*!< Get proc data by process id */
 #define KERN_PROC_PGRP          2   /*!< Get process group info */
 #define KERN_PROC_SESSION       3   /*!< Get session info */
+#define KERN_PROC_ALL           4   /*!< Get kinfo_proc of all processes */
 
 /*
  * KERN_PROC_PID subtypes
@@ -158,6 +158,7 @@
 #define SYSCALL_FS_UMASK            SYSCALL_MMTOTYPE(SYSCALL_GROUP_FS, 0x14)
 #define SYSCALL_FS_MOUNT            SYSCALL_MMTOTYPE(SYSCALL_GROUP_FS, 0x15)
 #define SYSCALL_FS_UMOUNT           SYSCALL_MMTOTYPE(SYSCALL_GROUP_FS, 0x16)
+#define SYSCALL_FS_COPY_FILE_RANGE  SYSCALL_MMTOTYPE(SYSCALL_GROUP_FS, 0x17)
 #define SYSCALL_IOCTL_GETSET        SYSCALL_MMTOTYPE(SYSCALL_GROUP_IOCTL, 0x00)
 #define SYSCALL_SHMEM_MMAP          SYSCALL_MMTOTYPE(SYSCALL_GROUP_SHMEM, 0x00)
 #define SYSCALL_SHMEM_MUNMAP        SYSCALL_MMTOTYPE(SYSCALL_GROUP_SHMEM, 0x01)
@@ -224,6 +224,16 @@ struct _fs_unlink_args {
     int flag;
 };
 
+/** Arguments for SYSCALL_FS_COPY_FILE_RANGE */
+struct _fs_copy_file_range_args {
+    int fd_in;
+    off_t off_in;   /*!< Input and return value; -1 to use the file offset. */
+    int fd_out;
+    off_t off_out;  /*!< Input and return value; -1 to use the file offset. */
+    size_t len;
+    unsigned int flags;
+};
+
 /** Arguments for SYSCALL_PROC_CHDIR */
 struct _proc_chdir_args {
     int fd; /* if AT_FDARG */
@@ -464,6 +474,25 @@ ssize_t pwrite(int fildes, const void *buf, size_t nbytes, off_t offset);
  */
 ssize_t write(int fildes, const void * buf, size_t nbyte);
 
+/**
+ * Copy a range of data from one file descriptor to another.
+ * The data is copied inside the kernel without passing it through a user
+ * space buffer.
+ * @param infd      is the source file descriptor.
+ * @param inoffp    is a pointer to the source offset that is updated after
+ *                  the copy; if NULL the file offset of infd is used and
+ *                  updated.
+ * @param outfd     is the destination file descriptor.
+ * @param outoffp   is a pointer to the destination offset; if NULL the file
+ *                  offset of outfd is used and updated.
+ * @param len       is the number of bytes to copy.
+ * @param flags     must be 0.
+ * @return  Returns the number of bytes copied, that can be less than len
+ *          if EOF was reached; otherwise -1 and errno is set.
+ */
+ssize_t copy_file_range(int infd, off_t * inoffp, int outfd, off_t * outoffp,
+                        size_t len, unsigned int flags);
+
 /**
  * Reposition read/write file offset.
  * The lseek function repositions the offset of the file descriptor fildes
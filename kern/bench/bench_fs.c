@@ -0,0 +1,18 @@
+/**
+ * @file bench_fs.c
+ * @brief Benchmark the vfs.
+ */
+
+#include <fcntl.h>
+#include <fs/fs.h>
+#include <kbench.h>
+#include <proc.h>
+
+static void bench_lookup_vnode(void * arg)
+{
+    vnode_t * vn;
+
+    if (!lookup_vnode(&vn, curproc->croot, "dev/zero", O_RDONLY))
+        vrele(vn);
+}
+KBENCH(fs, lookup_vnode, bench_lookup_vnode, NULL, NULL);
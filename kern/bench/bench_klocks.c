@@ -0,0 +1,25 @@
+/**
+ * @file bench_klocks.c
+ * @brief Benchmark uncontended locking primitives.
+ */
+
+#include <kbench.h>
+#include <klocks.h>
+#include <rcu.h>
+
+static mtx_t bench_mtx = MTX_INITIALIZER(MTX_TYPE_SPIN, MTX_OPT_DEFAULT);
+
+static void bench_mtx_lock(void * arg)
+{
+    mtx_lock(&bench_mtx);
+    mtx_unlock(&bench_mtx);
+}
+KBENCH(klocks, mtx_lock, bench_mtx_lock, NULL, NULL);
+
+static void bench_rcu_read_lock(void * arg)
+{
+    struct rcu_lock_ctx ctx = rcu_read_lock();
+
+    rcu_read_unlock(&ctx);
+}
+KBENCH(klocks, rcu_read_lock, bench_rcu_read_lock, NULL, NULL);
@@ -0,0 +1,25 @@
+/**
+ * @file bench_kmem.c
+ * @brief Benchmark kernel memory allocators.
+ */
+
+#include <buf.h>
+#include <kbench.h>
+#include <kmalloc.h>
+
+static void bench_kmalloc(void * arg)
+{
+    void * p = kmalloc(64);
+
+    kfree(p);
+}
+KBENCH(kmem, kmalloc, bench_kmalloc, NULL, NULL);
+
+static void bench_geteblk(void * arg)
+{
+    struct buf * bp = geteblk(MMU_PGSIZE_COARSE);
+
+    if (bp)
+        bp->vm_ops->rfree(bp);
+}
+KBENCH(kmem, geteblk, bench_geteblk, NULL, NULL);
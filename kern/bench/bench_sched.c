@@ -0,0 +1,63 @@
+/**
+ * @file bench_sched.c
+ * @brief Benchmark scheduling.
+ */
+
+#include <errno.h>
+#include <hal/core.h>
+#include <kbench.h>
+#include <klocks.h>
+#include <thread.h>
+
+static void bench_thread_yield(void * arg)
+{
+    thread_yield(THREAD_YIELD_IMMEDIATE);
+}
+KBENCH(sched, thread_yield, bench_thread_yield, NULL, NULL);
+
+/*
+ * A peer thread yields back on every switch, so an iteration is a round trip
+ * of two context switches.
+ */
+
+static atomic_t ctxsw_stop;
+static atomic_t ctxsw_running;
+
+static void * ctxsw_peer(void * arg)
+{
+    atomic_set(&ctxsw_running, 1);
+    while (!atomic_read(&ctxsw_stop)) {
+        thread_yield(THREAD_YIELD_IMMEDIATE);
+    }
+    atomic_set(&ctxsw_running, 0);
+
+    return NULL;
+}
+
+static int ctxsw_setup(void ** arg)
+{
+    struct sched_param param = {
+        .sched_policy = current_thread->param.sched_policy,
+        .sched_priority = current_thread->param.sched_priority,
+    };
+
+    atomic_set(&ctxsw_stop, 0);
+    atomic_set(&ctxsw_running, 0);
+    if (kthread_create("kbench_ctxsw", &param, 0, ctxsw_peer, NULL) < 0)
+        return -EAGAIN;
+
+    while (!atomic_read(&ctxsw_running)) {
+        thread_yield(THREAD_YIELD_IMMEDIATE);
+    }
+
+    return 0;
+}
+
+static void ctxsw_teardown(void * arg)
+{
+    atomic_set(&ctxsw_stop, 1);
+    while (atomic_read(&ctxsw_running)) {
+        thread_yield(THREAD_YIELD_IMMEDIATE);
+    }
+}
+KBENCH(sched, ctxsw, bench_thread_yield, ctxsw_setup, ctxsw_teardown);
@@ -35,12 +35,15 @@
 #include <idle.h>
 #include <kstring.h>
 #include <sys/linker_set.h>
+#include <sys/sysctl.h>
 #include <sys/tree.h>
 #include <sys/types.h>
+#include <bioq.h>
 #include <buf.h>
 #include <fs/devfs.h>
 #include <kerror.h>
 #include <kmalloc.h>
+#include <ktrace.h>
 
 /*
  * Used to protect access caching data structures and synchronizing access
@@ -51,14 +54,23 @@
  */
 static mtx_t cache_lock = MTX_INITIALIZER(MTX_TYPE_SPIN, MTX_OPT_SLEEP |
                                                          MTX_OPT_PRICEIL);
+LOCKSTAT_MTX(cache_lock);
 static TAILQ_HEAD(bio_relse_list_head, buf) relse_list =
      TAILQ_HEAD_INITIALIZER(relse_list);
+static int nr_relse; /*!< Number of buffers in relse_list. */
+
+static int bio_maxbufs = 256;
+SYSCTL_INT(_vfs, OID_AUTO, bio_maxbufs, CTLFLAG_RW, &bio_maxbufs, 0,
+           "Max number of released buffers kept in the buffer cache");
 
 static void _bio_readin(struct buf * bp);
 static void _bio_writeout(struct buf * bp);
 static void bl_brelse(struct buf * bp);
 static int biowait_timo(struct buf * bp, long timeout);
 static void bio_clean(uintptr_t freebufs);
+static void relse_insert(struct buf * bp);
+static void relse_remove(struct buf * bp);
+static void bio_evict(void);
 
 SPLAY_GENERATE(bufhd_splay, buf, sentry_, biobuf_compar);
 
@@ -111,10 +123,39 @@ void bio_readin(struct buf * bp)
     BUF_UNLOCK(bp);
 }
 
+/*
+ * Get the block number of a buffer on the file used for its I/O.
+ */
+static size_t bio_devblk(struct buf * bp)
+{
+    return (bp->b_devfile.vnode) ? bp->b_dblkno : bp->b_blkno;
+}
+
+/*
+ * Get the request queue of the device backing a file and set the queue
+ * block number of bp.
+ */
+static struct bioq * bio_getq(file_t * file, struct buf * bp)
+{
+#ifdef configDEVFS
+    struct bioq * q;
+    size_t blkoff;
+
+    q = dev_getq(file->vnode, &blkoff);
+    if (q)
+        bp->b_qblkno = bio_devblk(bp) + blkoff;
+
+    return q;
+#else
+    return NULL;
+#endif
+}
+
 static void _bio_readin(struct buf * bp)
 {
     file_t * file;
     vnode_t * vnode;
+    struct bioq * q;
     struct uio uio;
 
     KASSERT(mtx_test(&bp->lock), "bp should be locked\n");
@@ -131,12 +172,29 @@ static void _bio_readin(struct buf * bp)
     vnode = file->vnode;
 
     bp->b_flags &= ~B_DONE;
+    KTRACE(BIO_READ, vnode->vn_num, bp->b_blkno, bp->b_bcount);
+
+    q = bio_getq(file, bp);
+    if (q) {
+        bp->b_flags &= ~(B_ASYNC | B_ERROR);
+        bp->b_flags |= B_READ;
+        bp->b_error = 0;
+
+        /* biodone() needs the buffer lock. */
+        BUF_UNLOCK(bp);
+        bioq_enqueue(q, bp);
+        biowait(bp);
+        BUF_LOCK(bp);
+
+        bp->b_flags &= ~B_READ;
+        return;
+    }
 
     if (uio_buf2kuio(bp, &uio)) {
         /* TODO Error handling */
         return;
     }
-    vnode->vnode_ops->lseek(file, bp->b_blkno, SEEK_SET);
+    vnode->vnode_ops->lseek(file, bio_devblk(bp), SEEK_SET);
     vnode->vnode_ops->read(file, &uio, bp->b_bcount);
 
     bp->b_flags |= B_DONE;
@@ -173,15 +231,17 @@ static void _bio_writeout(struct buf * bp)
         file = &bp->b_file;
     }
     vnode = file->vnode;
+    KTRACE(BIO_WRITE, vnode->vn_num, bp->b_blkno, bp->b_bcount);
 
     if (uio_buf2kuio(bp, &uio)) {
         /* TODO Error handling */
         return;
     }
-    vnode->vnode_ops->lseek(file, bp->b_blkno, SEEK_SET);
+    vnode->vnode_ops->lseek(file, bio_devblk(bp), SEEK_SET);
     vnode->vnode_ops->write(file, &uio, bp->b_bcount);
 
 out:
+    bp->b_flags &= ~B_DELWRI;
     bp->b_flags |= B_DONE;
 }
 
@@ -213,16 +273,38 @@ int bwrite(struct buf * bp)
 
     /* TODO Use dirty offsets */
     if (flags & B_ASYNC) {
-        /* TODO */
+        file_t * file = (bp->b_devfile.vnode) ? &bp->b_devfile : &bp->b_file;
+        struct bioq * q = bio_getq(file, bp);
+
+        /*
+         * The buffer is released by biodone() once the write is complete.
+         * Without a queue the write is done synchronously.
+         */
+        if (q && !(flags & B_NOSYNC)) {
+            mtx_lock(&cache_lock);
+            BUF_LOCK(bp);
+            bp->b_flags &= ~B_READ;
+            bp->b_flags |= B_ASYNC;
+            relse_insert(bp);
+            BUF_UNLOCK(bp);
+            mtx_unlock(&cache_lock);
 
-        return 0;
-    } else {
-        BUF_LOCK(bp);
-        _bio_writeout(bp);
-        bp->b_flags &= ~B_BUSY;
-        BUF_UNLOCK(bp);
+            KTRACE(BIO_WRITE, file->vnode->vn_num, bp->b_blkno,
+                   bp->b_bcount);
+            bioq_enqueue(q, bp);
+
+            return 0;
+        }
     }
 
+    BUF_LOCK(bp);
+    _bio_writeout(bp);
+    if (flags & B_ASYNC)
+        bl_brelse(bp);
+    else
+        bp->b_flags &= ~B_BUSY;
+    BUF_UNLOCK(bp);
+
     return 0;
 }
 
@@ -254,7 +336,10 @@ void bio_clrbuf(struct buf * bp)
     if (flags & B_DELWRI) {
         _bio_writeout(bp);
     } else if (flags & B_ASYNC) {
+        /* biodone() needs the buffer lock. */
+        BUF_UNLOCK(bp);
         biowait(bp);
+        BUF_LOCK(bp);
     }
     bp->b_flags &= ~(B_DELWRI | B_ERROR);
     bp->b_flags |= B_BUSY;
@@ -276,6 +361,7 @@ static struct buf * create_blk(vnode_t * vnode, size_t blkno, size_t size,
         return NULL;
 
     bp->b_blkno = blkno;
+    bp->b_dblkno = blkno;
 
     /* fd for the file */
     fs_fildes_set(&bp->b_file, vnode, O_RDWR);
@@ -296,6 +382,7 @@ static struct buf * create_blk(vnode_t * vnode, size_t blkno, size_t size,
 
     bp->b_flags |= B_DONE;
     bp->b_flags &= ~B_BUSY; /* Unbusy for now */
+    relse_insert(bp);
 
     VN_LOCK(vnode);
 
@@ -318,24 +405,33 @@ struct buf * getblk(vnode_t * vnode, size_t blkno, size_t size, int slptimeo)
     /* For now we want to synchronize access to this function. */
     mtx_lock(&cache_lock);
 
+retry:
     bp = incore(vnode, blkno);
     if (!bp) { /* Not found, create a new buffer. */
+        if (nr_relse >= bio_maxbufs)
+            bio_evict();
         bp = create_blk(vnode, blkno, size, slptimeo);
         if (!bp)
             goto fail;
     }
 
-    /* Found */
-retry:
-    biowait(bp); /* Wait until I/O has completed. */
-
     /*
-     * Wait until the buffer is released. It is possible that we don't get it
-     * locked for us on first try, so we just keep trying until it's not set
-     * busy by some other thread.
+     * Wait until I/O has completed and the buffer is released.
+     * cache_lock is dropped while waiting because the buffer is released
+     * by bl_brelse() that needs cache_lock. The buffer may be freed
+     * meanwhile, so it's looked up again.
      */
-    while (bp->b_flags & B_BUSY)
+    if ((bp->b_flags & B_BUSY) || !(bp->b_flags & B_DONE)) {
+        mtx_unlock(&cache_lock);
         thread_yield(THREAD_YIELD_LAZY);
+        mtx_lock(&cache_lock);
+        goto retry;
+    }
+
+    /*
+     * It is possible that we don't get it locked for us on first try, so we
+     * just keep trying until it's not set busy by some other thread.
+     */
     BUF_LOCK(bp);
     if (bp->b_flags & B_BUSY) {
         BUF_UNLOCK(bp);
@@ -343,7 +439,7 @@ retry:
     }
     bp->b_flags |= B_BUSY;
     /* Remove from the released list. */
-    TAILQ_REMOVE(&relse_list, bp, relse_entry_);
+    relse_remove(bp);
     BUF_UNLOCK(bp);
 
     allocbuf(bp, size); /* Resize if necessary */
@@ -380,14 +476,22 @@ struct buf * incore(vnode_t * vnode, size_t blkno)
     return bp;
 }
 
+/*
+ * Release a busy buffer.
+ * The buffer lock must be held, it's dropped and taken again after
+ * cache_lock to keep the cache_lock -> bp->lock order of getblk().
+ */
 static void bl_brelse(struct buf * bp)
 {
     KASSERT(mtx_test(&bp->lock), "Lock is required.");
 
+    BUF_UNLOCK(bp);
+    mtx_lock(&cache_lock);
+    BUF_LOCK(bp);
+
     bp->b_flags &= ~B_BUSY;
+    relse_insert(bp);
 
-    mtx_lock(&cache_lock);
-    TAILQ_INSERT_TAIL(&relse_list, bp, relse_entry_);
     mtx_unlock(&cache_lock);
 }
 
@@ -400,23 +504,62 @@ void brelse(struct buf * bp)
 
 void biodone(struct buf * bp)
 {
+    struct thread_info * waiter;
+
     BUF_LOCK(bp);
 
-    KASSERT(bp->b_flags & B_DONE, "dup biodone");
+    KASSERT(!(bp->b_flags & B_DONE), "dup biodone");
 
     bp->b_flags |= B_DONE;
+    waiter = bp->b_waiter;
+    bp->b_waiter = NULL;
 
+    /*
+     * An async buffer is already in the released list, cache_lock can't be
+     * taken here as its holder may be waiting for this queue.
+     */
     if (bp->b_flags & B_ASYNC)
-        bl_brelse(bp);
+        bp->b_flags &= ~B_BUSY;
 
     BUF_UNLOCK(bp);
+
+    /* bp may be already gone if it was a request on the waiter's stack. */
+    if (waiter)
+        thread_release(waiter->id);
 }
 
 static int biowait_timo(struct buf * bp, long timeout)
 {
     /* TODO timeout */
 
-    while (!(bp->b_flags & B_DONE));
+    while (1) {
+        BUF_LOCK(bp);
+        if (bp->b_flags & B_DONE) {
+            BUF_UNLOCK(bp);
+            break;
+        }
+
+        /*
+         * Only one thread can sleep on a buffer, there is no one to
+         * wake us up before the scheduler is running and the idle thread
+         * must never sleep.
+         */
+        if (!current_thread || bp->b_waiter ||
+            thread_flags_is_set(current_thread, SCHED_INTERNAL_FLAG)) {
+            BUF_UNLOCK(bp);
+            thread_yield(THREAD_YIELD_LAZY);
+            continue;
+        }
+
+        bp->b_waiter = current_thread;
+        /*
+         * Interrupts are disabled until thread_wait() so the
+         * thread_release() from biodone() can't be lost.
+         */
+        disable_interrupt();
+        BUF_UNLOCK(bp);
+        thread_wait();
+    }
 
     return bp->b_error;
 }
@@ -426,6 +569,35 @@ int biowait(struct buf * bp)
     return biowait_timo(bp, 0);
 }
 
+/*
+ * Start a delayed write through the request queue of the device.
+ * The buffer stays in the released list and it's unbusied by biodone() once
+ * the write is complete.
+ * cache_lock and the buffer lock must be held.
+ * @return Returns 1 if the write was queued; Otherwise 0.
+ */
+static int bio_qwrite(struct buf * bp)
+{
+    file_t * file = (bp->b_devfile.vnode) ? &bp->b_devfile : &bp->b_file;
+    struct bioq * q;
+
+    if (bp->b_flags & B_NOSYNC)
+        return 0;
+
+    q = bio_getq(file, bp);
+    if (!q)
+        return 0;
+
+    bp->b_flags &= ~(B_READ | B_DONE | B_ERROR | B_DELWRI);
+    bp->b_flags |= B_BUSY | B_ASYNC;
+    bp->b_error = 0;
+
+    KTRACE(BIO_WRITE, file->vnode->vn_num, bp->b_blkno, bp->b_bcount);
+    bioq_enqueue(q, bp);
+
+    return 1;
+}
+
 /**
  * Cleanup released buffers.
  * @param freebufs  tells if released buffers should be freed after write out.
@@ -442,13 +614,25 @@ static void bio_clean(uintptr_t freebufs)
         file_t * file;
 
         /* Skip if already locked or BUSY */
-        if (mtx_trylock(&bp->lock) || (bp->b_flags & B_BUSY))
+        if (mtx_trylock(&bp->lock))
+            continue;
+        if (bp->b_flags & B_BUSY) {
+            BUF_UNLOCK(bp);
             continue;
+        }
 
         file = &bp->b_file;
 
-        /* Write out if delayed write was set. */
+        /*
+         * Write out if delayed write was set. The idle thread can't wait
+         * for a queued write so the buffer is freed on a later round.
+         */
         if (bp->b_flags & B_DELWRI) {
+            if (bio_qwrite(bp)) {
+                BUF_UNLOCK(bp);
+                continue;
+            }
+
             bp->b_flags |= B_BUSY;
             bp->b_flags &= ~B_ASYNC;
 
@@ -459,7 +643,7 @@ static void bio_clean(uintptr_t freebufs)
             !(bp->b_flags & B_LOCKED) &&
             !VN_TRYLOCK(file->vnode)) {
             SPLAY_REMOVE(bufhd_splay, &file->vnode->vn_bpo.sroot, bp);
-            TAILQ_REMOVE(&relse_list, bp, relse_entry_);
+            relse_remove(bp);
             vrfree(bp);
             VN_UNLOCK(file->vnode);
         } else {
@@ -475,6 +659,136 @@ static void bio_clean(uintptr_t freebufs)
  */
 IDLE_TASK(bio_clean, 0);
 
+/*
+ * Insert a buffer to the released list unless it's already there.
+ * cache_lock must be held.
+ */
+static void relse_insert(struct buf * bp)
+{
+    if (bp->relse_entry_.tqe_prev)
+        return;
+
+    TAILQ_INSERT_TAIL(&relse_list, bp, relse_entry_);
+    nr_relse++;
+}
+
+/*
+ * Remove a buffer from the released list if it's there.
+ * cache_lock must be held.
+ */
+static void relse_remove(struct buf * bp)
+{
+    if (!bp->relse_entry_.tqe_prev)
+        return;
+
+    TAILQ_REMOVE(&relse_list, bp, relse_entry_);
+    bp->relse_entry_.tqe_prev = NULL;
+    nr_relse--;
+}
+
+/*
+ * Free a released buffer.
+ * cache_lock, the vnode lock and the buffer lock must be held, the buffer
+ * lock is released.
+ */
+static void bio_free(vnode_t * vnode, struct buf * bp)
+{
+    if (bp->b_flags & B_DELWRI) {
+        bp->b_flags |= B_BUSY;
+        bp->b_flags &= ~B_ASYNC;
+        _bio_writeout(bp);
+    }
+
+    SPLAY_REMOVE(bufhd_splay, &vnode->vn_bpo.sroot, bp);
+    relse_remove(bp);
+    BUF_UNLOCK(bp);
+    vrfree(bp);
+}
+
+/*
+ * Free the least recently released buffer that is not in use.
+ * cache_lock must be held.
+ */
+static void bio_evict(void)
+{
+    struct buf * bp;
+
+    TAILQ_FOREACH(bp, &relse_list, relse_entry_) {
+        vnode_t * vnode = bp->b_file.vnode;
+
+        if (!vnode || mtx_trylock(&bp->lock))
+            continue;
+        if ((bp->b_flags & (B_BUSY | B_LOCKED)) || VN_TRYLOCK(vnode)) {
+            BUF_UNLOCK(bp);
+            continue;
+        }
+
+        bio_free(vnode, bp);
+        VN_UNLOCK(vnode);
+        return;
+    }
+}
+
+void bio_vinval(vnode_t * vnode)
+{
+    struct buf * bp;
+    struct buf * nxt;
+
+    mtx_lock(&cache_lock);
+    VN_LOCK(vnode);
+    for (bp = SPLAY_MIN(bufhd_splay, &vnode->vn_bpo.sroot); bp; bp = nxt) {
+        nxt = SPLAY_NEXT(bufhd_splay, &vnode->vn_bpo.sroot, bp);
+
+        BUF_LOCK(bp);
+        if (bp->b_flags & B_BUSY) {
+            /* Can't be freed but the next user must refill it. */
+            bp->b_flags &= ~B_CACHE;
+            BUF_UNLOCK(bp);
+            continue;
+        }
+        bio_free(vnode, bp);
+    }
+    VN_UNLOCK(vnode);
+    mtx_unlock(&cache_lock);
+}
+
+void bio_vflush(vnode_t * vnode)
+{
+    struct buf * bp;
+
+    mtx_lock(&cache_lock);
+    VN_LOCK(vnode);
+    bp = SPLAY_MIN(bufhd_splay, &vnode->vn_bpo.sroot);
+    while (bp) {
+        struct buf * nxt;
+
+        BUF_LOCK(bp);
+        if ((bp->b_flags & (B_DELWRI | B_BUSY)) == B_DELWRI) {
+            /*
+             * A busy buffer is not freed so the other locks can be
+             * released for the duration of the write.
+             */
+            bp->b_flags |= B_BUSY;
+            bp->b_flags &= ~B_ASYNC;
+            VN_UNLOCK(vnode);
+            mtx_unlock(&cache_lock);
+
+            _bio_writeout(bp);
+
+            BUF_UNLOCK(bp);
+            mtx_lock(&cache_lock);
+            VN_LOCK(vnode);
+            BUF_LOCK(bp);
+            bp->b_flags &= ~B_BUSY;
+        }
+        nxt = SPLAY_NEXT(bufhd_splay, &vnode->vn_bpo.sroot, bp);
+        BUF_UNLOCK(bp);
+        bp = nxt;
+    }
+    VN_UNLOCK(vnode);
+    mtx_unlock(&cache_lock);
+}
+
 int bio_geterror(struct buf * bp)
 {
     int error = 0;
@@ -0,0 +1,417 @@
+/**
+ *******************************************************************************
+ * @file    bioq.c
+ * @author  Olli Vanhoja
+ * @brief   Block I/O request queue.
+ * @section LICENSE
+ * Copyright (c) 2026 Olli Vanhoja <olli.vanhoja@alumni.helsinki.fi>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+
+#include <errno.h>
+#include <sys/sysctl.h>
+#include <bioq.h>
+#include <buf.h>
+#include <fs/devfs.h>
+#include <hal/core.h>
+#include <hal/hw_timers.h>
+#include <kerror.h>
+#include <kmalloc.h>
+#include <kstring.h>
+#include <libkern.h>
+#include <thread.h>
+
+/**
+ * Max number of requests merged to a single transfer.
+ */
+#define BIOQ_MAX_RUN 16
+
+static int bioq_deadline_ms = 500;
+static int bioq_max_merge = 64 * 1024;
+static atomic_t bioq_depth;
+static atomic_t bioq_max_depth;
+static atomic_t bioq_requests;
+static atomic_t bioq_merged;
+static atomic_t bioq_dispatched;
+static atomic_t bioq_expired;
+
+SYSCTL_DECL(_vfs_bioq);
+SYSCTL_NODE(_vfs, OID_AUTO, bioq, CTLFLAG_RW, 0,
+            "Block I/O request queues");
+
+SYSCTL_INT(_vfs_bioq, OID_AUTO, deadline_ms, CTLFLAG_RW,
+           &bioq_deadline_ms, 0,
+           "Max time a request is bypassed by the elevator");
+SYSCTL_INT(_vfs_bioq, OID_AUTO, max_merge, CTLFLAG_RW,
+           &bioq_max_merge, 0,
+           "Max size of a merged transfer in bytes");
+SYSCTL_INT(_vfs_bioq, OID_AUTO, depth, CTLFLAG_RD,
+           (int *)&bioq_depth, 0,
+           "Number of queued requests");
+SYSCTL_INT(_vfs_bioq, OID_AUTO, max_depth, CTLFLAG_RD,
+           (int *)&bioq_max_depth, 0,
+           "Max number of queued requests seen");
+SYSCTL_INT(_vfs_bioq, OID_AUTO, requests, CTLFLAG_RD,
+           (int *)&bioq_requests, 0,
+           "Number of requests queued");
+SYSCTL_INT(_vfs_bioq, OID_AUTO, merged, CTLFLAG_RD,
+           (int *)&bioq_merged, 0,
+           "Number of requests merged to a preceding request");
+SYSCTL_INT(_vfs_bioq, OID_AUTO, dispatched, CTLFLAG_RD,
+           (int *)&bioq_dispatched, 0,
+           "Number of transfers started");
+SYSCTL_INT(_vfs_bioq, OID_AUTO, expired, CTLFLAG_RD,
+           (int *)&bioq_expired, 0,
+           "Number of requests served because of the deadline");
+
+static int bioq_oflags(struct buf * bp);
+static void * bioq_worker(void * arg);
+
+int bioq_create(struct dev_info * dev)
+{
+    struct bioq * q;
+    struct sched_param param = {
+        .sched_policy = SCHED_FIFO,
+        .sched_priority = NICE_MIN,
+    };
+    char name[40];
+
+    if ((dev->flags & (DEV_FLAGS_MB_READ | DEV_FLAGS_MB_WRITE)) !=
+        (DEV_FLAGS_MB_READ | DEV_FLAGS_MB_WRITE))
+        return -ENOTSUP;
+
+    q = kzalloc(sizeof(struct bioq));
+    if (!q)
+        return -ENOMEM;
+
+    mtx_init(&q->lock, MTX_TYPE_TICKET, 0);
+    TAILQ_INIT(&q->head);
+    q->dev = dev;
+
+    ksprintf(name, sizeof(name), "bioq_%s", dev->dev_name);
+    q->worker = kthread_create(name, &param, 0, bioq_worker, q);
+    if (q->worker < 0) {
+        int err = q->worker;
+
+        kfree(q);
+        return err;
+    }
+
+    dev->bioq = q;
+
+    return 0;
+}
+
+void bioq_enqueue(struct bioq * q, struct buf * bp)
+{
+    struct buf * it;
+    int depth, max;
+
+    bp->b_qtime = get_utime();
+
+    mtx_lock(&q->lock);
+    /*
+     * Keep the queue sorted by the block number. Requests to the same block
+     * are kept in the FIFO order.
+     */
+    TAILQ_FOREACH(it, &q->head, ioq_entry_) {
+        if (it->b_qblkno > bp->b_qblkno)
+            break;
+    }
+    if (it)
+        TAILQ_INSERT_BEFORE(it, bp, ioq_entry_);
+    else
+        TAILQ_INSERT_TAIL(&q->head, bp, ioq_entry_);
+    q->depth++;
+
+    /*
+     * The depth is shared by all queues so the max is updated with cmpxchg
+     * rather than relying on the lock of this queue only.
+     */
+    depth = atomic_inc(&bioq_depth) + 1;
+    do {
+        max = atomic_read(&bioq_max_depth);
+    } while (depth > max &&
+             atomic_cmpxchg(&bioq_max_depth, max, depth) != max);
+    mtx_unlock(&q->lock);
+
+    atomic_inc(&bioq_requests);
+
+    thread_release(q->worker);
+}
+
+void bioq_plug(struct bioq * q)
+{
+    mtx_lock(&q->lock);
+    q->plugged++;
+    mtx_unlock(&q->lock);
+}
+
+void bioq_unplug(struct bioq * q)
+{
+    mtx_lock(&q->lock);
+    KASSERT(q->plugged > 0, "bioq not plugged");
+    q->plugged--;
+    mtx_unlock(&q->lock);
+
+    thread_release(q->worker);
+}
+
+/**
+ * Get the block following a request.
+ */
+static size_t bioq_endblk(struct bioq * q, struct buf * bp)
+{
+    return bp->b_qblkno + bp->b_bcount / q->dev->block_size;
+}
+
+/**
+ * Select the next request.
+ * The oldest request is selected if it has passed the deadline, otherwise
+ * the first one at or after the current position, wrapping around to the
+ * lowest block number.
+ */
+static struct buf * bioq_select(struct bioq * q)
+{
+    const uint64_t deadline = (uint64_t)bioq_deadline_ms * 1000;
+    const uint64_t now = get_utime();
+    struct buf * oldest = NULL;
+    struct buf * next = NULL;
+    struct buf * bp;
+
+    TAILQ_FOREACH(bp, &q->head, ioq_entry_) {
+        if (!oldest || bp->b_qtime < oldest->b_qtime)
+            oldest = bp;
+        if (!next && bp->b_qblkno >= q->pos)
+            next = bp;
+    }
+
+    if (oldest && now - oldest->b_qtime > deadline) {
+        atomic_inc(&bioq_expired);
+        return oldest;
+    }
+
+    return (next) ? next : TAILQ_FIRST(&q->head);
+}
+
+/**
+ * Take the next request and the requests adjacent to it.
+ * @param q     is a locked request queue.
+ * @param run   is an array of BIOQ_MAX_RUN buffers.
+ * @return Returns the number of buffers taken.
+ */
+static size_t bioq_take_run(struct bioq * q, struct buf ** run)
+{
+    const size_t block_size = q->dev->block_size;
+    struct buf * bp;
+    size_t n = 0;
+    size_t bytes;
+    unsigned long dir;
+
+    if (q->plugged || !(bp = bioq_select(q)))
+        return 0;
+
+    dir = bp->b_flags & B_READ;
+    bytes = bp->b_bcount;
+    do {
+        struct buf * next = TAILQ_NEXT(bp, ioq_entry_);
+
+        TAILQ_REMOVE(&q->head, bp, ioq_entry_);
+        run[n++] = bp;
+
+        if (!next || n == BIOQ_MAX_RUN ||
+            (next->b_flags & B_READ) != dir ||
+            bioq_oflags(next) != bioq_oflags(bp) ||
+            next->b_qblkno != bioq_endblk(q, bp) ||
+            bp->b_bcount % block_size != 0 ||
+            bytes + next->b_bcount > (size_t)bioq_max_merge)
+            break;
+
+        bytes += next->b_bcount;
+        bp = next;
+    } while (1);
+
+    q->depth -= n;
+    q->pos = bioq_endblk(q, run[n - 1]);
+
+    return n;
+}
+
+/**
+ * Complete a request.
+ */
+static void bioq_done(struct buf * bp, ssize_t ret)
+{
+    if (ret < 0 || (size_t)ret != bp->b_bcount) {
+        bp->b_flags |= B_ERROR;
+        bp->b_error = (ret < 0) ? ret : -EIO;
+    }
+    biodone(bp);
+}
+
+/**
+ * Get the open flags of the file used for the I/O of a request.
+ */
+static int bioq_oflags(struct buf * bp)
+{
+    return (bp->b_devfile.vnode) ? bp->b_devfile.oflags : bp->b_file.oflags;
+}
+
+/**
+ * Transfer a single request.
+ * The transfer is retried like dev_read() and dev_write() would do.
+ */
+static ssize_t bioq_io(struct dev_info * dev, struct buf * bp)
+{
+    uint8_t * data = (uint8_t *)bp->b_data;
+    const int oflags = bioq_oflags(bp);
+    int tries = DEV_RW_MAX_TRIES;
+    ssize_t ret;
+
+    do {
+        ret = (bp->b_flags & B_READ) ?
+            dev->read(dev, bp->b_qblkno, data, bp->b_bcount, oflags) :
+            dev->write(dev, bp->b_qblkno, data, bp->b_bcount, oflags);
+    } while (ret < 0 && --tries > 0);
+
+    return ret;
+}
+
+/**
+ * Test if the buffers of a run are contiguous in memory.
+ */
+static int bioq_run_contig(struct buf ** run, size_t n)
+{
+    for (size_t i = 1; i < n; i++) {
+        if (run[i]->b_data != run[i - 1]->b_data + run[i - 1]->b_bcount)
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Start a merged transfer.
+ * A bounce buffer is used if the buffers aren't contiguous in memory, if
+ * one can't be allocated or the transfer fails the requests are transferred
+ * and retried one by one.
+ */
+static void bioq_dispatch(struct bioq * q, struct buf ** run, size_t n)
+{
+    struct dev_info * dev = q->dev;
+    const int rd = run[0]->b_flags & B_READ;
+    size_t bytes = 0;
+    uint8_t * data;
+    uint8_t * bounce = NULL;
+    int oflags;
+    ssize_t ret;
+
+    atomic_sub(&bioq_depth, n);
+
+    if (!rd && !dev->write) {
+        for (size_t i = 0; i < n; i++) {
+            bioq_done(run[i], -EOPNOTSUPP);
+        }
+        return;
+    }
+
+    if (n == 1)
+        goto single;
+
+    for (size_t i = 0; i < n; i++) {
+        bytes += run[i]->b_bcount;
+    }
+
+    if (bioq_run_contig(run, n)) {
+        data = (uint8_t *)run[0]->b_data;
+    } else {
+        bounce = kmalloc(bytes);
+        if (!bounce)
+            goto single;
+        data = bounce;
+
+        if (!rd) {
+            size_t off = 0;
+
+            for (size_t i = 0; i < n; i++) {
+                memcpy(data + off, (void *)run[i]->b_data, run[i]->b_bcount);
+                off += run[i]->b_bcount;
+            }
+        }
+    }
+
+    atomic_inc(&bioq_dispatched);
+    atomic_add(&bioq_merged, n - 1);
+    oflags = bioq_oflags(run[0]);
+    ret = (rd) ? dev->read(dev, run[0]->b_qblkno, data, bytes, oflags) :
+                 dev->write(dev, run[0]->b_qblkno, data, bytes, oflags);
+    if (ret < 0 || (size_t)ret != bytes) {
+        kfree(bounce);
+        goto single;
+    }
+
+    for (size_t i = 0, off = 0; i < n; i++) {
+        if (rd && bounce)
+            memcpy((void *)run[i]->b_data, data + off, run[i]->b_bcount);
+        off += run[i]->b_bcount;
+        bioq_done(run[i], run[i]->b_bcount);
+    }
+    kfree(bounce);
+
+    return;
+single:
+    for (size_t i = 0; i < n; i++) {
+        atomic_inc(&bioq_dispatched);
+        bioq_done(run[i], bioq_io(dev, run[i]));
+    }
+}
+
+static void * bioq_worker(void * arg)
+{
+    struct bioq * q = (struct bioq *)arg;
+    struct buf * run[BIOQ_MAX_RUN];
+
+    while (1) {
+        size_t n;
+
+        mtx_lock(&q->lock);
+        n = bioq_take_run(q, run);
+        if (n == 0) {
+            /*
+             * Interrupts are disabled until thread_wait() so a
+             * thread_release() from bioq_enqueue() can't be lost.
+             */
+            disable_interrupt();
+            mtx_unlock(&q->lock);
+            thread_wait();
+            continue;
+        }
+        mtx_unlock(&q->lock);
+
+        bioq_dispatch(q, run, n);
+    }
+
+    return NULL;
+}
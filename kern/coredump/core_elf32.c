@@ -45,7 +45,8 @@
 #include <proc.h>
 
 #define SKIP_REGION(_region) \
-    ((!_region) || (_region)->b_flags & B_NOCORE || (_region)->b_data == 0 || \
+    ((!_region) || (_region)->b_flags & B_NOCORE || \
+     ((_region)->b_data == 0 && !(_region)->b_pages) || \
      (_region)->b_mmu.vaddr == 0)
 
 static off_t write2file(file_t * file, void * p, size_t size)
@@ -391,6 +392,35 @@ static int create_pheaders(const struct vm_mm_struct * mm, size_t notes_size,
     return phnum;
 }
 
+/**
+ * Dump an on-demand region page by page.
+ * Unpopulated pages are dumped as zeros without populating them.
+ */
+static off_t dump_lazy_region(file_t * file, struct buf * region)
+{
+    kmalloc_autofree void * zpage = NULL;
+
+    for (size_t i = 0; i < region->b_mmu.num_pages; i++) {
+        void * p = (void *)vr_pageaddr(region, i);
+        off_t err;
+
+        if (!p) {
+            if (!zpage) {
+                zpage = kzalloc(MMU_PGSIZE_COARSE);
+                if (!zpage)
+                    return -ENOMEM;
+            }
+            p = zpage;
+        }
+
+        err = write2file(file, p, MMU_PGSIZE_COARSE);
+        if (err != MMU_PGSIZE_COARSE)
+            return err;
+    }
+
+    return region->b_bufsize;
+}
+
 static off_t dump_regions(file_t * file, const struct vm_mm_struct * mm)
 {
     off_t err, off = 0;
@@ -401,7 +431,10 @@ static off_t dump_regions(file_t * file, const struct vm_mm_struct * mm)
         if (SKIP_REGION(region))
             continue;
 
-        err = write2file(file, (void *)region->b_data, region->b_bufsize);
+        if (region->b_pages)
+            err = dump_lazy_region(file, region);
+        else
+            err = write2file(file, (void *)region->b_data, region->b_bufsize);
         if (err != region->b_bufsize)
             return err;
         off += off;
@@ -34,6 +34,7 @@
 #include <errno.h>
 #include <sys/dev_major.h>
 #include <sys/ioctl.h>
+#include <bioq.h>
 #include <fs/devfs.h>
 #include <fs/fs.h>
 #include <fs/fs_util.h>
@@ -46,11 +47,6 @@
 #include <libkern.h>
 #include <proc.h>
 
-/**
- * Max tries in case of block read/write returns 0.
- */
-#define RW_MAX_TRIES 3
-
 static int devfs_mount(fs_t * fs, const char * source, uint32_t mode,
                        const char * parm, int parm_len,
                        struct fs_superblock ** sb);
@@ -147,6 +143,14 @@ int make_dev(struct dev_info * devnfo, uid_t uid, gid_t gid, int perms,
     if (!vn_devfs->vnode_ops->lookup(vn_devfs, devnfo->dev_name, NULL))
         return -EEXIST;
 
+    if (S_ISBLK(mode) && (devnfo->flags & DEV_FLAGS_BIOQ) && !devnfo->bioq) {
+        err = bioq_create(devnfo);
+        if (err) {
+            KERROR(KERROR_WARN, "Failed to create a bioq for %s (%d)\n",
+                   devnfo->dev_name, err);
+        }
+    }
+
     err = devfs_vnode_ops.mknod(vn_devfs, devnfo->dev_name, mode, devnfo, &vn);
     if (err)
         return err;
@@ -234,6 +238,43 @@ int devfs_lookup(vnode_t ** result, char * str)
     return 0;
 }
 
+struct bioq * dev_getq(vnode_t * vnode, size_t * blkoff)
+{
+    struct dev_info * devnfo;
+
+    if (!S_ISBLK(vnode->vn_mode) || vnode->vnode_ops != &devfs_vnode_ops)
+        return NULL;
+
+    devnfo = (struct dev_info *)vnode->vn_specinfo;
+    *blkoff = devnfo->bioq_blkoff;
+    return devnfo->bioq;
+}
+
+/**
+ * Transfer through the request queue of a device.
+ * The request is a temporary buffer around the caller's data.
+ */
+static ssize_t dev_bioq_rw(struct dev_info * devnfo, off_t blkno,
+                           uint8_t * buf, size_t bcount, int oflags, int rd)
+{
+    struct buf bp = {
+        .b_data = (uintptr_t)buf,
+        .b_bufsize = bcount,
+        .b_bcount = bcount,
+        .b_blkno = blkno,
+        .b_qblkno = blkno + devnfo->bioq_blkoff,
+        .b_flags = (rd) ? B_READ : 0,
+        .b_file.oflags = oflags,
+    };
+    int err;
+
+    mtx_init(&bp.lock, MTX_TYPE_TICKET, 0);
+    bioq_enqueue(devnfo->bioq, &bp);
+    err = biowait(&bp);
+
+    return (err) ? err : (ssize_t)bcount;
+}
+
 ssize_t dev_read(file_t * file, struct uio * uio, size_t bcount)
 {
     vnode_t * const vnode = file->vnode;
@@ -253,6 +294,11 @@ ssize_t dev_read(file_t * file, struct uio * uio, size_t bcount)
     if (err)
         return err;
 
+    if (devnfo->bioq) {
+        bytes_rd = dev_bioq_rw(devnfo, offset, buf, bcount, oflags, 1);
+        goto out;
+    }
+
     if ((devnfo->flags & DEV_FLAGS_MB_READ) &&
             ((bcount / devnfo->block_size) > 1)) {
         return devnfo->read(devnfo, offset, buf, bcount, oflags);
@@ -261,7 +307,7 @@ ssize_t dev_read(file_t * file, struct uio * uio, size_t bcount)
     buf_offset = 0;
     block_offset = 0;
     do {
-        int tries = RW_MAX_TRIES;
+        int tries = DEV_RW_MAX_TRIES;
         size_t to_read = (bcount > devnfo->block_size) ?
             devnfo->block_size : bcount;
         ssize_t ret;
@@ -305,6 +351,11 @@ ssize_t dev_write(file_t * file, struct uio * uio, size_t bcount)
     if (err)
         return err;
 
+    if (devnfo->bioq) {
+        bytes_wr = dev_bioq_rw(devnfo, offset, buf, bcount, oflags, 0);
+        goto out;
+    }
+
     if ((devnfo->flags & DEV_FLAGS_MB_WRITE) &&
             ((bcount / devnfo->block_size) > 1)) {
         return devnfo->write(devnfo, offset, buf, bcount, oflags);
@@ -313,7 +364,7 @@ ssize_t dev_write(file_t * file, struct uio * uio, size_t bcount)
     buf_offset = 0;
     block_offset = 0;
     do {
-        int tries = RW_MAX_TRIES;
+        int tries = DEV_RW_MAX_TRIES;
         size_t to_write = (bcount > devnfo->block_size) ?
             devnfo->block_size : bcount;
         ssize_t ret;
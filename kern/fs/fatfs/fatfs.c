@@ -38,6 +38,7 @@
 #include <sys/ioctl.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
+#include <buf.h>
 #include <kerror.h>
 #include <kinit.h>
 #include <kstring.h>
@@ -60,6 +61,8 @@ static int fatfs_statfs(struct fs_superblock * sb, struct statfs * st);
 static int fatfs_delete_vnode(vnode_t * vnode);
 static int fatfs_event_vnode_opened(struct proc_info * p, vnode_t * vnode);
 static void fatfs_event_file_closed(struct proc_info * p, file_t * file);
+static void fatfs_event_file_destroyed(file_t * file);
+static ssize_t fatfs_getdents(file_t * file, void * buf, size_t bytes);
 static int fatfs_lookup(vnode_t * dir, const char * name, vnode_t ** result);
 static void init_fatfs_vnode(vnode_t * vnode, ino_t inum, mode_t mode,
                              struct fs_superblock * sb);
@@ -82,6 +85,7 @@ vnode_ops_t fatfs_vnode_ops = {
     .read = fatfs_read,
     .event_vnode_opened = fatfs_event_vnode_opened,
     .event_fd_closed = fatfs_event_file_closed,
+    .event_file_destroyed = fatfs_event_file_destroyed,
     .create = fatfs_create,
     .mknod = fatfs_mknod,
     .lookup = fatfs_lookup,
@@ -89,6 +93,7 @@ vnode_ops_t fatfs_vnode_ops = {
     .mkdir = fatfs_mkdir,
     .rmdir = fatfs_rmdir,
     .readdir = fatfs_readdir,
+    .getdents = fatfs_getdents,
     .stat = fatfs_stat,
     .chmod = fatfs_chmod,
     .chflags = fatfs_chflags,
@@ -271,11 +276,10 @@ static int fatfs_mount(fs_t * fs, const char * source, uint32_t mode,
     }
     KERROR_DBG("Initialized a work area for FAT\n");
 
-#if (_FS_NOFSINFO == 0) /* Commit full scan of free clusters */
-    DWORD nclst;
-
-    f_getfree(&fatfs_sb->ff_fs, &nclst);
-#endif
+    /*
+     * The free cluster count is not needed for mounting, a full scan of the
+     * FAT is done by the first statfs if FSINFO doesn't have the count.
+     */
 
     /* Init super block */
     fs_init_superblock(&fatfs_sb->sb, fs);
@@ -381,6 +385,7 @@ static int create_inode(struct fatfs_inode ** result, struct fatfs_sb * sb,
     in->in_fpath = fpath;
 
     in->open_count = ATOMIC_INIT(0);
+    mtx_init(&in->lock, MTX_TYPE_TICKET, MTX_OPT_SLEEP);
 
     memset(&fno, 0, sizeof(fno));
 
@@ -397,6 +402,9 @@ static int create_inode(struct fatfs_inode ** result, struct fatfs_sb * sb,
             retval = fresult2errno(err);
             goto fail;
         }
+        /* Saves another path walk in the following stat. */
+        in->attr = fno;
+        in->attr_valid = 1;
     }
 
     /* Try open */
@@ -472,6 +480,8 @@ fail:
 #ifdef configFATFS_DEBUG
     FS_KERROR_FS(KERROR_DEBUG, sb->sb.fs, "retval for %s: %i\n", fpath, retval);
 #endif
+    if (in)
+        in->attr_valid = 0;
 
     inpool_insert_clean(&sb->inpool, vn); /* Return it back to the pool. */
     return retval;
@@ -488,6 +498,11 @@ static void finalize_inode(vnode_t * vnode)
 
     vrele_nunlink(vnode); /* If called by inpool */
     vfs_hash_remove(vfs_hash_ctx, &in->in_vnode);
+    bio_vinval(vnode); /* The inode is recycled. */
+    kfree(in->clmt);
+    for (size_t i = 0; i < FATFS_NEGCACHE_SIZE; i++) {
+        kfree(in->neg[i]);
+    }
 
     /*
      * We use a negative value of vn_len to mark a deleted directory entry,
@@ -502,6 +517,102 @@ static void finalize_inode(vnode_t * vnode)
     memset(in, 0, sizeof(*in));
 }
 
+/**
+ * Get the attributes of an inode.
+ * The directory entry is read only if the cached attributes are invalid.
+ */
+static FRESULT fatfs_getattr(struct fatfs_sb * ffsb, struct fatfs_inode * in,
+                             FILINFO * fno)
+{
+    FRESULT err = FR_OK;
+
+    mtx_lock(&in->lock);
+    if (!in->attr_valid) {
+        memset(&in->attr, 0, sizeof(in->attr));
+        err = f_stat(&ffsb->ff_fs, in->in_fpath, &in->attr);
+        in->attr_valid = (err == FR_OK);
+    }
+    if (err == FR_OK)
+        *fno = in->attr;
+    mtx_unlock(&in->lock);
+
+    return err;
+}
+
+/**
+ * Invalidate the cached attributes of an inode.
+ * Must be called after the directory entry was modified.
+ */
+static void fatfs_invalattr(struct fatfs_inode * in)
+{
+    mtx_lock(&in->lock);
+    in->attr_valid = 0;
+    mtx_unlock(&in->lock);
+}
+
+/**
+ * Check if name is cached as nonexistent in a directory.
+ * @param[out] gen returns the generation of the cache to be passed to
+ *                 fatfs_neg_insert().
+ */
+static int fatfs_neg_lookup(struct fatfs_inode * indir, const char * name,
+                            unsigned * gen)
+{
+    int found = 0;
+
+    mtx_lock(&indir->lock);
+    for (size_t i = 0; i < FATFS_NEGCACHE_SIZE; i++) {
+        if (indir->neg[i] && !strcmp(indir->neg[i], name)) {
+            found = 1;
+            break;
+        }
+    }
+    *gen = indir->neg_gen;
+    mtx_unlock(&indir->lock);
+
+    return found;
+}
+
+/**
+ * Cache name as nonexistent in a directory.
+ * Nothing is cached if the cache was cleared after the lookup that returned
+ * gen because the entry may have been created since.
+ */
+static void fatfs_neg_insert(struct fatfs_inode * indir, const char * name,
+                             unsigned gen)
+{
+    char * s = kstrdup(name, NAME_MAX + 1);
+
+    if (!s)
+        return;
+
+    mtx_lock(&indir->lock);
+    if (indir->neg_gen == gen) {
+        kfree(indir->neg[indir->neg_next]);
+        indir->neg[indir->neg_next] = s;
+        indir->neg_next = (indir->neg_next + 1) % FATFS_NEGCACHE_SIZE;
+        s = NULL;
+    }
+    mtx_unlock(&indir->lock);
+
+    kfree(s);
+}
+
+/**
+ * Clear the negative lookup cache of a directory.
+ * Must be called when an entry is created in the directory.
+ */
+static void fatfs_neg_clear(struct fatfs_inode * indir)
+{
+    mtx_lock(&indir->lock);
+    for (size_t i = 0; i < FATFS_NEGCACHE_SIZE; i++) {
+        kfree(indir->neg[i]);
+        indir->neg[i] = NULL;
+    }
+    indir->neg_gen++;
+    mtx_unlock(&indir->lock);
+}
+
 /**
  * This function is called when a pooled inode should be freed.
  */
@@ -574,8 +685,13 @@ static int fatfs_delete_vnode(vnode_t * vnode)
     vrele_nunlink(vnode);
 
     if (vrefcnt(vnode) > 0) {
-        if (!S_ISDIR(vnode->vn_mode))
+        if (!S_ISDIR(vnode->vn_mode)) {
+            bio_vflush(vnode);
+            mtx_lock(&in->lock);
             f_sync(&in->fp);
+            in->attr_valid = 0;
+            mtx_unlock(&in->lock);
+        }
     } else {
         finalize_inode(vnode);
         /* Recycle the inode */
@@ -585,10 +701,64 @@ static int fatfs_delete_vnode(vnode_t * vnode)
     return 0;
 }
 
+/**
+ * Build the cluster link map of a file.
+ * The caller must hold in->lock.
+ */
+static int fatfs_build_clmt(struct fatfs_inode * in)
+{
+    DWORD * tbl = in->clmt;
+    size_t len = (tbl) ? in->clmt_len : FATFS_CLMT_INIT;
+    int err;
+
+    in->clmt = NULL;
+    in->clmt_valid = 0;
+
+    do {
+        if (!tbl) {
+            tbl = kmalloc(len * sizeof(DWORD));
+            if (!tbl)
+                return -ENOMEM;
+        }
+
+        tbl[0] = len;
+        in->fp.cltbl = tbl;
+        err = f_lseek(&in->fp, CREATE_LINKMAP);
+        in->fp.cltbl = NULL;
+
+        if (err == FR_NOT_ENOUGH_CORE) {
+            /* The required size is returned in tbl[0]. */
+            len = tbl[0];
+            kfree(tbl);
+            tbl = NULL;
+        }
+    } while (err == FR_NOT_ENOUGH_CORE);
+    if (err) {
+        kfree(tbl);
+        return fresult2errno(err);
+    }
+
+    in->clmt = tbl;
+    in->clmt_len = len;
+    in->clmt_valid = 1;
+
+    return 0;
+}
+
 static int fatfs_event_vnode_opened(struct proc_info * p, vnode_t * vnode)
 {
     struct fatfs_inode * in = get_inode_of_vnode(vnode);
 
+    /*
+     * Failing to build the map only makes seeking slower.
+     */
+    if (S_ISREG(vnode->vn_mode)) {
+        mtx_lock(&in->lock);
+        if (!in->clmt_valid)
+            (void)fatfs_build_clmt(in);
+        mtx_unlock(&in->lock);
+    }
+
     atomic_inc(&in->open_count);
 
     return 0;
@@ -601,11 +771,30 @@ static void fatfs_event_file_closed(struct proc_info * p, file_t * file)
     /*
      * Sync on close.
      */
-    f_sync(&in->fp);
+    if (S_ISREG(file->vnode->vn_mode)) {
+        bio_vflush(file->vnode);
+        mtx_lock(&in->lock);
+        f_sync(&in->fp);
+        in->attr_valid = 0;
+        mtx_unlock(&in->lock);
+    }
 
     atomic_dec(&in->open_count);
 }
 
+static void fatfs_event_file_destroyed(file_t * file)
+{
+    /*
+     * The directory cursor is shared by all descriptors of the file after
+     * dup() or fork() and a getdents() may be still using it while one of
+     * them is closed.
+     */
+    if (S_ISDIR(file->vnode->vn_mode)) {
+        kfree(file->stream);
+        file->stream = NULL;
+    }
+}
+
 /**
  * Lookup for a vnode (file/dir) in FatFs.
  * First lookup form vfs_hash and if not found then read it from ff which will
@@ -706,9 +895,15 @@ static int fatfs_lookup(vnode_t * dir, const char * name, vnode_t ** result)
         retval = 0;
     } else { /* not cached */
         struct fatfs_inode * in = NULL;
+        unsigned neg_gen;
 
         KERROR_DBG("%s: vn not in vfs_hash\n", __func__);
 
+        if (fatfs_neg_lookup(indir, name, &neg_gen)) {
+            kfree(in_fpath);
+            return -ENOENT;
+        }
+
         /*
          * Create a inode and fetch data from the device.
          * This also vrefs.
@@ -718,6 +913,8 @@ static int fatfs_lookup(vnode_t * dir, const char * name, vnode_t ** result)
             KASSERT(in != NULL, "in must be set");
             in_fpath = NULL; /* shall not be freed. */
             *result = &in->in_vnode;
+        } else if (retval == -ENOENT) {
+            fatfs_neg_insert(indir, name, neg_gen);
         }
     }
 
@@ -725,57 +922,362 @@ static int fatfs_lookup(vnode_t * dir, const char * name, vnode_t ** result)
     return retval;
 }
 
+/**
+ * Test if the file pages can be transferred through the buffer cache.
+ * A page is contiguous on the device only if it's within a single cluster,
+ * otherwise the file data is accessed with f_read() and f_write().
+ */
+static int fatfs_pageio(struct fatfs_inode * in)
+{
+    const FATFS * fs = in->fp.fs;
+
+    return ((size_t)fs->csize * fs->ssize) % FATFS_PAGE_SIZE == 0;
+}
+
+/**
+ * Get the first sector of a page on the device.
+ * The page is translated with the cluster link map.
+ * The caller must hold in->lock.
+ * @return Returns the sector number; 0 if the page is not allocated.
+ */
+static DWORD fatfs_page2sect(struct fatfs_inode * in, size_t pgno)
+{
+    FATFS * fs = in->fp.fs;
+    const size_t bcs = (size_t)fs->csize * fs->ssize;
+    const size_t off = pgno * FATFS_PAGE_SIZE;
+    DWORD * tbl;
+    DWORD cl;
+    DWORD sect;
+
+    if (!in->clmt_valid && fatfs_build_clmt(in))
+        return 0;
+
+    /* The fragments are pairs of a length and a start cluster. */
+    cl = off / bcs;
+    tbl = in->clmt + 1;
+    while (tbl[0] && cl >= tbl[0]) {
+        cl -= tbl[0];
+        tbl += 2;
+    }
+    if (!tbl[0])
+        return 0;
+
+    sect = clust2sect(fs, tbl[1] + cl);
+    if (!sect)
+        return 0;
+
+    return sect + (off % bcs) / fs->ssize;
+}
+
+/**
+ * Fill a page from the file.
+ * The part of the page at and after fill_end is zeroed.
+ * The caller must hold in->lock and the page must be busy.
+ * @param in        is the inode.
+ * @param bp        is the page.
+ * @param fill_end  is the end of the valid file data, at most the file size.
+ */
+static int fatfs_fillpage(struct fatfs_inode * in, struct buf * bp,
+                          size_t fill_end)
+{
+    const size_t off = bp->b_blkno * FATFS_PAGE_SIZE;
+    size_t count_out = 0;
+    int err;
+
+    if (off < fill_end && fatfs_pageio(in)) {
+        DWORD sect = fatfs_page2sect(in, bp->b_blkno);
+
+        if (!sect)
+            return -EIO;
+
+        bp->b_dblkno = sect;
+        bio_readin(bp);
+        err = bio_geterror(bp);
+        if (err)
+            return err;
+        count_out = min(fill_end - off, FATFS_PAGE_SIZE);
+    } else if (off < fill_end) {
+        if (!in->clmt_valid)
+            (void)fatfs_build_clmt(in);
+
+        /*
+         * Use fast seek if the cluster link map is available, this also
+         * avoids locking the whole volume.
+         */
+        in->fp.cltbl = (in->clmt_valid) ? in->clmt : NULL;
+        err = f_lseek(&in->fp, off);
+        if (!err)
+            err = f_read(&in->fp, (void *)bp->b_data,
+                         min(fill_end - off, FATFS_PAGE_SIZE), &count_out);
+        in->fp.cltbl = NULL;
+        if (err)
+            return fresult2errno(err);
+    }
+    memset((uint8_t *)bp->b_data + count_out, 0, FATFS_PAGE_SIZE - count_out);
+
+    BUF_LOCK(bp);
+    bp->b_flags |= B_CACHE;
+    BUF_UNLOCK(bp);
+
+    return 0;
+}
+
+/**
+ * Get a page of file data from the buffer cache.
+ * The page is filled from the file if its contents are not valid.
+ * in->lock is always taken before the page is made busy, like fatfs_write()
+ * does, and never while holding a busy page.
+ * @param in    is the inode.
+ * @param pgno  is the page number in the file.
+ * @param bpp   returns the busy buffer of the page.
+ */
+static int fatfs_getpage(struct fatfs_inode * in, size_t pgno,
+                         struct buf ** bpp)
+{
+    struct buf * bp;
+    int err;
+
+    bp = getblk(&in->in_vnode, pgno, FATFS_PAGE_SIZE, 0);
+    if (!bp)
+        return -ENOMEM;
+
+    if (!(bp->b_flags & B_CACHE)) {
+        brelse(bp);
+
+        mtx_lock(&in->lock);
+        bp = getblk(&in->in_vnode, pgno, FATFS_PAGE_SIZE, 0);
+        if (!bp) {
+            mtx_unlock(&in->lock);
+            return -ENOMEM;
+        }
+        if (bp->b_flags & B_CACHE) {
+            /* Filled by another thread meanwhile. */
+            mtx_unlock(&in->lock);
+            *bpp = bp;
+            return 0;
+        }
+
+        err = fatfs_fillpage(in, bp, in->fp.fsize);
+        mtx_unlock(&in->lock);
+        if (err) {
+            brelse(bp);
+            return err;
+        }
+    }
+
+    *bpp = bp;
+    return 0;
+}
+
+/**
+ * Update the cached pages overlapping a write.
+ * Pages that are not cached are not created.
+ */
+static void fatfs_update_pages(struct fatfs_inode * in, off_t off,
+                               const uint8_t * data, size_t count)
+{
+    while (count > 0) {
+        const size_t pgno = off / FATFS_PAGE_SIZE;
+        const size_t pgoff = off % FATFS_PAGE_SIZE;
+        const size_t n = min(FATFS_PAGE_SIZE - pgoff, count);
+
+        if (incore(&in->in_vnode, pgno)) {
+            struct buf * bp;
+
+            bp = getblk(&in->in_vnode, pgno, FATFS_PAGE_SIZE, 0);
+            if (bp) {
+                if (bp->b_flags & B_CACHE)
+                    memcpy((uint8_t *)bp->b_data + pgoff, data, n);
+                brelse(bp);
+            }
+        }
+
+        off += n;
+        data += n;
+        count -= n;
+    }
+}
+
 ssize_t fatfs_read(file_t * file, struct uio * uio, size_t count)
 {
-    void * buf;
     struct fatfs_inode * in = get_inode_of_vnode(file->vnode);
-    size_t count_out;
-    int err;
+    off_t off = file->seek_pos;
+    size_t count_out = 0;
+    int err = 0;
 
     if (!S_ISREG(file->vnode->vn_mode))
         return -EOPNOTSUPP;
 
-    err = f_lseek(&in->fp, file->seek_pos);
-    if (err)
-        return -EIO;
+    if (off < 0)
+        return -EINVAL;
+    if ((size_t)off >= in->fp.fsize)
+        return 0;
+    count = min(count, in->fp.fsize - (size_t)off);
 
-    err = uio_get_kaddr(uio, &buf);
-    if (err)
-        return err;
+    /*
+     * File data is read through the buffer cache page by page.
+     */
+    while (count_out < count) {
+        const size_t pgoff = off % FATFS_PAGE_SIZE;
+        const size_t n = min(FATFS_PAGE_SIZE - pgoff, count - count_out);
+        struct buf * bp;
 
-    err = f_read(&in->fp, buf, count, &count_out);
-    if (err)
-        return fresult2errno(err);
+        err = fatfs_getpage(in, off / FATFS_PAGE_SIZE, &bp);
+        if (err)
+            break;
 
-    file->seek_pos = f_tell(&in->fp);
-    return count_out;
+        err = uio_copyout((uint8_t *)bp->b_data + pgoff, uio, count_out, n);
+        brelse(bp);
+        if (err)
+            break;
+
+        off += n;
+        count_out += n;
+    }
+
+    file->seek_pos = off;
+    return (count_out > 0) ? (ssize_t)count_out : err;
+}
+
+/**
+ * Write to the cached pages of a file.
+ * The dirty pages are written back to the device by bio on eviction or by
+ * bio_vflush().
+ * The caller must hold in->lock.
+ * @return Returns the number of bytes written or a negative errno.
+ */
+static ssize_t fatfs_write_pages(struct fatfs_inode * in, off_t off,
+                                 const uint8_t * data, size_t count)
+{
+    FF_FIL * fp = &in->fp;
+    const size_t old_size = fp->fsize;
+    size_t pos;
+    size_t end;
+    int err = 0;
+
+    if ((fp->fs->opt & FATFS_READONLY) || !(fp->flag & FA_WRITE))
+        return fresult2errno(FR_DENIED);
+    if (off < 0)
+        return -EINVAL;
+    if ((uint64_t)off + count > 0xFFFFFFFF) /* Max file size on FAT. */
+        return -EFBIG;
+    if (count == 0)
+        return 0;
+    end = off + count;
+
+    if (end > old_size) {
+        /*
+         * Allocate the clusters, f_lseek() stretches the file in the write
+         * mode. The file is clipped to the free space if the disk is full.
+         */
+        err = f_lseek(fp, end);
+        in->clmt_valid = 0;
+        if (err)
+            return fresult2errno(err);
+        end = min(end, (size_t)fp->fsize);
+        if (end <= (size_t)off)
+            return -ENOSPC;
+    }
+
+    /*
+     * The gap between the old end of the file and off is zero filled.
+     */
+    pos = min((size_t)off, old_size);
+    while (pos < end) {
+        const size_t pgno = pos / FATFS_PAGE_SIZE;
+        const size_t pgoff = pos % FATFS_PAGE_SIZE;
+        size_t n = min(FATFS_PAGE_SIZE - pgoff, end - pos);
+        struct buf * bp;
+
+        if (pos < (size_t)off)
+            n = min(n, (size_t)off - pos);
+
+        bp = getblk(&in->in_vnode, pgno, FATFS_PAGE_SIZE, 0);
+        if (!bp) {
+            err = -ENOMEM;
+            break;
+        }
+        if (!(bp->b_flags & B_CACHE)) {
+            /*
+             * The data past the old end of the file is not valid on the
+             * device and a page written over doesn't need to be read.
+             */
+            err = fatfs_fillpage(in, bp,
+                                 (n == FATFS_PAGE_SIZE) ? pos : old_size);
+            if (err) {
+                brelse(bp);
+                break;
+            }
+        }
+
+        if (pos < (size_t)off)
+            memset((uint8_t *)bp->b_data + pgoff, 0, n);
+        else
+            memcpy((uint8_t *)bp->b_data + pgoff, data + (pos - off), n);
+        bdwrite(bp);
+        brelse(bp);
+
+        pos += n;
+    }
+
+    fp->flag |= FA__WRITTEN; /* Update the modification time on sync. */
+    in->attr_valid = 0;
+
+    if (pos > (size_t)off)
+        return pos - off;
+    return (err) ? err : -EIO;
 }
 
 ssize_t fatfs_write(file_t * file, struct uio * uio, size_t count)
 {
     void * buf;
     struct fatfs_inode * in = get_inode_of_vnode(file->vnode);
+    DWORD old_size;
     size_t count_out;
+    ssize_t retval;
     int err;
 
     if (!S_ISREG(file->vnode->vn_mode))
         return -EOPNOTSUPP;
 
-    err = f_lseek(&in->fp, file->seek_pos);
-    if (err)
-        return -EIO;
-
     err = uio_get_kaddr(uio, &buf);
     if (err)
         return err;
 
+    mtx_lock(&in->lock);
+
+    if (fatfs_pageio(in)) {
+        retval = fatfs_write_pages(in, file->seek_pos, buf, count);
+        if (retval > 0)
+            file->seek_pos += retval;
+        mtx_unlock(&in->lock);
+
+        return retval;
+    }
+
+    old_size = in->fp.fsize;
+
+    err = f_lseek(&in->fp, file->seek_pos);
+    if (err) {
+        err = -EIO;
+        goto out;
+    }
+
     err = f_write(&in->fp, buf, count, &count_out);
-    if (err)
-        return fresult2errno(err);
+    if (in->fp.fsize != old_size)
+        in->clmt_valid = 0; /* The cluster chain may have grown. */
+    in->attr_valid = 0;
+    if (err) {
+        err = fresult2errno(err);
+        goto out;
+    }
 
+    fatfs_update_pages(in, file->seek_pos, buf, count_out);
     file->seek_pos = f_tell(&in->fp);
+out:
+    mtx_unlock(&in->lock);
 
-    return count_out;
+    return (err) ? err : (ssize_t)count_out;
 }
 
 int fatfs_create(vnode_t * dir, const char * name, mode_t mode,
@@ -811,6 +1313,7 @@ int fatfs_unlink(vnode_t * dir, const char * name)
     err = fresult2errno(f_unlink(fs, in->in_fpath));
     if (err)
         return err;
+    fatfs_invalattr(in);
 
     vnode->vn_len = -1; /* Mark deleted by setting len to a negative value. */
     vrele_nunlink(vnode);
@@ -853,6 +1356,7 @@ int fatfs_mknod(vnode_t * dir, const char * name, int mode, void * specinfo,
         return fresult2errno(err);
     }
     KASSERT(res != NULL, "res must be set");
+    fatfs_neg_clear(indir);
 
     if (result)
         *result = &res->in_vnode;
@@ -889,6 +1393,8 @@ int fatfs_mkdir(vnode_t * dir, const char * name, mode_t mode)
     err = f_mkdir(&ffsb->ff_fs, in_fpath, mode2attr(mode));
     if (err)
         retval = fresult2errno(err);
+    else
+        fatfs_neg_clear(indir);
 
     kfree(in_fpath);
     return retval;
@@ -919,6 +1425,33 @@ int fatfs_rmdir(vnode_t * dir,  const char * name)
     return fatfs_unlink(dir, name);
 }
 
+/**
+ * Get the inode number of the parent directory of dir.
+ */
+static int get_dotdot_ino(vnode_t * dir, ino_t * ino)
+{
+    /*
+     * FIXME fatfs_lookup() should be incrementing the refcount of this
+     *       vnode. However, if I use autorele here the kernel will panic
+     *       after hitting the vnode a few times, which looks like it's
+     *       getting freed.
+     */
+    /* vnode_autorele */ vnode_t * vnode_dotdot = NULL;
+    int lookup_err;
+
+    lookup_err = fatfs_lookup(dir, "..", &vnode_dotdot);
+
+    if (lookup_err == -EDOM) {
+        *ino = 0;
+    } else if (lookup_err) {
+        return -ENOTDIR;
+    } else {
+        *ino = vnode_dotdot->vn_num;
+    }
+
+    return 0;
+}
+
 int fatfs_readdir(vnode_t * dir, struct dirent * d, off_t * off)
 {
     struct fatfs_inode * in = get_inode_of_vnode(dir);
@@ -935,24 +1468,11 @@ int fatfs_readdir(vnode_t * dir, struct dirent * d, off_t * off)
         d->d_type = DT_DIR;
         *off = DIRENT_SEEK_START + 1;
     } else if (*off == DIRENT_SEEK_START + 1) { /* Emulate .. */
-        /*
-         * FIXME fatfs_lookup() should be incrementing the refcount of this
-         *       vnode. However, if I use autorele here the kernel will panic
-         *       after hitting the vnode a few times, which looks like it's
-         *       getting freed.
-         */
-        /* vnode_autorele */ vnode_t * vnode_dotdot = NULL;
-        int lookup_err;
-
-        lookup_err = fatfs_lookup(dir, "..", &vnode_dotdot);
+        int err;
 
-        if (lookup_err == -EDOM) {
-            d->d_ino = 0;
-        } else if (lookup_err) {
-            return -ENOTDIR;
-        } else {
-            d->d_ino = vnode_dotdot->vn_num;
-        }
+        err = get_dotdot_ino(dir, &d->d_ino);
+        if (err)
+            return err;
 
         strlcpy(d->d_name, "..", sizeof(d->d_name));
         d->d_type = DT_DIR;
@@ -978,6 +1498,111 @@ int fatfs_readdir(vnode_t * dir, struct dirent * d, off_t * off)
     return 0;
 }
 
+/**
+ * Read directory entries using a directory cursor kept in file->stream.
+ * Unlike in->dp the cursor isn't shared by other opens of the directory and
+ * it stays at the position where the previous call stopped.
+ */
+static ssize_t fatfs_getdents(file_t * file, void * buf, size_t bytes)
+{
+    vnode_t * dir = file->vnode;
+    struct fatfs_inode * in = get_inode_of_vnode(dir);
+    FF_DIR * dp;
+    ino_t dotdot_ino = 0;
+    size_t n = 0, reclen;
+    int full = 0;
+    ssize_t retval;
+    int err;
+
+    if (!S_ISDIR(dir->vn_mode))
+        return -ENOTDIR;
+
+    /* Must be resolved before locking the inode for the lookup. */
+    if (file->seek_pos == DIRENT_SEEK_START ||
+        file->seek_pos == DIRENT_SEEK_START + 1) {
+        err = get_dotdot_ino(dir, &dotdot_ino);
+        if (err)
+            return err;
+    }
+
+    mtx_lock(&in->lock);
+    dp = file->stream;
+    if (!dp) {
+        dp = kmalloc(sizeof(FF_DIR));
+        if (!dp) {
+            retval = -ENOMEM;
+            goto out;
+        }
+        *dp = in->dp;
+        f_readdir(dp, NULL); /* Rewind */
+        file->stream = dp;
+    }
+
+    /* Emulate . and .. */
+    if (file->seek_pos == DIRENT_SEEK_START) {
+        f_readdir(dp, NULL); /* Rewind */
+
+        reclen = fs_dirent_put(buf, bytes, dir->vn_num, DT_DIR, ".");
+        if (reclen == 0) {
+            full = 1;
+            goto done;
+        }
+        n += reclen;
+        file->seek_pos++;
+    }
+    if (file->seek_pos == DIRENT_SEEK_START + 1) {
+        reclen = fs_dirent_put((char *)buf + n, bytes - n,
+                               dotdot_ino, DT_DIR, "..");
+        if (reclen == 0) {
+            full = 1;
+            goto done;
+        }
+        n += reclen;
+        file->seek_pos++;
+    }
+
+    while (n < bytes) {
+        const FF_DIR saved = *dp;
+        FILINFO fno;
+        char name[NAME_MAX + 1];
+
+        memset(&fno, 0, sizeof(fno));
+        name[0] = '\0';
+        fno.lfname = name;
+
+        err = f_readdir(dp, &fno);
+        if (err) {
+            if (n == 0) {
+                retval = fresult2errno(err);
+                goto out;
+            }
+            break;
+        }
+        if (fno.fname[0] == '\0')
+            break; /* End of dir. */
+
+        if (!*fno.lfname)
+            strlcpy(name, fno.fname, sizeof(name));
+
+        reclen = fs_dirent_put((char *)buf + n, bytes - n, fno.ino,
+                               (fno.fattrib & AM_DIR) ? DT_DIR : DT_REG, name);
+        if (reclen == 0) {
+            *dp = saved; /* Return it on the next call. */
+            full = 1;
+            break;
+        }
+        n += reclen;
+        file->seek_pos++;
+    }
+
+done:
+    retval = (n == 0 && full) ? -EINVAL : (ssize_t)n;
+out:
+    mtx_unlock(&in->lock);
+
+    return retval;
+}
+
 static fflags_t fattrib2uflags(unsigned fattrib)
 {
     fflags_t flags = 0;
@@ -1021,7 +1646,7 @@ int fatfs_stat(vnode_t * vnode, struct stat * buf)
         /* Can't stat FAT root */
         memcpy(buf, &mp_stat, sizeof(struct stat));
     } else if (in->in_fpath[0] != '\0') {
-        err = f_stat(&ffsb->ff_fs, in->in_fpath, &fno);
+        err = fatfs_getattr(ffsb, in, &fno);
         if (err) {
             KERROR_DBG("%s(fs %p, fpath \"%s\", fno %p) failed\n",
                        __func__, &ffsb->ff_fs, in->in_fpath, &fno);
@@ -1084,6 +1709,7 @@ int fatfs_chmod(vnode_t * vnode, mode_t mode)
     int err;
 
     err = fresult2errno(f_chmod(&ffsb->ff_fs, in->in_fpath, attr, mask));
+    fatfs_invalattr(in);
     if (!err)
         vnode->vn_mode = mode;
 
@@ -1112,6 +1738,7 @@ int fatfs_chflags(vnode_t * vnode, fflags_t flags)
         attr |= AM_HID;
 
     fresult = f_chmod(&ffsb->ff_fs, in->in_fpath, attr, mask);
+    fatfs_invalattr(in);
 
     return fresult2errno(fresult);
 }
@@ -1126,6 +1753,7 @@ int fatfs_chown(vnode_t * vnode, uid_t owner, gid_t group)
         FRESULT fresult;
 
         fresult = f_chown(&ffsb->ff_fs, in->in_fpath, owner, group);
+        fatfs_invalattr(in);
 
         return fresult2errno(fresult);
     } else {
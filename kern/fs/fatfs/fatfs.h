@@ -51,11 +51,34 @@
 
 #define FATFS_FSNAME            "fatfs"
 
+/**
+ * Size of the buffer cache pages used for file data.
+ */
+#define FATFS_PAGE_SIZE         4096
+
+/**
+ * Initial size of a cluster link map in DWORDs.
+ * Enough for a file of 7 fragments.
+ */
+#define FATFS_CLMT_INIT         16
+
+/**
+ * Number of names cached as nonexistent per directory.
+ */
+#define FATFS_NEGCACHE_SIZE     8
+
 struct fatfs_inode {
     vnode_t in_vnode;   /*!< vnode for this inode. */
     char * in_fpath;    /*!< Full path to this node from the sb root. */
     atomic_t open_count;
 
+    /**
+     * Lock for fp and clmt of a file.
+     * FatFs locks the volume only for accessing the FAT and directories, data
+     * transfers in the fast seek mode are serialized by this lock.
+     */
+    mtx_t lock;
+
     /**
      * file pointer or directory pointer, check in_vnode->vn_mode.
      */
@@ -63,6 +86,32 @@ struct fatfs_inode {
     FF_FIL fp;
     FF_DIR dp;
     };
+
+    /**
+     * Cluster link map of a file.
+     * Used for seeking without following the cluster chain from the
+     * beginning of the file.
+     */
+    DWORD * clmt;
+    size_t clmt_len;    /*!< Size of clmt in DWORDs. */
+    int clmt_valid;     /*!< Set if clmt matches the cluster chain. */
+
+    /**
+     * Cached attributes of the directory entry.
+     * Protected by lock and invalidated by every operation modifying the
+     * entry.
+     */
+    FILINFO attr;
+    int attr_valid;     /*!< Set if attr matches the directory entry. */
+
+    /**
+     * Names known not to exist in a directory.
+     * Replaced in round-robin order and cleared when an entry is created in
+     * the directory. Protected by lock.
+     */
+    char * neg[FATFS_NEGCACHE_SIZE];
+    unsigned neg_next;  /*!< Next slot to be replaced. */
+    unsigned neg_gen;   /*!< Incremented when neg is cleared. */
 };
 
 /**
@@ -42,6 +42,22 @@
 #include <fs/devfs.h>
 #include "fatfs.h"
 
+/**
+ * Init a private file for accessing the device of a volume.
+ * The device file in the superblock is shared by all threads doing I/O on the
+ * volume so it can't hold the seek position of a transfer.
+ */
+static void init_devfile(FATFS * ff_fs, file_t * file)
+{
+    const file_t * devfile = &get_ffsb_of_fffs(ff_fs)->ff_devfile;
+
+    *file = (file_t){
+        .oflags = devfile->oflags,
+        .vnode = devfile->vnode,
+        .stream = devfile->stream,
+    };
+}
+
 /**
  * Read sector(s).
  * @param buff      is a data buffer to store read data.
@@ -52,12 +68,15 @@
 DRESULT fatfs_disk_read(FATFS * ff_fs, uint8_t * buff, DWORD sector,
                         unsigned int count)
 {
-    file_t * file = &get_ffsb_of_fffs(ff_fs)->ff_devfile;
-    struct vnode_ops * vnops = file->vnode->vnode_ops;
+    file_t file;
+    struct vnode_ops * vnops;
     struct uio uio;
     ssize_t retval;
 
-    retval = vnops->lseek(file, sector, SEEK_SET);
+    init_devfile(ff_fs, &file);
+    vnops = file.vnode->vnode_ops;
+
+    retval = vnops->lseek(&file, sector, SEEK_SET);
     if (retval < 0) {
 #ifdef configFATFS_DEBUG
         KERROR(KERROR_ERR, "%s(): err %i\n", __func__, retval);
@@ -66,7 +85,7 @@ DRESULT fatfs_disk_read(FATFS * ff_fs, uint8_t * buff, DWORD sector,
     }
 
     uio_init_kbuf(&uio, buff, count);
-    retval = vnops->read(file, &uio, count);
+    retval = vnops->read(&file, &uio, count);
     if (retval < 0) {
 #ifdef configFATFS_DEBUG
         KERROR(KERROR_ERR, "%s(): err %i\n", __func__, retval);
@@ -94,12 +113,15 @@ DRESULT fatfs_disk_read(FATFS * ff_fs, uint8_t * buff, DWORD sector,
 DRESULT fatfs_disk_write(FATFS * ff_fs, const uint8_t * buff, DWORD sector,
                          unsigned int count)
 {
-    file_t * file = &get_ffsb_of_fffs(ff_fs)->ff_devfile;
-    struct vnode_ops * vnops = file->vnode->vnode_ops;
+    file_t file;
+    struct vnode_ops * vnops;
     struct uio uio;
     ssize_t retval;
 
-    retval = vnops->lseek(file, sector, SEEK_SET);
+    init_devfile(ff_fs, &file);
+    vnops = file.vnode->vnode_ops;
+
+    retval = vnops->lseek(&file, sector, SEEK_SET);
     if (retval < 0) {
 #ifdef configFATFS_DEBUG
         KERROR(KERROR_ERR, "%s(): err %i\n", __func__, retval);
@@ -108,7 +130,7 @@ DRESULT fatfs_disk_write(FATFS * ff_fs, const uint8_t * buff, DWORD sector,
     }
 
     uio_init_kbuf(&uio, (void *)buff, count);
-    retval = vnops->write(file, &uio, count);
+    retval = vnops->write(&file, &uio, count);
     if (retval < 0) {
 #ifdef configFATFS_DEBUG
         KERROR(KERROR_ERR, "%s(): err %i\n", __func__, retval);
@@ -41,6 +41,19 @@
 
 #define ABORT(fs, res)      ({ fp->err = (uint8_t)(res); unlock_fs(fs, res); res; })
 
+/*
+ * Data transfers of a file in the fast seek mode don't access the FAT or the
+ * volume window, only the file object that is serialized by the caller.
+ */
+#if _USE_FASTSEEK
+#define lock_fp(_fp_)       ((_fp_)->cltbl ? 0 : lock_fs((_fp_)->fs))
+#define LEAVE_FP(fp, res)   ({ if (!(fp)->cltbl) unlock_fs((fp)->fs, res); res; })
+#else
+#define lock_fp(_fp_)       lock_fs((_fp_)->fs)
+#define LEAVE_FP(fp, res)   LEAVE_FF((fp)->fs, res)
+#endif
+#define ABORT_FP(fp, res)   ({ (fp)->err = (uint8_t)(res); LEAVE_FP(fp, res); })
+
 
 /*
  * Name status flags
@@ -1925,12 +1938,12 @@ FRESULT f_read(FF_FIL * fp, void * buff, unsigned int btr, unsigned int * br)
     *br = 0;    /* Clear read byte counter */
 
     KASSERT(fp->fs, "fs should be set");
-    if (lock_fs(fp->fs))
+    if (lock_fp(fp))
         return FR_TIMEOUT;
     if (fp->err)                                /* Check error */
-        return LEAVE_FF(fp->fs, (FRESULT)fp->err);
+        return LEAVE_FP(fp, (FRESULT)fp->err);
     if (!(fp->flag & FA_READ))                  /* Check access mode */
-        return LEAVE_FF(fp->fs, FR_DENIED);
+        return LEAVE_FP(fp, FR_DENIED);
     remain = fp->fsize - fp->fptr;
     if (btr > remain)
         btr = (unsigned int)remain;       /* Truncate btr by remaining bytes */
@@ -1956,14 +1969,14 @@ FRESULT f_read(FF_FIL * fp, void * buff, unsigned int btr, unsigned int * br)
                     }
                 }
                 if (clst < 2)
-                    return ABORT(fp->fs, FR_INT_ERR);
+                    return ABORT_FP(fp, FR_INT_ERR);
                 if (clst == 0xFFFFFFFF)
-                    return ABORT(fp->fs, FR_DISK_ERR);
+                    return ABORT_FP(fp, FR_DISK_ERR);
                 fp->clust = clst;               /* Update current cluster */
             }
             sect = clust2sect(fp->fs, fp->clust);   /* Get current sector */
             if (!sect)
-                return ABORT(fp->fs, FR_INT_ERR);
+                return ABORT_FP(fp, FR_INT_ERR);
             sect += csect;
             cc = btr / fp->fs->ssize; /* When remaining bytes >= sector size, */
             if (cc) { /* Read maximum contiguous sectors directly */
@@ -1971,7 +1984,7 @@ FRESULT f_read(FF_FIL * fp, void * buff, unsigned int btr, unsigned int * br)
                     cc = fp->fs->csize - csect;
                 if (fatfs_disk_read(fp->fs, rbuff, sect,
                                     cc * fp->fs->ssize))
-                    return ABORT(fp->fs, FR_DISK_ERR);
+                    return ABORT_FP(fp, FR_DISK_ERR);
                 /*
                  * Replace one of the read sectors with cached data if it
                  * contains a dirty sector
@@ -1990,14 +2003,14 @@ FRESULT f_read(FF_FIL * fp, void * buff, unsigned int btr, unsigned int * br)
                     /* Write-back dirty sector cache */
                     if (fatfs_disk_write(fp->fs, fp->buf, fp->dsect,
                                          fp->fs->ssize)) {
-                        return ABORT(fp->fs, FR_DISK_ERR);
+                        return ABORT_FP(fp, FR_DISK_ERR);
                     }
                     fp->flag &= ~FA__DIRTY;
                 }
 
                 /* Fill sector cache */
                 if (fatfs_disk_read(fp->fs, fp->buf, sect, fp->fs->ssize))
-                    return ABORT(fp->fs, FR_DISK_ERR);
+                    return ABORT_FP(fp, FR_DISK_ERR);
             }
             fp->dsect = sect;
         }
@@ -2011,7 +2024,7 @@ FRESULT f_read(FF_FIL * fp, void * buff, unsigned int btr, unsigned int * br)
         memcpy(rbuff, &fp->buf[fp->fptr % fp->fs->ssize], rcnt);
     }
 
-    return LEAVE_FF(fp->fs, FR_OK);
+    return LEAVE_FP(fp, FR_OK);
 }
 
 /**
@@ -2194,6 +2207,53 @@ fail:
     return LEAVE_FF(fs, res);
 }
 
+#if _USE_FASTSEEK
+/**
+ * Seek File R/W Pointer using the CLMT.
+ * The volume is not locked as the FAT is not accessed.
+ * @param fp Pointer to the file object.
+ * @param ofs File pointer from top of file.
+ */
+static FRESULT fast_seek(FF_FIL * fp, DWORD ofs)
+{
+    DWORD dsc;
+
+    if (fp->err) /* Check error */
+        return (FRESULT)fp->err;
+
+    if (ofs > fp->fsize)        /* Clip offset at the file size */
+        ofs = fp->fsize;
+    fp->fptr = ofs;             /* Set file pointer */
+    if (ofs) {
+        fp->clust = clmt_clust(fp, ofs - 1);
+        dsc = clust2sect(fp->fs, fp->clust);
+        if (!dsc)
+            return ABORT_FP(fp, FR_INT_ERR);
+        dsc += (ofs - 1) / fp->fs->ssize & (fp->fs->csize - 1);
+
+        /* Refill sector cache if needed */
+        if (fp->fptr % fp->fs->ssize && dsc != fp->dsect) {
+            if (!(fp->fs->opt & FATFS_READONLY) &&
+                (fp->flag & FA__DIRTY)) {
+                /* Write-back dirty sector cache */
+                if (fatfs_disk_write(fp->fs, fp->buf, fp->dsect,
+                                     fp->fs->ssize)) {
+                    return ABORT_FP(fp, FR_DISK_ERR);
+                }
+                fp->flag &= ~FA__DIRTY;
+            }
+
+            /* Load current sector */
+            if (fatfs_disk_read(fp->fs, fp->buf, dsc, fp->fs->ssize))
+                return ABORT_FP(fp, FR_DISK_ERR);
+            fp->dsect = dsc;
+        }
+    }
+
+    return FR_OK;
+}
+#endif
+
 /**
  * Seek File R/W Pointer.
  * @param fp Pointer to the file object.
@@ -2204,6 +2264,10 @@ FRESULT f_lseek(FF_FIL * fp, DWORD ofs)
     FRESULT res = FR_OK;
 
     KASSERT(fp->fs, "fs should be set");
+#if _USE_FASTSEEK
+    if (fp->cltbl && ofs != CREATE_LINKMAP)
+        return fast_seek(fp, ofs);
+#endif
     if (lock_fs(fp->fs))
         return FR_TIMEOUT;
     if (fp->err) { /* Check error */
@@ -2212,74 +2276,42 @@ FRESULT f_lseek(FF_FIL * fp, DWORD ofs)
     }
 
 #if _USE_FASTSEEK
-    if (fp->cltbl) {    /* Fast seek */
-        DWORD cl, pcl, ncl, tcl, dsc, tlen, ulen, *tbl;
-
-        if (ofs == CREATE_LINKMAP) {    /* Create CLMT */
-            tbl = fp->cltbl;
-
-            /* Given table size and required table size */
-            tlen = *tbl++;
-            ulen = 2;
-
-            cl = fp->sclust; /* Top of the chain */
-            if (cl) {
-                do { /*Get a fragment. */
-
-                    /* Top, length and used items */
-                    tcl = cl; ncl = 0; ulen += 2;
-                    do {
-                        pcl = cl; ncl++;
-                        cl = get_fat(fp->fs, cl);
-                        if (cl <= 1)
-                            return ABORT(fp->fs, FR_INT_ERR);
-                        if (cl == 0xFFFFFFFF)
-                            return ABORT(fp->fs, FR_DISK_ERR);
-                    } while (cl == pcl + 1);
-                    if (ulen <= tlen) {
-                        /* Store the length and top of the fragment */
-                        *tbl++ = ncl;
-                        *tbl++ = tcl;
-                    }
-                } while (cl < fp->fs->n_fatent); /* Repeat until end of chain */
-            }
-            *fp->cltbl = ulen;  /* Number of items used */
-            if (ulen <= tlen) {
-                *tbl = 0;       /* Terminate table */
-            } else {
-                /* Given table size is smaller than required */
-                res = FR_NOT_ENOUGH_CORE;
-            }
+    if (fp->cltbl) {    /* Create CLMT */
+        DWORD cl, pcl, ncl, tcl, tlen, ulen, *tbl;
 
-        } else {                        /* Fast seek */
-            if (ofs > fp->fsize)        /* Clip offset at the file size */
-                ofs = fp->fsize;
-            fp->fptr = ofs;             /* Set file pointer */
-            if (ofs) {
-                fp->clust = clmt_clust(fp, ofs - 1);
-                dsc = clust2sect(fp->fs, fp->clust);
-                if (!dsc)
-                    return ABORT(fp->fs, FR_INT_ERR);
-                dsc += (ofs - 1) / fp->fs->ssize & (fp->fs->csize - 1);
+        tbl = fp->cltbl;
 
-                /* Refill sector cache if needed */
-                if (fp->fptr % fp->fs->ssize && dsc != fp->dsect) {
-                    if (!(fp->fs->opt & FATFS_READONLY) &&
-                        (fp->flag & FA__DIRTY)) {
-                        /* Write-back dirty sector cache */
-                        if (fatfs_disk_write(fp->fs, fp->buf, fp->dsect,
-                                             fp->fs->ssize)) {
-                            return ABORT(fp->fs, FR_DISK_ERR);
-                        }
-                        fp->flag &= ~FA__DIRTY;
-                    }
+        /* Given table size and required table size */
+        tlen = *tbl++;
+        ulen = 2;
 
-                    /* Load current sector */
-                    if (fatfs_disk_read(fp->fs, fp->buf, dsc, fp->fs->ssize))
+        cl = fp->sclust; /* Top of the chain */
+        if (cl) {
+            do { /*Get a fragment. */
+
+                /* Top, length and used items */
+                tcl = cl; ncl = 0; ulen += 2;
+                do {
+                    pcl = cl; ncl++;
+                    cl = get_fat(fp->fs, cl);
+                    if (cl <= 1)
+                        return ABORT(fp->fs, FR_INT_ERR);
+                    if (cl == 0xFFFFFFFF)
                         return ABORT(fp->fs, FR_DISK_ERR);
-                    fp->dsect = dsc;
+                } while (cl == pcl + 1);
+                if (ulen <= tlen) {
+                    /* Store the length and top of the fragment */
+                    *tbl++ = ncl;
+                    *tbl++ = tcl;
                 }
-            }
+            } while (cl < fp->fs->n_fatent); /* Repeat until end of chain */
+        }
+        *fp->cltbl = ulen;  /* Number of items used */
+        if (ulen <= tlen) {
+            *tbl = 0;       /* Terminate table */
+        } else {
+            /* Given table size is smaller than required */
+            res = FR_NOT_ENOUGH_CORE;
         }
     } else
 #endif
@@ -201,6 +201,7 @@ FRESULT f_getlabel(FATFS * fs, TCHAR * label, DWORD * vsn);
 FRESULT f_setlabel(FATFS * fs, const TCHAR * label);
 FRESULT f_mount(FATFS * fs, uint8_t opt, int codepage_id);
 FRESULT f_umount(FATFS * fs);
+DWORD clust2sect(FATFS * fs, DWORD clst);
 
 #define f_eof(fp) (((fp)->fptr == (fp)->fsize) ? 1 : 0)
 #define f_error(fp) ((fp)->err)
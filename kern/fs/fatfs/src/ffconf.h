@@ -16,7 +16,7 @@
  * To enable fast seek feature, set _USE_FASTSEEK to 1.
  * 0:Disable or 1:Enable
  */
-#define _USE_FASTSEEK   0
+#define _USE_FASTSEEK   1
 
 /*---------------------------------------------------------------------------/
 / Locale and Namespace Configurations
@@ -529,6 +529,11 @@ int chkperm_vnode(vnode_t * vnode, struct cred * cred, int oflags)
     return err;
 }
 
+static void fs_fildes_free_rcu(struct rcu_cb * cb)
+{
+    kfree(containerof(cb, struct file, f_rcu));
+}
+
 /**
  * Automatically called destructor for file descriptors.
  */
@@ -539,8 +544,11 @@ static void fs_fildes_dtor(struct kobj * obj)
 
     KERROR_DBG("%s(%p), vnode %pV\n", __func__, obj, vn);
 
+    vn->vnode_ops->event_file_destroyed(file);
+
+    /* RCU readers of a descriptor table may still see the file. */
     if (file->oflags & O_KFREEABLE)
-        kfree(file);
+        rcu_call(&file->f_rcu, fs_fildes_free_rcu);
     vrele(vn);
 }
 
@@ -608,13 +616,7 @@ perms_ok:
     if (S_ISDIR(vnode->vn_mode))
         new_fildes->seek_pos = DIRENT_SEEK_START;
 
-    int fd = fs_fildes_curproc_next(new_fildes, 0);
-    if (fd < 0) {
-        kfree(new_fildes);
-        retval = fd;
-        goto out;
-    }
-    fs_fildes_set(curproc->files->fd[fd], vnode, oflags);
+    fs_fildes_set(new_fildes, vnode, oflags);
     new_fildes->oflags |= O_KFREEABLE;
 
     /*
@@ -628,6 +630,14 @@ perms_ok:
         new_fildes->oflags |= O_EXEC_ALTPCAP;
     }
 
+    /* The file must be fully set before it's visible in the table. */
+    int fd = fs_fildes_curproc_next(new_fildes, 0);
+    if (fd < 0) {
+        kfree(new_fildes);
+        retval = fd;
+        goto out;
+    }
+
     /*
      * File descriptor ready, make an event call to the fs.
      */
@@ -640,82 +650,212 @@ out:
     return retval;
 }
 
+/**
+ * Allocate a descriptor table.
+ */
+static struct fdtable * fdt_alloc(int size)
+{
+    const size_t map_size = E2BITMAP_SIZE(size) * sizeof(bitmap_t);
+    struct fdtable * fdt;
+
+    fdt = kzalloc(sizeof(struct fdtable) + size * sizeof(file_t *) + map_size);
+    if (!fdt)
+        return NULL;
+
+    fdt->size = size;
+    fdt->open_map = (bitmap_t *)(&fdt->fd[size]);
+
+    return fdt;
+}
+
+static void fdt_free_rcu(struct rcu_cb * cb)
+{
+    kfree(containerof(cb, struct fdtable, rcu));
+}
+
+/**
+ * Find the lowest free descriptor number >= start.
+ * @return Returns the descriptor number or -1 if the table is full.
+ */
+static int fdt_find_free(struct fdtable * fdt, int start)
+{
+    const size_t nr_words = E2BITMAP_SIZE(fdt->size);
+    const size_t bits = SIZEOF_BITMAP(bitmap_t);
+
+    for (size_t i = start / bits; i < nr_words; i++) {
+        bitmap_t word = fdt->open_map[i];
+        int fd;
+
+        if (i == start / bits)
+            word |= (1u << (start % bits)) - 1;
+        if (word == (bitmap_t)~0)
+            continue;
+
+        fd = i * bits + __builtin_ctz(~word);
+        return (fd < fdt->size) ? fd : -1;
+    }
+
+    return -1;
+}
+
+/**
+ * Replace the descriptor table of files with a larger one.
+ * files->lock must be held.
+ * @param min_size is the minimum number of slots needed.
+ */
+static int fdt_grow(files_t * files, int min_size)
+{
+    struct fdtable * old = files->fdt;
+    struct fdtable * fdt;
+    int size = old->size;
+
+    while (size < min_size) {
+        size *= 2;
+    }
+    size = min(size, files->count);
+
+    fdt = fdt_alloc(size);
+    if (!fdt)
+        return -ENOMEM;
+
+    memcpy(fdt->fd, old->fd, old->size * sizeof(file_t *));
+    memcpy(fdt->open_map, old->open_map,
+           E2BITMAP_SIZE(old->size) * sizeof(bitmap_t));
+
+    rcu_assign_pointer(files->fdt, fdt);
+    rcu_call(&old->rcu, fdt_free_rcu);
+
+    return 0;
+}
+
+/**
+ * Store a file in a free slot of the table.
+ * files->lock must be held.
+ */
+static void fdt_install(struct fdtable * fdt, int fd, file_t * file)
+{
+    bitmap_set(fdt->open_map, fd, E2BITMAP_SIZE(fdt->size) * sizeof(bitmap_t));
+    rcu_assign_pointer(fdt->fd[fd], file);
+}
+
 int fs_fildes_curproc_next(file_t * new_file, int start)
 {
     files_t * files = curproc->files;
+    int fd;
 
     if (!new_file)
         return -EBADF;
 
-    if (start > files->count - 1)
+    if (start < 0 || start > files->count - 1)
         return -EMFILE;
 
-    for (int i = start; i < files->count; i++) {
-        if (!(files->fd[i])) {
-            curproc->files->fd[i] = new_file;
-            return i;
+    mtx_lock(&files->lock);
+    while ((fd = fdt_find_free(files->fdt, start)) < 0) {
+        int err;
+
+        if (files->fdt->size >= files->count) {
+            fd = -ENFILE;
+            break;
+        }
+
+        err = fdt_grow(files, max(files->fdt->size + 1, start + 1));
+        if (err) {
+            fd = err;
+            break;
         }
     }
+    if (fd >= 0)
+        fdt_install(files->fdt, fd, new_file);
+    mtx_unlock(&files->lock);
 
-    return -ENFILE;
+    return fd;
 }
 
-/**
- * Check if the given fd number is in the valid range.
- */
-static int fs_fildes_is_in_range(files_t * files, int fd)
+int fs_fildes_install(files_t * files, int fd, file_t * file)
 {
-    return (fd >= 0 && fd < files->count);
+    int err = 0;
+
+    if (fd < 0 || fd >= files->count)
+        return -EBADF;
+
+    mtx_lock(&files->lock);
+    if (fd >= files->fdt->size)
+        err = fdt_grow(files, fd + 1);
+    if (!err) {
+        if (files->fdt->fd[fd])
+            err = -EBUSY;
+        else
+            fdt_install(files->fdt, fd, file);
+    }
+    mtx_unlock(&files->lock);
+
+    return err;
 }
 
 file_t * fs_fildes_ref(files_t * files, int fd, int count)
 {
-    file_t * file;
-    int orig_refcount;
+    struct rcu_lock_ctx ctx;
+    struct fdtable * fdt;
+    file_t * file = NULL;
 
     KASSERT(files != NULL, "files should be set");
 
-    if (!fs_fildes_is_in_range(files, fd))
+    if (fd < 0)
         return NULL;
 
-    file = files->fd[fd];
-    if (!file)
-        return NULL;
-
-    orig_refcount = kobj_refcnt(&file->f_obj);
-    if (orig_refcount <= 0) {
-        files->fd[fd] = NULL;
-        file = NULL;
-    } else if (count > 0) {
-        if (kobj_ref_v(&file->f_obj, count)) {
-            files->fd[fd] = NULL;
-            file = NULL;
-        }
-    } else if (count < 0) {
-        count = min(orig_refcount, -count);
-
-        kobj_unref_p(&file->f_obj, count);
-        if (count == orig_refcount) {
-            files->fd[fd] = NULL;
-            file = NULL;
+    /*
+     * The file can't be freed during the read section so it's safe to try
+     * taking a reference even if it's being closed.
+     */
+    ctx = rcu_read_lock();
+    fdt = rcu_dereference(files->fdt);
+    if (fd < fdt->size)
+        file = rcu_dereference(fdt->fd[fd]);
+    if (file) {
+        if (count > 0) {
+            if (kobj_ref_v(&file->f_obj, count))
+                file = NULL;
+        } else if (count < 0) {
+            const int orig_refcount = kobj_refcnt(&file->f_obj);
+
+            count = min(orig_refcount, -count);
+            kobj_unref_p(&file->f_obj, count);
+            if (count == orig_refcount)
+                file = NULL;
         }
     }
+    rcu_read_unlock(&ctx);
 
     return file;
 }
 
 int fs_fildes_close(struct proc_info * p, int fildes)
 {
-    file_t * file = fs_fildes_ref(p->files, fildes, 1);
+    files_t * files = p->files;
+    struct fdtable * fdt;
+    file_t * file = NULL;
+
+    if (fildes < 0)
+        return -EBADF;
+
+    mtx_lock(&files->lock);
+    fdt = files->fdt;
+    if (fildes < fdt->size) {
+        file = fdt->fd[fildes];
+        if (file) {
+            rcu_assign_pointer(fdt->fd[fildes], NULL);
+            bitmap_clear(fdt->open_map, fildes,
+                         E2BITMAP_SIZE(fdt->size) * sizeof(bitmap_t));
+        }
+    }
+    mtx_unlock(&files->lock);
     if (!file)
         return -EBADF;
 
     file->vnode->vnode_ops->event_fd_closed(p, file);
 
-    fs_fildes_ref(p->files, fildes, -2);
-
-    /* File pointer is set to NULL for closed files regardless of refcount. */
-    p->files->fd[fildes] = NULL;
+    /* Drop the reference of the descriptor. */
+    kobj_unref(&file->f_obj);
 
     return 0;
 }
@@ -726,9 +866,9 @@ void fs_fildes_close_all(struct proc_info * p, int fildes_begin)
 
     KASSERT(p->files, "files is expected to always exist");
 
-    start = p->files->count - 1;
+    start = p->files->fdt->size - 1;
     fdstop = fildes_begin;
-    if (!fs_fildes_is_in_range(p->files, fdstop))
+    if (fdstop < 0 || fdstop >= p->files->count)
         return;
 
     for (i = start; i > fdstop; i--) {
@@ -742,9 +882,9 @@ void fs_fildes_close_exec(struct proc_info * p)
 
     KASSERT(p->files, "files is expected to always exist");
 
-    end =  p->files->count;
+    end = p->files->fdt->size;
     for (i = 0; i < end; i++) {
-        file_t * file = p->files->fd[i];
+        file_t * file = p->files->fdt->fd[i];
 
         if (file && file->oflags & O_CLOEXEC) {
             KERROR_DBG("%s(%d): Close O_CLOEXEC fd %d\n", __func__, p->pid, i);
@@ -754,6 +894,21 @@ void fs_fildes_close_exec(struct proc_info * p)
     }
 }
 
+int fs_fildes_nr_open(files_t * files)
+{
+    struct fdtable * fdt;
+    int n = 0;
+
+    mtx_lock(&files->lock);
+    fdt = files->fdt;
+    for (size_t i = 0; i < E2BITMAP_SIZE(fdt->size); i++) {
+        n += __builtin_popcount(fdt->open_map[i]);
+    }
+    mtx_unlock(&files->lock);
+
+    return n;
+}
+
 int fs_fildes_isatty(int fd)
 {
     file_t * file;
@@ -782,16 +937,56 @@ files_t * fs_alloc_files(size_t nr_files, mode_t umask)
 {
     files_t * files;
 
-    files = kzalloc(SIZEOF_FILES(nr_files));
+    files = kzalloc(sizeof(files_t));
     if (!files)
         return NULL;
 
+    files->fdt = fdt_alloc(min(nr_files, FS_FDTABLE_INIT));
+    if (!files->fdt) {
+        kfree(files);
+        return NULL;
+    }
+
     files->count = nr_files;
     files->umask = umask;
+    mtx_init(&files->lock, MTX_TYPE_TICKET, MTX_OPT_DEFAULT);
 
     return files;
 }
 
+int fs_copy_files(files_t * dst, files_t * src)
+{
+    struct fdtable * fdt;
+    int err = 0;
+
+    mtx_lock(&src->lock);
+    fdt = src->fdt;
+    for (int i = 0; i < fdt->size && i < dst->count; i++) {
+        file_t * file = fdt->fd[i];
+
+        if (!file || kobj_ref(&file->f_obj))
+            continue;
+
+        err = fs_fildes_install(dst, i, file);
+        if (err) {
+            kobj_unref(&file->f_obj);
+            break;
+        }
+    }
+    mtx_unlock(&src->lock);
+
+    return err;
+}
+
+void fs_free_files(files_t * files)
+{
+    if (!files)
+        return;
+
+    kfree(files->fdt);
+    kfree(files);
+}
+
 /**
  * Get directory vnode of a target file and the actual directory entry name.
  * @param[in]   pathname    is a path to the target.
@@ -32,6 +32,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/time.h>
@@ -46,30 +47,36 @@
 #include <proc.h>
 #include <queue_r.h>
 #include <kern_ipc.h>
+#include <rcu.h>
+#include <thread.h>
 
 /*
  * TODO
- * - We should guarantee atomicity for transactions uder PIPE_BUF bytes
  * - Setting O_ASYNC should cause SIGIO to be sent if new input becomes
  *   available
  */
 
-/*
- * Just a humble guess that lazy yield may render improved performance on
- * MP system.
+/**
+ * A thread sleeping on a pipe wait queue.
  */
-#ifdef configMP
-#define PIPE_YIELD_STRATEGY THREAD_YIELD_LAZY
-#else
-#define PIPE_YIELD_STRATEGY THREAD_YIELD_IMMEDIATE
-#endif
+struct pipe_waiter {
+    pthread_t tid; /*!< Thread id of the sleeper; 0 if it was woken up. */
+    STAILQ_ENTRY(pipe_waiter) pw_entry_;
+};
+
+STAILQ_HEAD(pipe_waitq, pipe_waiter);
 
 /**
  * Pipe descriptor pointed by file->stream.
  */
 struct stream_pipe {
     struct vnode vnode;
+    mtx_t lock; /*!< Protects q and the wait queues. */
     struct queue_cb q;
+    struct pipe_waitq rd_waitq; /*!< Readers waiting for data. */
+    struct pipe_waitq wr_waitq; /*!< Writers waiting for space. */
+    int rd_closed; /*!< Set when the last reference to file0 is dropped. */
+    int wr_closed; /*!< Set when the last reference to file1 is dropped. */
     struct buf * bp;
     file_t file0; /*!< Read end. */
     file_t file1; /*!< Write end. */
@@ -79,6 +86,7 @@ struct stream_pipe {
     struct timespec sp_mtime;   /*!< Time of last data modification. */
     struct timespec sp_ctime;   /*!< Time of last status change. */
     struct timespec sp_birthtime;
+    struct rcu_cb rcu;
 };
 
 static ssize_t fs_pipe_write(file_t * file, struct uio * uio, size_t count);
@@ -118,10 +126,35 @@ int __kinit__ fs_pipe_init(void)
     return 0;
 }
 
+static void pipe_wakeup(struct pipe_waitq * waitq);
+
+/**
+ * Destructor of a pipe end.
+ * Called when the last reference to the end is dropped, marks the end closed
+ * and wakes up the other end so it can see EOF or EPIPE.
+ */
+static void pipe_file_dtor(struct kobj * obj)
+{
+    file_t * file = containerof(obj, struct file, f_obj);
+    struct stream_pipe * pipe = (struct stream_pipe *)file->stream;
+
+    mtx_lock(&pipe->lock);
+    if (file == &pipe->file0)
+        pipe->rd_closed = 1;
+    else
+        pipe->wr_closed = 1;
+    pipe_wakeup(&pipe->rd_waitq);
+    pipe_wakeup(&pipe->wr_waitq);
+    mtx_unlock(&pipe->lock);
+
+    vrele(file->vnode);
+}
+
 static void init_file(file_t * file, vnode_t * vn, struct stream_pipe * pipe,
                       int oflags)
 {
     fs_fildes_set(file, vn, oflags);
+    kobj_init(&file->f_obj, pipe_file_dtor);
 
     file->oflags &= ~O_CLOEXEC;
     file->stream = pipe;
@@ -152,7 +185,8 @@ int fs_pipe_curproc_creat(struct files_struct * files, int fildes[2],
     vnode_t * vnode;
     struct buf * bp;
 
-    len = memalign_size(len, MMU_PGSIZE_COARSE);
+    /* One slot of the queue is always left empty. */
+    len = memalign_size(max(len, PIPE_BUF + 1), MMU_PGSIZE_COARSE);
 
     /*
      * Allocate space for structs and get a buffer.
@@ -196,8 +230,11 @@ int fs_pipe_curproc_creat(struct files_struct * files, int fildes[2],
     vnode = &pipe->vnode;
 
     /* Init queue */
+    mtx_init(&pipe->lock, MTX_TYPE_SPIN, MTX_OPT_DEFAULT);
     pipe->bp = bp;
     pipe->q = queue_create((char *)bp->b_data, sizeof(char), len);
+    STAILQ_INIT(&pipe->rd_waitq);
+    STAILQ_INIT(&pipe->wr_waitq);
     pipe->owner = curproc->cred.euid;
     pipe->group = curproc->cred.egid;
 
@@ -224,92 +261,172 @@ int fs_pipe_curproc_creat(struct files_struct * files, int fildes[2],
 /*
  * This is called when vnode refcount <= 0.
  */
+static void fs_pipe_free_rcu(struct rcu_cb * cb)
+{
+    kfree(containerof(cb, struct stream_pipe, rcu));
+}
+
 int fs_pipe_destroy(vnode_t * vnode)
 {
     struct stream_pipe * pipe = (struct stream_pipe *)vnode->vn_specinfo;
     struct buf * bp = pipe->bp;
 
     bp->vm_ops->rfree(bp);
-    kfree(pipe);
+
+    /*
+     * RCU readers of a descriptor table may still see the embedded file
+     * ends, so the pipe is freed after a grace period.
+     */
+    rcu_call(&pipe->rcu, fs_pipe_free_rcu);
 
     return 0;
 }
 
+/**
+ * Sleep on a pipe wait queue.
+ * The caller must hold pipe->lock, the lock is released while sleeping and
+ * it's held again when this function returns. The sleep can be interrupted
+ * by a signal.
+ * @return Returns 0 if woken up; -EINTR if interrupted by a signal.
+ */
+static int pipe_sleep(struct stream_pipe * pipe, struct pipe_waitq * waitq)
+{
+    struct pipe_waiter waiter = { .tid = current_thread->id };
+    int err;
+
+    STAILQ_INSERT_TAIL(waitq, &waiter, pw_entry_);
+    ksignal_interruptible_begin();
+
+    /*
+     * Interrupts are disabled until thread_wait() so a thread_release() from
+     * pipe_wakeup() can't be lost.
+     */
+    disable_interrupt();
+    mtx_unlock(&pipe->lock);
+    thread_wait();
+    err = ksignal_interruptible_end();
+
+    mtx_lock(&pipe->lock);
+    if (waiter.tid != 0) /* Woken up by something else. */
+        STAILQ_REMOVE(waitq, &waiter, pipe_waiter, pw_entry_);
+
+    return err;
+}
+
+/**
+ * Wakeup all threads sleeping on a pipe wait queue.
+ * The caller must hold pipe->lock.
+ */
+static void pipe_wakeup(struct pipe_waitq * waitq)
+{
+    struct pipe_waiter * waiter;
+
+    while ((waiter = STAILQ_FIRST(waitq))) {
+        pthread_t tid = waiter->tid;
+
+        STAILQ_REMOVE_HEAD(waitq, pw_entry_);
+        waiter->tid = 0;
+        thread_release(tid);
+    }
+}
+
 static ssize_t fs_pipe_write(file_t * file, struct uio * uio, size_t count)
 {
     struct stream_pipe * pipe = (struct stream_pipe *)file->stream;
     char * buf_addr;
+    ssize_t retval = 0;
+    size_t i = 0;
     int err;
 
     if (!(file->oflags & O_WRONLY))
         return -EBADF;
 
-    if (kobj_ref(&pipe->file0.f_obj)) {
-        return -EPIPE;
-    }
-
     err = uio_get_kaddr(uio, (void **)(&buf_addr));
     if (err)
         return err;
 
-    /* TODO Implement O_NONBLOCK */
+    mtx_lock(&pipe->lock);
+    while (i < count) {
+        size_t space;
+
+        if (pipe->rd_closed) {
+            retval = -EPIPE;
+            break;
+        }
 
-    for (size_t i = 0; i < count;) {
-        if (queue_push(&pipe->q, buf_addr + i))
-            i++;
         /*
-         * FIXME Yielding is really needed but currently there seems to some
-         *       strange performance issues.
+         * Writes of at most PIPE_BUF bytes are never interleaved with data
+         * from other writers.
          */
-#if 0
-        thread_yield(PIPE_YIELD_STRATEGY);
-#endif
+        space = queue_space(&pipe->q);
+        if (space == 0 || (count <= PIPE_BUF && space < count)) {
+            if (file->oflags & O_NONBLOCK) {
+                retval = -EAGAIN;
+                break;
+            }
+            err = pipe_sleep(pipe, &pipe->wr_waitq);
+            if (err) {
+                retval = err;
+                break;
+            }
+            continue;
+        }
+
+        i += queue_push_n(&pipe->q, buf_addr + i, count - i);
+        pipe_wakeup(&pipe->rd_waitq);
     }
+    mtx_unlock(&pipe->lock);
 
-    return count;
+    if (i > 0) {
+        getrealtime(&pipe->sp_mtime);
+        retval = i;
+    }
+
+    return retval;
 }
 
 static ssize_t fs_pipe_read(file_t * file, struct uio * uio, size_t count)
 {
     struct stream_pipe * pipe = (struct stream_pipe *)file->stream;
     char * buf_addr;
-    int oflags = file->oflags;
-    int trycount = 0;
+    ssize_t retval;
     int err;
 
-    /*
-     * TODO Atomic pipes
-     *
-     * Instead of using that trycount we should actually make pipes atomic per
-     * PIPE_BUF and return immediately after some data is received.
-     */
-
-    if (!(oflags & O_RDONLY))
+    if (!(file->oflags & O_RDONLY))
         return -EBADF;
 
     err = uio_get_kaddr(uio, (void **)(&buf_addr));
     if (err)
         return err;
 
-    for (size_t i = 0; i < count;) {
-        if (queue_isempty(&pipe->q) &&
-            ((trycount++ > 5 && (i > 0 || (oflags & O_NONBLOCK))) ||
-            kobj_ref(&pipe->file1.f_obj))) {
-            return i;
+    /*
+     * Return whatever is available but wait if the pipe is empty and the
+     * write end is still open.
+     */
+    mtx_lock(&pipe->lock);
+    while (queue_isempty(&pipe->q)) {
+        if (count == 0 || pipe->wr_closed) {
+            retval = 0;
+            goto out;
         }
-
-        if (queue_pop(&pipe->q, buf_addr + i))
-            i++;
-        /*
-         * FIXME Yielding is really needed but currently there seems to some
-         *       strange performance issues.
-         */
-#if 0
-        thread_yield(PIPE_YIELD_STRATEGY);
-#endif
+        if (file->oflags & O_NONBLOCK) {
+            retval = -EAGAIN;
+            goto out;
+        }
+        retval = pipe_sleep(pipe, &pipe->rd_waitq);
+        if (retval)
+            goto out;
     }
 
-    return count;
+    retval = queue_pop_n(&pipe->q, buf_addr, count);
+    pipe_wakeup(&pipe->wr_waitq);
+out:
+    mtx_unlock(&pipe->lock);
+
+    if (retval > 0)
+        getrealtime(&pipe->sp_atime);
+
+    return retval;
 }
 
 int fs_pipe_stat(vnode_t * vnode, struct stat * stat)
@@ -41,8 +41,12 @@
 #include <syscall.h>
 #include <errno.h>
 #include <kerror.h>
+#include <kinit.h>
 #include <libkern.h>
+#include <kmalloc.h>
 #include <kstring.h>
+#include <buf.h>
+#include <uio.h>
 #include <vm/vm.h>
 #include <vm/vm_copyinstruct.h>
 #include <thread.h>
@@ -53,6 +57,11 @@
 #include <fs/fs.h>
 #include <fs/fs_util.h>
 
+/**
+ * Maximum size of the kernel buffer used by a single getdents call.
+ */
+#define GETDENTS_BUF_MAX    4096
+
 static int sys_readwrite(__user void * user_args, int write)
 {
     struct _fs_readwrite_args args;
@@ -162,6 +171,176 @@ out:
     return retval;
 }
 
+/**
+ * Size of the kernel buffer used by sys_copy_file_range().
+ */
+#define FS_COPY_BUFSIZE (4 * MMU_PGSIZE_COARSE)
+
+/**
+ * Get the file used for the I/O at an explicit offset.
+ * A private descriptor is used for an explicit offset so the seek_pos shared
+ * with other threads using the same descriptor is never touched.
+ * @param priv  is the private descriptor.
+ * @param file  is the open file.
+ * @param off   is an explicit offset or -1 to use the file offset.
+ */
+static file_t * fs_copy_fildes(file_t * priv, file_t * file, off_t off)
+{
+    if (off < 0)
+        return file;
+
+    *priv = (file_t){
+        .seek_pos = off,
+        .oflags = file->oflags,
+        .vnode = file->vnode,
+        .stream = file->stream,
+    };
+
+    return priv;
+}
+
+/**
+ * Copy data from file_in to file_out using a kernel buffer.
+ * @param off_in    is a pointer to an explicit input offset or -1, updated
+ *                  by the number of bytes read.
+ * @param off_out   is a pointer to an explicit output offset or -1, updated
+ *                  by the number of bytes written.
+ * @return Returns the number of bytes copied or a negative errno code if
+ *         nothing was copied.
+ */
+static ssize_t fs_copy_data(file_t * file_in, off_t * off_in,
+                            file_t * file_out, off_t * off_out, size_t len)
+{
+    vnode_t * vn_in = file_in->vnode;
+    vnode_t * vn_out = file_out->vnode;
+    file_t priv_in, priv_out;
+    struct buf * bp;
+    struct uio uio;
+    size_t copied = 0;
+    ssize_t err = 0;
+
+    if (len == 0)
+        return 0;
+
+    file_in = fs_copy_fildes(&priv_in, file_in, *off_in);
+    file_out = fs_copy_fildes(&priv_out, file_out, *off_out);
+
+    bp = geteblk(min(len, FS_COPY_BUFSIZE));
+    if (!bp)
+        return -ENOMEM;
+
+    while (copied < len) {
+        const size_t n = min(len - copied, bp->b_bufsize);
+        ssize_t rd;
+        size_t off = 0;
+
+        uio_init_kbuf(&uio, (void *)bp->b_data, n);
+        rd = vn_in->vnode_ops->read(file_in, &uio, n);
+        if (rd <= 0) {
+            err = rd;
+            break;
+        }
+
+        while (off < (size_t)rd) {
+            ssize_t wr;
+
+            uio_init_kbuf(&uio, (void *)(bp->b_data + off), rd - off);
+            wr = vn_out->vnode_ops->write(file_out, &uio, rd - off);
+            if (wr <= 0) {
+                err = (wr < 0) ? wr : -EIO;
+                break;
+            }
+            off += wr;
+        }
+        copied += off;
+        if (err)
+            break;
+    }
+
+    bp->vm_ops->rfree(bp);
+
+    if (*off_in >= 0)
+        *off_in = priv_in.seek_pos;
+    if (*off_out >= 0)
+        *off_out = priv_out.seek_pos;
+
+    return (copied > 0) ? (ssize_t)copied : err;
+}
+
+static intptr_t sys_copy_file_range(__user void * user_args)
+{
+    struct _fs_copy_file_range_args args;
+    file_t * file_in;
+    file_t * file_out = NULL;
+    ssize_t retval;
+    int err;
+
+    err = copyin(user_args, &args, sizeof(args));
+    if (err) {
+        set_errno(EFAULT);
+        return -1;
+    }
+
+    if (args.flags != 0) {
+        set_errno(EINVAL);
+        return -1;
+    }
+
+    file_in = fs_fildes_ref(curproc->files, args.fd_in, 1);
+    if (!file_in) {
+        set_errno(EBADF);
+        return -1;
+    }
+    file_out = fs_fildes_ref(curproc->files, args.fd_out, 1);
+    if (!file_out) {
+        retval = -EBADF;
+        goto out;
+    }
+
+    if (!(file_in->oflags & O_RDONLY) || !(file_out->oflags & O_WRONLY)) {
+        retval = -EBADF;
+        goto out;
+    }
+    if (S_ISDIR(file_in->vnode->vn_mode) ||
+        S_ISDIR(file_out->vnode->vn_mode)) {
+        retval = -EISDIR;
+        goto out;
+    }
+    if ((args.off_in >= 0 && (S_ISFIFO(file_in->vnode->vn_mode) ||
+                              S_ISSOCK(file_in->vnode->vn_mode))) ||
+        (args.off_out >= 0 && (S_ISFIFO(file_out->vnode->vn_mode) ||
+                               S_ISSOCK(file_out->vnode->vn_mode)))) {
+        retval = -ESPIPE;
+        goto out;
+    }
+    if (file_in->vnode == file_out->vnode) {
+        /* Overlapping ranges are not supported. */
+        retval = -EINVAL;
+        goto out;
+    }
+
+    /* Explicit offsets don't change the file offsets. */
+    retval = fs_copy_data(file_in, &args.off_in, file_out, &args.off_out,
+                          args.len);
+
+out:
+    if (file_out)
+        fs_fildes_ref(curproc->files, args.fd_out, -1);
+    fs_fildes_ref(curproc->files, args.fd_in, -1);
+
+    if (retval < 0) {
+        set_errno(-retval);
+        return -1;
+    }
+
+    if (copyout(&args, user_args, sizeof(args))) {
+        set_errno(EFAULT);
+        return -1;
+    }
+
+    return retval;
+}
+
 static intptr_t sys_open(__user void * user_args)
 {
     struct _fs_open_args * args = NULL;
@@ -276,10 +455,12 @@ static intptr_t sys_getdents(__user void * user_args)
 {
     struct _fs_getdents_args args;
     struct uio dents;
-    size_t bytes_left;
     file_t * fildes;
     vnode_t * vnode;
-    int err, count;
+    void * buf = NULL;
+    size_t bufsize;
+    ssize_t bytes;
+    int err;
 
     err = copyin(user_args, &args, sizeof(args));
     if (err) {
@@ -301,36 +482,44 @@ static intptr_t sys_getdents(__user void * user_args)
     }
 
     if (!S_ISDIR(fildes->vnode->vn_mode)) {
-        count = -1;
+        bytes = -1;
         set_errno(ENOTDIR);
         goto out;
     }
 
-
     vnode = fildes->vnode;
-    KASSERT(vnode->vnode_ops->readdir, "readdir() is defined");
+    KASSERT(vnode->vnode_ops->getdents, "getdents() is defined");
 
-    count = 0;
-    bytes_left = args.nbytes;
-    while (bytes_left >= sizeof(struct dirent)) {
-        struct dirent d; /* Temp storage */
+    /*
+     * Entries are collected in a kernel buffer by a single call to the file
+     * system and copied out at once.
+     */
+    bufsize = min(args.nbytes, GETDENTS_BUF_MAX);
+    buf = kmalloc(bufsize);
+    if (!buf) {
+        bytes = -1;
+        set_errno(ENOMEM);
+        goto out;
+    }
 
-        if (vnode->vnode_ops->readdir(vnode, &d, &fildes->seek_pos))
-            break;
-        err = uio_copyout(&d, &dents, count++ * sizeof(struct dirent),
-                          sizeof(struct dirent));
-        if (err) {
-            count = -1;
-            set_errno(-err);
-            goto out;
-        }
+    bytes = vnode->vnode_ops->getdents(fildes, buf, bufsize);
+    if (bytes < 0) {
+        set_errno(-bytes);
+        bytes = -1;
+        goto out;
+    }
 
-        bytes_left -= (sizeof(struct dirent));
+    err = uio_copyout(buf, &dents, 0, bytes);
+    if (err) {
+        bytes = -1;
+        set_errno(-err);
+        goto out;
     }
 
 out:
+    kfree(buf);
     fs_fildes_ref(curproc->files, args.fd, -1);
-    return count;
+    return bytes;
 }
 
 static intptr_t sys_fcntl(__user void * user_args)
@@ -1027,6 +1216,10 @@ static intptr_t sys_mount(__user void * user_args)
         goto out;
     }
 
+    /* The source device may still be initializing. */
+    if (args->source[0] != '\0')
+        kinit_async_wait();
+
     err = fs_mount(mpt, args->source, args->fsname, args->flags,
                    args->parm, args->parm_len);
     if (err) {
@@ -1123,5 +1316,6 @@ static const syscall_handler_t fs_sysfnmap[] = {
     ARRDECL_SYSCALL_HNDL(SYSCALL_FS_UMASK, sys_umask),
     ARRDECL_SYSCALL_HNDL(SYSCALL_FS_MOUNT, sys_mount),
     ARRDECL_SYSCALL_HNDL(SYSCALL_FS_UMOUNT, sys_umount),
+    ARRDECL_SYSCALL_HNDL(SYSCALL_FS_COPY_FILE_RANGE, sys_copy_file_range),
 };
 SYSCALL_HANDLERDEF(fs_syscall, fs_sysfnmap)
@@ -177,6 +177,25 @@ void fs_vnode_cleanup(vnode_t * vnode)
    }
 }
 
+size_t fs_dirent_put(void * buf, size_t bytes, ino_t ino, uint8_t type,
+                     const char * name)
+{
+    struct dirent * d = (struct dirent *)buf;
+    const size_t namelen = strlenn(name, NAME_MAX);
+    const size_t reclen = DIRENT_RECLEN(namelen);
+
+    if (reclen > bytes)
+        return 0;
+
+    d->d_ino = ino;
+    d->d_reclen = reclen;
+    d->d_type = type;
+    memcpy(d->d_name, name, namelen);
+    d->d_name[namelen] = '\0';
+
+    return reclen;
+}
+
 void fs_parse_parm(char * parm, const char * names[],
                    void * parsed, size_t parsed_size)
 {
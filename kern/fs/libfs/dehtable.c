@@ -40,266 +40,242 @@
 #include <fs/dehtable.h>
 
 /*
- * Chains
- * ------
+ * Buckets
+ * -------
  *
- * Dirent hash table uses chaining to solve collisions. Chains are dh_dirent
- * arrays that are dynamically resized when necessary.
+ * Every entry is allocated separately and linked to a singly linked hash
+ * chain. The full 32-bit hash of the name is stored in the entry so most
+ * mismatches in a chain are skipped without comparing the names.
  *
- * To keep a chain unbroken there shall be no empty slots between two entries.
- * If an entry is removed in the middle the chain must be restructured so that
- * empty slot is filled. There is no need to free the space left after
- * restructuring a chain because it will either completely reused on next link
- * or of partly freed if more than one entries have been removed before the next
- * insert.
+ * When the number of entries exceeds DH_LOAD_MAX times the number of buckets
+ * the bucket array is doubled. Instead of rehashing all entries at once the
+ * old buckets are moved to the new array DH_REHASH_STEP buckets at a time on
+ * every dh_link() and dh_unlink() call. An entry that hashes to an old bucket
+ * below rehash_ind is already in the new array, otherwise it's still in the
+ * old array.
  *
- * dh_link tag must be used to mark the end of chain.
- */
-
-/**
- * Chain info struct.
- */
-typedef struct chain_info {
-    size_t i_last; /*!< Index of the last node of the chain. */
-    size_t i_size; /*!< Size of the chain. */
-} chain_info_t;
-
-#define DIRENT_SIZE (sizeof(dh_dirent_t) - sizeof(char))
-
-#define CH_NOLINK   0
-#define CH_LINK     1
-
-/**
- * Get reference to a directory entry in array.
- * @param dea is a directory entry array.
- * @param offset is the offset of dh_dirent in the array.
- * @return Pointer to a dh_dirent struct.
+ * Slots
+ * -----
+ *
+ * Entries are also indexed by a slot number in ents. The iterator walks the
+ * slots, so iteration is not affected by rehashing. A removed entry frees its
+ * slot, which is reused by a later dh_link().
  */
-#define get_dirent(dea, offset) \
-    ((dh_dirent_t *)((size_t)(dea) + (offset)))
 
-/**
- * Returns true if given dirent node has an invalid dh_size.
- * Invalid dh_size would lead to invalid offset and possibly segmentation fault.
- * @param denode is a directory entry node.
- * @return 0 if dh_size is valid; Otherwise value other than zero.
- */
-#define is_invalid_offset(denode) \
-    ((denode)->dh_size > (DIRENT_SIZE + NAME_MAX + 1))
+#define DH_LOAD_MAX     2
+#define DH_REHASH_STEP  4
 
 /**
  * Hash function.
- * @note Only upto 32 bits.
  * @param str is the string to be hashed.
  * @return Hash value.
  */
-static size_t hash_fname(const char * str, uint32_t k[2])
+static uint32_t hash_fname(const char * str, uint32_t k[2])
 {
     size_t len = strlenn(str, NAME_MAX + 1);
-    int mask;
-    int chunks = NBITS(DEHTABLE_SIZE);
-    uint32_t hash, retval = 0;
 
-    hash = halfsiphash32(str, len, k);
+    return halfsiphash32(str, len, k);
+}
 
-    /* fold */
-    mask = (DEHTABLE_SIZE - 1);
-    while (chunks--) {
-        retval += hash & mask;
-        mask <<= (DEHTABLE_SIZE - 1);
-    }
+/**
+ * Get the head of the chain where an entry with hash h is stored.
+ */
+static dh_dirent_t ** get_bucket(dh_table_t * dir, uint32_t h)
+{
+    if (dir->old_htable) {
+        const size_t i = h & (dir->old_htable_size - 1);
 
-    /* truncate */
-    retval &= (DEHTABLE_SIZE - 1);
+        if (i >= dir->rehash_ind)
+            return &dir->old_htable[i];
+    }
 
-    return retval;
+    return &dir->htable[h & (dir->htable_size - 1)];
 }
 
 /**
- * Find a specific dirent node in chain.
- * @param chain     is the chain array.
- * @param name      is the name of the node searched for.
- * @param name_len  is the length of the name.
- * @return Returns a pointer to the node; Or null if node not found.
+ * Move up to n buckets from old_htable to htable.
  */
-static dh_dirent_t * find_node(dh_dirent_t * chain, const char * name)
+static void rehash_step(dh_table_t * dir, size_t n)
 {
-    size_t name_len = strlenn(name, NAME_MAX + 1) + 1;
-    size_t offset = 0;
-    dh_dirent_t * node;
-    dh_dirent_t * retval = 0;
-
-    do {
-        node = get_dirent(chain, offset);
-        if (is_invalid_offset(node)) {
-            KERROR(KERROR_ERR, "Invalid offset in deh node");
-            break;
-        }
+    while (dir->old_htable && n--) {
+        dh_dirent_t * de = dir->old_htable[dir->rehash_ind];
 
-        if (strncmp(node->dh_name, name, name_len) == 0) {
-            retval = node;
-            break;
+        while (de) {
+            dh_dirent_t * next = de->dh_next;
+            dh_dirent_t ** head = &dir->htable[de->dh_hash &
+                                               (dir->htable_size - 1)];
+
+            de->dh_next = *head;
+            *head = de;
+            de = next;
         }
-        offset += node->dh_size;
-    } while (node->dh_link == CH_LINK);
 
-    return retval;
+        if (++dir->rehash_ind == dir->old_htable_size) {
+            kfree(dir->old_htable);
+            dir->old_htable = NULL;
+            dir->old_htable_size = 0;
+            dir->rehash_ind = 0;
+        }
+    }
 }
 
 /**
- * Find the last node of the chain.
- * @param chain is the dirent chain array.
- * @return Returns the updated chain_info struct.
+ * Start growing the bucket array if the load factor is exceeded.
+ * Failing to grow is not an error, the chains just get longer.
  */
-static chain_info_t find_last_node(dh_dirent_t * chain)
+static void grow_htable(dh_table_t * dir)
 {
-    dh_dirent_t * node;
-    chain_info_t chinfo;
+    dh_dirent_t ** new_htable;
 
-    chinfo.i_size = 0;
-    do {
-        node = get_dirent(chain, chinfo.i_size);
-        if (is_invalid_offset(node)) {
-            KERROR(KERROR_ERR, "Invalid offset in deh node: %u",
-                     node->dh_size);
+    if (dir->htable && dir->nr_entries < DH_LOAD_MAX * dir->htable_size)
+        return;
 
-            break;
-        }
-        chinfo.i_size += node->dh_size;
-    } while (node->dh_link == CH_LINK);
-    chinfo.i_last = chinfo.i_size - node->dh_size;
+    /* Finish the previous resize first. */
+    rehash_step(dir, SIZE_MAX);
+
+    new_htable = kzalloc(2 * max(dir->htable_size, DEHTABLE_SIZE / 2) *
+                         sizeof(dh_dirent_t *));
+    if (!new_htable)
+        return;
 
-    return chinfo;
+    if (dir->htable) {
+        dir->old_htable = dir->htable;
+        dir->old_htable_size = dir->htable_size;
+        dir->rehash_ind = 0;
+        dir->htable_size *= 2;
+    } else {
+        dir->htable_size = DEHTABLE_SIZE;
+    }
+    dir->htable = new_htable;
 }
 
-static int rm_node(dh_dirent_t ** chain, const char * name)
+/**
+ * Allocate a slot for a new entry.
+ * @return Returns a slot index; Or SIZE_MAX if out of memory.
+ */
+static size_t alloc_slot(dh_table_t * dir)
 {
-    const chain_info_t chinfo = find_last_node(*chain);
-    size_t old_offset = 0;
-    size_t new_offset = 0;
-    size_t prev_noffset = 0;
-    dh_dirent_t * new_chain;
-    int match = 0;
-
-    if (chinfo.i_size < sizeof(void *))
-        return -ENOENT;
-
-    new_chain = kzalloc(chinfo.i_size);
-    if (!new_chain)
-        return -ENOMEM;
+    if (dir->nr_free > 0)
+        return dir->free_slots[--dir->nr_free];
 
-    /* Initial empty first entry. */
-    *get_dirent(new_chain, 0) = (dh_dirent_t){ .dh_size = 0 };
+    if (dir->ents_end == dir->ents_size) {
+        const size_t new_size = max(2 * dir->ents_size, DEHTABLE_SIZE);
+        dh_dirent_t ** ents;
+        size_t * free_slots;
 
-    while (1) {
-        const dh_dirent_t * const node = get_dirent(*chain, old_offset);
+        ents = krealloc(dir->ents, new_size * sizeof(dh_dirent_t *));
+        if (!ents)
+            return SIZE_MAX;
+        dir->ents = ents;
 
-        if (is_invalid_offset(node)) {
-            KERROR(KERROR_ERR, "Invalid offset in deh node");
+        free_slots = krealloc(dir->free_slots, new_size * sizeof(size_t));
+        if (!free_slots)
+            return SIZE_MAX;
+        dir->free_slots = free_slots;
 
-            kfree(new_chain);
-            return -ENOTRECOVERABLE;
-        }
+        dir->ents_size = new_size;
+    }
 
-        /* Copy if no match or already matched. */
-        if (match || strncmp(node->dh_name, name, NAME_MAX + 1) != 0) {
-            dh_dirent_t * new_node = get_dirent(new_chain, new_offset);
+    return dir->ents_end++;
+}
 
-            memcpy(new_node, node, node->dh_size);
-            prev_noffset = new_offset;
-            new_offset += node->dh_size;
-        } else {
-            match = 1;
-        }
-        old_offset += node->dh_size;
+/**
+ * Find the chain link pointing to an entry.
+ * @return Returns a pointer to the link pointing to the entry;
+ *         Or null if the entry was not found.
+ */
+static dh_dirent_t ** find_node(dh_table_t * dir, const char * name)
+{
+    const uint32_t h = hash_fname(name, dir->k);
+    dh_dirent_t ** pp;
 
-        if (node->dh_link == CH_NOLINK)
-            break;
-    }
+    if (!dir->htable)
+        return NULL;
 
-    get_dirent(new_chain, prev_noffset)->dh_link = CH_NOLINK;
+    for (pp = get_bucket(dir, h); *pp; pp = &(*pp)->dh_next) {
+        const dh_dirent_t * de = *pp;
 
-    /* Check if new_chain is empty */
-    if (get_dirent(new_chain, 0)->dh_size == 0) {
-        kfree(new_chain);
-        new_chain = NULL;
+        if (de->dh_hash == h &&
+            strncmp(de->dh_name, name, NAME_MAX + 1) == 0)
+            return pp;
     }
 
-    /* Replace old chain. */
-    kfree(*chain);
-    *chain = new_chain;
-
-    return 0;
+    return NULL;
 }
 
 void dh_init(dh_table_t * dir)
 {
+    memset(dir, 0, sizeof(*dir));
     dir->k[0] = krandom();
     dir->k[1] = krandom();
-    memset(dir, 0, sizeof(dir->htable));
 }
 
 int dh_link(dh_table_t * dir, ino_t vnode_num, uint8_t d_type,
             const char * name)
 {
-    size_t name_len = strlenn(name, NAME_MAX + 1) + 1;
-    const size_t h = hash_fname(name, dir->k);
-    const size_t entry_size = memalign(DIRENT_SIZE + name_len);
-    dh_dirent_t * dea;
-    chain_info_t chinfo;
-    int retval = 0;
+    const size_t name_len = strlenn(name, NAME_MAX + 1) + 1;
+    dh_dirent_t * de;
+    dh_dirent_t ** head;
+    size_t slot;
+
+    if (name_len > NAME_MAX + 1)
+        return -ENAMETOOLONG;
 
     /* Verify that link doesn't exist */
-    if (!dh_lookup(dir, name, NULL)) {
-        retval = -EEXIST;
-        goto out;
-    }
+    if (find_node(dir, name))
+        return -EEXIST;
 
-    dea = dir->htable[h];
-    if (!dea) { /* Chain array not yet created. */
-        dea = kzalloc(entry_size);
-
-        chinfo.i_last = 0;
-        chinfo.i_size = 0; /* Set size to 0 to fool the assignment code as
-                            * this is the first entry. */
-    } else { /* Chain array found. */
-        /* Find the last node of the chain and realloc a longer chain. */
-        chinfo = find_last_node(dea);
-        dea = krealloc(dea, chinfo.i_size + entry_size);
-    }
-    if (!dea) {
-        /* OOM, can't add new entries. */
-        retval = -ENOMEM;
-        goto out;
+    grow_htable(dir);
+    if (!dir->htable)
+        return -ENOMEM;
+    rehash_step(dir, DH_REHASH_STEP);
+
+    de = kmalloc(sizeof(dh_dirent_t) + name_len);
+    if (!de)
+        return -ENOMEM;
+
+    slot = alloc_slot(dir);
+    if (slot == SIZE_MAX) {
+        kfree(de);
+        return -ENOMEM;
     }
-    dir->htable[h] = dea;
-
-    /* Create a link */
-    get_dirent(dea, chinfo.i_last)->dh_link = CH_LINK;
-    /* New node */
-    get_dirent(dea, chinfo.i_size)->dh_ino = vnode_num;
-    get_dirent(dea, chinfo.i_size)->dh_type = d_type;
-    get_dirent(dea, chinfo.i_size)->dh_size = entry_size;
-    get_dirent(dea, chinfo.i_size)->dh_link = CH_NOLINK;
-    strlcpy(get_dirent(dea, chinfo.i_size)->dh_name, name, name_len + 1);
-
-out:
-    return retval;
+
+    de->dh_ino = vnode_num;
+    de->dh_type = d_type;
+    de->dh_hash = hash_fname(name, dir->k);
+    de->dh_slot = slot;
+    strlcpy(de->dh_name, name, name_len);
+
+    head = get_bucket(dir, de->dh_hash);
+    de->dh_next = *head;
+    *head = de;
+    dir->ents[slot] = de;
+    dir->nr_entries++;
+
+    return 0;
 }
 
 int dh_unlink(dh_table_t * dir, const char * name)
 {
-    const size_t h = hash_fname(name, dir->k);
-    dh_dirent_t ** dea;
-    int err;
+    dh_dirent_t ** pp;
+    dh_dirent_t * de;
 
-    dea = &dir->htable[h];
-    if (!dea)
+    pp = find_node(dir, name);
+    if (!pp)
         return -ENOENT;
 
-    err = rm_node(dea, name);
-    if (err)
-        return err;
+    de = *pp;
+    *pp = de->dh_next;
+
+    dir->ents[de->dh_slot] = NULL;
+    if (de->dh_slot == dir->ents_end - 1)
+        dir->ents_end--;
+    else
+        dir->free_slots[dir->nr_free++] = de->dh_slot;
+    dir->nr_entries--;
+    kfree(de);
+
+    rehash_step(dir, DH_REHASH_STEP);
 
     return 0;
 }
@@ -308,35 +284,41 @@ void dh_destroy_all(dh_table_t * dir)
 {
     size_t i;
 
-    /* Free all dir entry chains. */
-    for (i = 0; i < DEHTABLE_SIZE; i++) {
+    /* Free all dir entries. */
+    for (i = 0; i < dir->ents_end; i++) {
         /* No NuLL check needed. */
-        kfree(dir->htable[i]);
+        kfree(dir->ents[i]);
     }
-}
 
+    kfree(dir->ents);
+    kfree(dir->free_slots);
+    kfree(dir->htable);
+    kfree(dir->old_htable);
+    dir->ents = NULL;
+    dir->free_slots = NULL;
+    dir->htable = NULL;
+    dir->old_htable = NULL;
+    dir->ents_size = 0;
+    dir->ents_end = 0;
+    dir->nr_free = 0;
+    dir->nr_entries = 0;
+    dir->htable_size = 0;
+    dir->old_htable_size = 0;
+    dir->rehash_ind = 0;
+}
 
 int dh_lookup(dh_table_t * dir, const char * name, ino_t * vnode_num)
 {
-    const size_t h = hash_fname(name, dir->k);
-    dh_dirent_t * dea;
-    dh_dirent_t * dent;
-    int retval = -ENOENT;
+    dh_dirent_t ** pp;
 
-    dea = dir->htable[h];
-    if (!dea)
-        goto out;
-
-    dent = find_node(dea, name);
-    if (!dent)
-        goto out;
+    pp = find_node(dir, name);
+    if (!pp)
+        return -ENOENT;
 
     if (vnode_num)
-        *vnode_num = dent->dh_ino;
+        *vnode_num = (*pp)->dh_ino;
 
-    retval = 0;
-out:
-    return retval;
+    return 0;
 }
 
 int dh_revlookup(dh_table_t * dir, ino_t ino, char * name, size_t name_len)
@@ -362,8 +344,7 @@ dh_dir_iter_t dh_get_iter(dh_table_t * dir)
 {
     dh_dir_iter_t it = {
         .dir = dir,
-        .dea_ind = 0,
-        .ch_ind = SIZE_MAX
+        .slot = 0,
     };
 
     return it;
@@ -371,55 +352,22 @@ dh_dir_iter_t dh_get_iter(dh_table_t * dir)
 
 dh_dirent_t * dh_iter_next(dh_dir_iter_t * it)
 {
-    dh_dirent_t * dea; /* Dir entry array (chain). */
-    dh_dirent_t * node; /* Dir entry node in chain. */
+    dh_table_t * dir = it->dir;
 
-    /* Already iterated over all nodes? */
-    if (!it->dir || it->dea_ind >= DEHTABLE_SIZE)
+    if (!dir)
         return NULL;
 
-    if (it->ch_ind == SIZE_MAX) { /* Get a next chain array */
-        size_t i = it->dea_ind;
-
-        it->ch_ind = 0; /* Reset chain index */
+    while (it->slot < dir->ents_end) {
+        dh_dirent_t * de = dir->ents[it->slot++];
 
-        /* Get a dir entry array */
-        do {
-            dea = it->dir->htable[i];
-            i++;
-        } while (!dea && i < DEHTABLE_SIZE);
-
-        it->dea_ind = i - 1;
-    } else { /* Still iterating the old chain. */
-        dea = it->dir->htable[it->dea_ind];
-    }
-    if (!dea)
-        return NULL; /* Empty hash table or No more entries. */
-
-    /* Get a node from the chain. */
-    node = get_dirent(dea, it->ch_ind);
-    if (is_invalid_offset(node))
-        return NULL; /* Broken dirent hash table. */
-
-    if (node->dh_link == CH_LINK) {
-        it->ch_ind += node->dh_size;
-    } else {
-        it->dea_ind++;
-        it->ch_ind = SIZE_MAX; /* It's quite safe to assume the array is
-                                * shorter than SIZE_MAX. */
+        if (de)
+            return de;
     }
 
-    return node;
+    return NULL;
 }
 
 size_t dh_nr_entries(dh_table_t * dir)
 {
-    dh_dir_iter_t it = dh_get_iter(dir);
-    size_t n = 0;
-
-    while (dh_iter_next(&it)) {
-        n++;
-    }
-
-    return n;
+    return dir->nr_entries;
 }
@@ -160,7 +160,10 @@ static int make_dev_mbr(struct dev_info * parent,
     d->dev.lseek = mbr_lseek;
     d->dev.ioctl = parent->ioctl;
     d->dev.block_size = parent->block_size;
-    d->dev.flags = parent->flags;
+    /* Partitions share the request queue of the parent device. */
+    d->dev.flags = parent->flags & ~DEV_FLAGS_BIOQ;
+    d->dev.bioq = parent->bioq;
+    d->dev.bioq_blkoff = parent->bioq_blkoff + part->lba_start;
     d->part_no = part_no;
     d->part_id = part->type;
     d->start_block = part->lba_start;
@@ -34,6 +34,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fs/fs.h>
+#include <fs/fs_util.h>
 #include <kstring.h>
 #include <proc.h>
 
@@ -47,6 +48,7 @@ const vnode_ops_t nofs_vnode_ops = {
     .event_vnode_opened = fs_enotsup_event_vnode_opened,
     .event_fd_created = fs_enotsup_event_fd_created,
     .event_fd_closed = fs_enotsup_event_fd_closed,
+    .event_file_destroyed = fs_enotsup_event_file_destroyed,
     .create = fs_enotsup_create,
     .mknod = fs_enotsup_mknod,
     .lookup = fs_enotsup_lookup,
@@ -56,6 +58,7 @@ const vnode_ops_t nofs_vnode_ops = {
     .mkdir = fs_enotsup_mkdir,
     .rmdir = fs_enotsup_rmdir,
     .readdir = fs_enotsup_readdir,
+    .getdents = nofs_getdents,
     .stat = fs_enotsup_stat,
     .utimes = fs_enotsup_utimes,
     .chmod = fs_enotsup_chmod,
@@ -136,6 +139,11 @@ void fs_enotsup_event_fd_closed(struct proc_info * p, file_t * file)
     /* No need to implement */
 }
 
+void fs_enotsup_event_file_destroyed(file_t * file)
+{
+    /* No need to implement */
+}
+
 int fs_enotsup_create(vnode_t * dir, const char * name, mode_t mode,
                       vnode_t ** result)
 {
@@ -208,6 +216,42 @@ int fs_enotsup_readdir(vnode_t * dir, struct dirent * d, off_t * off)
     return -ENOTSUP;
 }
 
+/**
+ * Generic getdents built on readdir.
+ * Requires that readdir can be restarted from a previously returned offset.
+ */
+ssize_t nofs_getdents(file_t * file, void * buf, size_t bytes)
+{
+    vnode_t * dir = file->vnode;
+    struct dirent d;
+    size_t n = 0;
+
+    while (n < bytes) {
+        const off_t off = file->seek_pos;
+        size_t reclen;
+        int err;
+
+        err = dir->vnode_ops->readdir(dir, &d, &file->seek_pos);
+        if (err) {
+            if (err != -ESPIPE && n == 0)
+                return err;
+            break;
+        }
+
+        reclen = fs_dirent_put((char *)buf + n, bytes - n,
+                               d.d_ino, d.d_type, d.d_name);
+        if (reclen == 0) {
+            file->seek_pos = off; /* Return it on the next call. */
+            if (n == 0)
+                return -EINVAL;
+            break;
+        }
+        n += reclen;
+    }
+
+    return n;
+}
+
 int fs_enotsup_stat(vnode_t * vnode, struct stat * buf)
 {
     return -ENOTSUP;
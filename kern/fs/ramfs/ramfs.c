@@ -61,9 +61,24 @@
  */
 #define RAMFS_INODE_POOL_SIZE   ((configRAMFS_DESIREDVNODES >> 3) + 5)
 
+/**
+ * Maximum number of blocks allocated for a single extent.
+ */
+#define RAMFS_EXTENT_MAXBLKS    64
+
 #define RFS_DOT "."
 #define RFS_DOTDOT ".."
 
+/**
+ * A contiguous range of regular file data stored in a single buffer.
+ */
+struct ramfs_extent {
+    off_t ex_off;           /*!< File offset of the first byte. */
+    size_t ex_len;          /*!< Length of the extent, a multiple of
+                             *   in_blksize. */
+    struct buf * ex_bp;     /*!< Buffer holding the data. */
+};
+
 /**
  * inode struct.
  */
@@ -82,15 +97,17 @@ typedef struct ramfs_inode {
 
     union {
         /**
-         * Data array.
-         * This is a pointer to an array of pointer pointing to the actual
-         * blocks of data. Blocks are fragments of data of the stored file.
-         * in_blksize and in_blocks can be used to calculate the size of this
-         * file. The size derived from those variables might not correspond to
-         * the size indicated by in_vnode->len but the size is always at least
+         * Extent map.
+         * An array of extents sorted by ex_off. The extents cover the file
+         * data from offset zero to in_blocks * in_blksize without holes.
+         * The size derived from in_blocks might not correspond to the size
+         * indicated by in_vnode->len but the size is always at least
          * in_vnode->len in case of ramfs.
          */
-        struct buf ** data;
+        struct {
+            struct ramfs_extent * ext;
+            size_t nr_ext;  /*!< Number of extents in ext. */
+        } reg;
         dh_table_t * dir;
     } in;
     rwlock_t in_lock;
@@ -132,6 +149,7 @@ static void destroy_vnode(vnode_t * vnode);
 static void destroy_inode(ramfs_inode_t * inode);
 static void destroy_inode_data(ramfs_inode_t * inode);
 static int insert_inode(ramfs_inode_t * inode);
+static int set_filesize(ramfs_inode_t * file, off_t new_size);
 static struct ramfs_dp get_dp_by_offset(ramfs_inode_t * inode, off_t offset);
 
 /**
@@ -428,7 +446,7 @@ int ramfs_delete_vnode(vnode_t * vnode)
 
 ssize_t ramfs_read(file_t * file, struct uio * uio, size_t count)
 {
-    size_t bytes_rd = 0;
+    ssize_t bytes_rd;
 
     switch (file->vnode->vn_mode & S_IFMT) {
     case S_IFREG: /* file is a regular file. */
@@ -440,13 +458,16 @@ ssize_t ramfs_read(file_t * file, struct uio * uio, size_t count)
         return -EOPNOTSUPP;
     }
 
+    if (bytes_rd < 0)
+        return bytes_rd;
+
     file->seek_pos += bytes_rd;
     return bytes_rd;
 }
 
 ssize_t ramfs_write(file_t * file, struct uio * uio, size_t count)
 {
-    size_t bytes_wr = 0;
+    ssize_t bytes_wr;
 
     switch (file->vnode->vn_mode & S_IFMT) {
     case S_IFREG: /* File is a regular file. */
@@ -456,6 +477,9 @@ ssize_t ramfs_write(file_t * file, struct uio * uio, size_t count)
         return -EOPNOTSUPP;
     }
 
+    if (bytes_wr < 0)
+        return bytes_wr;
+
     ramfs_vnode_modified(file->vnode);
 
     file->seek_pos += bytes_wr;
@@ -795,8 +819,6 @@ int ramfs_rmdir(vnode_t * dir,  const char * name)
 
 int ramfs_readdir(vnode_t * dir, struct dirent * d, off_t * off)
 {
-    const off_t dea_ind_mask = 0x7FFFFFFF00000000;
-    const off_t ch_ind_mask  = DIRENT_SEEK_START;
     dh_dir_iter_t it;
     dh_dirent_t * dh;
 
@@ -805,26 +827,19 @@ int ramfs_readdir(vnode_t * dir, struct dirent * d, off_t * off)
 
     /*
      * Dirent to iterator translation.
-     * We assume here that off_t is a 64-bit signed integer, so we can store the
-     * dea index to upper bits as it's definitely shorter than chain index which
-     * will be the low 32-bits.
-     * Note: For the first iteration ch_ind must be set to 0xFFFFFFFF.
+     * The offset is the slot index of the next entry in the dirent hash
+     * table, slot indices are stable when the table is modified.
      */
-    it.dir = get_inode_of_vnode(dir)->in.dir;
-    it.dea_ind = (*off & dea_ind_mask) >> 32;
-    it.ch_ind  = (*off & ch_ind_mask);
-    if (it.ch_ind == ch_ind_mask)
-        it.ch_ind = SIZE_MAX; /* Just to make sure that the requirements of the
-                               * iterator are met on systems with different
-                               * architectures. (i.e. len of size_t) */
+    it = dh_get_iter(get_inode_of_vnode(dir)->in.dir);
+    if (*off != DIRENT_SEEK_START)
+        it.slot = (size_t)*off;
 
     dh = dh_iter_next(&it);
-    if (!dh || dh->dh_size == 0)
+    if (!dh)
         return -ESPIPE; /* End of dir. */
 
     /* Translate iterator back to dirent. */
-    *off = ((((off_t)it.dea_ind) << 32) & dea_ind_mask) |
-           (off_t)(it.ch_ind & ch_ind_mask);
+    *off = (off_t)it.slot;
     d->d_ino = dh->dh_ino;
     d->d_type = dh->dh_type;
     strlcpy(d->d_name, dh->dh_name, member_size(struct dirent, d_name));
@@ -1066,7 +1081,8 @@ static int insert_inode(ramfs_inode_t * inode)
  * @param offset    is the offset from SEEK_START.
  * @param buf       is a buffer where bytes are read from.
  * @param count     is the number of bytes buf contains.
- * @return Returns the number of bytes written.
+ * @return Returns the number of bytes written;
+ *         Otherwise a negative errno code.
  */
 ssize_t ramfs_wr_regular(vnode_t * file, const off_t * restrict offset,
                          struct uio * uio, size_t count)
@@ -1075,42 +1091,63 @@ ssize_t ramfs_wr_regular(vnode_t * file, const off_t * restrict offset,
     const blksize_t blksize = inode->in_blksize;
     struct ramfs_dp dp;
     size_t bytes_wr = 0;
+    ssize_t retval;
 
     /*
      * No file type check is needed as this function is called only for regular
      * files.
      */
 
-    do {
+    rwlock_wrlock(&inode->in_lock);
+
+    /* Extend the file to the final size if possible. */
+    if (*offset + (off_t)count > (off_t)inode->in_blocks * (off_t)blksize)
+        (void)set_filesize(inode, *offset + (off_t)count);
+
+    /* Clear the hole left between the old EOF and the offset. */
+    for (off_t pos = file->vn_len; pos < *offset;) {
+        dp = get_dp_by_offset(inode, pos);
+        if (!dp.p)
+            break;
+        dp.len = (size_t)min(dp.len, *offset - pos);
+        memset(dp.p, 0, dp.len);
+        pos += dp.len;
+    }
+
+    while (bytes_wr < count) {
         const size_t remain = count - bytes_wr;
         size_t curr_wr_len;
         int err;
 
-        /* Get next block pointer. */
+        /* Get next data pointer. */
         dp = get_dp_by_offset(inode, *offset + bytes_wr);
-        if (!dp.p) { /* Extend the file first. */
-            /* Extend the file to the final size if possible. */
-            if (ramfs_set_filesize(file, inode->in_blocks * blksize
-                        + *offset + (off_t)count)) {
-                break; /* Failed to extend the file. */
-            } else { /* Try again to get a block. */
-                continue;
-            }
-        }
+        if (!dp.p)
+            break; /* Failed to extend the file. */
 
         /*
-         * Write bytes to the block.
-         * Max per iteration is the size of the current block.
+         * Write bytes to the extent.
+         * Max per iteration is the remaining size of the current extent.
          */
         curr_wr_len = min(remain, dp.len);
         err = uio_copyin(uio, dp.p, bytes_wr, curr_wr_len);
-        if (err)
-            return err;
+        if (err) {
+            retval = err;
+            goto out;
+        }
         bytes_wr += curr_wr_len;
-    } while (bytes_wr < count);
+    }
 
-    file->vn_len = max(file->vn_len, *offset + bytes_wr);
-    return bytes_wr;
+    if (bytes_wr == 0 && count > 0) {
+        retval = -ENOSPC;
+        goto out;
+    }
+
+    if (*offset + (off_t)bytes_wr > file->vn_len)
+        file->vn_len = *offset + bytes_wr;
+    retval = bytes_wr;
+out:
+    rwlock_wrunlock(&inode->in_lock);
+    return retval;
 }
 
 /**
@@ -1118,7 +1155,8 @@ ssize_t ramfs_wr_regular(vnode_t * file, const off_t * restrict offset,
  * @param file      is a regular file.
  * @param offset    is the offset form SEEK_START.
  * @param count     is the requested number of bytes to be read.
- * @return Returns the number of bytes read from the file.
+ * @return Returns the number of bytes read from the file;
+ *         Otherwise a negative errno code.
  */
 ssize_t ramfs_rd_regular(vnode_t * file, const off_t * restrict offset,
                          struct uio * uio, size_t count)
@@ -1126,48 +1164,139 @@ ssize_t ramfs_rd_regular(vnode_t * file, const off_t * restrict offset,
     ramfs_inode_t * inode = get_inode_of_vnode(file);
     struct ramfs_dp dp;
     size_t bytes_rd = 0;
+    ssize_t retval;
 
     /*
      * No file type check is needed as this function is called only for regular
      * files.
      */
 
-    do {
-        const size_t remain = count - bytes_rd;
+    rwlock_rdlock(&inode->in_lock);
+
+    while (bytes_rd < count) {
+        const off_t pos = *offset + bytes_rd;
         size_t curr_rd_len;
         int err;
 
-        if ((*offset + bytes_rd) >= file->vn_len) {
+        if (pos >= file->vn_len)
             break; /* EOF */
-        }
 
-        /* Get next block pointer. */
-        dp = get_dp_by_offset(inode, *offset + bytes_rd);
-        if (!dp.p) {
+        /* Get next data pointer. */
+        dp = get_dp_by_offset(inode, pos);
+        if (!dp.p)
             break; /* EOF */
-        }
 
-        /* Read bytes from the block. */
-        curr_rd_len = min(remain, dp.len);
+        /* Read bytes from the extent. */
+        curr_rd_len = min(count - bytes_rd, dp.len);
+        curr_rd_len = (size_t)min(curr_rd_len, file->vn_len - pos);
         err = uio_copyout(dp.p, uio, bytes_rd, curr_rd_len);
-        if (err)
-            return err;
+        if (err) {
+            retval = err;
+            goto out;
+        }
         bytes_rd += curr_rd_len;
-    } while (bytes_rd < count);
+    }
 
-    return bytes_rd;
+    retval = bytes_rd;
+out:
+    rwlock_rdunlock(&inode->in_lock);
+    return retval;
 }
 
 /**
- * Set file size.
- * Sets a new size for a regular file.
+ * Append new extents to a file until it's new_size bytes long.
+ * Each extent is allocated as one contiguous buffer of at most
+ * RAMFS_EXTENT_MAXBLKS blocks, smaller extents are tried if the allocation
+ * fails.
  * @param file      is the inode of a regular file.
- * @param new_size  is the new size of file.
- * @return Returns 0 if succeeded; Otherwise value other than zero.
+ * @param new_size  is the new block aligned size of the file.
+ * @return Returns 0 if succeeded; Otherwise a negative errno code.
  */
-int ramfs_set_filesize(vnode_t * vnode, off_t new_size)
+static int extend_file(ramfs_inode_t * file, off_t new_size)
+{
+    const size_t blksize = (size_t)file->in_blksize;
+    off_t size = (off_t)file->in_blocks * (off_t)blksize;
+
+    while (size < new_size) {
+        struct ramfs_extent * ext;
+        struct buf * bp;
+        size_t len;
+
+        ext = krealloc(file->in.reg.ext,
+                       (file->in.reg.nr_ext + 1) * sizeof(struct ramfs_extent));
+        if (!ext)
+            return -ENOMEM;
+        file->in.reg.ext = ext;
+
+        len = (size_t)min(new_size - size, RAMFS_EXTENT_MAXBLKS * blksize);
+        while (!(bp = geteblk(len)) && len > blksize) {
+            len = max((len / 2) & ~(blksize - 1), blksize);
+        }
+        if (!bp)
+            return -ENOMEM; /* Can't extend to the requested size. */
+
+        ext[file->in.reg.nr_ext++] = (struct ramfs_extent){
+            .ex_off = size,
+            .ex_len = len,
+            .ex_bp = bp,
+        };
+        size += len;
+        file->in_blocks = size / blksize;
+    }
+
+    return 0;
+}
+
+/**
+ * Release the extents past new_size.
+ * An extent crossing new_size is replaced with a smaller copy if memory can
+ * be allocated for it; Otherwise the extent is kept as it is.
+ * @param file      is the inode of a regular file.
+ * @param new_size  is the new block aligned size of the file.
+ */
+static void truncate_file(ramfs_inode_t * file, off_t new_size)
+{
+    struct ramfs_extent * ext = file->in.reg.ext;
+
+    while (file->in.reg.nr_ext > 0) {
+        struct ramfs_extent * ex = &ext[file->in.reg.nr_ext - 1];
+
+        if (ex->ex_off >= new_size) {
+            vrfree(ex->ex_bp);
+            file->in.reg.nr_ext--;
+            continue;
+        }
+
+        if (ex->ex_off + (off_t)ex->ex_len > new_size) {
+            const size_t keep = (size_t)(new_size - ex->ex_off);
+            struct buf * bp;
+
+            bp = geteblk(keep);
+            if (bp) {
+                memcpy((void *)bp->b_data, (void *)ex->ex_bp->b_data, keep);
+                vrfree(ex->ex_bp);
+                ex->ex_bp = bp;
+                ex->ex_len = keep;
+            } else {
+                new_size = ex->ex_off + ex->ex_len;
+            }
+        }
+        break;
+    }
+
+    if (file->in.reg.nr_ext == 0) {
+        kfree(ext);
+        file->in.reg.ext = NULL;
+    }
+    file->in_blocks = new_size / file->in_blksize;
+}
+
+/**
+ * Set the size of the extent map of a file.
+ * The caller must hold in_lock for writing.
+ */
+static int set_filesize(ramfs_inode_t * file, off_t new_size)
 {
-    ramfs_inode_t * file = get_inode_of_vnode(vnode);
     const blksize_t blksize = file->in_blksize;
     const off_t old_size = (off_t)file->in_blocks * (off_t)blksize;
 
@@ -1181,79 +1310,70 @@ int ramfs_set_filesize(vnode_t * vnode, off_t new_size)
     if (new_size == old_size) { /* Same as old */
         return 0;
     } else if (new_size < old_size) { /* Truncate */
-        if (new_size > 0) {
-            /* TODO Free blocks to truncate the file */
-        } else {  /* Free all blocks. */
-            struct buf ** bpp = file->in.data;
-            size_t i;
-
-            for (i = 0; i < file->in_blocks; i++) {
-                if (bpp[i])
-                    vrfree(bpp[i]);
-            }
-            file->in.data = NULL;
-            file->in_blocks = 0;
-        }
+        truncate_file(file, new_size);
+        return 0;
     } else { /* Extend */
-        struct buf ** new_data;
-        const blkcnt_t new_blkcnt = new_size / blksize;
-        size_t i;
-
-        new_data = krealloc(file->in.data, sizeof(struct buf) * new_blkcnt);
-        if (!new_data) {
-            return -ENOMEM; /* Can't extend. */
-        }
-        file->in.data = new_data;
+        return extend_file(file, new_size);
+    }
+}
 
-        /*
-         * TODO It would be possibly more efficient for memory usage to allocate
-         * new blocks just before writing but that'd require some refactoring.
-         */
+/**
+ * Set file size.
+ * Sets a new size for a regular file.
+ * @param file      is the inode of a regular file.
+ * @param new_size  is the new size of file.
+ * @return Returns 0 if succeeded; Otherwise value other than zero.
+ */
+int ramfs_set_filesize(vnode_t * vnode, off_t new_size)
+{
+    ramfs_inode_t * file = get_inode_of_vnode(vnode);
+    int err;
 
-        /* Allocate new blocks. */
-        for (i = file->in_blocks; i < new_blkcnt; i++) {
-            new_data[i] = geteblk(blksize);
-            if (!new_data[i]) { /* Can't alloc. */
-                file->in_blocks += i;
-                return -ENOMEM; /* Can't extend to the requested size. */
-            }
-        }
-        file->in_blocks = new_blkcnt;
-    }
+    rwlock_wrlock(&file->in_lock);
+    err = set_filesize(file, new_size);
+    if (!err && vnode->vn_len > new_size)
+        vnode->vn_len = new_size;
+    rwlock_wrunlock(&file->in_lock);
 
-    return 0;
+    return err;
 }
 
 /**
  * Get data pointer by given offset.
+ * The extent containing offset is found with a binary search.
  * @note This function may return pointers that are pointing to a memory
  * location after the EOF.
  * @param inode     is a ramfs inode.
  * @param offset    is the offset of seek pointer.
  * @return Returns a struct that contains a pointer to the requested data and
- *         length of returned block. dp.p == NULL if request out of bounds.
+ *         the length of data remaining in the same extent.
+ *         dp.p == NULL if request out of bounds.
  */
 static struct ramfs_dp get_dp_by_offset(ramfs_inode_t * inode, off_t offset)
 {
-    const blksize_t blksize = inode->in_blksize;
+    const struct ramfs_extent * ext = inode->in.reg.ext;
     struct ramfs_dp dp = { .p = 0, .len = 0 }; /* Return value. */
-
-    if (/* Out of bounds check. */
-        !(offset >= ((off_t)inode->in_blocks * (off_t)blksize)) &&
-        /* Data array is set. */
-        inode->in.data) {
-        size_t bi; /* Block index. */
-        size_t di; /* Data index. */
-        char * block; /* Pointer to the block. */
-
-        bi = (size_t)((offset - (offset & ((off_t)(blksize - 1))))
-                / (off_t)blksize);
-        di = (size_t)(((size_t)offset) & (blksize - 1));
-        block = (char *)(inode->in.data[bi]->b_data);
-
-        /* Return value. */
-        dp.p = &block[di];
-        dp.len = blksize - di;
+    size_t lo = 0;
+    size_t hi = inode->in.reg.nr_ext;
+
+    if (offset < 0)
+        return dp;
+
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const struct ramfs_extent * ex = &ext[mid];
+
+        if (offset < ex->ex_off) {
+            hi = mid;
+        } else if (offset >= ex->ex_off + (off_t)ex->ex_len) {
+            lo = mid + 1;
+        } else {
+            const size_t di = (size_t)(offset - ex->ex_off); /* Data index. */
+
+            dp.p = (char *)ex->ex_bp->b_data + di;
+            dp.len = ex->ex_len - di;
+            break;
+        }
     }
 
     return dp;
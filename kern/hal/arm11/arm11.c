@@ -111,6 +111,17 @@ sw_stack_frame_t * get_usr_sframe(struct thread_info * thread)
     return NULL;
 }
 
+int get_irq_pc(const struct thread_info * thread, uintptr_t * pc,
+               uintptr_t * lr)
+{
+    const sw_stack_frame_t * sframe = &thread->sframe.s[SCHED_SFRAME_SYS];
+
+    *pc = sframe->pc - 4; /* The IRQ return address is PC + 4. */
+    *lr = sframe->lr;
+
+    return ((sframe->psr & PSR_MODE_MASK) == PSR_MODE_USER);
+}
+
 /**
  * Set the stack frame of the current thread to a privileged register.
  * This is an optimization that makes fetching the stack frame address
@@ -187,30 +198,225 @@ void cpu_invalidate_caches(void)
 }
 
 /**
- * Set Context ID.
+ * Clean a range of the D cache to the point of coherency.
+ * Used to make the page table updates visible to the table walk hardware.
+ */
+void cpu_clean_dcache_range(uintptr_t start, size_t len)
+{
+    const uint32_t rd = 0;
+    const uintptr_t end = start + len;
+
+    for (start &= ~(ARM11_DCACHE_LINE - 1); start < end;
+         start += ARM11_DCACHE_LINE) {
+        __asm__ volatile (
+            "MCR    p15, 0, %[mva], c7, c10, 1" /* Clean D line by MVA. */
+            : : [mva]"r" (start)
+        );
+    }
+    __asm__ volatile (
+        "MCR    p15, 0, %[rd], c7, c10, 4"      /* DSB. */
+        : : [rd]"r" (rd)
+    );
+}
+
+/**
+ * Invalidate a range of the D cache.
+ * Used to discard stale lines after a DMA transfer to memory. The range
+ * should be aligned to ARM11_DCACHE_LINE as the lines are discarded even if
+ * they contain dirty data outside of the range.
+ */
+void cpu_invalidate_dcache_range(uintptr_t start, size_t len)
+{
+    const uint32_t rd = 0;
+    const uintptr_t end = start + len;
+
+    for (start &= ~(ARM11_DCACHE_LINE - 1); start < end;
+         start += ARM11_DCACHE_LINE) {
+        __asm__ volatile (
+            "MCR    p15, 0, %[mva], c7, c6, 1"  /* Invalidate D line by MVA. */
+            : : [mva]"r" (start)
+        );
+    }
+    __asm__ volatile (
+        "MCR    p15, 0, %[rd], c7, c10, 4"      /* DSB. */
+        : : [rd]"r" (rd)
+    );
+}
+
+/**
+ * Clean the D cache and invalidate the I cache.
+ * Required before executing code that was written through the D cache.
+ */
+void cpu_sync_icache(void)
+{
+    const uint32_t rd = 0;
+
+    __asm__ volatile (
+        "MCR    p15, 0, %[rd], c7, c10, 0\n\t" /* Clean D cache. */
+        "MCR    p15, 0, %[rd], c7, c10, 4\n\t" /* DSB. */
+        "MCR    p15, 0, %[rd], c7, c5, 0\n\t"  /* Invalidate I cache & BTAC */
+        "MCR    p15, 0, %[rd], c7, c5, 4"       /* Prefetch flush. */
+        : : [rd]"r" (rd)
+    );
+}
+
+/**
+ * Invalidate the TLB entries for a range of virtual addresses.
+ * @param mva       is the first virtual address.
+ * @param asid      is the ASID of the entries or zero for global entries.
+ * @param count     is the number of entries.
+ * @param size      is the size of a single entry.
+ */
+void cpu_invalidate_tlb_range(uintptr_t mva, uint32_t asid, size_t count,
+                              size_t size)
+{
+    const uint32_t rd = 0;
+
+    if (count > ARM11_TLB_RANGE_MAX) {
+        if (asid)
+            cpu_invalidate_tlb_asid(asid);
+        else
+            cpu_invalidate_tlb();
+        return;
+    }
+
+    asid &= ARM11_CID_ASID_MASK;
+    for (size_t i = 0; i < count; i++) {
+        __asm__ volatile (
+            "MCR    p15, 0, %[mva], c8, c7, 1" /* Invalidate I+D TLB by MVA */
+            : : [mva]"r" (((mva + i * size) & ~0xfff) | asid)
+        );
+    }
+    __asm__ volatile (
+        "MCR    p15, 0, %[rd], c7, c5, 6\n\t"  /* Flush BTAC. */
+        "MCR    p15, 0, %[rd], c7, c10, 4\n\t" /* DSB. */
+        "MCR    p15, 0, %[rd], c7, c5, 4"       /* Prefetch flush. */
+        : : [rd]"r" (rd)
+    );
+}
+
+/**
+ * Invalidate all non-global TLB entries tagged with an ASID.
+ * @param asid      is the ASID.
+ */
+void cpu_invalidate_tlb_asid(uint32_t asid)
+{
+    const uint32_t rd = 0;
+
+    __asm__ volatile (
+        "MCR    p15, 0, %[asid], c8, c7, 2\n\t" /* Invalidate by ASID. */
+        "MCR    p15, 0, %[rd], c7, c5, 6\n\t"   /* Flush BTAC. */
+        "MCR    p15, 0, %[rd], c7, c10, 4\n\t"  /* DSB. */
+        "MCR    p15, 0, %[rd], c7, c5, 4"        /* Prefetch flush. */
+        : : [asid]"r" (asid & ARM11_CID_ASID_MASK), [rd]"r" (rd)
+    );
+}
+
+/**
+ * Invalidate all TLB entries.
+ */
+void cpu_invalidate_tlb(void)
+{
+    const uint32_t rd = 0;
+
+    __asm__ volatile (
+        "MCR    p15, 0, %[rd], c8, c7, 0\n\t"  /* Invalidate all I+D TLBs. */
+        "MCR    p15, 0, %[rd], c7, c5, 6\n\t"  /* Flush BTAC. */
+        "MCR    p15, 0, %[rd], c7, c10, 4\n\t" /* DSB. */
+        "MCR    p15, 0, %[rd], c7, c5, 4"       /* Prefetch flush. */
+        : : [rd]"r" (rd)
+    );
+}
+
+/**
+ * Switch the translation table base and the ASID.
+ * The reserved ASID 0 is used while TTBR0 is changed so that no entries
+ * from the old tables can be cached with the new ASID.
+ * @param ttb       is the address of the new L1 translation table.
+ * @param asid      is the new ASID.
+ */
+void arm11_switch_ttb(uintptr_t ttb, uint32_t asid)
+{
+    const uint32_t rd = 0;
+    uint32_t cid;
+
+    __asm__ volatile (
+        "MRC    p15, 0, %[cid], c13, c0, 1" /* Read CID */
+         : [cid]"=r" (cid)
+    );
+    cid &= ~ARM11_CID_ASID_MASK;
+
+    __asm__ volatile (
+        "MCR    p15, 0, %[rd], c7, c10, 4\n\t"  /* DSB */
+        "MCR    p15, 0, %[cid], c13, c0, 1\n\t" /* Set the reserved ASID */
+        "MCR    p15, 0, %[rd], c7, c5, 4\n\t"   /* Prefetch flush */
+        "MCR    p15, 0, %[ttb], c2, c0, 0\n\t"  /* Set TTBR0 */
+        "MCR    p15, 0, %[rd], c7, c5, 4\n\t"   /* Prefetch flush */
+        "MCR    p15, 0, %[ncid], c13, c0, 1\n\t" /* Set the new ASID */
+        "MCR    p15, 0, %[rd], c7, c5, 6\n\t"   /* Flush BTAC */
+        "MCR    p15, 0, %[rd], c7, c5, 4"        /* Prefetch flush */
+        : : [rd]"r" (rd), [cid]"r" (cid), [ttb]"r" (ttb),
+            [ncid]"r" (cid | (asid & ARM11_CID_ASID_MASK))
+    );
+}
+
+/**
+ * Set the process ID field of the Context ID.
+ * The ASID field is owned by arm11_switch_ttb() and it's preserved.
  * Should be only called from ARM11 specific interrupt handlers.
- * @param cid new Context ID.
+ * @param procid is the new process ID.
  */
-void arm11_set_cid(uint32_t cid)
+void arm11_set_cid(uint32_t procid)
 {
     const int rd = 0;
     uint32_t curr_cid;
+    uint32_t cid;
 
     __asm__ volatile (
         "MRC    p15, 0, %[cid], c13, c0, 1" /* Read CID */
          : [cid]"=r" (curr_cid)
     );
 
+    cid = (procid << ARM11_CID_PROCID_SHIFT) |
+          (curr_cid & ARM11_CID_ASID_MASK);
     if (curr_cid != cid) {
         __asm__ volatile (
             "MCR    p15, 0, %[rd], c7, c10, 4\n\t"  /* DSB */
             "MCR    p15, 0, %[cid], c13, c0, 1\n\t" /* Set CID */
-            "MCR    p15, 0, %[rd], c7, c5, 0\n\t"   /* Flush I cache & BTAC */
+            "MCR    p15, 0, %[rd], c7, c5, 4"        /* Prefetch flush */
             : : [rd]"r" (rd), [cid]"r" (cid)
         );
     }
 }
 
+uint32_t core_get_cycles(void)
+{
+    uint32_t pmnc;
+    uint32_t ccnt;
+
+    __asm__ volatile (
+        "MRC    p15, 0, %[pmnc], c15, c12, 0" /* Read PMNC */
+        : [pmnc]"=r" (pmnc)
+    );
+
+    if (!(pmnc & ARM11_PMNC_E)) {
+        /* Enable the counters and reset CCNT without the 1/64 divider. */
+        pmnc &= ~ARM11_PMNC_D;
+        pmnc |= ARM11_PMNC_E | ARM11_PMNC_C;
+        __asm__ volatile (
+            "MCR    p15, 0, %[pmnc], c15, c12, 0" /* Write PMNC */
+            : : [pmnc]"r" (pmnc)
+        );
+    }
+
+    __asm__ volatile (
+        "MRC    p15, 0, %[ccnt], c15, c12, 1" /* Read CCNT */
+        : [ccnt]"=r" (ccnt)
+    );
+
+    return ccnt;
+}
+
 uint32_t core_get_user_tls(void)
 {
     uint32_t value;
@@ -46,6 +46,7 @@
 #ifndef ARM11_H
 #define ARM11_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <hal/core.h>
 
@@ -161,7 +162,48 @@ struct tls_regs {
 #endif
 };
 
+/**
+ * D cache line size in bytes.
+ */
+#define ARM11_DCACHE_LINE       32
+
+/**
+ * Max number of TLB entries invalidated one by one.
+ * Invalidating larger ranges is done by invalidating the whole TLB.
+ */
+#define ARM11_TLB_RANGE_MAX     32
+
+/**
+ * Context ID register fields.
+ * @{
+ */
+#define ARM11_CID_ASID_MASK     0xffu   /*!< Address Space Identifier. */
+#define ARM11_CID_PROCID_SHIFT  8       /*!< Process ID. */
+/**
+ * @}
+ */
+
+/**
+ * Performance Monitor Control Register bits.
+ * @{
+ */
+#define ARM11_PMNC_E            0x1     /*!< Enable all counters. */
+#define ARM11_PMNC_C            0x4     /*!< Reset the cycle counter. */
+#define ARM11_PMNC_D            0x8     /*!< Count every 64th cycle. */
+/**
+ * @}
+ */
+
 void cpu_invalidate_caches(void);
+void cpu_clean_dcache_range(uintptr_t start, size_t len);
+void cpu_invalidate_dcache_range(uintptr_t start, size_t len);
+void cpu_sync_icache(void);
+void cpu_invalidate_tlb_range(uintptr_t mva, uint32_t asid, size_t count,
+                              size_t size);
+void cpu_invalidate_tlb_asid(uint32_t asid);
+void cpu_invalidate_tlb(void);
+void arm11_switch_ttb(uintptr_t ttb, uint32_t asid);
+void arm11_set_cid(uint32_t procid);
 
 uint32_t core_get_user_tls(void);
 void core_set_user_tls(uint32_t value);
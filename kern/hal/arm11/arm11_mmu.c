@@ -35,9 +35,11 @@
 #include <kstring.h>
 #include <kerror.h>
 #include <klocks.h>
+#include <ksched.h>
 #include <proc.h>
 #include <hal/core.h>
 #include <hal/mmu.h>
+#include "arm11.h"
 
 #ifdef configMP
 static mtx_t mmu_lock = MTX_INITIALIZER(MTX_TYPE_SPIN, MTX_OPT_DEFAULT);
@@ -50,6 +52,159 @@ static mtx_t mmu_lock = MTX_INITIALIZER(MTX_TYPE_SPIN, MTX_OPT_DEFAULT);
 
 #define mmu_disable_ints() __asm__ volatile ("cpsid if")
 
+#define MMU_SYNC_TLB     0x1 /*!< Invalidate the TLB of the address space. */
+#define MMU_SYNC_ICACHE  0x2 /*!< Sync the I cache with the D cache. */
+
+/**
+ * ASID allocator state.
+ * ASIDs are handed out in generations; ASID 0 is reserved for the kernel
+ * and it's used for global mappings only. When the ASIDs of a generation
+ * run out the whole TLB is invalidated and a new generation is started,
+ * making every ASID of the previous generation stale.
+ * @{
+ */
+#define MMU_ASID_GEN_FIRST  (ARM11_CID_ASID_MASK + 1)
+static uint32_t mmu_asid_gen = MMU_ASID_GEN_FIRST;
+static uint32_t mmu_asid_next = 1;
+/**
+ * @}
+ */
+
+#ifdef configMP
+#define MMU_BATCH_NR_CPUS 4 /*!< Maximum number of cores in an ARM11 MPCore. */
+#else
+#define MMU_BATCH_NR_CPUS 1
+#endif
+
+/**
+ * Deferred MMU maintenance state.
+ * Kept per CPU, interrupts are disabled during a batch so the caller can't
+ * migrate to another core before the batch ends.
+ */
+static struct mmu_batch {
+    int depth;      /*!< Nesting depth of mmu_batch_begin() calls. */
+    int sync;       /*!< MMU_SYNC_ flags pending. */
+    istate_t istate;
+} mmu_batch_cpu[MMU_BATCH_NR_CPUS];
+
+/**
+ * Get the batch state of the current CPU.
+ * Must be called with interrupts disabled.
+ */
+static inline struct mmu_batch * mmu_batch_get(void)
+{
+    const int cpu = get_cpu_index();
+
+    KASSERT(cpu >= 0 && cpu < MMU_BATCH_NR_CPUS, "Invalid CPU index");
+
+    return &mmu_batch_cpu[cpu];
+}
+
+/*
+ * Page tables are allocated from the write-through ptmapper region, so
+ * cleaning the updated entries is cheap and mostly drains the write buffer
+ * before the TLB maintenance.
+ */
+
+/**
+ * Get the ASID of a page table for TLB maintenance.
+ * @param pt        is the page table.
+ * @return  Returns 0 if the page table is global, the ASID if the address
+ *          space has a valid ASID in the current generation, or -1 if the
+ *          TLB can't hold any entries tagged for the address space.
+ */
+static int mmu_tlb_asid(const mmu_pagetable_t * pt)
+{
+    const struct mmu_asid * asid = pt->pt_asid;
+
+    if (!asid)
+        return 0;
+    if ((asid->asid & ~ARM11_CID_ASID_MASK) != mmu_asid_gen)
+        return -1;
+    return asid->asid & ARM11_CID_ASID_MASK;
+}
+
+/**
+ * Get a valid ASID for an address space, allocating a new one if necessary.
+ * Must be called with interrupts disabled.
+ * @param pt        is the master page table of the address space.
+ * @return Returns the hardware ASID.
+ */
+static uint32_t mmu_asid_get(const mmu_pagetable_t * pt)
+{
+    struct mmu_asid * asid = pt->pt_asid;
+    int tlb_asid;
+
+    tlb_asid = mmu_tlb_asid(pt);
+    if (tlb_asid >= 0)
+        return tlb_asid;
+
+    if (mmu_asid_next > ARM11_CID_ASID_MASK) {
+        mmu_asid_gen += MMU_ASID_GEN_FIRST;
+        if (mmu_asid_gen == 0) /* Zero means unallocated. */
+            mmu_asid_gen = MMU_ASID_GEN_FIRST;
+        mmu_asid_next = 1;
+        cpu_invalidate_tlb();
+    }
+    asid->asid = mmu_asid_gen | mmu_asid_next++;
+
+    return asid->asid & ARM11_CID_ASID_MASK;
+}
+
+/**
+ * Make TLB and cache state consistent after a page table update.
+ * @param flags     MMU_SYNC_ flags.
+ * @param pt        is the page table updated.
+ * @param vaddr     is the first virtual address affected.
+ * @param count     is the number of TLB entries affected.
+ * @param size      is the size of a TLB entry.
+ */
+static void mmu_sync(int flags, const mmu_pagetable_t * pt, uintptr_t vaddr,
+                     size_t count, size_t size)
+{
+    struct mmu_batch * batch = mmu_batch_get();
+    int asid;
+
+    if (batch->depth > 0) {
+        batch->sync |= flags | MMU_SYNC_TLB;
+        return;
+    }
+
+    if (flags & MMU_SYNC_ICACHE)
+        cpu_sync_icache();
+
+    asid = mmu_tlb_asid(pt);
+    if (asid < 0)
+        return; /* No entries with a stale ASID can be used. */
+    if (flags & MMU_SYNC_TLB) {
+        if (asid)
+            cpu_invalidate_tlb_asid(asid);
+        else
+            cpu_invalidate_tlb();
+    } else {
+        cpu_invalidate_tlb_range(vaddr, asid, count, size);
+    }
+}
+
+/**
+ * Get MMU_SYNC_ flags needed after mapping a region.
+ * The caches are physically tagged, only executable mappings need to sync
+ * the I cache to see code written through the D cache.
+ */
+static int map_sync_flags(const mmu_region_t * region)
+{
+    return (region->control & MMU_CTRL_XN) ? 0 : MMU_SYNC_ICACHE;
+}
+
+/**
+ * Get the control bits for mapping a region.
+ * Regions mapped to an address space with an ASID are never global.
+ */
+static uint32_t map_control(const mmu_region_t * region)
+{
+    return region->control | ((region->pt->pt_asid) ? MMU_CTRL_NG : 0);
+}
+
 /**
  * MMU must be enabled early in the init to make atomic operations work
  * and to speed up the boot as caching can be enabled.
@@ -143,6 +298,7 @@ static void mmu_map_section_region(const mmu_region_t * region)
     uint32_t * p_pte;
     uint32_t pte;
     const int pages = region->num_pages - 1;
+    const uint32_t control = map_control(region);
     istate_t s;
 
     p_pte = (uint32_t *)region->pt->pt_addr; /* Page table base address */
@@ -153,10 +309,10 @@ static void mmu_map_section_region(const mmu_region_t * region)
     pte |= (region->ap & 0x3) << 10;        /* Set access permissions (AP) */
     pte |= (region->ap & 0x4) << 13;        /* Set access permissions (APX) */
     pte |= (region->pt->pt_dom & 0x7) << 5; /* Set domain */
-    pte |= (region->control & 0x3) << 16;   /* Set nG & S bits */
-    pte |= (region->control & 0x10);        /* Set XN bit */
-    pte |= (region->control & 0x60) >> 3;   /* Set C & B bits */
-    pte |= (region->control & 0x380) << 5;  /* Set TEX bits */
+    pte |= (control & 0x3) << 16;           /* Set nG & S bits */
+    pte |= (control & 0x10);                /* Set XN bit */
+    pte |= (control & 0x60) >> 3;           /* Set C & B bits */
+    pte |= (control & 0x380) << 5;          /* Set TEX bits */
     pte |= MMU_PTE_SECTION;                 /* Set entry type */
 
     MMU_LOCK();
@@ -167,7 +323,10 @@ static void mmu_map_section_region(const mmu_region_t * region)
         *p_pte-- = pte + (i << 20); /* i = 1 MB section */
     }
 
-    cpu_invalidate_caches();
+    cpu_clean_dcache_range((uintptr_t)(p_pte + 1),
+                           region->num_pages * sizeof(uint32_t));
+    mmu_sync(map_sync_flags(region), region->pt, region->vaddr,
+             region->num_pages, MMU_PGSIZE_SECTION);
     set_interrupt_state(s);
     MMU_UNLOCK();
 }
@@ -183,6 +342,7 @@ static void mmu_map_coarse_region(const mmu_region_t * region)
     uint32_t * p_pte;
     uint32_t pte;
     const int pages = region->num_pages - 1;
+    const uint32_t control = map_control(region);
     istate_t s;
 
     /* Page table base address */
@@ -195,10 +355,10 @@ static void mmu_map_coarse_region(const mmu_region_t * region)
     pte = region->paddr & 0xfffff000;       /* Set physical address */
     pte |= (region->ap & 0x3) << 4;         /* Set access permissions (AP) */
     pte |= (region->ap & 0x4) << 7;         /* Set access permissions (APX) */
-    pte |= (region->control & 0x3) << 10;   /* Set nG & S bits */
-    pte |= (region->control & 0x10) >> 4;   /* Set XN bit */
-    pte |= (region->control & 0x60) >> 3;   /* Set C & B bits */
-    pte |= (region->control & 0x380) >> 1;  /* Set TEX bits */
+    pte |= (control & 0x3) << 10;           /* Set nG & S bits */
+    pte |= (control & 0x10) >> 4;           /* Set XN bit */
+    pte |= (control & 0x60) >> 3;           /* Set C & B bits */
+    pte |= (control & 0x380) >> 1;          /* Set TEX bits */
     pte |= 0x2;                             /* Set entry type (4 kB page) */
 
     MMU_LOCK();
@@ -209,7 +369,10 @@ static void mmu_map_coarse_region(const mmu_region_t * region)
         *p_pte-- = pte + (i << 12); /* i = 4 KB small page */
     }
 
-    cpu_invalidate_caches();
+    cpu_clean_dcache_range((uintptr_t)(p_pte + 1),
+                           region->num_pages * sizeof(uint32_t));
+    mmu_sync(map_sync_flags(region), region->pt, region->vaddr,
+             region->num_pages, MMU_PGSIZE_COARSE);
     set_interrupt_state(s);
     MMU_UNLOCK();
 }
@@ -257,7 +420,10 @@ static void mmu_unmap_section_region(const mmu_region_t * region)
         *p_pte-- = pte + (i << 20); /* i = 1 MB section */
     }
 
-    cpu_invalidate_caches();
+    cpu_clean_dcache_range((uintptr_t)(p_pte + 1),
+                           region->num_pages * sizeof(uint32_t));
+    mmu_sync(0, region->pt, region->vaddr, region->num_pages,
+             MMU_PGSIZE_SECTION);
     set_interrupt_state(s);
     MMU_UNLOCK();
 }
@@ -286,7 +452,10 @@ static void mmu_unmap_coarse_region(const mmu_region_t * region)
         *p_pte-- = pte + (i << 12); /* i = 4 KB small page */
     }
 
-    cpu_invalidate_caches();
+    cpu_clean_dcache_range((uintptr_t)(p_pte + 1),
+                           region->num_pages * sizeof(uint32_t));
+    mmu_sync(0, region->pt, region->vaddr, region->num_pages,
+             MMU_PGSIZE_COARSE);
     set_interrupt_state(s);
     MMU_UNLOCK();
 }
@@ -326,6 +495,9 @@ static void attach_coarse_pagetable(const mmu_pagetable_t * restrict pt)
         i = (pt->vaddr + j * MMU_PGSIZE_SECTION) >> 20;
         ttb[i] = pte;
     }
+
+    cpu_clean_dcache_range((uintptr_t)&ttb[pt->vaddr >> 20],
+                           pt->nr_tables * sizeof(uint32_t));
 }
 
 int mmu_attach_pagetable(const mmu_pagetable_t * pt)
@@ -342,23 +514,28 @@ int mmu_attach_pagetable(const mmu_pagetable_t * pt)
 
     switch (pt->pt_type) {
     case MMU_PTT_MASTER:
-        /* TTB -> CP15:c2:c0,0 : TTBR0 */
-        __asm__ volatile (
-            "MCR p15, 0, %[ttb], c2, c0, 0"
-            :
-            : [ttb]"r" (ttb));
-
+        /*
+         * The kernel mappings are global and identical in every L1 table
+         * and the rest are tagged with the ASID, so the TLB can be kept.
+         * The caches are physically tagged and need no maintenance.
+         */
+        arm11_switch_ttb((uintptr_t)ttb, mmu_asid_get(pt));
         break;
     case MMU_PTT_COARSE:
         /* First level coarse page table entry */
         attach_coarse_pagetable(pt);
+
+        /*
+         * A new L2 table replaces any translations cached for the
+         * address range.
+         */
+        mmu_sync(MMU_SYNC_TLB, pt, 0, 0, 0);
         break;
     default:
         retval = -EINVAL;
         break;
     }
 
-    cpu_invalidate_caches();
     set_interrupt_state(s);
     MMU_UNLOCK();
 
@@ -392,13 +569,46 @@ int mmu_detach_pagetable(const mmu_pagetable_t * pt)
         ttb[i] = MMU_PTE_FAULT;
     }
 
-    cpu_invalidate_caches();
+    cpu_clean_dcache_range((uintptr_t)&ttb[pt->vaddr >> 20],
+                           nr_tables * sizeof(uint32_t));
+    mmu_sync(MMU_SYNC_TLB, pt, 0, 0, 0);
     set_interrupt_state(s);
     MMU_UNLOCK();
 
     return 0;
 }
 
+void mmu_batch_begin(void)
+{
+    istate_t s = get_interrupt_state();
+    struct mmu_batch * batch;
+
+    mmu_disable_ints();
+    batch = mmu_batch_get();
+    if (batch->depth++ == 0) {
+        batch->istate = s;
+        batch->sync = 0;
+    }
+}
+
+void mmu_batch_end(void)
+{
+    struct mmu_batch * batch = mmu_batch_get();
+
+    KASSERT(batch->depth > 0, "mmu_batch_end() without a batch");
+
+    if (--batch->depth == 0) {
+        const istate_t s = batch->istate;
+
+        if (batch->sync & MMU_SYNC_ICACHE)
+            cpu_sync_icache();
+        if (batch->sync & MMU_SYNC_TLB)
+            cpu_invalidate_tlb();
+        batch->sync = 0;
+        set_interrupt_state(s);
+    }
+}
+
 uint32_t mmu_domain_access_get(void)
 {
     uint32_t acr;
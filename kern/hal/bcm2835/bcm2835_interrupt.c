@@ -33,6 +33,7 @@
 #include <stdint.h>
 #include <hal/irq.h>
 #include <kerror.h>
+#include <ktrace.h>
 #include <libkern.h>
 #include "bcm2835_mmio.h"
 #include "bcm2835_interrupt.h"
@@ -64,15 +65,15 @@ void irq_disable(int irq)
 
     if (irq >= 0 && irq <= 7) {
         mmio_start(&s_entry);
-        mmio_write(BCMIRQ_DISABLE_BASIC, 1 < irq);
+        mmio_write(BCMIRQ_DISABLE_BASIC, 1 << irq);
         mmio_end(&s_entry);
     } else if (irq >= 29 && irq <= 31) {
         mmio_start(&s_entry);
-        mmio_write(BCMIRQ_DISABLE_IRQ1, 1 < irq);
+        mmio_write(BCMIRQ_DISABLE_IRQ1, 1 << irq);
         mmio_end(&s_entry);
     } else if (irq >= 32 && irq <= 63) {
         mmio_start(&s_entry);
-        mmio_write(BCMIRQ_DISABLE_IRQ2, 1 < (irq - 32));
+        mmio_write(BCMIRQ_DISABLE_IRQ2, 1 << (irq - 32));
         mmio_end(&s_entry);
     } else {
         KERROR(KERROR_ERR, "%s(): Invalid IRQ%d\n", __func__, irq);
@@ -92,21 +93,24 @@ void arm_handle_sys_interrupt(void)
     mmio_end(&s_entry);
 
     /*
-     * Clear ambiguous bits.
+     * Use the same numbering as irq_enable(); 0-7 are the ARM peripheral
+     * IRQs of the basic register, 29-31 and 32-63 are the GPU IRQs of the
+     * pending registers 1 and 2. The GPU IRQs mirrored to the basic
+     * register are ignored there.
      */
-    pending[0] &= ~0xffe00300;
-    pending[1] &= ~0xc0680;
-    pending[2] &= ~0x43e00000;
+    pending[0] &= 0xff;
+    pending[1] &= 0xe0000000;
 
     for (size_t i = 0; i < num_elem(pending); i++) {
         int bit = ffs(pending[i]);
         if (bit != 0) {
-            irq = 32 * i + bit - 1;
+            irq = ((i == 2) ? 32 : 0) + bit - 1;
         }
     }
     if (irq != -1 && irq < NR_IRQ && irq_handlers[irq]) {
         struct irq_handler * handler = irq_handlers[irq];
         handler->cnt++;
+        KTRACE(IRQ, irq, 0, 0);
         enum irq_ack ack_res = handler->ack(irq);
 
         if (ack_res == IRQ_NEEDS_HANDLING) {
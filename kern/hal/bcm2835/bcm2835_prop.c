@@ -31,22 +31,21 @@
  */
 
 #include <errno.h>
-#include <machine/atomic.h>
 #include <buf.h>
 #include <hal/hw_timers.h>
 #include <kerror.h>
 #include <kinit.h>
+#include <klocks.h>
 #include "bcm2835_mailbox.h"
 #include "bcm2835_mmio.h"
 #include "bcm2835_prop.h"
 
 /*
- * The mailbuffer is divided to 8 sections each 512 bytes to allow assynchronous
- * calls. This size should be re-evaluated if we hit a case where it's too
- * small.
+ * A response is read from the shared property channel so it could be
+ * consumed by a concurrent caller, the lock allows only one request at time
+ * and protects the mailbuffer.
  */
-#define MB_SECSIZE 512
-static isema_t mb_res[8] = ISEMA_INITIALIZER(8);
+static mtx_t mb_lock = MTX_INITIALIZER(MTX_TYPE_TICKET, 0);
 
 static struct buf * mbuf;
 
@@ -67,16 +66,13 @@ int __kinit__ bcm2835_prop_init(void)
 int bcm2835_prop_request(uint32_t * request)
 {
     uint32_t resp;
-    size_t i;
-    size_t offset;
     uint32_t * buf;
     uint32_t buf_hwaddr;
     int err;
 
-    i = isema_acquire(mb_res, num_elem(mb_res));
-    offset = i * MB_SECSIZE;
-    buf = (uint32_t *)(mbuf->b_data + offset);
-    buf_hwaddr = (uint32_t)(mbuf->b_mmu.paddr) + offset;
+    mtx_lock(&mb_lock);
+    buf = (uint32_t *)mbuf->b_data;
+    buf_hwaddr = (uint32_t)(mbuf->b_mmu.paddr);
 
     /*
      * Copy request to a buffer.
@@ -89,7 +85,8 @@ int bcm2835_prop_request(uint32_t * request)
     if (err) {
         KERROR(KERROR_ERR, "Failed to write to a prop mbox (%d)\n", err);
 
-        return -EIO;
+        err = -EIO;
+        goto out;
     }
 
     /* Get response. */
@@ -97,17 +94,19 @@ int bcm2835_prop_request(uint32_t * request)
     if (err) {
         KERROR(KERROR_DEBUG, "Failed to read from a prop mbox (%d)\n", err);
 
-        return err;
+        goto out;
     }
     if (buf[1] != BCM2835_STATUS_SUCCESS) {
         KERROR(KERROR_ERR, "Invalid prop mbox response (status: %u)\n",
                buf[1]);
 
-        return -EIO;
+        err = -EIO;
+        goto out;
     }
 
     memcpy(request, buf, buf[0]);
+out:
+    mtx_unlock(&mb_lock);
 
-    isema_release(mb_res, i); /* Release the mb. */
-    return 0;
+    return err;
 }
@@ -30,13 +30,18 @@
  *******************************************************************************
  */
 
+#include <errno.h>
+#include <kerror.h>
 #include <kinit.h>
+#include <hal/irq.h>
 #include "bcm2835_mmio.h"
 #include "bcm2835_gpio.h"
 #include "bcm2835_timers.h"
 #include <hal/core.h>
 #include <hal/uart.h>
 
+#define UART0_IRQ       57
+
 /* Addresses */
 #define UART0_BASE      0x20201000
 #define UART0_DR        (UART0_BASE + 0x00)
@@ -74,18 +79,59 @@
 #define UART0_FR_BUSY_OFFSET    3
 #define UART0_FR_CTS_OFFSET     0
 
+#define UART0_IMSC_RX           (1 << 4)
+#define UART0_IMSC_RT           (1 << 6)
+
 static void bcm2835_uart_setconf(struct termios * conf);
 static void set_baudrate(unsigned int baud_rate);
 static void set_lcrh(const struct termios * conf);
 int bcm2835_uart_uputc(struct uart_port * port, uint8_t byte);
 int bcm2835_uart_ugetc(struct uart_port * port);
 int bcm2835_uart_peek(struct uart_port * port);
+static void bcm2835_uart_rx_arm(struct uart_port * port);
 
 static struct uart_port port = {
     .setconf = bcm2835_uart_setconf,
     .uputc = bcm2835_uart_uputc,
     .ugetc = bcm2835_uart_ugetc,
-    .peek = bcm2835_uart_peek
+    .peek = bcm2835_uart_peek,
+    .rx_arm = bcm2835_uart_rx_arm,
+};
+
+static enum irq_ack bcm2835_uart_irq_ack(int irq)
+{
+    istate_t s_entry;
+
+    /*
+     * The RX interrupt is asserted until the FIFO is drained, so it's masked
+     * here and enabled again by the reader with rx_arm().
+     */
+    mmio_start(&s_entry);
+    mmio_write(UART0_IMSC, 0);
+    mmio_write(UART0_ICR, UART0_IMSC_RX | UART0_IMSC_RT);
+    mmio_end(&s_entry);
+
+    return IRQ_WAKE_THREAD;
+}
+
+static void bcm2835_uart_irq_handle(int irq)
+{
+    uart_rx_wakeup(&port);
+}
+
+static struct irq_handler uart_irq_handler = {
+    .name = "UART0",
+    .ack = bcm2835_uart_irq_ack,
+    .handle = bcm2835_uart_irq_handle,
+    .flags = {
+        /* The source is masked in the UART by bcm2835_uart_irq_ack(). */
+        .allow_multiple = 1,
+        .threaded = 1,
+    },
+    .thread_param = {
+        .sched_policy = SCHED_FIFO,
+        .sched_priority = NICE_MIN,
+    },
 };
 
 
@@ -100,6 +146,22 @@ int bcm2835_uart_register(void)
 }
 HW_PREINIT_ENTRY(bcm2835_uart_register);
 
+int __kinit__ bcm2835_uart_irq_init(void)
+{
+    int err;
+
+    SUBSYS_DEP(irq_init);
+    SUBSYS_INIT("BCM2835 UART IRQ");
+
+    err = irq_register(UART0_IRQ, &uart_irq_handler);
+    if (err) {
+        KERROR(KERROR_ERR, "UART: Failed to register the IRQ handler\n");
+        return err;
+    }
+
+    return 0;
+}
+
 static void bcm2835_uart_setconf(struct termios * conf)
 {
     istate_t s_entry;
@@ -264,3 +326,12 @@ int bcm2835_uart_peek(struct uart_port * port)
 
     return retval;
 }
+
+static void bcm2835_uart_rx_arm(struct uart_port * port)
+{
+    istate_t s_entry;
+
+    mmio_start(&s_entry);
+    mmio_write(UART0_IMSC, UART0_IMSC_RX | UART0_IMSC_RT);
+    mmio_end(&s_entry);
+}
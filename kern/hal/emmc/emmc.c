@@ -72,24 +72,83 @@
 #include <sys/types.h>
 #include <fs/mbr.h>
 #include <hal/hw_timers.h>
+#include <hal/irq.h>
 #include <kerror.h>
 #include <kinit.h>
 #include <klocks.h>
 #include <kmalloc.h>
 #include <kstring.h>
 #include <libkern.h>
+#include <thread.h>
 #include <vm/vm.h>
 #ifdef configBCM2835
 #include "../bcm2835/bcm2835_mmio.h"
 #endif
 #include "emmc.h"
 
+#ifdef configEMMC_SDMA_SUPPORT
+/** EMMC controller IRQ, GPU IRQ 62. */
+#define EMMC_IRQ            62
 
-/* TODO DMA support */
-/* SDMA buffer address */
-#if 0
-#define SDMA_BUFFER     0x6000
-#define SDMA_BUFFER_PA  (SDMA_BUFFER + 0xC0000000)
+/**
+ * Convert a kernel address to an SDMA system address.
+ * Kernel addresses are physical and 0xC0000000 is the uncached alias of
+ * the SDRAM on the VC bus.
+ */
+#define SDMA_BUS_ADDR(_p_)  ((uint32_t)(uintptr_t)(_p_) + 0xC0000000)
+
+/**
+ * SDMA buffer boundary, the DMA is paused on every boundary crossing until
+ * the next system address is written.
+ * 7 = 512 kiB is the largest boundary supported.
+ */
+#define SDMA_BOUNDARY_ARG   7
+#define SDMA_BOUNDARY       (4096 << SDMA_BOUNDARY_ARG)
+
+/** Interrupts ending an SDMA wait. */
+#define SDMA_WAIT_IRPTS \
+    (0xffff0000 | SD_DMA_INTERRUPT | SD_TRANSFER_COMPLETE)
+
+/** Thread waiting for an SDMA interrupt or -1. */
+static pthread_t sdma_waiter = -1;
+
+static enum irq_ack emmc_irq_ack(int irq)
+{
+    istate_t s_entry;
+
+    /*
+     * Only stop signalling the ARM, the status is left in the INTERRUPT
+     * register for the waiter.
+     */
+    mmio_start(&s_entry);
+    mmio_write(EMMC_BASE + EMMC_IRPT_EN, 0);
+    mmio_end(&s_entry);
+
+    return IRQ_WAKE_THREAD;
+}
+
+static void emmc_irq_handle(int irq)
+{
+    pthread_t waiter = sdma_waiter;
+
+    if (waiter >= 0)
+        thread_release(waiter);
+}
+
+static struct irq_handler emmc_irq_handler = {
+    .name = "EMMC",
+    .ack = emmc_irq_ack,
+    .handle = emmc_irq_handle,
+    .flags = {
+        /* The source is masked in the controller by emmc_irq_ack(). */
+        .allow_multiple = 1,
+        .threaded = 1,
+    },
+    .thread_param = {
+        .sched_policy = SCHED_FIFO,
+        .sched_priority = NICE_MIN + 1,
+    },
+};
 #endif
 
 static const char driver_name[] = "emmc";
@@ -118,7 +177,12 @@ static const char * err_irpts[] = {
 
 #define DEFAULT_CMD_TIMEOUT 500000
 
+#ifdef configEMMC_SDMA_SUPPORT
+/* The command path sleeps while waiting for an SDMA interrupt. */
+static mtx_t emmc_lock = MTX_INITIALIZER(MTX_TYPE_TICKET, 0);
+#else
 static mtx_t emmc_lock = MTX_INITIALIZER(MTX_TYPE_SPIN, MTX_OPT_DINT);
+#endif
 
 static ssize_t sd_read(struct dev_info * dev, off_t offset, uint8_t * buf,
                        size_t count, int oflags);
@@ -150,7 +214,8 @@ static uint32_t sd_commands[] = {
     SD_CMD_INDEX(16) | SD_RESP_R1,
     SD_CMD_INDEX(17) | SD_RESP_R1 | SD_DATA_READ,
     SD_CMD_INDEX(18) | SD_RESP_R1 | SD_DATA_READ |
-                       SD_CMD_MULTI_BLOCK | SD_CMD_BLKCNT_EN,
+                       SD_CMD_MULTI_BLOCK | SD_CMD_BLKCNT_EN |
+                       SD_CMD_AUTO_CMD_EN_CMD12,
     SD_CMD_INDEX(19) | SD_RESP_R1 | SD_DATA_READ,
     SD_CMD_INDEX(20) | SD_RESP_R1b,
     SD_CMD_RESERVED(21),
@@ -158,7 +223,8 @@ static uint32_t sd_commands[] = {
     SD_CMD_INDEX(23) | SD_RESP_R1,
     SD_CMD_INDEX(24) | SD_RESP_R1 | SD_DATA_WRITE,
     SD_CMD_INDEX(25) | SD_RESP_R1 | SD_DATA_WRITE |
-                       SD_CMD_MULTI_BLOCK | SD_CMD_BLKCNT_EN,
+                       SD_CMD_MULTI_BLOCK | SD_CMD_BLKCNT_EN |
+                       SD_CMD_AUTO_CMD_EN_CMD12,
     SD_CMD_RESERVED(26),
     SD_CMD_INDEX(27) | SD_RESP_R1 | SD_DATA_WRITE,
     SD_CMD_INDEX(28) | SD_RESP_R1b,
@@ -319,6 +385,7 @@ static uint32_t sd_acommands[] = {
 #define SD_GET_CLOCK_DIVIDER_FAIL    0xffffffff
 
 static int emmc_card_init(struct emmc_block_dev ** edev);
+static int emmc_probe(void);
 
 int __kinit__ emmc_init(void)
 {
@@ -327,6 +394,17 @@ int __kinit__ emmc_init(void)
 #endif
     SUBSYS_INIT("emmc");
 
+    /*
+     * Card init takes a long time and only mounting depends on it.
+     */
+    return kinit_async(emmc_init, emmc_probe);
+}
+
+/**
+ * Init the card and register it with devfs.
+ */
+static int emmc_probe(void)
+{
     vnode_t * vnode;
 #ifdef configMBR
     int fd;
@@ -338,6 +416,14 @@ int __kinit__ emmc_init(void)
     if (err)
         return err;
 
+#ifdef configEMMC_SDMA_SUPPORT
+    err = irq_register(EMMC_IRQ, &emmc_irq_handler);
+    if (err) {
+        KERROR(KERROR_ERR, "EMMC: Failed to register the IRQ handler\n");
+        return err;
+    }
+#endif
+
     /* TODO Block cache not implemented */
 #ifdef ENABLE_BLOCK_CACHE
     struct dev_info * c_dev = sd_edev->dev;
@@ -584,11 +670,75 @@ static int sd_reset_dat()
     return 0;
 }
 
+#ifdef configEMMC_SDMA_SUPPORT
+/**
+ * Wait for an SDMA boundary, transfer complete or error interrupt.
+ * The caller sleeps until the interrupt, before the scheduler is running
+ * the INTERRUPT register is polled instead.
+ * @returns the value of the INTERRUPT register; 0 if timed out.
+ */
+static uint32_t sd_sdma_wait(useconds_t timeout)
+{
+    const uint64_t start = get_utime();
+    istate_t s_entry;
+    istate_t s;
+    int timer_id;
+    uint32_t irpts;
+
+    if (!current_thread) {
+        do {
+            mmio_start(&s_entry);
+            irpts = mmio_read(EMMC_BASE + EMMC_INTERRUPT);
+            mmio_end(&s_entry);
+            if (irpts & SDMA_WAIT_IRPTS)
+                return irpts;
+        } while (get_utime() - start < timeout);
+
+        return 0;
+    }
+
+    timer_id = thread_alarm(timeout / 1000 + 1);
+
+    s = get_interrupt_state();
+    disable_interrupt();
+    mmio_start(&s_entry);
+    irpts = mmio_read(EMMC_BASE + EMMC_INTERRUPT);
+    while (!(irpts & SDMA_WAIT_IRPTS) && get_utime() - start < timeout) {
+        sdma_waiter = current_thread->id;
+        mmio_write(EMMC_BASE + EMMC_IRPT_EN, SDMA_WAIT_IRPTS);
+        mmio_end(&s_entry);
+
+        /*
+         * Interrupts are kept disabled until thread_wait() has blocked
+         * the thread, so the wakeup can't be lost. A wakeup may also come
+         * from a previous IRQ thread run, so the status is checked again.
+         */
+        thread_wait();
+
+        disable_interrupt();
+        sdma_waiter = -1;
+        mmio_start(&s_entry);
+        mmio_write(EMMC_BASE + EMMC_IRPT_EN, 0);
+        irpts = mmio_read(EMMC_BASE + EMMC_INTERRUPT);
+    }
+    mmio_end(&s_entry);
+    set_interrupt_state(s);
+
+    if (timer_id >= 0)
+        thread_alarm_rele(timer_id);
+
+    return (irpts & SDMA_WAIT_IRPTS) ? irpts : 0;
+}
+#endif
+
 static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg,
                                  uint32_t argument, useconds_t timeout)
 {
     int is_sdma = 0;
     uint32_t blksizecnt, irpts;
+#ifdef configEMMC_SDMA_SUPPORT
+    uint32_t sdma_addr = 0;
+#endif
     istate_t s_entry;
 
     dev->last_cmd_reg = cmd_reg;
@@ -635,22 +785,28 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg,
         is_sdma = 1;
     }
 
+#ifdef configEMMC_SDMA_SUPPORT
     if (is_sdma) {
-        /* Set system address register (ARGUMENT2 in RPi) */
-
         /*
-         * We need to define a 4 kiB aligned buffer to use here
-         * Then convert its virtual address to a bus address
+         * Write back any dirty lines of the buffer before the controller
+         * accesses the memory. On read the lines fetched during the transfer
+         * are invalidated once it's complete.
          */
-        /* TODO set dma buffer */
-        panic("no dma support");
-        /*mmio_write(EMMC_BASE + EMMC_ARG2, SDMA_BUFFER_PA); */
+        cpu_clean_dcache_range((uintptr_t)dev->buf,
+                               dev->blocks_to_transfer * dev->block_size);
+
+        /* Set system address register (ARGUMENT2 in RPi) */
+        sdma_addr = SDMA_BUS_ADDR(dev->buf);
+        mmio_start(&s_entry);
+        mmio_write(EMMC_BASE + EMMC_ARG2, sdma_addr);
+        mmio_end(&s_entry);
     }
+#endif
 
     /*
      * Set block size and block count
-     * For now, block size = 512 bytes, block count = 1,
-     * host SDMA buffer boundary = 4 kiB
+     * For now, block size = 512 bytes,
+     * host SDMA buffer boundary = SDMA_BOUNDARY
      */
     if (dev->blocks_to_transfer > 0xffff) {
         KERROR(KERROR_ERR, "SD: blocks_to_transfer too great (%i)\n",
@@ -660,6 +816,9 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg,
         return;
     }
     blksizecnt = dev->block_size | (dev->blocks_to_transfer << 16);
+#ifdef configEMMC_SDMA_SUPPORT
+    blksizecnt |= SDMA_BOUNDARY_ARG << 12;
+#endif
     mmio_start(&s_entry);
     mmio_write(EMMC_BASE + EMMC_BLKSIZECNT, blksizecnt);
 
@@ -813,6 +972,7 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg,
             mmio_write(EMMC_BASE + EMMC_INTERRUPT, 0xffff0002);
             mmio_end(&s_entry);
         }
+#ifdef configEMMC_SDMA_SUPPORT
     } else if (is_sdma) {
         /*
          * For SDMA transfers, we have to wait for either transfer complete,
@@ -825,9 +985,23 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg,
             mmio_write(EMMC_BASE + EMMC_INTERRUPT, 0xffff000a);
             mmio_end(&s_entry);
         } else {
-            TIMEOUT_WAIT(mmio_read(EMMC_BASE + EMMC_INTERRUPT) & 0x800a,
-                         timeout);
-            irpts = mmio_read(EMMC_BASE + EMMC_INTERRUPT);
+            mmio_end(&s_entry);
+
+            while ((irpts = sd_sdma_wait(timeout)) &&
+                   (irpts & 0xffff000a) == SD_DMA_INTERRUPT) {
+                /*
+                 * The DMA was paused on a buffer boundary, continue from
+                 * the next boundary.
+                 */
+                sdma_addr = (sdma_addr & ~(SDMA_BOUNDARY - 1)) +
+                            SDMA_BOUNDARY;
+                mmio_start(&s_entry);
+                mmio_write(EMMC_BASE + EMMC_INTERRUPT, SD_DMA_INTERRUPT);
+                mmio_write(EMMC_BASE + EMMC_ARG2, sdma_addr);
+                mmio_end(&s_entry);
+            }
+
+            mmio_start(&s_entry);
             mmio_write(EMMC_BASE + EMMC_INTERRUPT, 0xffff000a);
             mmio_end(&s_entry);
 
@@ -842,31 +1016,11 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg,
                 return;
             }
 
-            /*
-             * Detect DMA interrupt without transfer complete
-             * Currently not supported - all block sizes should fit in the
-             *  buffer
-             */
-            if ((irpts & 0x8) && ((irpts & 0x2) != 0x2)) {
-#ifdef configEMMC_DEBUG
-                KERROR(KERROR_ERR,
-                       "SD: error: DMA interrupt occured without transfer complete\n");
-#endif
-                dev->last_error = irpts & 0xffff0000;
-                dev->last_interrupt = irpts;
-                return;
-            }
-
             /* Detect transfer complete */
             if (irpts & 0x2) {
 #ifdef configEMMC_DEBUG
-                KERROR(KERROR_DEBUG, "SD: SDMA transfer complete");
+                KERROR(KERROR_DEBUG, "SD: SDMA transfer complete\n");
 #endif
-                panic("NO DMA support");
-                /* TODO */
-                /* Transfer the data to the user buffer */
-                /*memcpy(dev->buf, (const void *)SDMA_BUFFER,
-                  dev->block_size); */
             } else {
                 /* Unknown error */
 #ifdef configEMMC_DEBUG
@@ -904,6 +1058,13 @@ static void sd_issue_command_int(struct emmc_block_dev *dev, uint32_t cmd_reg,
                 return;
             }
         }
+
+        /* Drop the lines fetched while the controller was writing. */
+        if (cmd_reg & SD_CMD_DAT_DIR_CH) {
+            cpu_invalidate_dcache_range((uintptr_t)dev->buf,
+                    dev->blocks_to_transfer * dev->block_size);
+        }
+#endif
     }
 
     /* Return success */
@@ -1314,7 +1475,7 @@ static int emmc_card_init(struct emmc_block_dev ** edev)
 #endif
     ret->dev.lseek = sd_lseek;
     ret->dev.ioctl = sd_ioctl;
-    ret->dev.flags = DEV_FLAGS_MB_READ | DEV_FLAGS_MB_WRITE;
+    ret->dev.flags = DEV_FLAGS_MB_READ | DEV_FLAGS_MB_WRITE | DEV_FLAGS_BIOQ;
     ret->base_clock = base_clock;
 
 #ifdef configEMMC_DEBUG
@@ -1904,10 +2065,13 @@ static int sd_ensure_data_mode(struct emmc_block_dev *edev)
 }
 
 #ifdef configEMMC_SDMA_SUPPORT
-/* We only support DMA transfers to buffers aligned on a 4 kiB boundary */
+/*
+ * The buffer must be aligned to the cache line size so that invalidating
+ * it after a read doesn't discard anything else.
+ */
 static inline int sd_suitable_for_dma(void *buf)
 {
-    return ((uintptr_t)buf & 0xfff) ? 0 : 1;
+    return ((uintptr_t)buf & (ARM11_DCACHE_LINE - 1)) ? 0 : 1;
 }
 #endif
 
@@ -35,14 +35,25 @@
 #include <bitmap.h>
 #include <fs/procfs.h>
 #include <fs/procfs_dbgfile.h>
+#include <hal/core.h>
+#include <hal/hw_timers.h>
 #include <hal/irq.h>
+#include <kerror.h>
 #include <kinit.h>
+#include <kstring.h>
+#include <libkern.h>
 #include <thread.h>
 
+/**
+ * IRQs waiting for the shared IRQ thread.
+ */
 static bitmap_t irq_pending[E2BITMAP_SIZE(NR_IRQ)];
 static pthread_t irq_handler_tid;
 struct irq_handler * irq_handlers[NR_IRQ];
 
+static void * irq_shared_thread(void * arg);
+static void * irq_dedicated_thread(void * arg);
+
 int irq_register(int irq, struct irq_handler * handler)
 {
     if (irq < 0 || irq >= NR_IRQ)
@@ -51,6 +62,22 @@ int irq_register(int irq, struct irq_handler * handler)
     if (irq_handlers[irq])
         return -EBUSY;
 
+    handler->irq = irq;
+    handler->pending = 0;
+    handler->stop = 0;
+    handler->tid = -1;
+    if (handler->flags.threaded) {
+        char name[40];
+        pthread_t tid;
+
+        ksprintf(name, sizeof(name), "irq%d", irq);
+        tid = kthread_create(name, &handler->thread_param, 0,
+                             irq_dedicated_thread, handler);
+        if (tid < 0)
+            return tid;
+        handler->tid = tid;
+    }
+
     irq_handlers[irq] = handler;
     irq_enable(irq);
 
@@ -59,46 +86,170 @@ int irq_register(int irq, struct irq_handler * handler)
 
 int irq_deregister(int irq)
 {
+    struct irq_handler * handler;
+    istate_t s;
+
     if (irq < 0 || irq >= NR_IRQ)
         return -EINVAL;
 
-    irq_handlers[irq] = NULL;
     irq_disable(irq);
+    s = get_interrupt_state();
+    disable_interrupt();
+    handler = irq_handlers[irq];
+    irq_handlers[irq] = NULL;
+    set_interrupt_state(s);
+
+    if (handler && handler->flags.threaded && handler->tid >= 0) {
+        /* Stop the dedicated thread and wait until it has exited. */
+        handler->stop = 1;
+        thread_release(handler->tid);
+        while (handler->tid >= 0) {
+            thread_sleep(1);
+        }
+    }
 
     return 0;
 }
 
 void irq_thread_wakeup(int irq)
 {
-    bitmap_set(irq_pending, irq, sizeof(irq_pending));
-    thread_release(irq_handler_tid);
+    struct irq_handler * handler = irq_handlers[irq];
+
+    handler->t_wakeup = get_utime();
+
+    if (handler->flags.threaded) {
+        handler->pending = 1;
+        thread_release(handler->tid);
+    } else {
+        bitmap_set(irq_pending, irq, sizeof(irq_pending));
+        thread_release(irq_handler_tid);
+    }
 }
 
-static void * irq_handler_thread(void * arg)
+static void irq_lat_account(struct irq_handler * handler)
+{
+    uint64_t lat = get_utime() - handler->t_wakeup;
+    size_t i = 0;
+
+    while (lat >= 10 && i < IRQ_LAT_BUCKETS - 1) {
+        lat /= 10;
+        i++;
+    }
+    handler->lat_hist[i]++;
+}
+
+static void irq_run_threaded(int irq, struct irq_handler * handler)
+{
+    handler->handle(irq);
+    irq_lat_account(handler);
+
+    if (!handler->flags.allow_multiple) {
+        irq_enable(irq);
+    }
+}
+
+/**
+ * Take and clear the next word of pending IRQs.
+ */
+static bitmap_t irq_take_pending(size_t i)
+{
+    bitmap_t word;
+    istate_t s;
+
+    s = get_interrupt_state();
+    disable_interrupt();
+    word = irq_pending[i];
+    irq_pending[i] = 0;
+    set_interrupt_state(s);
+
+    return word;
+}
+
+/**
+ * Test if any IRQ is waiting for the shared thread.
+ * Must be called with interrupts disabled.
+ */
+static int irq_any_pending(void)
+{
+    for (size_t i = 0; i < num_elem(irq_pending); i++) {
+        if (irq_pending[i])
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Shared IRQ handler thread.
+ * Handles IRQs that don't have a dedicated thread.
+ */
+static void * irq_shared_thread(void * arg)
 {
     while (1) {
-        thread_wait(); /* Wait until the HW specific handler calls
-                        * irq_threaded_wakeup().
-                        */
-
-        for (int irq = 0; irq < NR_IRQ; irq++) {
-            /* NOTE: Ignoring errors */
-            if (bitmap_status(irq_pending, irq, sizeof(irq_pending))) {
-                struct irq_handler * handler = irq_handlers[irq];
-                handler->handle(irq);
-                bitmap_clear(irq_pending, irq, sizeof(irq_pending));
-
-                if (!handler->flags.allow_multiple) {
-                    irq_enable(irq);
+        /*
+         * Interrupts are disabled until thread_wait() so a wakeup from
+         * irq_thread_wakeup() can't be lost between the check and the wait.
+         */
+        disable_interrupt();
+        if (!irq_any_pending()) {
+            thread_wait(); /* Wait until the HW specific handler calls
+                            * irq_thread_wakeup().
+                            */
+            continue;
+        }
+        enable_interrupt();
+
+        for (size_t i = 0; i < num_elem(irq_pending); i++) {
+            bitmap_t word;
+
+            while ((word = irq_take_pending(i))) {
+                int bit;
+
+                while ((bit = ffs(word))) {
+                    const int irq = i * 8 * sizeof(bitmap_t) + bit - 1;
+                    struct irq_handler * handler = irq_handlers[irq];
+
+                    word &= ~(1u << (bit - 1));
+                    /* NOTE: Ignoring errors */
+                    if (handler)
+                        irq_run_threaded(irq, handler);
                 }
             }
         }
     }
 }
 
+/**
+ * Dedicated IRQ handler thread.
+ * @param arg is the handler of the IRQ.
+ */
+static void * irq_dedicated_thread(void * arg)
+{
+    struct irq_handler * handler = (struct irq_handler *)arg;
+
+    while (1) {
+        disable_interrupt();
+        if (handler->stop)
+            break;
+        if (!handler->pending) {
+            /* Interrupts are enabled again by thread_wait(). */
+            thread_wait();
+            continue;
+        }
+        handler->pending = 0;
+        enable_interrupt();
+
+        irq_run_threaded(handler->irq, handler);
+    }
+    handler->tid = -1;
+    enable_interrupt();
+
+    return NULL;
+}
+
 static int read_irq_file(void * buf, size_t max, void * elem)
 {
     struct irq_handler * handler = *((struct irq_handler **)elem);
+    const unsigned * lat;
     int irq;
 
     if (!handler)
@@ -106,8 +257,11 @@ static int read_irq_file(void * buf, size_t max, void * elem)
 
     irq = (int)(((uintptr_t)elem - (uintptr_t)irq_handlers) /
                 (uintptr_t)sizeof(struct irq_handler *));
+    lat = handler->lat_hist;
 
-    return ksprintf(buf, max, "%d: %u %s\n", irq, handler->cnt, handler->name);
+    return ksprintf(buf, max, "%d: %u %u %u %u %u %u %s\n",
+                    irq, handler->cnt, lat[0], lat[1], lat[2], lat[3], lat[4],
+                    handler->name);
 }
 
 static ssize_t write_irq_file(const void * buf, size_t bufsize)
@@ -130,7 +284,7 @@ int __kinit__ irq_init(void)
         .sched_priority = NICE_MIN,
     };
     irq_handler_tid = kthread_create("irq", &param, 0,
-                                     irq_handler_thread, NULL);
+                                     irq_shared_thread, NULL);
     if (irq_handler_tid < 0) {
         KERROR(KERROR_ERR, "Failed to create a thread for IRQ handling");
         return irq_handler_tid;
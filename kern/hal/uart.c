@@ -118,6 +118,7 @@ int uart_register_port(struct uart_port * port)
     if (i >= UART_PORTS_MAX)
         return -1;
 
+    port->rx_waiter = -1;
     uart_ports[i] = port;
     uart_nr_ports++;
     if (vfs_ready)
@@ -141,6 +142,48 @@ struct uart_port * uart_getport(int port_num)
     return retval;
 }
 
+void uart_rx_wakeup(struct uart_port * port)
+{
+    pthread_t waiter = port->rx_waiter;
+
+    if (waiter >= 0)
+        thread_release(waiter);
+}
+
+/**
+ * Block until there is data available from a port.
+ * Only one reader at a time waits for the RX interrupt, others and ports
+ * without an RX interrupt poll.
+ */
+static void uart_wait_rx(struct uart_port * port)
+{
+    istate_t s;
+
+    if (port->rx_arm) {
+        s = get_interrupt_state();
+        disable_interrupt();
+        while (!port->peek(port) &&
+               (port->rx_waiter < 0 || port->rx_waiter == current_thread->id)) {
+            port->rx_waiter = current_thread->id;
+            port->rx_arm(port);
+
+            /*
+             * Interrupts are kept disabled until thread_wait() has blocked
+             * the thread, so the wakeup can't be lost.
+             */
+            thread_wait();
+            disable_interrupt();
+        }
+        if (port->rx_waiter == current_thread->id)
+            port->rx_waiter = -1;
+        set_interrupt_state(s);
+    }
+
+    while (!port->peek(port)) {
+        thread_sleep(50);
+    }
+}
+
 static ssize_t uart_read(struct tty * tty, off_t blkno,
                          uint8_t * buf, size_t bcount, int oflags)
 {
@@ -150,12 +193,8 @@ static ssize_t uart_read(struct tty * tty, off_t blkno,
     if (!port)
         return -ENODEV;
 
-    if ((oflags & O_NONBLOCK) != O_NONBLOCK) {
-        /* TODO Block until new data event */
-        while (!port->peek(port)) {
-            thread_sleep(50);
-        }
-    }
+    if ((oflags & O_NONBLOCK) != O_NONBLOCK)
+        uart_wait_rx(port);
 
     while (n < bcount) {
         int ret = port->ugetc(port);
@@ -0,0 +1,105 @@
+/**
+ *******************************************************************************
+ * @file    bioq.h
+ * @author  Olli Vanhoja
+ * @brief   Block I/O request queue.
+ * @section LICENSE
+ * Copyright (c) 2026 Olli Vanhoja <olli.vanhoja@alumni.helsinki.fi>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+
+/**
+ * @addtogroup bioq
+ * Block I/O request queue.
+ * A block device created with DEV_FLAGS_BIOQ set gets a request queue and
+ * a worker thread driving the device driver. Buffers are queued by bio and
+ * reads and writes of the device file, and completed with biodone().
+ * Partitions share the queue of their parent device. Adjacent requests are merged into a single
+ * multi-block transfer and the requests are served in the ascending order
+ * of block numbers (C-LOOK) unless the oldest request has waited longer
+ * than the deadline.
+ * The tunables and the statistics of all queues are in vfs.bioq.
+ * @{
+ */
+
+#pragma once
+#ifndef BIOQ_H
+#define BIOQ_H
+
+#include <stdint.h>
+#include <sys/queue.h>
+#include <sys/types.h>
+#include <buf.h>
+#include <klocks.h>
+
+struct dev_info;
+
+/**
+ * Block I/O request queue of a device.
+ */
+struct bioq {
+    mtx_t lock;
+    TAILQ_HEAD(bioq_head, buf) head; /*!< Requests sorted by b_qblkno. */
+    struct dev_info * dev;
+    size_t pos;         /*!< Block following the last dispatched request. */
+    unsigned depth;     /*!< Number of queued requests. */
+    int plugged;        /*!< Dispatching is held while nonzero. */
+    pthread_t worker;
+};
+
+/**
+ * Create a request queue for a block device.
+ * @param dev is the device, it must support multiple block reads and writes.
+ * @return Returns 0 if succeed; Otherwise a negative errno is returned.
+ */
+int bioq_create(struct dev_info * dev);
+
+/**
+ * Queue a buffer for I/O.
+ * The direction is given by B_READ in b_flags and the I/O is completed by
+ * calling biodone(). bp->b_qblkno is the block number on q->dev and
+ * bp->b_bcount the number of bytes to transfer.
+ * @param q     is the request queue of the device.
+ * @param bp    is the buffer.
+ */
+void bioq_enqueue(struct bioq * q, struct buf * bp);
+
+/**
+ * Hold dispatching of new requests.
+ * Allows queuing a batch of requests to be merged and sorted before the
+ * worker starts on them.
+ */
+void bioq_plug(struct bioq * q);
+
+/**
+ * Release a bioq_plug().
+ */
+void bioq_unplug(struct bioq * q);
+
+#endif /* BIOQ_H */
+
+/**
+ * @}
+ */
@@ -36,6 +36,7 @@
 #define BUF_H
 
 #include <sys/queue.h>
+#include <bitmap.h>
 #include <fs/fs.h>
 #include <hal/mmu.h>
 #include <kobj.h>
@@ -65,10 +66,18 @@ struct buf {
                              *   for bounds check. */
     size_t b_blkno;         /*!< Block # on device. */
     size_t b_lblkno;        /*!< Logical block number. */
+    size_t b_dblkno;        /*!< Block # on b_devfile. Set by the fs if the
+                             *   file blocks are not the device blocks. */
+    size_t b_qblkno;        /*!< Block # on the device of a bioq request. */
 
     /* MMU mappings.             Usually used for user space mapping. */
     mmu_region_t b_mmu;     /*!< MMU struct for user space or special access. */
     int b_uflags;           /*!< Actual user space permissions and flags. */
+    uintptr_t * b_pages;    /*!< Kernel addresses of the pages of an
+                             *   on-demand region, 0 if a page is not
+                             *   populated; NULL for a regular buffer. */
+    size_t b_rss;           /*!< Number of populated pages if b_pages is
+                             *   set. */
 
     /* IO Buffer */
     file_t b_file;          /*!< File descriptor for the buffered vnode. */
@@ -93,6 +102,9 @@ struct buf {
     SPLAY_ENTRY(buf) sentry_;
     LIST_ENTRY(buf) shmem_entry_; /*!< shmem sync list entry. */
     TAILQ_ENTRY(buf) relse_entry_; /*!< bio relse list entry. */
+    TAILQ_ENTRY(buf) ioq_entry_; /*!< bioq request queue entry. */
+    uint64_t b_qtime;       /*!< Time the buffer was queued to a bioq. */
+    struct thread_info * b_waiter; /*!< Thread sleeping in biowait(). */
 
     struct kobj b_obj;
     mtx_t lock;
@@ -138,14 +150,28 @@ typedef struct vm_ops {
      * just call `this->rclone()`.
      */
     int (*rmmap)(struct buf * this, struct vm_pt * pt);
+
+    /**
+     * Populate a page of an on-demand region.
+     * Called by `proc_abo_handler()` on a translation fault and by the vm
+     * before the kernel accesses the region through a user address.
+     * @note Can be null if `rmmap()` maps the whole region.
+     * @param vaddr is a user space address within the page.
+     * @param pt    is the page table the page is mapped to; NULL if the page
+     *              shall be only populated.
+     * @return Returns 0 if succeed; Otherwise a negative errno is returned.
+     */
+    int (*rpopulate)(struct buf * this, struct vm_pt * pt, uintptr_t vaddr);
 } vm_ops_t;
 
 /* generic */
+#define B_READ      0x0000001  /*!< Read transaction, write if not set. */
 #define B_DONE      0x0000002  /*!< Transaction finished. */
 #define B_ERROR     0x0000004  /*!< Transaction aborted. */
 #define B_BUSY      0x0000008  /*!< Buffer busy. */
 #define B_LOCKED    0x0000010  /*!< Locked in memory. */
 #define B_DIRTY     0x0000020
+#define B_CACHE     0x0000040  /*!< Buffer contents are valid. */
 #define B_NOCOPY    0x0000100  /*!< Don't copy-on-write this buf. */
 #define B_NOSYNC    0x0001000  /*!< Never synch to the fs. */
 #define B_ASYNC     0x0002000  /*!< Start I/O but don't wait for completion. */
@@ -240,6 +266,28 @@ struct buf * getblk(vnode_t * vnode, size_t blkno, size_t size, int slptimeo)
 struct buf * geteblk(size_t size)
     __attribute__ ((warn_unused_result));
 
+/**
+ * Allocate an empty, disassociated block that is populated on-demand.
+ * No physical memory is reserved up front, a zeroed page is allocated and
+ * mapped to the user space only on the first touch, see vm_ops::rpopulate.
+ * The block is not contiguous in the kernel space and b_data is not set,
+ * use vr_pageaddr() to access the pages.
+ * Meant for anonymous user space memory.
+ * @param[in] size is the size of the new buffer.
+ * @return  Returns the new buffer.
+ */
+struct buf * geteblk_lazy(size_t size)
+    __attribute__ ((warn_unused_result));
+
+/**
+ * Get the kernel address of a page of a vrallocated block.
+ * @param bp is the block.
+ * @param i is the page index.
+ * @return Returns the kernel address of the page;
+ *         0 if the page of an on-demand block is not populated.
+ */
+uintptr_t vr_pageaddr(struct buf * bp, size_t i);
+
 /**
  * Get a special block that has a mapping in ksect area as well as regular
  * mapping in kernel space.
@@ -259,6 +307,21 @@ struct buf * geteblk_special(size_t size, uint32_t control)
  */
 struct buf * incore(vnode_t * vnode, size_t blkno);
 
+/**
+ * Invalidate the buffers of a vnode.
+ * Delayed writes are written out and the released buffers are freed, buffers
+ * currently in use only lose B_CACHE.
+ * @param[in]   vnode   is a vnode pointer.
+ */
+void bio_vinval(vnode_t * vnode);
+
+/**
+ * Write out the delayed writes of a vnode.
+ * The buffers currently in use are skipped.
+ * @param[in]   vnode   is a vnode pointer.
+ */
+void bio_vflush(vnode_t * vnode);
+
 /**
  * Readin file backed buffer.
  * @param bp is the buffer.
@@ -41,6 +41,9 @@
 
 #include <fs/fs.h>
 
+/**
+ * Initial number of hash buckets.
+ */
 #define DEHTABLE_SIZE 16
 
 /**
@@ -49,18 +52,35 @@
 typedef struct dh_dirent {
     ino_t dh_ino; /*!< File serial number. */
     uint8_t dh_type; /*!< Dirent type. */
-    size_t dh_size; /*!< Size of this directory entry. */
-    uint8_t dh_link; /*!< Internal link tag. If 0 chain ends here; otherwise
-                      * chain linking continues. */
+    uint32_t dh_hash; /*!< Hash of dh_name. */
+    size_t dh_slot; /*!< Index of this entry in the entry array. */
+    struct dh_dirent * dh_next; /*!< Next entry in the hash chain. */
     char dh_name[1]; /*!< Name of the entry. */
 } dh_dirent_t;
 
 /**
- * Directory entry hash table array type.
+ * Directory entry hash table.
+ * The table is grown incrementally, when a resize is in progress the buckets
+ * are moved from old_htable to htable a few at a time on every update.
  */
 typedef struct dh_table {
     uint32_t k[2];
-    struct dh_dirent * htable[DEHTABLE_SIZE];
+    struct dh_dirent ** htable; /*!< Hash buckets. */
+    size_t htable_size; /*!< Number of buckets in htable, a power of 2. */
+    struct dh_dirent ** old_htable; /*!< Buckets being moved to htable. */
+    size_t old_htable_size;
+    size_t rehash_ind; /*!< Index of the next bucket to move. */
+    /**
+     * Entries by slot.
+     * Entries never move between slots, so a slot index is a stable iterator
+     * position regardless of resizing.
+     */
+    struct dh_dirent ** ents;
+    size_t ents_size; /*!< Size of ents and free_slots. */
+    size_t ents_end; /*!< Index after the highest slot ever used. */
+    size_t * free_slots; /*!< Stack of free slots below ents_end. */
+    size_t nr_free;
+    size_t nr_entries;
 } dh_table_t;
 
 /**
@@ -68,8 +88,7 @@ typedef struct dh_table {
  */
 typedef struct dh_dir_iter {
     dh_table_t * dir;
-    size_t dea_ind;
-    size_t ch_ind;
+    size_t slot; /*!< Next slot to be examined. */
 } dh_dir_iter_t;
 
 /**
@@ -133,6 +152,7 @@ dh_dir_iter_t dh_get_iter(dh_table_t * dir);
 
 /**
  * Get the next directory entry from iterator it.
+ * The iterator position remains valid when entries are added or removed.
  * @param it is a dirent hash table iterator.
  * @return Next directory entry in hash table.
  */
@@ -50,9 +50,18 @@
 
 #define DEVFS_FSNAME            "devfs" /*!< Name of the devfs in vfs. */
 
+/**
+ * Max tries in case of block read/write returns an error.
+ */
+#define DEV_RW_MAX_TRIES        3
+
 #define DEV_FLAGS_MB_READ       0x01 /*!< Supports multiple block read. */
 #define DEV_FLAGS_MB_WRITE      0x02 /*!< Supports multiple block write. */
 #define DEV_FLAGS_WR_BT_MASK    0x04 /*!< 0 = Write-back; 1 = Write-through */
+#define DEV_FLAGS_BIOQ          0x08 /*!< Create a bioq request queue for bio.
+                                      *   Requires MB_READ and MB_WRITE. */
+
+struct bioq;
 
 struct dev_info {
     dev_t dev_id;           /*!< Device id (major, minor). */
@@ -65,6 +74,9 @@ struct dev_info {
     ssize_t num_blocks;
 
     void * opt_data; /*!< Optional device data internal to the driver. */
+    struct bioq * bioq; /*!< Request queue if DEV_FLAGS_BIOQ is set or
+                         *   the queue of the parent device. */
+    size_t bioq_blkoff; /*!< First block of the device on the queue. */
 
     ssize_t (*read)(struct dev_info * devnfo, off_t blkno,
                     uint8_t * buf, size_t bcount, int oflags);
@@ -145,6 +157,15 @@ const char * devtoname(struct vnode * dev);
  */
 int devfs_lookup(vnode_t ** result, char * str);
 
+/**
+ * Get the request queue of a device.
+ * @param vnode is a vnode.
+ * @param[out] blkoff returns the block offset of the device on the queue.
+ * @return  Returns the bioq of the device;
+ *          NULL if the vnode isn't a device or it has no queue.
+ */
+struct bioq * dev_getq(vnode_t * vnode, size_t * blkoff);
+
 /**
  * Read from a device.
  * @param file      is a pointer to the device file.
@@ -51,8 +51,10 @@
 #include <sys/stat.h>
 #include <sys/tree.h>
 #include <sys/types.h>
+#include <bitmap.h>
 #include <klocks.h>
 #include <kobj.h>
+#include <rcu.h>
 #include <uio.h>
 
 #define FS_FLAG_INIT    0x01 /*!< File system initialized. */
@@ -178,27 +180,41 @@ typedef struct file {
     vnode_t * vnode;
     void * stream;      /*!< Pointer to a special file stream data or info. */
     struct kobj f_obj;
+    struct rcu_cb f_rcu; /*!< Used to defer freeing of a O_KFREEABLE file. */
 } file_t;
 
 /**
- * Open file descriptors.
+ * File descriptor table.
+ * The table is read under rcu_read_lock() and modified under the lock of
+ * the files struct owning it. A table is replaced by a larger one when
+ * it's full and the old one is freed after an RCU grace period.
+ */
+struct fdtable {
+    int size;               /*!< Number of descriptor slots. */
+    bitmap_t * open_map;    /*!< Allocated descriptors. */
+    struct rcu_cb rcu;
+    struct file * fd[0];    /*!< Open files.
+                             *   Thre should be at least following files:
+                             *   [0] = stdin
+                             *   [1] = stdout
+                             *   [2] = stderr
+                             */
+};
+
+/**
+ * Initial number of descriptor slots in a files struct.
  */
-typedef struct files_struct {
-    int count;
-    mode_t umask;        /*!< File mode creation mask of the process. */
-    struct file * fd[0]; /*!< Open files.
-                          *   Thre should be at least following files:
-                          *   [0] = stdin
-                          *   [1] = stdout
-                          *   [2] = stderr
-                          */
-} files_t;
+#define FS_FDTABLE_INIT 16
 
 /**
- * Size of files struct in bytes.
- * @param n is a file count.
+ * Open file descriptors.
  */
-#define SIZEOF_FILES(n) (sizeof(files_t) + (n) * sizeof(file_t *))
+typedef struct files_struct {
+    int count;              /*!< Max number of open files. */
+    mode_t umask;           /*!< File mode creation mask of the process. */
+    mtx_t lock;             /*!< Lock for modifying the table. */
+    struct fdtable * fdt;   /*!< Descriptor table. */
+} files_t;
 
 /*
  * Macros for fs giant locks.
@@ -375,6 +391,14 @@ typedef struct vnode_ops {
      * @param file  is the file that was closed by p.
      */
     void (*event_fd_closed)(struct proc_info * p, file_t * file);
+    /**
+     * File destroyed callback.
+     * This function is called when the last reference to a file is dropped,
+     * after all the descriptors sharing it have been closed. Allows freeing
+     * data attached to the file, like file->stream.
+     * @param file  is the file being destroyed.
+     */
+    void (*event_file_destroyed)(file_t * file);
     /* Directory file operations
      * ------------------------- */
     /**
@@ -473,6 +497,18 @@ typedef struct vnode_ops {
      *          -ESPIPE if end of dir.
      */
     int (*readdir)(vnode_t * dir, struct dirent * d, off_t * off);
+    /**
+     * Read as many directory entries as fit in buf.
+     * The entries are packed as variable length records with
+     * fs_dirent_put() and the position is kept in file->seek_pos.
+     * @param file      is a directory open in the file system.
+     * @param buf       is a kernel buffer.
+     * @param bytes     is the size of buf.
+     * @return  Returns the number of bytes written to buf, 0 at the end of
+     *          dir; -EINVAL if buf can't hold the next entry;
+     *          Otherwise a negative errno code is returned.
+     */
+    ssize_t (*getdents)(file_t * file, void * buf, size_t bytes);
     /* Operations specified for any file type
      * -------------------------------------- */
     /**
@@ -644,12 +680,24 @@ int fs_fildes_create_curproc(vnode_t * vnode, int oflags);
 
 /**
  * Get next free file descriptor for the current process.
+ * The lowest free descriptor number greater than or equal to start is
+ * allocated.
  * @param new_file  is the file to be stored in the next free position from
  *                  start.
  * @param start     is the start offset.
  */
 int fs_fildes_curproc_next(file_t * new_file, int start);
 
+/**
+ * Store a file in a file descriptor slot.
+ * The reference of the file is passed to the files struct.
+ * @param files     is the files struct.
+ * @param fd        is a free file descriptor number.
+ * @param file      is the file.
+ * @return Returns 0 if succeed; Otherwise a negative errno is returned.
+ */
+int fs_fildes_install(files_t * files, int fd, file_t * file);
+
 /**
  * Increment or decrement a file descriptor reference count and free the
  * descriptor if there is no more refereces to it.
@@ -685,6 +733,11 @@ void fs_fildes_close_exec(struct proc_info * p);
  */
 int fs_fildes_isatty(int fd);
 
+/**
+ * Get the number of open file descriptors.
+ */
+int fs_fildes_nr_open(files_t * files);
+
 /**
  * Allocate a files_t struct for storing file descriptors.
  * @param nrfiles is the maximum number of files open.
@@ -692,6 +745,20 @@ int fs_fildes_isatty(int fd);
  */
 files_t * fs_alloc_files(size_t nr_files, mode_t umask);
 
+/**
+ * Copy and ref all file descriptors from a files struct to another.
+ * @param dst is an empty files struct.
+ * @param src is the files struct copied.
+ * @return Returns 0 if succeed; Otherwise a negative errno is returned.
+ */
+int fs_copy_files(files_t * dst, files_t * src);
+
+/**
+ * Free a files struct.
+ * All the file descriptors should be closed before calling this function.
+ */
+void fs_free_files(files_t * files);
+
 /**
  * Create a new file by using fs specific create() function.
  * File will be created relative to the attributes of a current process.
@@ -839,6 +906,7 @@ int fs_enotsup_ioctl(file_t * file, unsigned request, void * arg,
 int fs_enotsup_event_vnode_opened(struct proc_info * p, vnode_t * vnode);
 void fs_enotsup_event_fd_created(struct proc_info * p, file_t * file);
 void fs_enotsup_event_fd_closed(struct proc_info * p, file_t * file);
+void fs_enotsup_event_file_destroyed(file_t * file);
 int fs_enotsup_create(vnode_t * dir, const char * name, mode_t mode,
                       vnode_t ** result);
 int fs_enotsup_mknod(vnode_t * dir, const char * name, int mode,
@@ -850,6 +918,7 @@ int fs_enotsup_unlink(vnode_t * dir, const char * name);
 int fs_enotsup_mkdir(vnode_t * dir,  const char * name, mode_t mode);
 int fs_enotsup_rmdir(vnode_t * dir,  const char * name);
 int fs_enotsup_readdir(vnode_t * dir, struct dirent * d, off_t * off);
+ssize_t nofs_getdents(file_t * file, void * buf, size_t bytes);
 int fs_enotsup_stat(vnode_t * vnode, struct stat * buf);
 int fs_enotsup_utimes(vnode_t * vnode, const struct timespec times[2]);
 int fs_enotsup_chmod(vnode_t * vnode, mode_t mode);
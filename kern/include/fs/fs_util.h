@@ -103,6 +103,16 @@ void fs_vnode_init(struct vnode * vnode, ino_t vn_num,
  */
 void fs_vnode_cleanup(struct vnode * vnode);
 
+/**
+ * Append a directory entry to a getdents buffer.
+ * @param buf   is the position of the entry in the buffer.
+ * @param bytes is the space left in the buffer.
+ * @return Returns the length of the record written;
+ *         0 if the entry doesn't fit in the buffer.
+ */
+size_t fs_dirent_put(void * buf, size_t bytes, ino_t ino, uint8_t type,
+                     const char * name);
+
 
 /**
  * **Usage:**
@@ -80,6 +80,17 @@ __user void * init_stack_frame(struct _sched_pthread_create_args * thread_def,
  */
 sw_stack_frame_t * get_usr_sframe(struct thread_info * thread);
 
+/**
+ * Get the location where a thread was interrupted by an IRQ.
+ * @param thread is a thread that was preempted by an IRQ.
+ * @param[out] pc returns the address of the interrupted instruction.
+ * @param[out] lr returns the link register at the time of the IRQ.
+ * @return Returns 1 if the thread was interrupted in user mode;
+ *         Otherwise 0.
+ */
+int get_irq_pc(const struct thread_info * thread, uintptr_t * pc,
+               uintptr_t * lr);
+
 /**
  * Functions that can be calling while in a syscall.
  * @{
@@ -124,6 +135,14 @@ void hal_thread_yield(void);
 
 void stack_dump(sw_stack_frame_t frame);
 
+/**
+ * Get the value of the CPU cycle counter.
+ * The counter is enabled on the first call and it wraps around.
+ * @return Returns the current value of the cycle counter;
+ *         The value doesn't change if the core has no usable cycle counter.
+ */
+uint32_t core_get_cycles(void);
+
 /*
  * Core Implementation must provide following either as inlined functions or
  * macros:
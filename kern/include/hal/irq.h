@@ -30,9 +30,17 @@
  *******************************************************************************
  */
 
+#include <stdint.h>
+#include <sched.h>
 
 #define NR_IRQ 64
 
+/**
+ * Number of buckets in the IRQ handling latency histogram.
+ * The buckets are <10 us, <100 us, <1 ms, <10 ms and >=10 ms.
+ */
+#define IRQ_LAT_BUCKETS 5
+
 /**
  * IRQ Acknowledge Types.
  */
@@ -58,9 +66,23 @@ struct irq_handler {
     struct {
         unsigned allow_multiple : 1; /*!< Allow multiple IRQs to be received for
                                       *   a threaded handler. */
+        unsigned threaded : 1;  /*!< Create a dedicated handler thread using
+                                 *   thread_param. Otherwise IRQ_WAKE_THREAD
+                                 *   is handled by the shared IRQ thread. */
     } flags; /*!< IRQ handler control flags */
 
+    /**
+     * Scheduling policy and priority of the dedicated handler thread.
+     */
+    struct sched_param thread_param;
+
     unsigned int cnt; /*!< Interrupts received count. */
+    unsigned int lat_hist[IRQ_LAT_BUCKETS]; /*!< Threaded handling latency. */
+    uint64_t t_wakeup;  /*!< Time of the last irq_thread_wakeup(). */
+    int irq;            /*!< IRQ number, set by irq_register(). */
+    pthread_t tid;      /*!< Dedicated handler thread; -1 if none. */
+    int pending;        /*!< Set if waiting for the dedicated thread. */
+    int stop;           /*!< Set to stop the dedicated thread. */
     char name[]; /*!< Name of the handler/IRQ. Should be incremented by the
                   *   HW specific IRQ resolver. */
 };
@@ -84,15 +106,22 @@ void irq_disable(int irq);
 
 /**
  * Register an interrupt handler.
+ * If flags.threaded is set a dedicated handler thread is created, so
+ * threaded handlers can't be registered before the scheduler is initialized.
+ * @return Returns 0 if succeed; Otherwise a negative errno is returned.
  */
 int irq_register(int irq, struct irq_handler * handler);
 
 /**
  * Deregister an interrupt handler.
+ * The dedicated handler thread of a threaded handler is stopped and this
+ * function returns once the thread has exited.
  */
 int irq_deregister(int irq);
 
 /**
  * Postpone IRQ handling to the threaded IRQ handler.
+ * The IRQ is handled by its dedicated thread if the handler was registered
+ * with flags.threaded set; Otherwise by the shared IRQ thread.
  */
 void irq_thread_wakeup(int irq);
@@ -107,7 +107,8 @@ enum mmu_ptt {
  * +--------------------------------------+
  * S        = Shared
  * nG       = Determines if the translation is marked as global (0) or process
- *            specific (1).
+ *            specific (1). Always set for regions mapped to a page table
+ *            that has an ASID.
  * XN       = Execute-Never, mark region not-executable.
  * MEMTYPE  = TEX C B
  *            987 6 5 b
@@ -172,6 +173,17 @@ enum mmu_ptt {
  * @}
  */
 
+/**
+ * Address Space Identifier.
+ * Tags the non-global TLB entries of an address space so that switching
+ * between address spaces doesn't require invalidating the TLB. The value
+ * is allocated and managed by the HAL; A zeroed struct means that no ASID
+ * has been allocated yet.
+ */
+struct mmu_asid {
+    uint32_t asid;      /*!< Generation and the hardware ASID. */
+};
+
 /**
  * Page Table Control Block - PTCB
  */
@@ -187,6 +199,9 @@ typedef struct {
                                * the value is same as pt_addr. */
     enum mmu_ptt pt_type; /*!< Identifies the type of the page table. */
     uint32_t pt_dom;    /*!< The domain of the page table. */
+    struct mmu_asid * pt_asid; /*!< ASID of the address space owning the
+                                *   page table. NULL if the table is part
+                                *   of the global kernel address space. */
 } mmu_pagetable_t;
 
 /**
@@ -278,6 +293,8 @@ int mmu_unmap_region(const mmu_region_t * region);
 
 /**
  * Attach a L2 page table to a L1 master page table or attach a L1 page table.
+ * Attaching a L1 page table switches the address space without invalidating
+ * the TLB if the ASID of the page table is still valid.
  * @param pt    A page table descriptor structure.
  * @return  Zero if attach succeed; non-zero error code if invalid page table
  *          type.
@@ -291,6 +308,22 @@ int mmu_attach_pagetable(const mmu_pagetable_t * pt);
  */
 int mmu_detach_pagetable(const mmu_pagetable_t * pt);
 
+/**
+ * Begin a batch of page table updates.
+ * The TLB and cache maintenance of mmu_map_region(), mmu_unmap_region(),
+ * mmu_attach_pagetable() and mmu_detach_pagetable() calls made before the
+ * matching mmu_batch_end() is deferred and done once at the end of the batch.
+ * Batches can be nested.
+ * @note Interrupts are disabled until the batch ends, so the caller must not
+ *       block or wait for locks held by other threads.
+ */
+void mmu_batch_begin(void);
+
+/**
+ * End a batch of page table updates.
+ */
+void mmu_batch_end(void);
+
 /**
  * Read domain access bits.
  */
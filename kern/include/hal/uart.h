@@ -45,6 +45,7 @@
 #define UART_H
 
 #include <stdint.h>
+#include <sys/types.h>
 #include <termios.h>
 
 /* UART HAL Configuration */
@@ -84,6 +85,15 @@ struct uart_port {
      * @return 0 if no data avaiable; Otherwise value other than zero.
      */
     int (* peek)(struct uart_port * port);
+
+    /**
+     * Enable the receive interrupt.
+     * Optional, if set the driver calls uart_rx_wakeup() from its IRQ handler
+     * and readers wait for the interrupt instead of polling peek().
+     */
+    void (* rx_arm)(struct uart_port * port);
+
+    pthread_t rx_waiter;    /*!< Reader waiting for the RX interrupt or -1. */
 };
 
 /**
@@ -92,6 +102,13 @@ struct uart_port {
  */
 int uart_register_port(struct uart_port * port);
 
+/**
+ * Wake up a reader waiting for data on a port.
+ * Called by the driver from its threaded IRQ handler; the receive interrupt
+ * stays disabled until the next rx_arm().
+ */
+void uart_rx_wakeup(struct uart_port * port);
+
 /**
  * Get nr of ports registered with UART.
  */
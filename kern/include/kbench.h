@@ -0,0 +1,97 @@
+/**
+ * @file kbench.h
+ * @brief KBench, an in-kernel microbenchmark framework for Zeke.
+ */
+
+/*
+ * Copyright (c) 2026 Olli Vanhoja <olli.vanhoja@alumni.helsinki.fi>
+ * All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @addtogroup KBench
+ * @{
+ */
+
+#if configKBENCH == 0
+#error kbench is required for benchmarks
+#endif
+
+#pragma once
+#ifndef KBENCH_H
+#define KBENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Results of a benchmark run.
+ */
+struct kbench_result {
+    uint32_t min;       /*!< Fastest iteration. */
+    uint32_t median;    /*!< Median iteration. */
+    uint32_t p99;       /*!< 99th percentile. */
+    const char * unit;  /*!< Unit of the results, NULL if not run yet. */
+};
+
+struct _kbench {
+    char * name;
+    size_t iterations;
+    int (*setup)(void ** arg);
+    void (*fn)(void * arg);
+    void (*teardown)(void * arg);
+    struct kbench_result result;
+};
+
+/**
+ * Declare a benchmark.
+ * The benchmark is exported under procfs in the kbench file and it can be
+ * run by writing its name, or "all", to the file.
+ * @param group is the benchmark group name.
+ * @param bname is the name of the benchmark.
+ * @param _fn_ is the function measured, called once per iteration with the
+ *             argument returned by _setup_.
+ * @param _setup_ is an optional function called before the iterations, a
+ *                non-zero return value cancels the benchmark.
+ * @param _teardown_ is an optional function called after the iterations.
+ */
+#define KBENCH(group, bname, _fn_, _setup_, _teardown_)     \
+    static struct _kbench _kbench_##bname                   \
+        __section("set_kbench_sect") __used = {             \
+        .name = #group "_" #bname,                          \
+        .iterations = configKBENCH_ITERATIONS,              \
+        .setup = (_setup_),                                 \
+        .fn = (_fn_),                                       \
+        .teardown = (_teardown_),                           \
+    }
+
+/* Documented in kbench.c */
+int kbench_run(const char * name);
+
+#endif /* KBENCH_H */
+
+/**
+ * @}
+ */
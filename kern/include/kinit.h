@@ -60,6 +60,7 @@ void (*kputs)(const char *);
     } else {                            \
         __subsys_init = '\x01';         \
         kputs((name));                  \
+        kinit_prof_name((name));        \
     }                                   \
 } while (0)
 
@@ -88,6 +89,30 @@ void (*kputs)(const char *);
 
 void exec_initfn(int (*fn)(void));
 
+/**
+ * Name the running initializer in the boot profile.
+ * Called by SUBSYS_INIT().
+ */
+void kinit_prof_name(const char * name);
+
+/**
+ * Continue a subsystem initializer asynchronously.
+ * fn is run in a kernel thread once the scheduler is running. During the
+ * boot a SUBSYS_DEP() on self runs fn synchronously if the thread hasn't
+ * started yet, otherwise it waits for the thread to finish.
+ * @param self  is the initializer function of the subsystem.
+ * @param fn    is the rest of the initialization.
+ * @return Returns -EINPROGRESS that should be returned by the initializer;
+ *         If the thread can't be created fn is called immediately and its
+ *         return value is returned.
+ */
+int kinit_async(int (*self)(void), int (*fn)(void));
+
+/**
+ * Wait for all asynchronous initializers to finish.
+ */
+void kinit_async_wait(void);
+
 void kinit_parse_cmdline(const char * cmdline);
 
 #endif /* KINIT_H */
@@ -48,6 +48,7 @@
 #ifdef configLOCK_DEBUG
 #include <kerror.h>
 #endif
+#include <lockstat.h>
 
 /**
  * @addtogroup mtx mtx_init, mtx_lock, mtx_trylock
@@ -135,6 +136,10 @@ typedef struct mtx {
 #ifdef configLOCK_DEBUG
     char * mtx_ldebug;
 #endif
+#ifdef configLOCK_STAT
+    struct lockstat_class * mtx_lstat;  /*!< Lock class if registered. */
+    uint32_t mtx_lstat_t0;              /*!< Acquisition time. */
+#endif
 } mtx_t;
 
 #define MTX_OPT(mtx, typ) (!!((mtx)->mod.mtx_flags & (typ)))
@@ -212,8 +217,26 @@ typedef struct rwlock {
     int state; /*!< Lock state. 0 = no lock, -1 = wrlock and 0 < rdlock. */
     int wr_waiting; /*!< writers waiting. */
     struct mtx lock; /*!< Mutex protecting attributes. */
+#ifdef configLOCK_STAT
+    struct lockstat_class * rw_lstat;   /*!< Lock class if registered. */
+    uint32_t rw_lstat_t0;               /*!< Write lock acquisition time. */
+#endif
 } rwlock_t;
 
+/**
+ * Static initializer for an rwlock.
+ */
+#define RWLOCK_INITIALIZER (rwlock_t){                          \
+    .state = 0,                                                 \
+    .wr_waiting = 0,                                            \
+    .lock.mod.mtx_type = MTX_TYPE_SPIN,                         \
+    .lock.mod.mtx_flags = 0,                                    \
+    .lock.mod.mtx_modcsum = MTX_MODCSUM(MTX_TYPE_SPIN, 0),      \
+    .lock.mtx_lock = ATOMIC_INIT(0),                            \
+    .lock.ticket.queue = ATOMIC_INIT(0),                        \
+    .lock.ticket.dequeue = ATOMIC_INIT(0),                      \
+}
+
 /* Rwlock functions */
 
 /**
@@ -242,6 +242,18 @@ int ksignal_sigtimedwait(siginfo_t * retval, const sigset_t * restrict set,
  */
 int ksignal_sigsleep(const struct timespec * restrict timeout);
 
+/**
+ * Make a blocking wait of the current syscall interruptible by signals.
+ * Must be followed by ksignal_interruptible_end() after the wait.
+ */
+void ksignal_interruptible_begin(void);
+
+/**
+ * End an interruptible wait started with ksignal_interruptible_begin().
+ * @returns Returns -EINTR if a signal interrupted the wait; Otherwise 0.
+ */
+int ksignal_interruptible_end(void);
+
 /**
  * Check if a signal is blocked.
  * @param sigs is a pointer to a signals struct, that's already locked.
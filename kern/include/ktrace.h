@@ -0,0 +1,96 @@
+/**
+ * @file ktrace.h
+ * @brief Kernel trace buffer.
+ */
+
+/*
+ * Copyright (c) 2026 Olli Vanhoja <olli.vanhoja@alumni.helsinki.fi>
+ * All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @addtogroup ktrace
+ * Static tracepoints recorded to a per CPU ring buffer.
+ * Each entry has a timestamp in microseconds, an event id and three integer
+ * arguments. Recording doesn't format anything; the buffer is converted to
+ * text only when /proc/ktrace is opened, one line per entry:
+ *
+ *     cpu timestamp event arg0 arg1 arg2
+ *
+ * tools/ktrace.py decodes the event ids.
+ * @{
+ */
+
+#pragma once
+#ifndef KTRACE_H
+#define KTRACE_H
+
+#include <stdint.h>
+
+/**
+ * Trace events.
+ * Keep in sync with tools/ktrace.py.
+ */
+enum ktrace_event {
+    KTRACE_NONE = 0,        /*!< Unused entry. */
+    KTRACE_SCHED_SWITCH,    /*!< prev tid, next tid. */
+    KTRACE_SYSCALL_ENTER,   /*!< type, pid, tid. */
+    KTRACE_SYSCALL_EXIT,    /*!< type, retval, tid. */
+    KTRACE_ABO,             /*!< far, fsr, pid. */
+    KTRACE_BIO_READ,        /*!< vnode number, blkno, bcount. */
+    KTRACE_BIO_WRITE,       /*!< vnode number, blkno, bcount. */
+    KTRACE_IRQ,             /*!< irq. */
+};
+
+/**
+ * Trace buffer entry.
+ */
+struct ktrace_entry {
+    uint64_t ts;            /*!< Timestamp from get_utime(). */
+    uint32_t event;         /*!< enum ktrace_event. */
+    uint32_t arg[3];
+};
+
+#ifdef configKTRACE
+/**
+ * Record a trace event.
+ * @param _event_ is the name of the event without the KTRACE_ prefix.
+ */
+#define KTRACE(_event_, _a0_, _a1_, _a2_)                                   \
+    ktrace_record(KTRACE_##_event_, (uint32_t)(_a0_), (uint32_t)(_a1_),    \
+                  (uint32_t)(_a2_))
+#else
+#define KTRACE(_event_, _a0_, _a1_, _a2_) do { } while (0)
+#endif
+
+/* Documented in ktrace.c */
+void ktrace_record(enum ktrace_event event, uint32_t a0, uint32_t a1,
+                   uint32_t a2);
+
+#endif /* KTRACE_H */
+
+/**
+ * @}
+ */
@@ -0,0 +1,137 @@
+/**
+ * @file lockstat.h
+ * @brief Lock contention statistics.
+ */
+
+/*
+ * Copyright (c) 2026 Olli Vanhoja <olli.vanhoja@alumni.helsinki.fi>
+ * All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @addtogroup lockstat
+ * Per lock class contention statistics.
+ * A lock class is a statically allocated mtx or rwlock registered with
+ * LOCKSTAT_MTX() or LOCKSTAT_RWLOCK(). The statistics are exported in
+ * /proc/lockstat and /proc/lockstat_sites and they can be cleared by
+ * writing to the kern.lockstat.reset sysctl.
+ * @{
+ */
+
+#pragma once
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+#include <stdint.h>
+
+/**
+ * Number of call sites tracked per lock class.
+ */
+#define LOCKSTAT_NSITES 4
+
+/**
+ * Contended acquisitions of a lock class from a single call site.
+ */
+struct lockstat_site {
+    const char * cls_name;  /*!< Name of the lock class. */
+    const char * whr;       /*!< Call site, NULL if the entry is free. */
+    uint32_t contended;     /*!< Contended acquisitions from the site. */
+    uint64_t wait_total;    /*!< Total wait time at the site. */
+};
+
+/**
+ * Lock class statistics.
+ * The counters are updated while holding the lock itself.
+ */
+struct lockstat_class {
+    const char * name;
+    struct lockstat_class ** lockp; /*!< Class pointer in the lock. */
+    struct lockstat_site * sites;   /*!< LOCKSTAT_NSITES call sites. */
+    uint32_t acquired;      /*!< Number of acquisitions. */
+    uint32_t contended;     /*!< Acquisitions that had to wait. */
+    uint64_t wait_total;    /*!< Total wait time. */
+    uint32_t wait_max;      /*!< Longest wait. */
+    uint64_t hold_total;    /*!< Total time held exclusively. */
+    uint32_t hold_max;      /*!< Longest exclusive hold. */
+};
+
+#ifdef configLOCK_STAT
+#define _LOCKSTAT_CLASS(_lock_, _field_)                                \
+    static struct lockstat_site _lockstat_sites_##_lock_                \
+        [LOCKSTAT_NSITES] __section("set_lockstat_site_sect") __used = {\
+        [0 ... LOCKSTAT_NSITES - 1] = { .cls_name = #_lock_ },          \
+    };                                                                  \
+    static struct lockstat_class _lockstat_##_lock_                     \
+        __section("set_lockstat_sect") __used = {                       \
+        .name = #_lock_,                                                \
+        .lockp = &(_lock_)._field_,                                     \
+        .sites = _lockstat_sites_##_lock_,                              \
+    }
+#else
+#define _LOCKSTAT_CLASS(_lock_, _field_) \
+    extern int _lockstat_unused_##_lock_
+#endif
+
+/**
+ * Collect contention statistics for a statically allocated mtx.
+ * @param _lock_ is the name of the mtx_t variable.
+ */
+#define LOCKSTAT_MTX(_lock_) _LOCKSTAT_CLASS(_lock_, mtx_lstat)
+
+/**
+ * Collect contention statistics for a statically allocated rwlock.
+ * Hold times are only collected for write locks and call sites are not
+ * tracked.
+ * @param _lock_ is the name of the rwlock_t variable.
+ */
+#define LOCKSTAT_RWLOCK(_lock_) _LOCKSTAT_CLASS(_lock_, rw_lstat)
+
+/**
+ * Get a timestamp for lock statistics.
+ */
+uint32_t lockstat_now(void);
+
+/**
+ * Account an acquisition of a lock.
+ * @param cls is the lock class.
+ * @param wait is the time spent waiting for the lock.
+ * @param contended tells whether the lock was held by someone else.
+ * @param whr is the call site or NULL.
+ */
+void lockstat_acquired(struct lockstat_class * cls, uint32_t wait,
+                       int contended, const char * whr);
+
+/**
+ * Account a release of an exclusively held lock.
+ * @param cls is the lock class.
+ * @param hold is the time the lock was held.
+ */
+void lockstat_released(struct lockstat_class * cls, uint32_t hold);
+
+#endif /* LOCKSTAT_H */
+
+/**
+ * @}
+ */
@@ -90,6 +90,17 @@ queue_cb_t queue_create(void * data_array, size_t block_size,
  */
 int queue_push(queue_cb_t * cb, const void * element);
 
+/**
+ * Push n elements to the queue.
+ * Copies as many elements as there is free space in the queue with at most
+ * two memcpy() calls.
+ * @param cb is a pointer to the queue control block.
+ * @param elements is a pointer to an array of elements to be copied.
+ * @param n is the number of elements in the array.
+ * @return Returns the number of elements pushed.
+ */
+size_t queue_push_n(queue_cb_t * cb, const void * elements, size_t n);
+
 /**
  * Allocate an element from the queue.
  * @param cb is a pointer to the queue control block.
@@ -112,6 +123,17 @@ void queue_alloc_commit(queue_cb_t * cb);
  */
 int queue_pop(queue_cb_t * cb, void * element);
 
+/**
+ * Pop n elements from the queue.
+ * Copies as many elements as there is in the queue with at most two memcpy()
+ * calls.
+ * @param cb is a pointer to the queue control block.
+ * @param elements is a pointer to an array where the elements are copied to.
+ * @param n is the maximum number of elements to be copied.
+ * @return Returns the number of elements popped.
+ */
+size_t queue_pop_n(queue_cb_t * cb, void * elements, size_t n);
+
 /**
  * Peek an element from the queue.
  * @param cb is a pointer to the queue control block.
@@ -155,6 +177,18 @@ int queue_isempty(queue_cb_t * cb);
  */
 int queue_isfull(queue_cb_t * cb);
 
+/**
+ * Get the number of elements in the queue.
+ * @param cb is a pointer to the queue control block.
+ */
+size_t queue_count(queue_cb_t * cb);
+
+/**
+ * Get the number of free element slots in the queue.
+ * @param cb is a pointer to the queue control block.
+ */
+size_t queue_space(queue_cb_t * cb);
+
 /**
  * Seek queue.
  * @param cb is a pointer to the queue control block.
@@ -75,6 +75,7 @@ RB_HEAD(ptlist, vm_pt);
  */
 struct vm_mm_struct {
     mmu_pagetable_t mpt;        /*!< Process master page table. */
+    struct mmu_asid asid;       /*!< ASID of the address space. */
     /** RB tree of page tables */
     struct ptlist ptlist_head;
     struct buf * (*regions)[]; /*!< Memory regions of a process.
@@ -84,6 +85,13 @@ struct vm_mm_struct {
                                  *   [n] = allocs
                                  */
     int nr_regions;             /*!< Number of regions allocated. */
+    /**
+     * Numbers of the non-NULL regions sorted by vaddr.
+     * Maintained by vm_set_region_locked().
+     */
+    int * regions_sorted;
+    int nr_sorted;              /*!< Number of entries in regions_sorted. */
+    int regions_hit;            /*!< Region last found by vm_find_reg(). */
     mtx_t regions_lock;
 };
 
@@ -204,7 +212,9 @@ __kernel void * vm_uaddr2kaddr(struct proc_info * proc,
  * Kernel copy functions.
  *
  * The copy functions are designed to copy contiguous data from one address
- * to another from user-space to kernel-space and vice-versa.
+ * to another from user-space to kernel-space and vice-versa. A user range may
+ * span over multiple consecutive regions, small copies hitting the region
+ * last accessed take a fast path.
  * @{
  */
 
@@ -276,6 +286,25 @@ int copyout_proc(struct proc_info * proc, __kernel const void * kaddr,
  */
 int vm_find_reg(struct proc_info * proc, uintptr_t uaddr, struct buf ** bp);
 
+/**
+ * Find a region in a mm that maps uaddr.
+ * @note mm must be locked.
+ * @return  Returns the region number if found; Otherwise -1.
+ */
+int vm_find_reg_locked(struct vm_mm_struct * mm, uintptr_t uaddr);
+
+/**
+ * Set a region pointer in the regions array of mm.
+ * All changes to the regions array must be made with this function to keep
+ * the region index in sync.
+ * @note mm must be locked.
+ * @param mm is the mm struct.
+ * @param region_nr is the region number, must be less than mm->nr_regions.
+ * @param region is the new region pointer, can be NULL.
+ */
+void vm_set_region_locked(struct vm_mm_struct * mm, int region_nr,
+                          struct buf * region);
+
 /**
  * Create a new empty general purpose section.
  * Create a new empty buffer that can be inserted as a section/region
@@ -305,6 +334,7 @@ struct buf * vm_rndsect(struct proc_info * proc, size_t size, int prot,
 /**
  * Create a new user space stack for the current process.
  * Create and map new user stack, free the old stack.
+ * The stack is populated on-demand.
  * @param size is the minimum size of the new stack.
  * @return Returns the new buf struct if allocated; Otherwise NULL.
  */
@@ -386,6 +416,25 @@ int vm_map_region(struct buf * region, struct vm_pt * pt);
  */
 int vm_mapproc_region(struct proc_info * proc, struct buf * region);
 
+/**
+ * Populate and map the pages of an on-demand region.
+ * Does nothing if the region is not populated on-demand.
+ * @param proc is the process struct.
+ * @param region is a vm region buffer mapped to proc.
+ * @param uaddr is the start of the range.
+ * @param len is the length of the range, the range is clipped to the region.
+ * @return Zero if succeed; A negative errno otherwise.
+ */
+int vm_populate_region(struct proc_info * proc, struct buf * region,
+                       uintptr_t uaddr, size_t len);
+
+/**
+ * Get the resident set size of a VM region.
+ * @param region is a vm region buffer.
+ * @return Returns the number of bytes of the region backed by populated pages.
+ */
+size_t vm_region_rss(struct buf * region);
+
 /**
  * Unmap a VM region from a given process.
  * @param proc is a pointer to the process.
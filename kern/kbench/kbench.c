@@ -0,0 +1,202 @@
+/**
+ * @file kbench.c
+ * @brief KBench, an in-kernel microbenchmark framework for Zeke.
+ */
+
+/*
+ * Copyright (c) 2026 Olli Vanhoja <olli.vanhoja@alumni.helsinki.fi>
+ * All rights reserved.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fs/procfs.h>
+#include <fs/procfs_dbgfile.h>
+#include <hal/core.h>
+#include <hal/hw_timers.h>
+#include <kerror.h>
+#include <kmalloc.h>
+#include <kstring.h>
+#include "kbench.h"
+
+/**
+ * Number of calls timed together per sample if the cycle counter is not
+ * available and get_utime() must be used.
+ */
+#define KBENCH_UTIME_BATCH 32
+
+__GLOBL(__start_set_kbench_sect);
+__GLOBL(__stop_set_kbench_sect);
+extern struct _kbench __start_set_kbench_sect;
+extern struct _kbench __stop_set_kbench_sect;
+
+/**
+ * Test if the cycle counter is running.
+ */
+static int has_cycles(void)
+{
+    uint32_t start = core_get_cycles();
+
+    for (int i = 0; i < 1000; i++) {
+        if (core_get_cycles() != start)
+            return 1;
+    }
+    return 0;
+}
+
+static void sort_samples(uint32_t * samples, size_t n)
+{
+    for (size_t i = 1; i < n; i++) {
+        const uint32_t x = samples[i];
+        size_t j = i;
+
+        while (j > 0 && samples[j - 1] > x) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = x;
+    }
+}
+
+static int kbench_run_one(struct _kbench * bench)
+{
+    const size_t n = bench->iterations;
+    const int cycles = has_cycles();
+    uint32_t * samples;
+    void * arg = NULL;
+    int err;
+
+    samples = kmalloc(n * sizeof(uint32_t));
+    if (!samples)
+        return -ENOMEM;
+
+    if (bench->setup) {
+        err = bench->setup(&arg);
+        if (err) {
+            KERROR(KERROR_ERR, "kbench %s: setup failed (%d)\n",
+                   bench->name, err);
+            kfree(samples);
+            return err;
+        }
+    }
+
+    bench->fn(arg); /* Warm up. */
+    for (size_t i = 0; i < n; i++) {
+        if (cycles) {
+            const uint32_t start = core_get_cycles();
+
+            bench->fn(arg);
+            samples[i] = core_get_cycles() - start;
+        } else {
+            const uint64_t start = get_utime();
+
+            for (int j = 0; j < KBENCH_UTIME_BATCH; j++) {
+                bench->fn(arg);
+            }
+            samples[i] = (uint32_t)((get_utime() - start) * 1000 /
+                                    KBENCH_UTIME_BATCH);
+        }
+    }
+
+    if (bench->teardown)
+        bench->teardown(arg);
+
+    sort_samples(samples, n);
+    bench->result = (struct kbench_result){
+        .min = samples[0],
+        .median = samples[n / 2],
+        .p99 = samples[(n * 99) / 100],
+        .unit = (cycles) ? "cycles" : "ns",
+    };
+    kfree(samples);
+
+    KERROR(KERROR_INFO, "kbench %s: min %u median %u p99 %u %s\n",
+           bench->name, bench->result.min, bench->result.median,
+           bench->result.p99, bench->result.unit);
+
+    return 0;
+}
+
+/**
+ * Run a benchmark.
+ * @param name is the name of the benchmark or "all".
+ * @return Returns zero if the benchmark was found and run;
+ *         Otherwise a negative errno is returned.
+ */
+int kbench_run(const char * name)
+{
+    struct _kbench * bench = &__start_set_kbench_sect;
+    struct _kbench * stop = &__stop_set_kbench_sect;
+    const int all = strcmp(name, "all") == 0;
+    int found = 0;
+    int retval = 0;
+
+    while (bench < stop) {
+        if (all || strcmp(name, bench->name) == 0) {
+            int err;
+
+            found = 1;
+            err = kbench_run_one(bench);
+            if (err)
+                retval = err;
+            if (!all)
+                break;
+        }
+
+        bench++;
+    }
+
+    return (found) ? retval : -EINVAL;
+}
+
+static int read_kbench(void * buf, size_t max, void * elem)
+{
+    struct _kbench * bench = elem;
+    const struct kbench_result * res = &bench->result;
+
+    if (!res->unit)
+        return ksprintf(buf, max, "%s\n", bench->name);
+
+    return ksprintf(buf, max, "%s %u %u %u %s\n",
+                    bench->name, res->min, res->median, res->p99, res->unit);
+}
+
+static ssize_t write_kbench(const void * buf, size_t bufsize)
+{
+    int err;
+
+    if (!strvalid((char *)buf, bufsize))
+        return -EINVAL;
+
+    err = kbench_run((char *)buf);
+    if (err)
+        return err;
+
+    return bufsize;
+}
+
+PROCFS_DBGFILE(kbench,
+               &__start_set_kbench_sect,
+               &__stop_set_kbench_sect,
+               read_kbench, write_kbench);
@@ -36,6 +36,9 @@
 #include <sys/sysctl.h>
 #include <sys/types.h>
 #include <buf.h>
+#include <fs/procfs.h>
+#include <fs/procfs_dbgfile.h>
+#include <hal/hw_timers.h>
 #include <kerror.h>
 #include <kinit.h>
 #include <kmalloc.h>
@@ -57,7 +60,64 @@ extern int (*__init_array_end []) (void) __attribute__((weak));
 extern int (*__fini_array_start []) (void) __attribute__((weak));
 extern int (*__fini_array_end []) (void) __attribute__((weak));
 
+/**
+ * Max number of subsystems in the boot profile.
+ */
+#define KINIT_PROF_MAX  128
+
+/**
+ * Max number of asynchronous initializers in progress.
+ */
+#define KINIT_ASYNC_MAX 8
+
+/**
+ * Boot profile entry of a subsystem.
+ */
+struct kinit_prof {
+    const char * name;  /*!< Name given in SUBSYS_INIT(). */
+    uint32_t self_us;   /*!< Time spent excluding dependencies. */
+    uint32_t total_us;  /*!< Time spent including dependencies. */
+    int async;          /*!< Partly initialized in a kernel thread. */
+};
+
+/**
+ * An initializer being executed.
+ */
+struct kinit_frame {
+    struct kinit_frame * parent;
+    struct kinit_prof * prof;
+    uint64_t start;
+    uint64_t dep_us;    /*!< Time spent in dependencies. */
+};
+
+enum kinit_async_state {
+    KINIT_ASYNC_FREE = 0,   /*!< Slot not in use. */
+    KINIT_ASYNC_RESERVED,   /*!< Slot being set up by kinit_async(). */
+    KINIT_ASYNC_PENDING,
+    KINIT_ASYNC_RUNNING,
+};
+
+/**
+ * Asynchronous part of an initializer.
+ */
+struct kinit_async {
+    int (*self)(void);
+    int (*fn)(void);
+    struct kinit_prof * prof;
+    atomic_t state;     /*!< enum kinit_async_state. */
+};
+
+static struct kinit_prof kinit_prof[KINIT_PROF_MAX];
+static size_t kinit_prof_count;
+static struct kinit_frame * kinit_frame;
+static struct kinit_async kinit_async_arr[KINIT_ASYNC_MAX];
+
+static unsigned kinit_time_us;
+SYSCTL_UINT(_kern, OID_AUTO, kinit_us, CTLFLAG_RD, &kinit_time_us, 0,
+            "Time spent in subsystem initializers (us)");
+
 static void exec_array(int (*a []) (void), int n);
+static void kinit_async_join(struct kinit_async * a);
 
 /* Default tty. */
 static char console[16] = "/dev/ttyS0"; /* TODO use console value */
@@ -76,6 +136,7 @@ void exec_init_array(void)
     extern void kmem_init(void);
     extern void dynmem_init(void);
     extern void vralloc_init(void);
+    uint64_t start;
     int n;
 
 #ifdef configDYNDEBUG
@@ -95,7 +156,9 @@ void exec_init_array(void)
 
     kputs("SubsysInit\n");
     n  = __init_array_end - __init_array_start;
+    start = get_utime();
     exec_array(__init_array_start, n);
+    kinit_time_us = get_utime() - start;
 
     kputs("PostInit\n");
     disable_interrupt();
@@ -212,7 +275,9 @@ static void map_vmstack2proc(struct proc_info * proc, struct buf * vmstack)
 {
     struct vm_pt * vpt;
 
-    (*proc->mm.regions)[MM_STACK_REGION] = vmstack;
+    mtx_lock(&proc->mm.regions_lock);
+    vm_set_region_locked(&proc->mm, MM_STACK_REGION, vmstack);
+    mtx_unlock(&proc->mm.regions_lock);
     vm_updateusr_ap(vmstack);
 
     vpt = ptlist_get_pt(&proc->mm, vmstack->b_mmu.vaddr,
@@ -358,14 +423,179 @@ static void exec_array(int (*a []) (void), int n)
 
 void exec_initfn(int (*fn)(void))
 {
+    struct kinit_frame frame = {
+        .parent = kinit_frame,
+    };
+    uint64_t time;
     int err;
 
+    /* Dependencies must be fully initialized. */
+    for (int i = 0; i < KINIT_ASYNC_MAX; i++) {
+        if (kinit_async_arr[i].self == fn)
+            kinit_async_join(&kinit_async_arr[i]);
+    }
+
+    kinit_frame = &frame;
+    frame.start = get_utime();
     err = fn();
+    time = get_utime() - frame.start;
+    kinit_frame = frame.parent;
+
+    if (frame.prof) {
+        frame.prof->total_us += time;
+        frame.prof->self_us += time - frame.dep_us;
+    }
+    if (frame.parent)
+        frame.parent->dep_us += time;
 
     if (err == 0) {
         kputs("\r\t\t\t\tOK\n");
+    } else if (err == -EINPROGRESS) {
+        kputs("\r\t\t\t\tASYNC\n");
     } else if (err != -EAGAIN) {
         kputs("\r\t\t\t\tFAILED\n");
         panic("Halt");
     }
 }
+
+void kinit_prof_name(const char * name)
+{
+    struct kinit_prof * prof;
+
+    if (!kinit_frame || kinit_prof_count >= KINIT_PROF_MAX)
+        return;
+
+    prof = &kinit_prof[kinit_prof_count++];
+    prof->name = name;
+    kinit_frame->prof = prof;
+}
+
+/**
+ * Run the asynchronous part of an initializer unless it's already started.
+ */
+static void kinit_async_run(struct kinit_async * a)
+{
+    uint64_t start, time;
+    int err;
+
+    if (atomic_cmpxchg(&a->state, KINIT_ASYNC_PENDING,
+                       KINIT_ASYNC_RUNNING) != KINIT_ASYNC_PENDING)
+        return;
+
+    start = get_utime();
+    err = a->fn();
+    time = get_utime() - start;
+
+    if (a->prof) {
+        a->prof->total_us += time;
+        a->prof->self_us += time;
+    }
+    if (kinit_frame)
+        kinit_frame->dep_us += time;
+
+    if (err) {
+        KERROR(KERROR_ERR, "Async init of %s failed (%d)\n",
+               (a->prof) ? a->prof->name : "?", err);
+        panic("Halt");
+    }
+
+    /* Done, the slot can be reused. */
+    atomic_set(&a->state, KINIT_ASYNC_FREE);
+}
+
+static void * kinit_async_thread(void * arg)
+{
+    kinit_async_run(arg);
+
+    return NULL;
+}
+
+/**
+ * Wait for an asynchronous initializer.
+ * The scheduler isn't running during the boot so the initializer is run by
+ * the caller if the thread hasn't started it yet. After the boot the caller
+ * can be a process, that must not run the initializer, so only the thread
+ * is waited for.
+ */
+static void kinit_async_join(struct kinit_async * a)
+{
+    int (*self)(void) = a->self;
+    int state;
+
+    if (!current_thread)
+        kinit_async_run(a);
+    while ((state = atomic_read(&a->state)) == KINIT_ASYNC_PENDING ||
+           state == KINIT_ASYNC_RUNNING) {
+        if (a->self != self)
+            break; /* Done and the slot was reused. */
+        thread_yield(THREAD_YIELD_LAZY);
+    }
+}
+
+int kinit_async(int (*self)(void), int (*fn)(void))
+{
+    struct sched_param param = {
+        .sched_policy = SCHED_OTHER,
+        .sched_priority = NZERO,
+    };
+    struct kinit_async * a = NULL;
+    char name[40];
+    pthread_t tid;
+
+    /* Reserve a free slot. */
+    for (int i = 0; i < KINIT_ASYNC_MAX; i++) {
+        if (atomic_cmpxchg(&kinit_async_arr[i].state, KINIT_ASYNC_FREE,
+                           KINIT_ASYNC_RESERVED) == KINIT_ASYNC_FREE) {
+            a = &kinit_async_arr[i];
+            break;
+        }
+    }
+    if (!a)
+        return fn();
+
+    a->self = self;
+    a->fn = fn;
+    a->prof = (kinit_frame) ? kinit_frame->prof : NULL;
+    atomic_set(&a->state, KINIT_ASYNC_PENDING);
+
+    ksprintf(name, sizeof(name), "kinit_%s", (a->prof) ? a->prof->name : "");
+    tid = kthread_create(name, &param, 0, kinit_async_thread, a);
+    if (tid < 0) {
+        a->self = NULL;
+        atomic_set(&a->state, KINIT_ASYNC_FREE);
+        return fn();
+    }
+    if (a->prof)
+        a->prof->async = 1;
+
+    return -EINPROGRESS;
+}
+
+void kinit_async_wait(void)
+{
+    for (int i = 0; i < KINIT_ASYNC_MAX; i++) {
+        kinit_async_join(&kinit_async_arr[i]);
+    }
+}
+
+static int read_kinit(void * buf, size_t max, void * elem)
+{
+    struct kinit_prof * prof = elem;
+
+    if (!prof->name)
+        return 0;
+
+    return ksprintf(buf, max, "%s %u %u %s\n",
+                    prof->name, prof->self_us, prof->total_us,
+                    (prof->async) ? "async" : "sync");
+}
+
+static ssize_t write_kinit(const void * buf, size_t bufsize)
+{
+    return -ENOTSUP;
+}
+
+PROCFS_DBGFILE(kinit,
+               &kinit_prof[0],
+               &kinit_prof[KINIT_PROF_MAX],
+               read_kinit, write_kinit);
@@ -47,6 +47,12 @@
 #define MTX_TYPE_NOTSUP()
 #endif
 
+#ifdef configLOCK_DEBUG
+#define LOCKSTAT_WHR whr
+#else
+#define LOCKSTAT_WHR NULL
+#endif
+
 #define MTX_MOD_ASSERT(mod)                                     \
     KASSERT(MTX_MODCSUM((mod)->mtx_type, (mod)->mtx_flags) ==   \
             (mod)->mtx_modcsum,                                 \
@@ -58,6 +64,19 @@
  */
 istate_t cpu_istate;
 
+/**
+ * Account a successful mtx_trylock().
+ */
+static inline void lstat_trylock(mtx_t * mtx)
+{
+#ifdef configLOCK_STAT
+    if (mtx->mtx_lstat) {
+        mtx->mtx_lstat_t0 = lockstat_now();
+        lockstat_acquired(mtx->mtx_lstat, 0, 0, NULL);
+    }
+#endif
+}
+
 static void priceil_set(mtx_t * mtx)
 {
     if (MTX_OPT(mtx, MTX_OPT_PRICEIL)) {
@@ -89,6 +108,9 @@ void mtx_init(mtx_t * mtx, enum mtx_type type, unsigned int opt)
 #ifdef configLOCK_DEBUG
     mtx->mtx_ldebug = NULL;
 #endif
+#ifdef configLOCK_STAT
+    mtx->mtx_lstat = NULL;
+#endif
 }
 
 #ifndef configLOCK_DEBUG
@@ -101,6 +123,10 @@ int _mtx_lock(mtx_t * mtx, char * whr)
     const int sleep_mode = MTX_OPT(mtx, MTX_OPT_SLEEP);
     const int opt_timeout = (mtx->mod.mtx_flags & 0xf) * 1000;
     uint64_t start_time = (opt_timeout) ? get_utime() : 0;
+#ifdef configLOCK_STAT
+    const uint32_t lstat_start = (mtx->mtx_lstat) ? lockstat_now() : 0;
+    int lstat_contended = 0;
+#endif
 #ifdef configLOCK_DEBUG
     unsigned deadlock_cnt = 0;
 
@@ -165,11 +191,21 @@ int _mtx_lock(mtx_t * mtx, char * whr)
             return -ENOTSUP;
         }
 
+#ifdef configLOCK_STAT
+        lstat_contended = 1;
+#endif
 #ifdef configMP
         cpu_wfe(); /* Sleep until event. */
 #endif
     }
 out:
+#ifdef configLOCK_STAT
+    if (mtx->mtx_lstat) {
+        mtx->mtx_lstat_t0 = lockstat_now();
+        lockstat_acquired(mtx->mtx_lstat, mtx->mtx_lstat_t0 - lstat_start,
+                          lstat_contended, LOCKSTAT_WHR);
+    }
+#endif
 
     /* Handle priority ceiling. */
     priceil_set(mtx);
@@ -246,6 +282,8 @@ int _mtx_trylock(mtx_t * mtx, char * whr)
     switch (mtx->mod.mtx_type) {
     case MTX_TYPE_SPIN:
         retval = atomic_test_and_set(&mtx->mtx_lock);
+        if (retval == 0)
+            lstat_trylock(mtx);
         break;
 
     case MTX_TYPE_TICKET:
@@ -253,6 +291,7 @@ int _mtx_trylock(mtx_t * mtx, char * whr)
 
         if (atomic_read(&mtx->ticket.dequeue) == ticket) {
             atomic_set(&mtx->mtx_lock, 1);
+            lstat_trylock(mtx);
             return 0; /* Got it */
         } else {
             atomic_dec(&mtx->ticket.queue);
@@ -295,6 +334,10 @@ void mtx_unlock(mtx_t * mtx)
 #ifdef configLOCK_DEBUG
     mtx->mtx_ldebug = NULL;
 #endif
+#ifdef configLOCK_STAT
+    if (mtx->mtx_lstat)
+        lockstat_released(mtx->mtx_lstat, lockstat_now() - mtx->mtx_lstat_t0);
+#endif
 
     if (mtx->mod.mtx_type == MTX_TYPE_TICKET)
         atomic_inc(&mtx->ticket.dequeue);
@@ -37,15 +37,48 @@
 #include <kstring.h>
 #include <thread.h>
 
+#ifdef configLOCK_STAT
+#define LSTAT_START(l) ((l)->rw_lstat ? lockstat_now() : 0)
+
+/**
+ * Account an acquisition of an rwlock.
+ * Must be called while holding l->lock.
+ */
+static void lstat_acquired(rwlock_t * l, uint32_t start, int contended,
+                           int wr)
+{
+    uint32_t now;
+
+    if (!l->rw_lstat)
+        return;
+
+    now = lockstat_now();
+    if (wr)
+        l->rw_lstat_t0 = now;
+    lockstat_acquired(l->rw_lstat, (start) ? now - start : 0, contended,
+                      NULL);
+}
+#else
+#define LSTAT_START(l) 0
+#define lstat_acquired(l, start, contended, wr) \
+    ((void)(start), (void)(contended))
+#endif
+
 void rwlock_init(rwlock_t * l)
 {
     l->state = 0;
     l->wr_waiting = 0;
     mtx_init(&l->lock, MTX_TYPE_SPIN, 0);
+#ifdef configLOCK_STAT
+    l->rw_lstat = NULL;
+#endif
 }
 
 void rwlock_wrlock(rwlock_t * l)
 {
+    const uint32_t lstat_start = LSTAT_START(l);
+    int contended = 0;
+
     mtx_lock(&(l->lock));
     if (l->state == 0) {
         goto get_wrlock;
@@ -53,6 +86,7 @@ void rwlock_wrlock(rwlock_t * l)
         l->wr_waiting++;
     }
     mtx_unlock(&l->lock);
+    contended = 1;
 
     /* Try to minimize locked time. */
     while (1) {
@@ -68,6 +102,7 @@ void rwlock_wrlock(rwlock_t * l)
 
 get_wrlock:
     l->state = -1;
+    lstat_acquired(l, lstat_start, contended, 1);
     mtx_unlock(&l->lock);
 }
 
@@ -80,6 +115,7 @@ int rwlock_trywrlock(rwlock_t * l)
 
     if (l->state == 0) {
         l->state = -1;
+        lstat_acquired(l, 0, 0, 1);
         retval = 0;
     }
     mtx_unlock(&l->lock);
@@ -106,18 +142,26 @@ void rwlock_wrunlock(rwlock_t * l)
     mtx_lock(&(l->lock));
     if (l->state == -1) {
         l->state = 0;
+#ifdef configLOCK_STAT
+        if (l->rw_lstat)
+            lockstat_released(l->rw_lstat, lockstat_now() - l->rw_lstat_t0);
+#endif
     }
     mtx_unlock(&l->lock);
 }
 
 void rwlock_rdlock(rwlock_t * l)
 {
+    const uint32_t lstat_start = LSTAT_START(l);
+    int contended = 0;
+
     mtx_lock(&(l->lock));
     /* Don't take lock if any writer is waiting. */
     if (l->wr_waiting == 0 && l->state >= 0) {
         goto get_rdlock;
     }
     mtx_unlock(&(l->lock));
+    contended = 1;
 
     /* Try to minimize locked time. */
     while (1) {
@@ -132,6 +176,7 @@ void rwlock_rdlock(rwlock_t * l)
 
 get_rdlock:
     l->state++;
+    lstat_acquired(l, lstat_start, contended, 0);
     mtx_unlock(&(l->lock));
 }
 
@@ -144,6 +189,7 @@ int rwlock_tryrdlock(rwlock_t * l)
 
     if (l->wr_waiting == 0 && l->state >= 0) {
         l->state++;
+        lstat_acquired(l, 0, 0, 0);
         retval = 0;
     }
     mtx_unlock(&l->lock);
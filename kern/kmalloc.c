@@ -111,6 +111,7 @@ typedef struct mblock {
 void * kmalloc_base;
 
 static mtx_t kmalloc_giant_lock = MTX_INITIALIZER(MTX_TYPE_TICKET, 0);
+LOCKSTAT_MTX(kmalloc_giant_lock);
 
 /*
  * CB and data pointer array for lazy freeing data.
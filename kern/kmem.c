@@ -144,6 +144,7 @@ void kmem_init(void)
     mmu_region_kdata.paddr      = (intptr_t)(&_data_start);
 
     /* Fill page tables with translations & attributes */
+    mmu_batch_begin();
     {
         mmu_region_t ** regp;
 #if defined(configKMEM_DEBUG)
@@ -171,6 +172,7 @@ void kmem_init(void)
     /* Activate page tables */
     mmu_attach_pagetable(&vm_pagetable_system.pt); /* Add L2 pte into L1 mpt */
     mmu_attach_pagetable(&mmu_pagetable_master); /* Load L1 TTB */
+    mmu_batch_end();
 
     _kmem_ready = 1;
 }
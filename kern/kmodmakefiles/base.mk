@@ -9,3 +9,5 @@ base-SRC-$(configKERROR_UART) += kerror/kerror_uart.c
 base-SRC-$(configKERROR_FB) += kerror/kerror_fb.c
 base-SRC-$(configDYNDEBUG) += kerror/dyndebug.c
 base-SRC-$(configCORE_DUMPS) += $(wildcard coredump/*.c)
+base-SRC-$(configLOCK_STAT) += lockstat/lockstat.c
+base-SRC-$(configKTRACE) += ktrace/ktrace.c
@@ -0,0 +1,3 @@
+# KBench in-kernel microbenchmarks.
+kbench-SRC-$(configKBENCH) += $(wildcard kbench/*.c)
+kbench-SRC-$(configKBENCH) += $(wildcard bench/*.c)
@@ -862,6 +862,30 @@ int ksignal_sigsleep(const struct timespec * restrict timeout)
     return unslept;
 }
 
+void ksignal_interruptible_begin(void)
+{
+    struct signals * sigs = &current_thread->sigs;
+
+    while (ksig_lock(&sigs->s_lock));
+    KSIGFLAG_SET(sigs, KSIGFLAG_INTERRUPTIBLE);
+    ksig_unlock(&sigs->s_lock);
+}
+
+int ksignal_interruptible_end(void)
+{
+    struct signals * sigs = &current_thread->sigs;
+    int intr;
+
+    while (ksig_lock(&sigs->s_lock));
+    KSIGFLAG_CLEAR(sigs, KSIGFLAG_INTERRUPTIBLE);
+    /* A signal is going to be handled before returning to user space. */
+    intr = KSIGFLAG_IS_SET(sigs, KSIGFLAG_SIGHANDLER) ||
+           KSIGFLAG_IS_SET(sigs, KSIGFLAG_SA_KILL);
+    ksig_unlock(&sigs->s_lock);
+
+    return (intr) ? -EINTR : 0;
+}
+
 int ksignal_isblocked(struct signals * sigs, int signum)
 {
     KASSERT(ksig_testlock(&sigs->s_lock), "sigs should be locked\n");
@@ -0,0 +1,135 @@
+/**
+ *******************************************************************************
+ * @file    ktrace.c
+ * @author  Olli Vanhoja
+ * @brief   Kernel trace buffer.
+ * @section LICENSE
+ * Copyright (c) 2026 Olli Vanhoja <olli.vanhoja@alumni.helsinki.fi>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+
+#include <errno.h>
+#include <fs/procfs.h>
+#include <fs/procfs_dbgfile.h>
+#include <hal/core.h>
+#include <hal/hw_timers.h>
+#include <ksched.h>
+#include <kstring.h>
+#include <ktrace.h>
+
+#if (configKTRACE_SIZE & (configKTRACE_SIZE - 1)) != 0
+#error configKTRACE_SIZE must be a power of two
+#endif
+
+static struct ktrace_entry ktrace_buf[KSCHED_CPU_COUNT][configKTRACE_SIZE];
+static unsigned ktrace_head[KSCHED_CPU_COUNT];
+static int ktrace_enabled = 1;
+
+/**
+ * Record a trace event.
+ * Use the KTRACE() macro instead of calling this function directly.
+ * @param event is the event id.
+ * @param a0 is the first argument of the event.
+ * @param a1 is the second argument of the event.
+ * @param a2 is the third argument of the event.
+ */
+void ktrace_record(enum ktrace_event event, uint32_t a0, uint32_t a1,
+                   uint32_t a2)
+{
+    const int cpu = get_cpu_index();
+    struct ktrace_entry * entry;
+    istate_t s;
+
+    if (!ktrace_enabled)
+        return;
+
+    s = get_interrupt_state();
+    disable_interrupt();
+
+    entry = &ktrace_buf[cpu][ktrace_head[cpu]++ & (configKTRACE_SIZE - 1)];
+    entry->ts = get_utime();
+    entry->event = event;
+    entry->arg[0] = a0;
+    entry->arg[1] = a1;
+    entry->arg[2] = a2;
+
+    set_interrupt_state(s);
+}
+
+static void ktrace_clear(void)
+{
+    istate_t s;
+
+    s = get_interrupt_state();
+    disable_interrupt();
+
+    memset(ktrace_buf, 0, sizeof(ktrace_buf));
+    memset(ktrace_head, 0, sizeof(ktrace_head));
+
+    set_interrupt_state(s);
+}
+
+static int read_ktrace(void * buf, size_t max, void * elem)
+{
+    const size_t i = (struct ktrace_entry *)elem - &ktrace_buf[0][0];
+    struct ktrace_entry entry;
+    istate_t s;
+
+    /* Copy the entry to avoid reading it while it's being overwritten. */
+    s = get_interrupt_state();
+    disable_interrupt();
+    entry = *(struct ktrace_entry *)elem;
+    set_interrupt_state(s);
+
+    if (entry.event == KTRACE_NONE)
+        return 0;
+
+    return ksprintf(buf, max, "%u %llu %u %u %u %u\n",
+                    (unsigned)(i / configKTRACE_SIZE), entry.ts, entry.event,
+                    entry.arg[0], entry.arg[1], entry.arg[2]);
+}
+
+static ssize_t write_ktrace(const void * buf, size_t bufsize)
+{
+    if (!strvalid((char *)buf, bufsize))
+        return -EINVAL;
+
+    if (strcmp(buf, "on") == 0) {
+        ktrace_enabled = 1;
+    } else if (strcmp(buf, "off") == 0) {
+        ktrace_enabled = 0;
+    } else if (strcmp(buf, "clear") == 0) {
+        ktrace_clear();
+    } else {
+        return -EINVAL;
+    }
+
+    return bufsize;
+}
+
+PROCFS_DBGFILE(ktrace,
+               &ktrace_buf[0][0],
+               &ktrace_buf[0][0] + KSCHED_CPU_COUNT * configKTRACE_SIZE,
+               read_ktrace, write_ktrace);
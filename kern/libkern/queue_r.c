@@ -34,6 +34,7 @@
 
 #include <stdint.h>
 #include <kstring.h>
+#include <libkern.h>
 #include <queue_r.h>
 
 queue_cb_t queue_create(void * data_array, size_t block_size, size_t array_size)
@@ -64,6 +65,27 @@ int queue_push(queue_cb_t * cb, const void * element)
     return 1;
 }
 
+size_t queue_push_n(queue_cb_t * cb, const void * elements, size_t n)
+{
+    const size_t write = cb->m_write;
+    const size_t b_size = cb->b_size;
+    size_t first;
+
+    n = min(n, queue_space(cb));
+    if (n == 0)
+        return 0;
+
+    first = min(n, cb->a_len - write);
+    memcpy(&((uint8_t *)(cb->data))[write * b_size], elements, first * b_size);
+    if (n > first) {
+        memcpy(cb->data, (const uint8_t *)elements + first * b_size,
+               (n - first) * b_size);
+    }
+
+    cb->m_write = (write + n) % cb->a_len;
+    return n;
+}
+
 void * queue_alloc_get(queue_cb_t * cb)
 {
     const size_t write = cb->m_write;
@@ -106,6 +128,27 @@ int queue_pop(queue_cb_t * cb, void * element)
     return 1;
 }
 
+size_t queue_pop_n(queue_cb_t * cb, void * elements, size_t n)
+{
+    const size_t read = cb->m_read;
+    const size_t b_size = cb->b_size;
+    size_t first;
+
+    n = min(n, queue_count(cb));
+    if (n == 0)
+        return 0;
+
+    first = min(n, cb->a_len - read);
+    memcpy(elements, &((uint8_t *)(cb->data))[read * b_size], first * b_size);
+    if (n > first) {
+        memcpy((uint8_t *)elements + first * b_size, cb->data,
+               (n - first) * b_size);
+    }
+
+    cb->m_read = (read + n) % cb->a_len;
+    return n;
+}
+
 int queue_peek(queue_cb_t * cb, void ** element)
 {
     const size_t read = cb->m_read;
@@ -157,6 +200,16 @@ int queue_isfull(queue_cb_t * cb)
     return (int)(((cb->m_write + 1) % cb->a_len) == cb->m_read);
 }
 
+size_t queue_count(queue_cb_t * cb)
+{
+    return (cb->m_write + cb->a_len - cb->m_read) % cb->a_len;
+}
+
+size_t queue_space(queue_cb_t * cb)
+{
+    return cb->a_len - 1 - queue_count(cb);
+}
+
 int seek(queue_cb_t * cb, size_t i, void * element)
 {
     size_t read = cb->m_read;
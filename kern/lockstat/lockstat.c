@@ -0,0 +1,221 @@
+/**
+ *******************************************************************************
+ * @file    lockstat.c
+ * @author  Olli Vanhoja
+ * @brief   Lock contention statistics.
+ * @section LICENSE
+ * Copyright (c) 2026 Olli Vanhoja <olli.vanhoja@alumni.helsinki.fi>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *******************************************************************************
+ */
+
+#include <errno.h>
+#include <fs/procfs.h>
+#include <fs/procfs_dbgfile.h>
+#include <hal/core.h>
+#include <hal/hw_timers.h>
+#include <kinit.h>
+#include <kstring.h>
+#include <lockstat.h>
+#include <sys/sysctl.h>
+
+__GLOBL(__start_set_lockstat_sect);
+__GLOBL(__stop_set_lockstat_sect);
+extern struct lockstat_class __start_set_lockstat_sect;
+extern struct lockstat_class __stop_set_lockstat_sect;
+
+__GLOBL(__start_set_lockstat_site_sect);
+__GLOBL(__stop_set_lockstat_site_sect);
+extern struct lockstat_site __start_set_lockstat_site_sect;
+extern struct lockstat_site __stop_set_lockstat_site_sect;
+
+/**
+ * Set if the cycle counter is running, otherwise get_utime() is used.
+ */
+static int lockstat_cycles;
+
+static char lockstat_unit[] = "cycles";
+
+SYSCTL_DECL(_kern_lockstat);
+SYSCTL_NODE(_kern, OID_AUTO, lockstat, CTLFLAG_RW, 0,
+            "Lock contention statistics");
+
+SYSCTL_STRING(_kern_lockstat, OID_AUTO, unit, CTLFLAG_RD, lockstat_unit, 0,
+              "Unit of the wait and hold times");
+
+uint32_t lockstat_now(void)
+{
+    return (lockstat_cycles) ? core_get_cycles() : (uint32_t)get_utime();
+}
+
+static struct lockstat_site * find_site(struct lockstat_class * cls,
+                                        const char * whr)
+{
+    struct lockstat_site * min = &cls->sites[0];
+
+    for (size_t i = 0; i < LOCKSTAT_NSITES; i++) {
+        struct lockstat_site * site = &cls->sites[i];
+
+        if (site->whr == whr)
+            return site;
+        if (site->contended < min->contended)
+            min = site;
+    }
+
+    /*
+     * Replace the least contended site but keep its count so a new site
+     * can't push out a busier one before it has been seen as often.
+     */
+    min->whr = whr;
+    min->wait_total = 0;
+
+    return min;
+}
+
+void lockstat_acquired(struct lockstat_class * cls, uint32_t wait,
+                       int contended, const char * whr)
+{
+    cls->acquired++;
+    if (!contended)
+        return;
+
+    cls->contended++;
+    cls->wait_total += wait;
+    if (wait > cls->wait_max)
+        cls->wait_max = wait;
+
+    if (whr) {
+        struct lockstat_site * site = find_site(cls, whr);
+
+        site->contended++;
+        site->wait_total += wait;
+    }
+}
+
+void lockstat_released(struct lockstat_class * cls, uint32_t hold)
+{
+    cls->hold_total += hold;
+    if (hold > cls->hold_max)
+        cls->hold_max = hold;
+}
+
+static void lockstat_reset(void)
+{
+    struct lockstat_class * cls = &__start_set_lockstat_sect;
+    struct lockstat_class * stop = &__stop_set_lockstat_sect;
+
+    while (cls < stop) {
+        cls->acquired = 0;
+        cls->contended = 0;
+        cls->wait_total = 0;
+        cls->wait_max = 0;
+        cls->hold_total = 0;
+        cls->hold_max = 0;
+        for (size_t i = 0; i < LOCKSTAT_NSITES; i++) {
+            cls->sites[i].whr = NULL;
+            cls->sites[i].contended = 0;
+            cls->sites[i].wait_total = 0;
+        }
+
+        cls++;
+    }
+}
+
+static int sysctl_kern_lockstat_reset(SYSCTL_HANDLER_ARGS)
+{
+    int error;
+    int reset = 0;
+
+    error = sysctl_handle_int(oidp, &reset, sizeof(reset), req);
+    if (!error && req->newptr && reset)
+        lockstat_reset();
+
+    return error;
+}
+
+SYSCTL_PROC(_kern_lockstat, OID_AUTO, reset, CTLTYPE_INT | CTLFLAG_RW,
+            NULL, 0, sysctl_kern_lockstat_reset, "I",
+            "Write non-zero to clear the statistics");
+
+int __kinit__ lockstat_init(void)
+{
+    struct lockstat_class * cls = &__start_set_lockstat_sect;
+    struct lockstat_class * stop = &__stop_set_lockstat_sect;
+    const uint32_t start = core_get_cycles();
+
+    SUBSYS_INIT("lockstat");
+
+    for (int i = 0; i < 1000; i++) {
+        if (core_get_cycles() != start) {
+            lockstat_cycles = 1;
+            break;
+        }
+    }
+    if (!lockstat_cycles)
+        strlcpy(lockstat_unit, "us", sizeof(lockstat_unit));
+
+    while (cls < stop) {
+        *cls->lockp = cls;
+        cls++;
+    }
+
+    return 0;
+}
+
+static int read_lockstat(void * buf, size_t max, void * elem)
+{
+    struct lockstat_class * cls = elem;
+
+    return ksprintf(buf, max, "%s %u %u %llu %u %llu %u\n",
+                    cls->name, cls->acquired, cls->contended,
+                    cls->wait_total, cls->wait_max,
+                    cls->hold_total, cls->hold_max);
+}
+
+static int read_lockstat_site(void * buf, size_t max, void * elem)
+{
+    struct lockstat_site * site = elem;
+
+    if (!site->whr)
+        return 0;
+
+    return ksprintf(buf, max, "%s %u %llu %s\n",
+                    site->cls_name, site->contended, site->wait_total,
+                    site->whr);
+}
+
+static ssize_t write_lockstat(const void * buf, size_t bufsize)
+{
+    return -ENOTSUP;
+}
+
+PROCFS_DBGFILE(lockstat,
+               &__start_set_lockstat_sect,
+               &__stop_set_lockstat_sect,
+               read_lockstat, write_lockstat);
+
+PROCFS_DBGFILE(lockstat_sites,
+               &__start_set_lockstat_site_sect,
+               &__stop_set_lockstat_site_sect,
+               read_lockstat_site, write_lockstat);
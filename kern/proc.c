@@ -47,6 +47,7 @@
 #include <kmalloc.h>
 #include <kmem.h>
 #include <ksched.h>
+#include <ktrace.h>
 #include <kstring.h>
 #include <libkern.h>
 #include <mempool.h>
@@ -73,6 +74,7 @@ extern void * __bss_break __attribute__((weak));
  * This should be only touched by using macros defined in proc.h file.
  */
 mtx_t proclock = MTX_INITIALIZER(MTX_TYPE_SPIN, MTX_OPT_DINT);
+LOCKSTAT_MTX(proclock);
 
 static const char * const proc_state_names[] = {
     "PROC_STATE_INITIAL",
@@ -198,15 +200,15 @@ static void init_kernel_proc(void)
     mtx_init(&(kprocvm_heap->lock), MTX_TYPE_SPIN, 0);
 
     mtx_lock(&kernel_proc->mm.regions_lock);
-    (*kernel_proc->mm.regions)[MM_CODE_REGION] = kprocvm_code;
+    vm_set_region_locked(&kernel_proc->mm, MM_CODE_REGION, kprocvm_code);
     /*
      * proc 0 stack shouldn't be set here because NULL for
      * MM_STACK_REGION is a special case for intialization because
      * proc 1 is really not forked from the kernel but rather just
      * spawned and constructed by hand in kinit.
      */
-    (*kernel_proc->mm.regions)[MM_STACK_REGION] = NULL;
-    (*kernel_proc->mm.regions)[MM_HEAP_REGION] = kprocvm_heap;
+    vm_set_region_locked(&kernel_proc->mm, MM_STACK_REGION, NULL);
+    vm_set_region_locked(&kernel_proc->mm, MM_HEAP_REGION, kprocvm_heap);
     mtx_unlock(&kernel_proc->mm.regions_lock);
 
     /*
@@ -230,19 +232,20 @@ static void init_kernel_proc(void)
         panic(panic_msg);
     }
 
-    kernel_proc->files->fd[STDIN_FILENO] = NULL;
     /* stderr */
 #ifdef configKLOGGER
-    kernel_proc->files->fd[STDERR_FILENO] = kzalloc_crit(sizeof(file_t));
-    if (fs_fildes_set(kernel_proc->files->fd[STDERR_FILENO],
-                      &kerror_vnode, O_WRONLY)) {
-        panic(panic_msg);
+    {
+        file_t * kerror_file = kzalloc_crit(sizeof(file_t));
+
+        if (fs_fildes_set(kerror_file, &kerror_vnode, O_WRONLY) ||
+            fs_fildes_install(kernel_proc->files, STDERR_FILENO,
+                              kerror_file) ||
+            fs_fildes_install(kernel_proc->files, STDOUT_FILENO,
+                              fs_fildes_ref(kernel_proc->files,
+                                            STDERR_FILENO, 1))) {
+            panic(panic_msg);
+        }
     }
-    kernel_proc->files->fd[STDOUT_FILENO] = fs_fildes_ref(kernel_proc->files,
-                                                          STDERR_FILENO, 1);
-#else
-    kernel_proc->files->fd[STDOUT_FILENO] = NULL;
-    kernel_proc->files->fd[STDERR_FILENO] = NULL;
 #endif
 
     init_rlims(&kernel_proc->rlim);
@@ -286,7 +289,7 @@ pid_t * proc_get_pids_buffer(void)
     pid_t * buf;
 
     buf = pids_buf[isema_acquire(pids_buf_isema, num_elem(pids_buf_isema))];
-    memset(buf, 0, configMAXPROC + 1);
+    memset(buf, 0, sizeof(pids_buf[0]));
 
     return buf;
 }
@@ -379,7 +382,7 @@ void proc_free(struct proc_info * p)
 
     /* Close all file descriptors and free files struct. */
     fs_fildes_close_all(p, 0);
-    kfree(p->files);
+    fs_free_files(p->files);
 
     vm_mm_destroy(&p->mm);
 
@@ -550,6 +553,7 @@ int proc_abo_handler(const struct mmu_abo_param * restrict abo)
     const uintptr_t vaddr = abo->far;
     struct vm_mm_struct * mm;
     const char * abo_str = mmu_abo_strerror(abo);
+    int i;
     int err;
 
     KASSERT(abo, "abo must be set");
@@ -557,6 +561,7 @@ int proc_abo_handler(const struct mmu_abo_param * restrict abo)
     if (!abo->proc) {
         return -ESRCH;
     }
+    KTRACE(ABO, vaddr, abo->fsr, abo->proc->pid);
 
     KERROR_DBG("%s: MOO, (%s) %x @ %x by %d:%d\n", __func__,
                abo_str, (unsigned)vaddr, (unsigned)abo->lr,
@@ -565,28 +570,30 @@ int proc_abo_handler(const struct mmu_abo_param * restrict abo)
     mm = &abo->proc->mm;
 
     mtx_lock(&mm->regions_lock);
-    for (int i = 0; i < mm->nr_regions; i++) {
+    i = vm_find_reg_locked(mm, vaddr);
+    if (i >= 0) {
         struct buf * region = (*mm->regions)[i];
-        uintptr_t reg_start, reg_end;
         char uap[5];
 
-        if (!region)
-            continue;
-
-        reg_start = region->b_mmu.vaddr;
-        reg_end = region->b_mmu.vaddr + region->b_bufsize - 1;
-
         vm_get_uapstring(uap, region);
         KERROR_DBG("sect %d: vaddr: %x - %x paddr: %x uap: %s\n",
-                   i, (unsigned)reg_start, (unsigned)reg_end,
+                   i, (unsigned)region->b_mmu.vaddr,
+                   (unsigned)(region->b_mmu.vaddr + region->b_bufsize - 1),
                    (unsigned)region->b_mmu.paddr, uap);
 
-        if (!VM_ADDR_IS_IN_RANGE(vaddr, reg_start, reg_end))
-            continue; /* if not in range then try next region. */
+        if (MMU_ABORT_IS_TRANSLATION_FAULT(abo->fsr) &&
+            region->vm_ops->rpopulate) {
+            /*
+             * The first touch of a page of an on-demand region.
+             */
+            mtx_unlock(&mm->regions_lock);
+            err = vm_populate_region(abo->proc, region, vaddr, 1);
 
-        /*
-         * This is the correct region.
-         */
+            KERROR_DBG("%s \"%s\" of an on-demand region (%d) populated (%d)\n",
+                       mmu_abo_strtype(abo), abo_str, i, err);
+
+            return err;
+        }
 
         if (MMU_ABORT_IS_TRANSLATION_FAULT(abo->fsr)) { /* Translation fault */
             /*
@@ -88,7 +88,9 @@ static int clone_code_region(struct proc_info * new_proc,
     if (vm_reg_tmp->vm_ops->rref)
         vm_reg_tmp->vm_ops->rref(vm_reg_tmp);
 
-    (*new_proc->mm.regions)[MM_CODE_REGION] = vm_reg_tmp;
+    mtx_lock(&new_proc->mm.regions_lock);
+    vm_set_region_locked(&new_proc->mm, MM_CODE_REGION, vm_reg_tmp);
+    mtx_unlock(&new_proc->mm.regions_lock);
 
     return 0;
 }
@@ -125,7 +127,9 @@ static int clone_regions_from(struct proc_info * new_proc,
 
         /* Don't clone regions in system page table */
         if (vm_reg_tmp->b_mmu.vaddr <= configKERNEL_END) {
-            (*new_proc->mm.regions)[i] = vm_reg_tmp;
+            mtx_lock(&new_proc->mm.regions_lock);
+            vm_set_region_locked(&new_proc->mm, i, vm_reg_tmp);
+            mtx_unlock(&new_proc->mm.regions_lock);
             continue;
         }
 
@@ -174,7 +178,9 @@ static int clone_regions_from(struct proc_info * new_proc,
                 }
             }
         }
-        (*new_proc->mm.regions)[i] = vm_reg_tmp;
+        mtx_lock(&new_proc->mm.regions_lock);
+        vm_set_region_locked(&new_proc->mm, i, vm_reg_tmp);
+        mtx_unlock(&new_proc->mm.regions_lock);
 
         /*
          * Map the region to new_proc.
@@ -390,9 +396,10 @@ pid_t proc_fork(void)
         goto out;
     }
     /* Copy and ref old file descriptors */
-    for (int i = 0; i < old_proc->files->count; i++) {
-        new_proc->files->fd[i] = old_proc->files->fd[i];
-        fs_fildes_ref(new_proc->files, i, 1); /* null pointer safe */
+    retval = fs_copy_files(new_proc->files, old_proc->files);
+    if (retval) {
+        KERROR_DBG("\tFailed to copy file descriptors\n");
+        goto out;
     }
     KERROR_DBG("All file descriptors copied\n");
 
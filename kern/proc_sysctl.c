@@ -90,6 +90,45 @@ static int proc_sysctl_pids(struct sysctl_oid * oidp, struct sysctl_req * req)
     return retval;
 }
 
+/**
+ * Get kinfo_proc of all processes visible to the caller.
+ */
+static int proc_sysctl_all(struct sysctl_oid * oidp, struct sysctl_req * req)
+{
+    int retval = 0;
+    pid_t * pids;
+
+    pids = proc_get_pids_buffer();
+
+    PROC_LOCK();
+    proc_get_pids(pids);
+    PROC_UNLOCK();
+
+    for (pid_t * pid = pids; *pid != 0; pid++) {
+        struct proc_info * proc;
+        struct kinfo_proc ps;
+
+        proc = proc_ref(*pid);
+        if (!proc)
+            continue; /* The process has already exited. */
+
+        if (priv_check_cred(req->cred, &proc->cred, PRIV_PROC_STAT) ||
+            proc2pstat(&ps, proc)) {
+            proc_unref(proc);
+            continue;
+        }
+        proc_unref(proc);
+
+        retval = req->oldfunc(req, &ps, sizeof(struct kinfo_proc));
+        if (retval)
+            break;
+    }
+
+    proc_release_pids_buffer(pids);
+
+    return retval;
+}
+
 static int proc_sysctl_vmmap(struct sysctl_oid * oidp,
                              struct proc_info * proc,
                              struct sysctl_req * req)
@@ -126,6 +165,7 @@ static int proc_sysctl_vmmap(struct sysctl_oid * oidp,
             .paddr = region->b_data,
             .reg_start = region->b_mmu.vaddr,
             .reg_end = region->b_mmu.vaddr + region->b_bufsize - 1,
+            .rss = vm_region_rss(region),
             .flags = region->b_flags,
         };
         vm_get_uapstring(entry->uap, region);
@@ -148,14 +188,7 @@ static int proc_sysctl_nfds(struct sysctl_oid * oidp,
                             struct proc_info * proc,
                             struct sysctl_req * req)
 {
-    files_t * files = proc->files;
-    int nfds = 0;
-
-    for (int i = 0; i < files->count; i++) {
-        if (files->fd[i]) {
-            nfds++;
-        }
-    }
+    int nfds = fs_fildes_nr_open(proc->files);
 
     return sysctl_handle_int(oidp, NULL, nfds, req);
 }
@@ -341,6 +374,8 @@ static int proc_sysctl(SYSCTL_HANDLER_ARGS)
         } else { /* Get a single proc info */
             return proc_sysctl_pid(oidp, mib + 1, len - 1, req);
         }
+    case KERN_PROC_ALL: /* Get kinfo_proc of all processes */
+        return proc_sysctl_all(oidp, req);
     case KERN_PROC_PGRP:
         if (len >= 2) { /* Get the list of PIDs in a process group */
             return proc_sysctl_pgrp(oidp, mib + 2, len - 1, req);
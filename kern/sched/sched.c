@@ -40,6 +40,9 @@
 #include <sys/tree.h>
 #include <syscall.h>
 #include <buf.h>
+#include <fs/procfs.h>
+#include <fs/procfs_dbgfile.h>
+#include <hal/core.h>
 #include <hal/hw_timers.h>
 #include <idle.h>
 #include <kerror.h>
@@ -47,6 +50,7 @@
 #include <kmalloc.h>
 #include <kmem.h>
 #include <ksched.h>
+#include <ktrace.h>
 #include <kstring.h>
 #include <libkern.h>
 #include <proc.h>
@@ -295,6 +299,107 @@ static void sched_calc_loads(void)
 }
 TIMER_TASK(sched_calc_loads);
 
+#ifdef configSCHED_PROF
+/**
+ * Profiler sample.
+ */
+struct sched_prof_sample {
+    uintptr_t pc;
+    uintptr_t lr;
+    pid_t pid;
+    pthread_t tid;
+    int user;
+};
+
+static struct sched_prof_sample
+    sched_prof_buf[KSCHED_CPU_COUNT][configSCHED_PROF_SIZE];
+static unsigned sched_prof_head[KSCHED_CPU_COUNT];
+
+/**
+ * The thread that was running when sched_handler() was last called.
+ */
+static struct thread_info * sched_prof_thread[KSCHED_CPU_COUNT];
+
+/**
+ * Sampling rate in Hz, 0 = disabled.
+ */
+static int sched_prof_hz;
+
+/**
+ * Sample the location where the thread preempted by the scheduler timer
+ * was running.
+ * Timer tasks are run right after sched_handler() so the previous thread
+ * was preempted by the timer IRQ.
+ */
+static void sched_prof_sample(void)
+{
+    static int count;
+    const int cpu_i = get_cpu_index();
+    struct thread_info * thread = sched_prof_thread[cpu_i];
+    struct sched_prof_sample * sample;
+
+    if (sched_prof_hz == 0 || !thread)
+        return;
+
+    if (--count > 0)
+        return;
+    count = configSCHED_HZ / sched_prof_hz;
+
+    sample = &sched_prof_buf[cpu_i][sched_prof_head[cpu_i]++ %
+                                    configSCHED_PROF_SIZE];
+    sample->user = get_irq_pc(thread, &sample->pc, &sample->lr);
+    sample->pid = thread->pid_owner;
+    sample->tid = thread->id;
+}
+TIMER_TASK(sched_prof_sample);
+
+static int sysctl_sched_prof_hz(SYSCTL_HANDLER_ARGS)
+{
+    int new_hz = sched_prof_hz;
+    int error;
+
+    error = sysctl_handle_int(oidp, &new_hz, sizeof(new_hz), req);
+    if (!error && req->newptr) {
+        if (new_hz < 0 || new_hz > configSCHED_HZ)
+            return -EINVAL;
+        sched_prof_hz = new_hz;
+    }
+
+    return error;
+}
+SYSCTL_PROC(_kern_sched, OID_AUTO, prof_hz, CTLTYPE_INT | CTLFLAG_RW,
+            NULL, 0, sysctl_sched_prof_hz, "I",
+            "Profiler sampling rate, 0 = disabled.");
+
+static int read_sched_prof(void * buf, size_t max, void * elem)
+{
+    const size_t i = (struct sched_prof_sample *)elem - &sched_prof_buf[0][0];
+    struct sched_prof_sample * sample = elem;
+
+    if (sample->pc == 0)
+        return 0;
+
+    return ksprintf(buf, max, "%u %d %d %d %x %x\n",
+                    (unsigned)(i / configSCHED_PROF_SIZE), sample->pid,
+                    sample->tid, sample->user, sample->pc, sample->lr);
+}
+
+static ssize_t write_sched_prof(const void * buf, size_t bufsize)
+{
+    if (!strvalid((char *)buf, bufsize) || strcmp(buf, "clear"))
+        return -EINVAL;
+
+    memset(sched_prof_buf, 0, sizeof(sched_prof_buf));
+
+    return bufsize;
+}
+
+PROCFS_DBGFILE(sched_prof,
+               &sched_prof_buf[0][0],
+               &sched_prof_buf[KSCHED_CPU_COUNT - 1][configSCHED_PROF_SIZE],
+               read_sched_prof, write_sched_prof);
+#endif
+
 void sched_get_loads(uint32_t loads[3])
 {
     rwlock_rdlock(&loadavg_lock);
@@ -358,6 +463,10 @@ void sched_handler(void)
 
     sched_start_time = get_utime();
 
+#ifdef configSCHED_PROF
+    sched_prof_thread[get_cpu_index()] = prev_thread;
+#endif
+
     if (unlikely(!current_thread)) {
         current_thread = thread_lookup(0);
         if (!current_thread)
@@ -410,6 +519,8 @@ void sched_handler(void)
     /* Check if we need to remap the kstack. */
     if (current_thread != prev_thread) {
         mmu_map_region(&current_thread->kstack_region->b_mmu);
+        KTRACE(SCHED_SWITCH, (prev_thread) ? prev_thread->id : -1,
+               current_thread->id, 0);
     }
 
     /*
@@ -149,7 +149,7 @@ int shmem_mmap(struct proc_info * proc, uintptr_t vaddr, size_t bsize, int prot,
 
     if (flags & MAP_ANON) {
         bsize = memalign_size(bsize, MMU_PGSIZE_COARSE);
-        bp = geteblk(bsize);
+        bp = geteblk_lazy(bsize);
         if (!bp) {
             return -ENOMEM;
         }
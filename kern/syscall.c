@@ -39,6 +39,7 @@
 #include <proc.h>
 #include <hal/core.h>
 #include <kerror.h>
+#include <ktrace.h>
 #include <errno.h>
 #include <vm/vm.h>
 #include <syscall.h>
@@ -90,6 +91,7 @@ void syscall_handler(void)
     svc_getargs(&type, &pu);
     p = (__user void *)pu;
     major = SYSCALL_MAJOR(type);
+    KTRACE(SYSCALL_ENTER, type, curproc->pid, current_thread->id);
 
 
     if ((major >= num_elem(syscall_callmap)) || !syscall_callmap[major]) {
@@ -108,5 +110,6 @@ void syscall_handler(void)
     }
 
     retval = ksignal_syscall_exit(retval);
+    KTRACE(SYSCALL_EXIT, type, retval, current_thread->id);
     svc_setretval(retval);
 }
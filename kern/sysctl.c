@@ -50,6 +50,7 @@
 #include <klocks.h>
 #include <kmalloc.h>
 #include <kstring.h>
+#include <libkern.h>
 #include <proc.h>
 #include <sys/priv.h>
 #include <sys/queue.h>
@@ -72,19 +73,34 @@ SYSCTL_NODE(, 0, sysctl, CTLFLAG_RW, 0,
 /**
  * The sysctllock protects the MIB tree. It also protects sysctl contexts used
  * with dynamic sysctls. The sysctl_register_oid() and sysctl_unregister_oid()
- * routines require the sysctllock to already be held, so the sysctl_lock() and
- * sysctl_unlock() routines are provided for the few places in the kernel which
- * need to use that API rather than using the dynamic API. Use of the dynamic
- * API is strongly encouraged for most code.
+ * routines require the sysctllock to already be held exclusively. Lookups
+ * and sysctl requests only need a reader's lock, so the requests don't
+ * serialize each other.
  */
-static mtx_t sysctllock = MTX_INITIALIZER(MTX_TYPE_SPIN, 0);
-
-#define SYSCTL_LOCK()       mtx_lock(&sysctllock)
-#define SYSCTL_UNLOCK()     mtx_unlock(&sysctllock)
+static rwlock_t sysctllock = RWLOCK_INITIALIZER;
+LOCKSTAT_RWLOCK(sysctllock);
+
+#define SYSCTL_RLOCK()      rwlock_rdlock(&sysctllock)
+#define SYSCTL_RUNLOCK()    rwlock_rdunlock(&sysctllock)
+#define SYSCTL_XLOCK()      rwlock_wrlock(&sysctllock)
+#define SYSCTL_XUNLOCK()    rwlock_wrunlock(&sysctllock)
+#define SYSCTL_ASSERT_LOCKED() \
+    KASSERT(sysctllock.state != 0, "sysctllock is required")
 #define SYSCTL_ASSERT_XLOCKED() \
-    KASSERT(mtx_test(&sysctllock), "sysctllock is required")
+    KASSERT(sysctllock.state == -1, "exclusive sysctllock is required")
+
+/**
+ * Key for hashing oid names.
+ * The names are defined by the kernel so there is no need for a random key.
+ */
+static uint32_t sysctl_siphash_key[2] = { 0x7379736b, 0x63746c00 };
 
+#define SYSCTL_NHASH(nbr) \
+    ((unsigned)(nbr) & (SYSCTL_OID_HASH_SIZE - 1))
 
+
+static struct sysctl_oid * sysctl_find_oidnumber(int number,
+        struct sysctl_oid_list * list);
 static struct sysctl_oid * sysctl_find_oidname(const char * name,
         struct sysctl_oid_list * list);
 static int sysctl_sysctl_name(SYSCTL_HANDLER_ARGS);
@@ -113,14 +129,64 @@ int __kinit__ sysctl_init(void)
 
     SUBSYS_INIT("sysctl");
 
-    SYSCTL_LOCK();
+    SYSCTL_XLOCK();
     SET_FOREACH(oidp, sysctl_set)
             sysctl_register_oid(*oidp);
-    SYSCTL_UNLOCK();
+    SYSCTL_XUNLOCK();
 
     return 0;
 }
 
+static size_t sysctl_shash(const char * name)
+{
+    size_t len = strlenn(name, CTL_MAXSTRNAME);
+
+    return halfsiphash32(name, len, sysctl_siphash_key) &
+           (SYSCTL_OID_HASH_SIZE - 1);
+}
+
+static void sysctl_hash_insert(struct sysctl_oid_list * list,
+                               struct sysctl_oid * oidp)
+{
+    struct sysctl_oid ** nhead;
+    struct sysctl_oid ** shead;
+
+    nhead = &list->oidl_nhash[SYSCTL_NHASH(oidp->oid_number)];
+    shead = &list->oidl_shash[sysctl_shash(oidp->oid_name)];
+
+    oidp->oid_nhnext = *nhead;
+    *nhead = oidp;
+    oidp->oid_shnext = *shead;
+    *shead = oidp;
+}
+
+static void sysctl_hash_remove(struct sysctl_oid_list * list,
+                               struct sysctl_oid * oidp)
+{
+    struct sysctl_oid ** pp;
+
+    pp = &list->oidl_nhash[SYSCTL_NHASH(oidp->oid_number)];
+    while (*pp) {
+        if (*pp == oidp) {
+            *pp = oidp->oid_nhnext;
+            break;
+        }
+        pp = &(*pp)->oid_nhnext;
+    }
+
+    pp = &list->oidl_shash[sysctl_shash(oidp->oid_name)];
+    while (*pp) {
+        if (*pp == oidp) {
+            *pp = oidp->oid_shnext;
+            break;
+        }
+        pp = &(*pp)->oid_shnext;
+    }
+
+    oidp->oid_nhnext = NULL;
+    oidp->oid_shnext = NULL;
+}
+
 void sysctl_register_oid(struct sysctl_oid * oidp)
 {
     struct sysctl_oid_list * parent = oidp->oid_parent;
@@ -178,6 +244,7 @@ void sysctl_register_oid(struct sysctl_oid * oidp)
         SLIST_INSERT_AFTER(q, oidp, oid_link);
     else
         SLIST_INSERT_HEAD(parent, oidp, oid_link);
+    sysctl_hash_insert(parent, oidp);
 }
 
 void sysctl_unregister_oid(struct sysctl_oid * oidp)
@@ -199,6 +266,7 @@ void sysctl_unregister_oid(struct sysctl_oid * oidp)
         if (p == oidp) {
             SLIST_REMOVE(oidp->oid_parent, oidp,
                          sysctl_oid, oid_link);
+            sysctl_hash_remove(oidp->oid_parent, oidp);
             break;
         }
     }
@@ -274,9 +342,9 @@ int sysctl_remove_oid(struct sysctl_oid * oidp, int del, int recurse)
 {
     int error;
 
-    SYSCTL_LOCK();
+    SYSCTL_XLOCK();
     error = sysctl_remove_oid_locked(oidp, del, recurse);
-    SYSCTL_UNLOCK();
+    SYSCTL_XUNLOCK();
     return error;
 }
 
@@ -293,15 +361,15 @@ struct sysctl_oid * sysctl_add_oid(struct sysctl_oid_list * parent,
         return NULL;
 
     /* Check if the node already exists, otherwise create it */
-    SYSCTL_LOCK();
+    SYSCTL_XLOCK();
     oidp = sysctl_find_oidname(name, parent);
     if (oidp != NULL) {
         if ((oidp->oid_kind & CTLTYPE) == CTLTYPE_NODE) {
             oidp->oid_refcnt++;
-            SYSCTL_UNLOCK();
+            SYSCTL_XUNLOCK();
             return oidp;
         } else {
-            SYSCTL_UNLOCK();
+            SYSCTL_XUNLOCK();
             KERROR(KERROR_ERR, "Can't re-use a leaf (%s)!\n", name);
             return NULL;
         }
@@ -324,7 +392,7 @@ struct sysctl_oid * sysctl_add_oid(struct sysctl_oid_list * parent,
         oidp->oid_descr = kstrdup(descr, CTL_MAXSTRNAME);
     /* Register this oid */
     sysctl_register_oid(oidp);
-    SYSCTL_UNLOCK();
+    SYSCTL_XUNLOCK();
 
     return oidp;
 }
@@ -338,10 +406,12 @@ int sysctl_rename_oid(struct sysctl_oid * oidp, const char * name)
         return -EROFS;
 
     newname = kstrdup(name, CTL_MAXSTRNAME);
-    SYSCTL_LOCK();
+    SYSCTL_XLOCK();
     oldname = __DECONST(char *, oidp->oid_name);
+    sysctl_hash_remove(oidp->oid_parent, oidp);
     oidp->oid_name = newname;
-    SYSCTL_UNLOCK();
+    sysctl_hash_insert(oidp->oid_parent, oidp);
+    SYSCTL_XUNLOCK();
     kfree(oldname);
 
     return 0;
@@ -354,15 +424,15 @@ int sysctl_move_oid(struct sysctl_oid * oid, struct sysctl_oid_list * parent)
     if ((oid->oid_kind & CTLFLAG_DYN) == 0)
         return -EROFS;
 
-    SYSCTL_LOCK();
+    SYSCTL_XLOCK();
     if (oid->oid_parent == parent) {
-        SYSCTL_UNLOCK();
+        SYSCTL_XUNLOCK();
         return 0;
     }
 
     oidp = sysctl_find_oidname(oid->oid_name, parent);
     if (oidp != NULL) {
-        SYSCTL_UNLOCK();
+        SYSCTL_XUNLOCK();
         return -EEXIST;
     }
 
@@ -370,7 +440,7 @@ int sysctl_move_oid(struct sysctl_oid * oid, struct sysctl_oid_list * parent)
     oid->oid_parent = parent;
     oid->oid_number = OID_AUTO;
     sysctl_register_oid(oid);
-    SYSCTL_UNLOCK();
+    SYSCTL_XUNLOCK();
     return 0;
 }
 
@@ -381,14 +451,11 @@ int sysctl_find_oid(int * name, unsigned int namelen, struct sysctl_oid ** noid,
     struct sysctl_oid * oid;
     int indx;
 
-    SYSCTL_ASSERT_XLOCKED();
+    SYSCTL_ASSERT_LOCKED();
     lsp = &sysctl__children;
     indx = 0;
     while (indx < CTL_MAXNAME) {
-        SLIST_FOREACH(oid, lsp, oid_link) {
-            if (oid->oid_number == name[indx])
-                break;
-        }
+        oid = sysctl_find_oidnumber(name[indx], lsp);
         if (oid == NULL)
             return -ENOENT;
 
@@ -421,16 +488,32 @@ int sysctl_find_oid(int * name, unsigned int namelen, struct sysctl_oid ** noid,
     return -ENOENT;
 }
 
+static struct sysctl_oid * sysctl_find_oidnumber(int number,
+                                                 struct sysctl_oid_list * list)
+{
+    struct sysctl_oid * oidp;
+
+    SYSCTL_ASSERT_LOCKED();
+    oidp = list->oidl_nhash[SYSCTL_NHASH(number)];
+    while (oidp) {
+        if (oidp->oid_number == number)
+            return oidp;
+        oidp = oidp->oid_nhnext;
+    }
+    return NULL;
+}
+
 static struct sysctl_oid * sysctl_find_oidname(const char * name,
                                                struct sysctl_oid_list * list)
 {
     struct sysctl_oid * oidp;
 
-    SYSCTL_ASSERT_XLOCKED();
-    SLIST_FOREACH(oidp, list, oid_link) {
-        if (strcmp(oidp->oid_name, name) == 0) {
+    SYSCTL_ASSERT_LOCKED();
+    oidp = list->oidl_shash[sysctl_shash(name)];
+    while (oidp) {
+        if (strcmp(oidp->oid_name, name) == 0)
             return oidp;
-        }
+        oidp = oidp->oid_shnext;
     }
     return NULL;
 }
@@ -445,7 +528,7 @@ static int sysctl_sysctl_name(SYSCTL_HANDLER_ARGS)
     struct sysctl_oid_list *lsp = &sysctl__children, *lsp2;
     char buf[10];
 
-    SYSCTL_LOCK();
+    SYSCTL_RLOCK();
     while (namelen) {
         if (!lsp) {
             ksprintf(buf, sizeof(buf), "%d", *name);
@@ -460,10 +543,8 @@ static int sysctl_sysctl_name(SYSCTL_HANDLER_ARGS)
             continue;
         }
         lsp2 = 0;
-        SLIST_FOREACH(oid, lsp, oid_link) {
-            if (oid->oid_number != *name)
-                continue;
-
+        oid = sysctl_find_oidnumber(*name, lsp);
+        if (oid) {
             if (req->oldidx)
                 error = req->oldfunc(req, ".", 1);
             if (!error)
@@ -475,20 +556,14 @@ static int sysctl_sysctl_name(SYSCTL_HANDLER_ARGS)
             namelen--;
             name++;
 
-            if ((oid->oid_kind & CTLTYPE) != CTLTYPE_NODE)
-                break;
-
-            if (oid->oid_handler)
-                break;
-
-            lsp2 = SYSCTL_CHILDREN(oid);
-            break;
+            if ((oid->oid_kind & CTLTYPE) == CTLTYPE_NODE && !oid->oid_handler)
+                lsp2 = SYSCTL_CHILDREN(oid);
         }
         lsp = lsp2;
     }
     error = req->oldfunc(req, "", 1);
  out:
-    SYSCTL_UNLOCK();
+    SYSCTL_RUNLOCK();
     return error;
 }
 
@@ -501,7 +576,7 @@ static int sysctl_sysctl_next_ls(struct sysctl_oid_list * lsp, int * name,
 {
     struct sysctl_oid * oidp;
 
-    SYSCTL_ASSERT_XLOCKED();
+    SYSCTL_ASSERT_LOCKED();
     *len = level;
     SLIST_FOREACH(oidp, lsp, oid_link) {
         *next = oidp->oid_number;
@@ -564,9 +639,9 @@ static int sysctl_sysctl_next(SYSCTL_HANDLER_ARGS)
     struct sysctl_oid_list *lsp = &sysctl__children;
     int newoid[CTL_MAXNAME];
 
-    SYSCTL_LOCK();
+    SYSCTL_RLOCK();
     i = sysctl_sysctl_next_ls(lsp, name, namelen, newoid, &j, 1, &oid);
-    SYSCTL_UNLOCK();
+    SYSCTL_RUNLOCK();
     if (i)
         return -ENOENT;
     error = req->oldfunc(req, newoid, j * sizeof(int));
@@ -582,18 +657,14 @@ static int name2oid(char * name, int * oid, int * len,
     struct sysctl_oid * oidp;
     struct sysctl_oid_list * lsp = &sysctl__children;
 
-    SYSCTL_ASSERT_XLOCKED();
+    SYSCTL_ASSERT_LOCKED();
 
     for (*len = 0; *len < CTL_MAXNAME;) {
         char * p = strsep(&name, ".");
 
-        oidp = SLIST_FIRST(lsp);
-        for (;; oidp = SLIST_NEXT(oidp, oid_link)) {
-            if (oidp == NULL)
-                return -ENOENT;
-            if (strcmp(p, oidp->oid_name) == 0)
-                break;
-        }
+        oidp = sysctl_find_oidname(p, lsp);
+        if (oidp == NULL)
+            return -ENOENT;
         *oid++ = oidp->oid_number;
         (*len)++;
 
@@ -635,9 +706,9 @@ static int sysctl_sysctl_name2oid(SYSCTL_HANDLER_ARGS)
 
     p[req->newlen] = '\0';
 
-    SYSCTL_LOCK();
+    SYSCTL_RLOCK();
     error = name2oid(p, oid, &len, &op);
-    SYSCTL_UNLOCK();
+    SYSCTL_RUNLOCK();
 
     kfree(p);
 
@@ -657,7 +728,7 @@ static int sysctl_sysctl_oidfmt(SYSCTL_HANDLER_ARGS)
     struct sysctl_oid * oid;
     int error;
 
-    SYSCTL_LOCK();
+    SYSCTL_RLOCK();
     error = sysctl_find_oid(arg1, arg2, &oid, NULL, req);
     if (error)
         goto out;
@@ -672,7 +743,7 @@ static int sysctl_sysctl_oidfmt(SYSCTL_HANDLER_ARGS)
     error = req->oldfunc(req, oid->oid_fmt,
                          strlenn(oid->oid_fmt, CTL_MAXSTRNAME) + 1);
  out:
-    SYSCTL_UNLOCK();
+    SYSCTL_RUNLOCK();
     return error;
 }
 
@@ -685,7 +756,7 @@ static int sysctl_sysctl_oiddescr(SYSCTL_HANDLER_ARGS)
     struct sysctl_oid *oid;
     int error;
 
-    SYSCTL_LOCK();
+    SYSCTL_RLOCK();
     error = sysctl_find_oid(arg1, arg2, &oid, NULL, req);
     if (error)
         goto out;
@@ -697,7 +768,7 @@ static int sysctl_sysctl_oiddescr(SYSCTL_HANDLER_ARGS)
     error = req->oldfunc(req, oid->oid_descr,
                          strlenn(oid->oid_descr, CTL_MAXSTRNAME) + 1);
  out:
-    SYSCTL_UNLOCK();
+    SYSCTL_RUNLOCK();
     return error;
 }
 
@@ -1031,9 +1102,8 @@ int kernel_sysctl(struct cred * cred, int * name, unsigned int namelen,
     req.oldfunc = sysctl_old_kernel;
     req.newfunc = sysctl_new_kernel;
 
-    SYSCTL_LOCK();
+    SYSCTL_RLOCK();
     error = sysctl_root(0, name, namelen, &req);
-    SYSCTL_UNLOCK();
 
     if (error && error != -ENOMEM)
         return error;
@@ -1122,6 +1192,8 @@ static int sysctl_new_user(struct sysctl_req * req, void * p, size_t l)
 /*
  * Traverse our tree, and find the right node, execute whatever it points
  * to, and return the resulting error code.
+ * The caller must hold a reader's lock on the sysctllock, the lock is always
+ * released before returning.
  */
 
 static int sysctl_root(SYSCTL_HANDLER_ARGS)
@@ -1129,11 +1201,11 @@ static int sysctl_root(SYSCTL_HANDLER_ARGS)
     struct sysctl_oid * oid;
     int error, indx;
 
-    SYSCTL_ASSERT_XLOCKED();
+    SYSCTL_ASSERT_LOCKED();
 
     error = sysctl_find_oid(arg1, arg2, &oid, &indx, req);
     if (error)
-        return error;
+        goto out;
 
     if ((oid->oid_kind & CTLTYPE) == CTLTYPE_NODE) {
         /*
@@ -1141,8 +1213,10 @@ static int sysctl_root(SYSCTL_HANDLER_ARGS)
          * no handler.  Inform the user that it's a node.
          * The indx may or may not be the same as namelen.
          */
-        if (!oid->oid_handler)
-            return -EISDIR;
+        if (!oid->oid_handler) {
+            error = -EISDIR;
+            goto out;
+        }
     }
 
     /* Is this sysctl writable? */
@@ -1150,7 +1224,8 @@ static int sysctl_root(SYSCTL_HANDLER_ARGS)
         !(oid->oid_kind & CTLFLAG_WR ||
           (req->flags & SYSCTL_REQFLAG_KERNEL &&
            oid->oid_kind & CTLFLAG_KERWR))) {
-        return -EPERM;
+        error = -EPERM;
+        goto out;
     }
 
     /* Is this sysctl sensitive to securelevels? */
@@ -1158,7 +1233,7 @@ static int sysctl_root(SYSCTL_HANDLER_ARGS)
         int lvl = (oid->oid_kind & CTLMASK_SECURE) >> CTLSHIFT_SECURE;
         error = securelevel_gt(lvl);
         if (error)
-            return error;
+            goto out;
     }
 
     /* Is this sysctl writable by only privileged users? */
@@ -1166,11 +1241,13 @@ static int sysctl_root(SYSCTL_HANDLER_ARGS)
         !(oid->oid_kind & CTLFLAG_ANYBODY)) {
         error = priv_check(req->cred, PRIV_SYSCTL_WRITE);
         if (error)
-            return error;
+            goto out;
     }
 
-    if (!oid->oid_handler)
-        return -EINVAL;
+    if (!oid->oid_handler) {
+        error = -EINVAL;
+        goto out;
+    }
 
     if ((oid->oid_kind & CTLTYPE) == CTLTYPE_NODE) {
         arg1 = (int *)arg1 + indx;
@@ -1180,13 +1257,15 @@ static int sysctl_root(SYSCTL_HANDLER_ARGS)
         arg2 = oid->oid_arg2;
     }
 
-    /* TODO atomic */
     atomic_inc(&oid->oid_running);
-    SYSCTL_UNLOCK();
+    SYSCTL_RUNLOCK();
 
     error = oid->oid_handler(oid, arg1, arg2, req);
 
-    SYSCTL_LOCK();
+    /*
+     * The oid can't be freed before oid_running drops to zero, so there is
+     * no need to take the lock again.
+     */
     atomic_dec(&oid->oid_running);
     /* TODO */
 #if 0
@@ -1194,6 +1273,9 @@ static int sysctl_root(SYSCTL_HANDLER_ARGS)
         wakeup(&oid->oid_running);
 #endif
     return error;
+out:
+    SYSCTL_RUNLOCK();
+    return error;
 }
 
 static int userland_sysctl(const struct proc_info * proc, int * name,
@@ -1240,9 +1322,8 @@ static int userland_sysctl(const struct proc_info * proc, int * name,
     for (;;) {
         req.oldidx = 0;
         req.newidx = 0;
-        SYSCTL_LOCK();
+        SYSCTL_RLOCK();
         error = sysctl_root(0, name, namelen, &req);
-        SYSCTL_UNLOCK();
         if (error != -EAGAIN)
             break;
         thread_yield(THREAD_YIELD_IMMEDIATE);
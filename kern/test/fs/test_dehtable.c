@@ -3,82 +3,62 @@
  * @brief Test directory entry hash table.
  */
 
+#include <errno.h>
 #include <kunit.h>
+#include <kerror.h>
 #include <kmalloc.h>
+#include <kstring.h>
+#include <hal/hw_timers.h>
 #include <fs/fs.h>
 #include <fs/dehtable.h>
 
-#define get_dirent(dea, offset) ((dh_dirent_t *)((size_t)(dea) + (offset)))
-
 static dh_table_t table;
 
 static void setup(void)
 {
-    memset(table, 0, sizeof(dh_table_t));
+    dh_init(&table);
 }
 
 static void teardown(void)
 {
+    dh_destroy_all(&table);
 }
 
 static char * test_link(void)
 {
 #define str "test"
-    size_t i;
     vnode_t vnode;
-    dh_dirent_t * dea;
+    dh_dir_iter_t it;
+    dh_dirent_t * de;
 
     ku_test_description("Test that dh_link works correctly.");
 
     vnode.vn_num = 10;
-    dh_link(&table, vnode.vn_num, 0, str);
+    ku_assert_equal("Insert succeeded.",
+                    dh_link(&table, vnode.vn_num, 0, str), 0);
 
-    for (i = 0; i < DEHTABLE_SIZE; i++) {
-        if ((dea = table[i]) != 0) break;
-    }
-    ku_assert("Created chain found.", dea != 0);
+    it = dh_get_iter(&table);
+    de = dh_iter_next(&it);
+    ku_assert("Created entry found.", de != 0);
 
     ku_assert_equal("Entry has a correct vnode number.",
-                    (int)dea[0].dh_ino, (int)vnode.vn_num);
+                    (int)de->dh_ino, (int)vnode.vn_num);
+    ku_assert_str_equal("Entry has a correct name.", de->dh_name, str);
 
 #undef str
     return NULL;
 }
 
-static char * test_link_chain(void)
+static char * test_link_exist(void)
 {
-#define str1 "test"
-#define str2 "teest"
-    size_t i;
-    int res;
-    vnode_t vnode1;
-    vnode_t vnode2;
-    dh_dirent_t * dea;
-    size_t offset;
-
-    ku_test_description("Test that dh_link chaining works correctly.");
-
-    vnode1.vn_num = 10;
-    vnode2.vn_num = 11;
-
-    res = dh_link(&table, vnode1.vn_num, 0, str1);
-    ku_assert_equal("Insert succeeded.", res, 0);
-    res = dh_link(&table, vnode2.vn_num, 0, str2);
-    ku_assert_equal("Insert succeeded.", res, 0);
-
-    for (i = 0; i < DEHTABLE_SIZE; i++) {
-        if ((dea = table[i]) != 0) break;
-    }
-    ku_assert("Created chain found.", dea != 0);
+#define str "test"
+    ku_test_description("Test that dh_link doesn't create duplicates.");
 
-    ku_assert_equal("First entry has a correct vnode number.",
-                    (int)get_dirent(dea, 0)->dh_ino, (int)vnode1.vn_num);
-    offset = get_dirent(dea, 0)->dh_size;
-    ku_assert_equal("Second entry has a correct vnode number.",
-                    (int)get_dirent(dea, offset)->dh_ino, (int)vnode2.vn_num);
+    ku_assert_equal("Insert succeeded.", dh_link(&table, 1, 0, str), 0);
+    ku_assert_equal("Insert failed.", dh_link(&table, 2, 0, str), -EEXIST);
+    ku_assert_equal("One entry", (int)dh_nr_entries(&table), 1);
 
-#undef str1
-#undef str2
+#undef str
     return NULL;
 }
 
@@ -110,6 +90,30 @@ static char * test_lookup(void)
     return NULL;
 }
 
+static char * test_unlink(void)
+{
+#define str1 "file1"
+#define str2 "file2"
+    ino_t nnum;
+
+    ku_test_description("Test that dh_unlink removes only the given link.");
+
+    ku_assert_equal("Insert OK.", dh_link(&table, 1, 0, str1), 0);
+    ku_assert_equal("Insert OK.", dh_link(&table, 2, 0, str2), 0);
+
+    ku_assert_equal("Unlink OK.", dh_unlink(&table, str1), 0);
+    ku_assert_equal("Unlink fails.", dh_unlink(&table, str1), -ENOENT);
+    ku_assert_equal("Removed entry not found.",
+                    dh_lookup(&table, str1, &nnum), -ENOENT);
+    ku_assert_equal("Other entry found.", dh_lookup(&table, str2, &nnum), 0);
+    ku_assert_equal("vnode num equal.", (int)nnum, 2);
+    ku_assert_equal("One entry", (int)dh_nr_entries(&table), 1);
+
+#undef str1
+#undef str2
+    return NULL;
+}
+
 static char * test_iterator(void)
 {
 #define str1 "ff"
@@ -168,12 +172,119 @@ static char * test_iterator(void)
     return NULL;
 }
 
+static char * test_iterator_grow(void)
+{
+#define NR_ENTRIES 200
+    static uint8_t fnd_inodes[NR_ENTRIES];
+    dh_dir_iter_t it;
+    dh_dirent_t * de;
+    char name[16];
+    size_t n = 0;
+
+    ku_test_description(
+        "Test that the iterator is stable while the table grows.");
+
+    memset(fnd_inodes, 0, sizeof(fnd_inodes));
+
+    ku_assert_equal("Insert OK.", dh_link(&table, 0, 0, "0"), 0);
+
+    it = dh_get_iter(&table);
+    while ((de = dh_iter_next(&it))) {
+        ku_assert("inode number in range", de->dh_ino < NR_ENTRIES);
+        fnd_inodes[de->dh_ino]++;
+        n++;
+
+        /* Add more entries while iterating. */
+        if (n == 1) {
+            for (int i = 1; i < NR_ENTRIES; i++) {
+                ksprintf(name, sizeof(name), "%d", i);
+                ku_assert_equal("Insert OK.", dh_link(&table, i, 0, name), 0);
+            }
+        }
+    }
+
+    ku_assert_equal("Found all entries", (int)n, NR_ENTRIES);
+    for (int i = 0; i < NR_ENTRIES; i++) {
+        ku_assert_equal("Found every inode once.", (int)fnd_inodes[i], 1);
+    }
+
+#undef NR_ENTRIES
+    return NULL;
+}
+
+/**
+ * Measure link and lookup times with nr_entries entries in the table.
+ */
+static char * bench_scaling(size_t nr_entries)
+{
+    char name[16];
+    uint64_t start, t_link, t_lookup, t_unlink;
+    ino_t ino;
+
+    start = get_utime();
+    for (size_t i = 0; i < nr_entries; i++) {
+        ksprintf(name, sizeof(name), "file%u", (unsigned)i);
+        ku_assert_equal("Insert OK.", dh_link(&table, i, 0, name), 0);
+    }
+    t_link = get_utime() - start;
+
+    start = get_utime();
+    for (size_t i = 0; i < nr_entries; i++) {
+        ksprintf(name, sizeof(name), "file%u", (unsigned)i);
+        ku_assert_equal("Lookup OK.", dh_lookup(&table, name, &ino), 0);
+        ku_assert_equal("Correct ino.", (int)ino, (int)i);
+    }
+    t_lookup = get_utime() - start;
+
+    start = get_utime();
+    for (size_t i = 0; i < nr_entries; i++) {
+        ksprintf(name, sizeof(name), "file%u", (unsigned)i);
+        ku_assert_equal("Unlink OK.", dh_unlink(&table, name), 0);
+    }
+    t_unlink = get_utime() - start;
+
+    ku_assert_equal("Table empty", (int)dh_nr_entries(&table), 0);
+
+    KERROR(KERROR_INFO,
+           "dehtable %u entries: link %u us, lookup %u us, unlink %u us\n",
+           (unsigned)nr_entries, (unsigned)t_link, (unsigned)t_lookup,
+           (unsigned)t_unlink);
+
+    return NULL;
+}
+
+static char * test_scaling_100(void)
+{
+    ku_test_description("Benchmark dehtable with 100 entries.");
+
+    return bench_scaling(100);
+}
+
+static char * test_scaling_1000(void)
+{
+    ku_test_description("Benchmark dehtable with 1000 entries.");
+
+    return bench_scaling(1000);
+}
+
+static char * test_scaling_10000(void)
+{
+    ku_test_description("Benchmark dehtable with 10000 entries.");
+
+    return bench_scaling(10000);
+}
+
 static void all_tests(void)
 {
     ku_def_test(test_link, KU_RUN);
-    ku_def_test(test_link_chain, KU_SKIP);
+    ku_def_test(test_link_exist, KU_RUN);
     ku_def_test(test_lookup, KU_RUN);
+    ku_def_test(test_unlink, KU_RUN);
     ku_def_test(test_iterator, KU_RUN);
+    ku_def_test(test_iterator_grow, KU_RUN);
+    ku_def_test(test_scaling_100, KU_RUN);
+    ku_def_test(test_scaling_1000, KU_RUN);
+    ku_def_test(test_scaling_10000, KU_RUN);
 }
 
 TEST_MODULE(fs, dehtable);
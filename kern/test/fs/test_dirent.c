@@ -0,0 +1,73 @@
+/**
+ * @file test_dirent.c
+ * @brief Test packing of getdents records.
+ */
+
+#include <dirent.h>
+#include <fs/fs.h>
+#include <fs/fs_util.h>
+#include <kunit.h>
+#include <kstring.h>
+#include <libkern.h>
+
+static struct dirent buf[2];
+
+static void setup(void)
+{
+    memset(buf, 0, sizeof(buf));
+}
+
+static void teardown(void)
+{
+}
+
+static char * test_put(void)
+{
+    struct dirent * d;
+    size_t reclen, off;
+
+    ku_test_description("Test that dirents are packed by the name length.");
+
+    reclen = fs_dirent_put(buf, sizeof(buf), 5, DT_REG, "a");
+    ku_assert_equal("reclen", reclen, DIRENT_RECLEN(1));
+    ku_assert("record is short", reclen < sizeof(struct dirent));
+    ku_assert_equal("record is aligned", reclen % sizeof(ino_t), 0);
+    off = reclen;
+
+    reclen = fs_dirent_put((char *)buf + off, sizeof(buf) - off, 6, DT_DIR,
+                           "dir");
+    ku_assert_equal("reclen", reclen, DIRENT_RECLEN(3));
+
+    d = buf;
+    ku_assert_equal("ino", (int)d->d_ino, 5);
+    ku_assert_equal("type", d->d_type, DT_REG);
+    ku_assert_str_equal("name", d->d_name, "a");
+
+    d = (struct dirent *)((char *)buf + d->d_reclen);
+    ku_assert_equal("ino", (int)d->d_ino, 6);
+    ku_assert_equal("type", d->d_type, DT_DIR);
+    ku_assert_str_equal("name", d->d_name, "dir");
+
+    return NULL;
+}
+
+static char * test_full(void)
+{
+    size_t reclen;
+
+    ku_test_description("Test that an entry not fitting is not written.");
+
+    reclen = fs_dirent_put(buf, DIRENT_RECLEN(3) - 1, 1, DT_REG, "abc");
+    ku_assert_equal("didn't fit", reclen, 0);
+    ku_assert_equal("buf untouched", buf[0].d_reclen, 0);
+
+    return NULL;
+}
+
+static void all_tests(void)
+{
+    ku_def_test(test_put, KU_RUN);
+    ku_def_test(test_full, KU_RUN);
+}
+
+TEST_MODULE(fs, dirent);
@@ -0,0 +1,87 @@
+/**
+ * @file test_fdtable.c
+ * @brief Test the file descriptor table of files_t.
+ */
+
+#include <errno.h>
+#include <fs/fs.h>
+#include <kobj.h>
+#include <kunit.h>
+#include <libkern.h>
+
+#define NR_FILES 64
+
+static files_t * files;
+static file_t file[3];
+
+static void free_file(struct kobj * p)
+{
+}
+
+static void setup(void)
+{
+    files = fs_alloc_files(NR_FILES, 0);
+    for (size_t i = 0; i < num_elem(file); i++) {
+        memset(&file[i], 0, sizeof(file_t));
+        kobj_init(&file[i].f_obj, free_file);
+    }
+}
+
+static void teardown(void)
+{
+    fs_free_files(files);
+}
+
+static char * test_install(void)
+{
+    int err;
+
+    ku_test_description("Test that files are installed and found by fd.");
+
+    ku_assert("files allocated", files);
+
+    err = fs_fildes_install(files, 0, &file[0]);
+    ku_assert_equal("installed", err, 0);
+    err = fs_fildes_install(files, 0, &file[1]);
+    ku_assert_equal("fd in use", err, -EBUSY);
+    err = fs_fildes_install(files, NR_FILES, &file[1]);
+    ku_assert_equal("fd out of range", err, -EBADF);
+
+    ku_assert_ptr_equal("file found", fs_fildes_ref(files, 0, 1), &file[0]);
+    ku_assert_equal("ref taken", kobj_refcnt(&file[0].f_obj), 2);
+    ku_assert_ptr_equal("free fd not found", fs_fildes_ref(files, 1, 1), NULL);
+    ku_assert_equal("one open", fs_fildes_nr_open(files), 1);
+
+    return NULL;
+}
+
+static char * test_grow(void)
+{
+    int err;
+
+    ku_test_description("Test that the table grows on demand.");
+
+    ku_assert("files allocated", files);
+    ku_assert("table starts small", files->fdt->size < NR_FILES);
+
+    err = fs_fildes_install(files, 1, &file[0]);
+    ku_assert_equal("installed", err, 0);
+    err = fs_fildes_install(files, NR_FILES - 1, &file[1]);
+    ku_assert_equal("installed past the table", err, 0);
+    ku_assert_equal("table grown", files->fdt->size, NR_FILES);
+
+    ku_assert_ptr_equal("old fd kept", fs_fildes_ref(files, 1, 1), &file[0]);
+    ku_assert_ptr_equal("new fd found",
+                        fs_fildes_ref(files, NR_FILES - 1, 1), &file[1]);
+    ku_assert_equal("two open", fs_fildes_nr_open(files), 2);
+
+    return NULL;
+}
+
+static void all_tests(void)
+{
+    ku_def_test(test_install, KU_RUN);
+    ku_def_test(test_grow, KU_RUN);
+}
+
+TEST_MODULE(fs, fdtable);
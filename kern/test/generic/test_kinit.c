@@ -0,0 +1,62 @@
+/**
+ * @file test_kinit.c
+ * @brief Test asynchronous subsystem initializers.
+ */
+
+#include <errno.h>
+#include <kinit.h>
+#include <kunit.h>
+#include <thread.h>
+
+static int nr_runs;
+static pthread_t run_tid;
+
+static int fake_init_rest(void)
+{
+    nr_runs++;
+    run_tid = current_thread->id;
+
+    return 0;
+}
+
+static int fake_init(void)
+{
+    return -EAGAIN;
+}
+
+static void setup(void)
+{
+    nr_runs = 0;
+    run_tid = -1;
+}
+
+static void teardown(void)
+{
+}
+
+static char * test_async_dep(void)
+{
+    int err;
+
+    ku_test_description("Test that a dependency waits for an async init.");
+
+    err = kinit_async(fake_init, fake_init_rest);
+    ku_assert_equal("Init continues asynchronously", err, -EINPROGRESS);
+
+    exec_initfn(fake_init);
+    ku_assert_equal("Async part done before the dependency", nr_runs, 1);
+    ku_assert("Async part not run by the caller",
+              run_tid != current_thread->id);
+
+    kinit_async_wait();
+    ku_assert_equal("Async part run only once", nr_runs, 1);
+
+    return NULL;
+}
+
+static void all_tests(void)
+{
+    ku_def_test(test_async_dep, KU_RUN);
+}
+
+TEST_MODULE(generic, kinit);
@@ -0,0 +1,78 @@
+/**
+ * @file test_lockstat.c
+ * @brief Test lock contention statistics.
+ */
+
+#include <kunit.h>
+#include <klocks.h>
+#include <libkern.h>
+
+#ifdef configLOCK_STAT
+static mtx_t test_mtx = MTX_INITIALIZER(MTX_TYPE_SPIN, MTX_OPT_DEFAULT);
+LOCKSTAT_MTX(test_mtx);
+
+static rwlock_t test_rwlock = RWLOCK_INITIALIZER;
+LOCKSTAT_RWLOCK(test_rwlock);
+#endif
+
+static void setup(void)
+{
+}
+
+static void teardown(void)
+{
+}
+
+#ifdef configLOCK_STAT
+static char * test_mtx_counts(void)
+{
+    struct lockstat_class * cls = test_mtx.mtx_lstat;
+    uint32_t acquired, contended;
+
+    ku_assert("lock class attached", cls != NULL);
+    acquired = cls->acquired;
+    contended = cls->contended;
+
+    mtx_lock(&test_mtx);
+    ku_assert_equal("trylock fails", mtx_trylock(&test_mtx), 1);
+    mtx_unlock(&test_mtx);
+    ku_assert_equal("trylock succeeds", mtx_trylock(&test_mtx), 0);
+    mtx_unlock(&test_mtx);
+
+    ku_assert_equal("acquisitions counted", cls->acquired, acquired + 2);
+    ku_assert_equal("no contention", cls->contended, contended);
+
+    return NULL;
+}
+
+static char * test_rwlock_counts(void)
+{
+    struct lockstat_class * cls = test_rwlock.rw_lstat;
+    uint32_t acquired;
+
+    ku_assert("lock class attached", cls != NULL);
+    acquired = cls->acquired;
+
+    rwlock_rdlock(&test_rwlock);
+    ku_assert_equal("tryrdlock succeeds", rwlock_tryrdlock(&test_rwlock), 0);
+    ku_assert("trywrlock fails", rwlock_trywrlock(&test_rwlock) != 0);
+    rwlock_rdunlock(&test_rwlock);
+    rwlock_rdunlock(&test_rwlock);
+    rwlock_wrlock(&test_rwlock);
+    rwlock_wrunlock(&test_rwlock);
+
+    ku_assert_equal("acquisitions counted", cls->acquired, acquired + 3);
+
+    return NULL;
+}
+#endif
+
+static void all_tests(void)
+{
+#ifdef configLOCK_STAT
+    ku_def_test(test_mtx_counts, KU_RUN);
+    ku_def_test(test_rwlock_counts, KU_RUN);
+#endif
+}
+
+TEST_MODULE(generic, lockstat);
@@ -146,6 +146,38 @@ static char * test_queue_is_not_empty(void)
     return NULL;
 }
 
+static char * test_queue_push_pop_n(void)
+{
+    int in[] = { 1, 2, 3, 4, 5, 6 };
+    int out[6];
+    int expected[] = { 3, 4, 5, 6 };
+    size_t n;
+
+    n = queue_push_n(&queue, in, 3);
+    ku_assert_equal("Three elements pushed", (int)n, 3);
+    ku_assert_equal("Count is three", (int)queue_count(&queue), 3);
+
+    n = queue_pop_n(&queue, out, 2);
+    ku_assert_equal("Two elements popped", (int)n, 2);
+    ku_assert_equal("First element", out[0], 1);
+    ku_assert_equal("Second element", out[1], 2);
+
+    /* Wraps around the end of the array. */
+    n = queue_push_n(&queue, in + 3, 3);
+    ku_assert_equal("Three elements pushed", (int)n, 3);
+    ku_assert_equal("Queue is full", (int)queue_space(&queue), 0);
+
+    n = queue_push_n(&queue, in, 1);
+    ku_assert_equal("Push to a full queue", (int)n, 0);
+
+    n = queue_pop_n(&queue, out, num_elem(out));
+    ku_assert_equal("Four elements popped", (int)n, 4);
+    ku_assert_array_equal("Elements popped in order", out, expected, 4);
+    ku_assert("Queue is empty", queue_isempty(&queue) != 0);
+
+    return NULL;
+}
+
 static void all_tests(void)
 {
     ku_def_test(test_queue_single_push, KU_RUN);
@@ -157,6 +189,7 @@ static void all_tests(void)
     ku_def_test(test_queue_alloc, KU_RUN);
     ku_def_test(test_queue_is_empty, KU_RUN);
     ku_def_test(test_queue_is_not_empty, KU_RUN);
+    ku_def_test(test_queue_push_pop_n, KU_RUN);
 }
 
 TEST_MODULE(generic, queue);
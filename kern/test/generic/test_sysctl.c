@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <sys/sysctl.h>
 #include <kunit.h>
 #include <libkern.h>
@@ -30,9 +31,47 @@ static char * test_add_rem_oid(void)
     return NULL;
 }
 
+static char * test_lookup_oid(void)
+{
+    struct sysctl_oid * oidp;
+    int value = 0;
+    size_t len = sizeof(value);
+    int retval;
+
+    integer = 5;
+    oidp = sysctl_add_oid(&SYSCTL_NODE_CHILDREN(, debug),
+                          "unittest", CTLTYPE_INT | CTLFLAG_RW, &integer, 0,
+                          sysctl_handle_int, "I", "Integer");
+    ku_assert("OID created", oidp != NULL);
+
+    retval = kernel_sysctlbyname(NULL, "debug.unittest", &value, &len,
+                                 NULL, 0, NULL, 0);
+    ku_assert_equal("OID found by name", retval, 0);
+    ku_assert_equal("Value read", value, 5);
+
+    retval = sysctl_rename_oid(oidp, "unittest2");
+    ku_assert_equal("OID renamed", retval, 0);
+
+    retval = kernel_sysctlbyname(NULL, "debug.unittest", &value, &len,
+                                 NULL, 0, NULL, 0);
+    ku_assert_equal("Old name not found", retval, -ENOENT);
+
+    value = 0;
+    retval = kernel_sysctlbyname(NULL, "debug.unittest2", &value, &len,
+                                 NULL, 0, NULL, 0);
+    ku_assert_equal("OID found by the new name", retval, 0);
+    ku_assert_equal("Value read", value, 5);
+
+    retval = sysctl_remove_oid(oidp, 1, 0);
+    ku_assert_equal("OID removed", retval, 0);
+
+    return NULL;
+}
+
 static void all_tests(void)
 {
     ku_def_test(test_add_rem_oid, KU_RUN);
+    ku_def_test(test_lookup_oid, KU_RUN);
 }
 
 TEST_MODULE(generic, sysctl);
@@ -62,6 +62,32 @@ static char * test_getblk(void)
     return NULL;
 }
 
+static char * test_vinval(void)
+{
+    vnode_t * vndev;
+    struct buf * bp;
+    struct proc_info * proc;
+
+    ku_test_description("Test that bio_vinval() frees released buffers.");
+
+    proc = proc_ref(0);
+    proc_unref(proc);
+
+    ku_assert("lookup failed",
+               !lookup_vnode(&vndev, proc->croot, "dev/zero",
+                             O_RDWR));
+    bp = getblk(vndev, 1, 4096, 0);
+    ku_assert("got a buffer", bp);
+    bp->b_flags |= B_CACHE;
+    brelse(bp);
+    ku_assert("buffer is cached", incore(vndev, 1) == bp);
+
+    bio_vinval(vndev);
+    ku_assert("buffer was freed", incore(vndev, 1) == NULL);
+
+    return NULL;
+}
+
 static char * test_bread(void)
 {
     vnode_t * vndev;
@@ -93,6 +119,7 @@ static void all_tests(void)
 {
     ku_def_test(test_geteblk, KU_RUN);
     ku_def_test(test_getblk, KU_RUN);
+    ku_def_test(test_vinval, KU_RUN);
     ku_def_test(test_bread, KU_SKIP);
 }
 
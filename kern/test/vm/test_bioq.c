@@ -0,0 +1,143 @@
+/**
+ * @file test_bioq.c
+ * @brief Test block I/O request queues.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <bioq.h>
+#include <buf.h>
+#include <fs/devfs.h>
+#include <kunit.h>
+#include <kstring.h>
+#include <libkern.h>
+
+#define BLOCK_SIZE 512
+
+static int nr_reads;
+static int fail_reads;
+static int last_oflags;
+
+static ssize_t fake_read(struct dev_info * devnfo, off_t blkno,
+                         uint8_t * buf, size_t bcount, int oflags)
+{
+    last_oflags = oflags;
+    if (fail_reads > 0) {
+        fail_reads--;
+        return -EIO;
+    }
+
+    for (size_t i = 0; i < bcount; i++) {
+        buf[i] = (uint8_t)(blkno + i / BLOCK_SIZE);
+    }
+    nr_reads++;
+
+    return bcount;
+}
+
+static ssize_t fake_write(struct dev_info * devnfo, off_t blkno,
+                          uint8_t * buf, size_t bcount, int oflags)
+{
+    return bcount;
+}
+
+static struct dev_info fake_dev = {
+    .dev_name = "ku_bioq",
+    .flags = DEV_FLAGS_MB_READ | DEV_FLAGS_MB_WRITE,
+    .block_size = BLOCK_SIZE,
+    .num_blocks = 64,
+    .read = fake_read,
+    .write = fake_write,
+};
+
+static void setup(void)
+{
+    nr_reads = 0;
+    fail_reads = 0;
+    last_oflags = 0;
+}
+
+static void teardown(void)
+{
+}
+
+static char * test_merge(void)
+{
+    struct buf * bp[3];
+    int err;
+
+    ku_test_description("Test that adjacent requests are merged.");
+
+    /* The queue lives as long as the device. */
+    if (!fake_dev.bioq) {
+        err = bioq_create(&fake_dev);
+        ku_assert_equal("Queue created", err, 0);
+    }
+
+    bioq_plug(fake_dev.bioq);
+    for (int i = 2; i >= 0; i--) {
+        bp[i] = geteblk(BLOCK_SIZE);
+        ku_assert("Got a buffer", bp[i]);
+        bp[i]->b_qblkno = 10 + i;
+        bp[i]->b_flags &= ~B_DONE;
+        bp[i]->b_flags |= B_READ;
+        bioq_enqueue(fake_dev.bioq, bp[i]);
+    }
+    bioq_unplug(fake_dev.bioq);
+
+    for (int i = 0; i < 3; i++) {
+        err = biowait(bp[i]);
+        ku_assert_equal("No error", err, 0);
+        ku_assert_equal("Data was read",
+                        ((uint8_t *)bp[i]->b_data)[0], 10 + i);
+        ku_assert_equal("Data was read",
+                        ((uint8_t *)bp[i]->b_data)[BLOCK_SIZE - 1], 10 + i);
+    }
+    ku_assert_equal("A single transfer", nr_reads, 1);
+
+    for (int i = 0; i < 3; i++) {
+        brelse(bp[i]);
+    }
+
+    return NULL;
+}
+
+static char * test_retry(void)
+{
+    struct buf * bp;
+    int err;
+
+    ku_test_description("Test that a failed request is retried with oflags.");
+
+    if (!fake_dev.bioq) {
+        err = bioq_create(&fake_dev);
+        ku_assert_equal("Queue created", err, 0);
+    }
+
+    bp = geteblk(BLOCK_SIZE);
+    ku_assert("Got a buffer", bp);
+    bp->b_qblkno = 20;
+    bp->b_file.oflags = O_RDWR | O_SYNC;
+    bp->b_flags &= ~B_DONE;
+    bp->b_flags |= B_READ;
+
+    fail_reads = DEV_RW_MAX_TRIES - 1;
+    bioq_enqueue(fake_dev.bioq, bp);
+    err = biowait(bp);
+    ku_assert_equal("No error", err, 0);
+    ku_assert_equal("All tries used", fail_reads, 0);
+    ku_assert_equal("Data was read", ((uint8_t *)bp->b_data)[0], 20);
+    ku_assert_equal("oflags passed", last_oflags, (O_RDWR | O_SYNC));
+
+    brelse(bp);
+
+    return NULL;
+}
+
+static void all_tests(void)
+{
+    ku_def_test(test_merge, KU_RUN);
+    ku_def_test(test_retry, KU_RUN);
+}
+
+TEST_MODULE(vm, bioq);
@@ -0,0 +1,103 @@
+/**
+ * @file test_regions.c
+ * @brief Test the region index of vm_mm_struct.
+ */
+
+#include <buf.h>
+#include <kmalloc.h>
+#include <kunit.h>
+#include <libkern.h>
+#include <vm/vm.h>
+
+static struct vm_mm_struct mm;
+static struct buf bufs[4];
+
+static void setup(void)
+{
+    const uintptr_t vaddr[] = { 0x300000, 0x100000, 0x200000, 0x500000 };
+
+    memset(&mm, 0, sizeof(mm));
+    memset(bufs, 0, sizeof(bufs));
+    mm.regions_hit = -1;
+    realloc_mm_regions(&mm, num_elem(bufs));
+
+    for (size_t i = 0; i < num_elem(bufs); i++) {
+        bufs[i].b_mmu.vaddr = vaddr[i];
+        bufs[i].b_bufsize = 0x1000;
+    }
+}
+
+static void teardown(void)
+{
+    kfree(mm.regions);
+    kfree(mm.regions_sorted);
+}
+
+static char * test_find(void)
+{
+    ku_test_description("Test that regions are found by address.");
+
+    ku_assert("regions array allocated", mm.regions && mm.regions_sorted);
+
+    mtx_lock(&mm.regions_lock);
+    for (size_t i = 0; i < num_elem(bufs); i++) {
+        vm_set_region_locked(&mm, i, &bufs[i]);
+    }
+    ku_assert_equal("all regions indexed", mm.nr_sorted, num_elem(bufs));
+
+    ku_assert_equal("found region 1",
+                    vm_find_reg_locked(&mm, 0x100000), 1);
+    ku_assert_equal("found region 0",
+                    vm_find_reg_locked(&mm, 0x300fff), 0);
+    ku_assert_equal("found region 3",
+                    vm_find_reg_locked(&mm, 0x500800), 3);
+    ku_assert_equal("found region 3 again",
+                    vm_find_reg_locked(&mm, 0x500000), 3);
+    ku_assert_equal("gap not found", vm_find_reg_locked(&mm, 0x301000), -1);
+    ku_assert_equal("below all not found",
+                    vm_find_reg_locked(&mm, 0x0fffff), -1);
+    ku_assert_equal("above all not found",
+                    vm_find_reg_locked(&mm, 0x600000), -1);
+    mtx_unlock(&mm.regions_lock);
+
+    return NULL;
+}
+
+static char * test_replace(void)
+{
+    ku_test_description("Test that the index follows region changes.");
+
+    mtx_lock(&mm.regions_lock);
+    for (size_t i = 0; i < num_elem(bufs); i++) {
+        vm_set_region_locked(&mm, i, &bufs[i]);
+    }
+
+    ku_assert_equal("found region 2",
+                    vm_find_reg_locked(&mm, 0x200000), 2);
+    vm_set_region_locked(&mm, 2, NULL);
+    ku_assert_equal("region removed", mm.nr_sorted, num_elem(bufs) - 1);
+    ku_assert_equal("removed region not found",
+                    vm_find_reg_locked(&mm, 0x200000), -1);
+
+    bufs[2].b_mmu.vaddr = 0x400000;
+    vm_set_region_locked(&mm, 2, &bufs[2]);
+    ku_assert_equal("moved region found",
+                    vm_find_reg_locked(&mm, 0x400010), 2);
+    ku_assert_equal("region 0 still found",
+                    vm_find_reg_locked(&mm, 0x300010), 0);
+
+    vm_set_region_locked(&mm, 0, &bufs[0]);
+    ku_assert_equal("replacing doesn't duplicate",
+                    mm.nr_sorted, num_elem(bufs));
+    mtx_unlock(&mm.regions_lock);
+
+    return NULL;
+}
+
+static void all_tests(void)
+{
+    ku_def_test(test_find, KU_RUN);
+    ku_def_test(test_replace, KU_RUN);
+}
+
+TEST_MODULE(vm, regions);
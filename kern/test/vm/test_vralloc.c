@@ -0,0 +1,106 @@
+/**
+ * @file test_vralloc.c
+ * @brief Test on-demand populated vralloc regions.
+ */
+
+#include <errno.h>
+#include <buf.h>
+#include <kunit.h>
+#include <libkern.h>
+#include <vm/vm.h>
+
+#define NR_PAGES 4
+
+static struct buf * bp;
+
+static void setup(void)
+{
+    bp = NULL;
+}
+
+static void teardown(void)
+{
+    if (bp && bp->vm_ops->rfree)
+        bp->vm_ops->rfree(bp);
+}
+
+static char * test_populate(void)
+{
+    const uintptr_t vaddr = 0x100000;
+    uint8_t * page;
+
+    ku_test_description("Test that pages are allocated and zeroed on populate.");
+
+    bp = geteblk_lazy(NR_PAGES * MMU_PGSIZE_COARSE);
+    ku_assert("A new buffer was returned", bp);
+    ku_assert("rpopulate is set", bp->vm_ops->rpopulate);
+    ku_assert_equal("Nothing resident", vm_region_rss(bp), 0);
+    ku_assert_equal("No page allocated", vr_pageaddr(bp, 2), 0);
+
+    bp->b_mmu.vaddr = vaddr;
+    ku_assert_equal("Page populated",
+                    bp->vm_ops->rpopulate(bp, NULL,
+                                          vaddr + 2 * MMU_PGSIZE_COARSE + 8),
+                    0);
+    page = (uint8_t *)vr_pageaddr(bp, 2);
+    ku_assert("Page allocated", page);
+    ku_assert_equal("Other pages not allocated", vr_pageaddr(bp, 1), 0);
+    ku_assert_equal("Page was zeroed", page[0], 0);
+    ku_assert_equal("Page was zeroed", page[MMU_PGSIZE_COARSE - 1], 0);
+    ku_assert_equal("One page resident", vm_region_rss(bp), MMU_PGSIZE_COARSE);
+
+    page[0] = 0xa5;
+    ku_assert_equal("Populated again",
+                    bp->vm_ops->rpopulate(bp, NULL,
+                                          vaddr + 2 * MMU_PGSIZE_COARSE), 0);
+    ku_assert("Same page", (uint8_t *)vr_pageaddr(bp, 2) == page);
+    ku_assert_equal("A populated page is not zeroed again", page[0], 0xa5);
+    ku_assert_equal("Still one page resident",
+                    vm_region_rss(bp), MMU_PGSIZE_COARSE);
+
+    ku_assert_equal("Out of region",
+                    bp->vm_ops->rpopulate(bp, NULL,
+                                          vaddr + NR_PAGES * MMU_PGSIZE_COARSE),
+                    -EFAULT);
+
+    return NULL;
+}
+
+static char * test_rclone(void)
+{
+    const uintptr_t vaddr = 0x100000;
+    struct buf * clone;
+    uint8_t * page;
+
+    ku_test_description("Test that a clone copies only populated pages.");
+
+    bp = geteblk_lazy(NR_PAGES * MMU_PGSIZE_COARSE);
+    ku_assert("A new buffer was returned", bp);
+    bp->b_mmu.vaddr = vaddr;
+
+    bp->vm_ops->rpopulate(bp, NULL, vaddr + MMU_PGSIZE_COARSE);
+    ((uint8_t *)vr_pageaddr(bp, 1))[0] = 0x5a;
+
+    clone = bp->vm_ops->rclone(bp);
+    ku_assert("Region cloned", clone);
+    ku_assert_equal("Same resident size",
+                    vm_region_rss(clone), MMU_PGSIZE_COARSE);
+    page = (uint8_t *)vr_pageaddr(clone, 1);
+    ku_assert("Page allocated", page);
+    ku_assert("Page not shared", page != (uint8_t *)vr_pageaddr(bp, 1));
+    ku_assert_equal("Data copied", page[0], 0x5a);
+    ku_assert_equal("Unpopulated page not allocated", vr_pageaddr(clone, 0), 0);
+    ku_assert("Clone is populated on-demand", clone->vm_ops->rpopulate);
+
+    clone->vm_ops->rfree(clone);
+
+    return NULL;
+}
+
+static void all_tests(void)
+{
+    ku_def_test(test_populate, KU_RUN);
+    ku_def_test(test_rclone, KU_RUN);
+}
+
+TEST_MODULE(vm, vralloc);
@@ -55,45 +55,154 @@
 
 extern mmu_region_t mmu_region_kernel;
 
-__kernel void * vm_uaddr2kaddr(struct proc_info * proc,
-                               __user const void * uaddr,
-                               size_t acc_size)
+/**
+ * Max size of a user copy that can take the fast path.
+ */
+#define COPY_FAST_MAX 64
+
+/**
+ * Test if a user range of len bytes starting from uaddr is within a page.
+ */
+#define COPY_IN_PAGE(uaddr, len) \
+    (((uaddr) & (MMU_PGSIZE_COARSE - 1)) + (len) <= MMU_PGSIZE_COARSE)
+
+static int test_ap_user(uint32_t rw, struct buf * bp);
+static uintptr_t useracc_end(struct buf * region);
+static size_t useracc_chunk(struct proc_info * proc, uintptr_t uaddr, int rw,
+                            struct buf ** region);
+
+/**
+ * Get kernel accessible address from user space address in a known region.
+ * @param region is the region of uaddr or NULL if not known.
+ */
+static void * region_uaddr2kaddr(struct proc_info * proc, struct buf * region,
+                                 uintptr_t uaddr, size_t acc_size)
 {
     struct vm_pt * vpt;
-    void * phys_uaddr;
 
-    vpt = ptlist_get_pt(&proc->mm, (uintptr_t)uaddr, acc_size, VM_PT_CREAT);
+    /*
+     * Pages of an on-demand region must be populated before the kernel can
+     * access them.
+     */
+    if (region && vm_populate_region(proc, region, uaddr, acc_size))
+        return NULL;
+
+    vpt = ptlist_get_pt(&proc->mm, uaddr, acc_size, VM_PT_CREAT);
     if (!vpt)
         return NULL;
 
-    phys_uaddr = mmu_translate_vaddr(&vpt->pt, (uintptr_t)uaddr);
+    return mmu_translate_vaddr(&vpt->pt, uaddr);
+}
+
+__kernel void * vm_uaddr2kaddr(struct proc_info * proc,
+                               __user const void * uaddr,
+                               size_t acc_size)
+{
+    struct buf * region;
+
+    if (vm_find_reg(proc, (uintptr_t)uaddr, &region) < 0)
+        region = NULL;
 
-    return phys_uaddr;
+    return region_uaddr2kaddr(proc, region, (uintptr_t)uaddr, acc_size);
 }
 
-int copyin(__user const void * uaddr, __kernel void * kaddr, size_t len)
+/**
+ * Try to resolve a small user range using the region last found in the
+ * process.
+ * @return Returns a kernel pointer to uaddr if the whole range is accessible
+ *         in the cached region; Otherwise NULL and the slow path must be
+ *         taken.
+ */
+static inline void * copy_fast_kaddr(struct proc_info * proc,
+                                     uintptr_t uaddr, size_t len, int rw)
 {
-    return copyin_proc(curproc, uaddr, kaddr, len);
+    struct vm_mm_struct * mm = &proc->mm;
+    struct buf * region = NULL;
+    int hit;
+
+    if (len > COPY_FAST_MAX || len == 0 || uaddr == 0)
+        return NULL;
+
+    mtx_lock(&mm->regions_lock);
+    hit = mm->regions_hit;
+    if (hit >= 0 && hit < mm->nr_regions)
+        region = (*mm->regions)[hit];
+    mtx_unlock(&mm->regions_lock);
+
+    if (!region || uaddr < region->b_mmu.vaddr ||
+        uaddr + len - 1 > useracc_end(region) ||
+        (region->b_pages && !COPY_IN_PAGE(uaddr, len)) ||
+        ((rw & VM_PROT_WRITE) && (region->b_uflags & VM_PROT_COW)) ||
+        !test_ap_user(rw, region))
+        return NULL;
+
+    return region_uaddr2kaddr(proc, region, uaddr, len);
 }
 
-int copyin_proc(struct proc_info * proc, __user const void * uaddr,
-                __kernel void * kaddr, size_t len)
+/**
+ * Copy between kernel and user space one region at a time.
+ * @param rw is VM_PROT_READ to copy from uaddr to kaddr and VM_PROT_WRITE to
+ *           copy from kaddr to uaddr.
+ */
+static int copy_user(struct proc_info * proc, uintptr_t uaddr,
+                     uint8_t * kaddr, size_t len, int rw)
 {
     void * phys_uaddr;
 
-    if (!useracc_proc(uaddr, len, proc, VM_PROT_READ)) {
+    if (!uaddr)
         return -EFAULT;
+
+    phys_uaddr = copy_fast_kaddr(proc, uaddr, len, rw);
+    if (phys_uaddr) {
+        if (rw & VM_PROT_WRITE)
+            memcpy(phys_uaddr, kaddr, len);
+        else
+            memcpy(kaddr, phys_uaddr, len);
+        return 0;
     }
 
-    phys_uaddr = vm_uaddr2kaddr(proc, uaddr, len);
-    if (!phys_uaddr) {
-        return -EFAULT;
+    while (len > 0) {
+        struct buf * region;
+        size_t n;
+
+        n = useracc_chunk(proc, uaddr, rw, &region);
+        if (n == 0)
+            return -EFAULT;
+        if (n > len)
+            n = len;
+        if (region->b_pages && !COPY_IN_PAGE(uaddr, n)) {
+            /* The pages of an on-demand region are scattered. */
+            n = MMU_PGSIZE_COARSE - (uaddr & (MMU_PGSIZE_COARSE - 1));
+        }
+
+        phys_uaddr = region_uaddr2kaddr(proc, region, uaddr, n);
+        if (!phys_uaddr)
+            return -EFAULT;
+
+        if (rw & VM_PROT_WRITE)
+            memcpy(phys_uaddr, kaddr, n);
+        else
+            memcpy(kaddr, phys_uaddr, n);
+
+        uaddr += n;
+        kaddr += n;
+        len -= n;
     }
 
-    memcpy(kaddr, phys_uaddr, len);
     return 0;
 }
 
+int copyin(__user const void * uaddr, __kernel void * kaddr, size_t len)
+{
+    return copyin_proc(curproc, uaddr, kaddr, len);
+}
+
+int copyin_proc(struct proc_info * proc, __user const void * uaddr,
+                __kernel void * kaddr, size_t len)
+{
+    return copy_user(proc, (uintptr_t)uaddr, kaddr, len, VM_PROT_READ);
+}
+
 int copyout(__kernel const void * kaddr, __user void * uaddr, size_t len)
 {
     return copyout_proc(curproc, kaddr, uaddr, len);
@@ -103,19 +212,8 @@ int copyout_proc(struct proc_info * proc, __kernel const void * kaddr,
                  __user void * uaddr, size_t len)
 {
     /* TODO Handle possible cow flag? */
-    void * phys_uaddr;
-
-    if (!useracc_proc(uaddr, len, proc, VM_PROT_WRITE)) {
-        return -EFAULT;
-    }
-
-    phys_uaddr = vm_uaddr2kaddr(proc, uaddr, len);
-    if (!phys_uaddr) {
-        return -EFAULT;
-    }
-
-    memcpy(phys_uaddr, kaddr, len);
-    return 0;
+    return copy_user(proc, (uintptr_t)uaddr, (uint8_t *)kaddr, len,
+                     VM_PROT_WRITE);
 }
 
 int copyinstr(__user const char * uaddr, __kernel char * kaddr, size_t len,
@@ -204,34 +302,122 @@ int copyoutstr(__kernel char * kaddr, __user const char * uaddr, size_t len,
     return 0;
 }
 
+/**
+ * Get the region at position pos of the sorted region index.
+ */
+static inline struct buf * sorted_reg(struct vm_mm_struct * mm, int pos)
+{
+    return (*mm->regions)[mm->regions_sorted[pos]];
+}
+
+/**
+ * Find the last position in the sorted region index with vaddr <= addr.
+ * @return Returns the position or -1 if all regions start above addr.
+ */
+static int sorted_find(struct vm_mm_struct * mm, uintptr_t addr)
+{
+    int lo = 0;
+    int hi = mm->nr_sorted;
+
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+
+        if (sorted_reg(mm, mid)->b_mmu.vaddr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo - 1;
+}
+
+static int reg_contains(struct buf * region, uintptr_t uaddr)
+{
+    /*
+     * TODO Would be good idea to use region size instead of mmu alloc size
+     *      but before that it has to be fixed everywhere in the codebase.
+     */
+    const uintptr_t reg_start = region->b_mmu.vaddr;
+    const uintptr_t reg_end = region->b_mmu.vaddr + region->b_bufsize - 1;
+
+    return VM_ADDR_IS_IN_RANGE(uaddr, reg_start, reg_end);
+}
+
+int vm_find_reg_locked(struct vm_mm_struct * mm, uintptr_t uaddr)
+{
+    const int hit = mm->regions_hit;
+
+    KASSERT(mtx_test(&mm->regions_lock), "mm should be locked\n");
+
+    if (hit >= 0 && hit < mm->nr_regions && (*mm->regions)[hit] &&
+        reg_contains((*mm->regions)[hit], uaddr))
+        return hit;
+
+    /*
+     * Regions don't overlap so only the last region starting at or below
+     * uaddr can contain it, unless there are empty regions at the same
+     * address.
+     */
+    for (int pos = sorted_find(mm, uaddr); pos >= 0; pos--) {
+        const int i = mm->regions_sorted[pos];
+        struct buf * region = (*mm->regions)[i];
+
+        if (reg_contains(region, uaddr)) {
+            mm->regions_hit = i;
+            return i;
+        }
+        if (region->b_bufsize > 0)
+            break;
+    }
+
+    return -1;
+}
+
 int vm_find_reg(struct proc_info * proc, uintptr_t uaddr, struct buf ** bp)
 {
-    struct buf * region = NULL;
     struct vm_mm_struct * mm = &proc->mm;
-    uintptr_t reg_start, reg_end;
+    int i;
 
     mtx_lock(&mm->regions_lock);
-    for (int i = 0; i < mm->nr_regions; i++) {
-        region = (*mm->regions)[i];
-        if (!region)
-            continue;
+    i = vm_find_reg_locked(mm, uaddr);
+    if (i >= 0)
+        *bp = (*mm->regions)[i];
+    mtx_unlock(&mm->regions_lock);
 
-        /*
-         * TODO Would be good idea to use region size instead of mmu alloc size
-         *      but before that it has to be fixed everywhere in the codebase.
-         */
-        reg_start = region->b_mmu.vaddr;
-        reg_end = region->b_mmu.vaddr + region->b_bufsize - 1;
+    return i;
+}
 
-        if (VM_ADDR_IS_IN_RANGE(uaddr, reg_start, reg_end)) {
-            mtx_unlock(&mm->regions_lock);
-            *bp = region;
-            return i;
+void vm_set_region_locked(struct vm_mm_struct * mm, int region_nr,
+                          struct buf * region)
+{
+    int * sorted = mm->regions_sorted;
+    int pos;
+
+    KASSERT(mtx_test(&mm->regions_lock), "mm should be locked\n");
+    KASSERT(region_nr >= 0 && region_nr < mm->nr_regions,
+            "region_nr out of bounds\n");
+
+    if ((*mm->regions)[region_nr]) {
+        for (pos = 0; pos < mm->nr_sorted; pos++) {
+            if (sorted[pos] == region_nr)
+                break;
         }
+        KASSERT(pos < mm->nr_sorted, "region not indexed\n");
+
+        mm->nr_sorted--;
+        memmove(sorted + pos, sorted + pos + 1,
+                (mm->nr_sorted - pos) * sizeof(int));
     }
-    mtx_unlock(&mm->regions_lock);
 
-    return -1;
+    (*mm->regions)[region_nr] = region;
+
+    if (region) {
+        pos = sorted_find(mm, region->b_mmu.vaddr) + 1;
+        memmove(sorted + pos + 1, sorted + pos,
+                (mm->nr_sorted - pos) * sizeof(int));
+        sorted[pos] = region_nr;
+        mm->nr_sorted++;
+    }
 }
 
 struct buf * vm_newsect(uintptr_t vaddr, size_t size, int prot)
@@ -260,54 +446,62 @@ struct buf * vm_newsect(uintptr_t vaddr, size_t size, int prot)
 }
 
 /**
- * Check whether a new address range is overlapping an existing mapping.
+ * Find the first free section aligned address range at or above addr.
  * @note mm must be locked.
+ * @return Returns the address of the range; 0 if there is no space left.
  */
-static bool is_overlaping_current_regions(
-    struct vm_mm_struct * mm,
-    uintptr_t vaddr,
-    size_t size)
+static uintptr_t find_gap(struct vm_mm_struct * mm, uintptr_t addr,
+                          size_t size)
 {
-    const size_t nr_regions = mm->nr_regions;
-    const uintptr_t newreg_end = vaddr + size - 1;
-
-    for (size_t i = 0; i < nr_regions; i++) {
-        struct buf * bp = (*mm->regions)[i];
-        if (!bp)
-            continue;
+    const uintptr_t align = MMU_PGSIZE_SECTION;
+    const uintptr_t addr_max = configUSER_VM_MAX;
+    int pos = sorted_find(mm, addr);
 
-        const uintptr_t reg_start = bp->b_mmu.vaddr;
-        const uintptr_t reg_end = bp->b_mmu.vaddr + bp->b_bufsize - 1;
+    addr = (addr + align - 1) & ~(align - 1);
+    for (pos = (pos < 0) ? 0 : pos; pos < mm->nr_sorted; pos++) {
+        struct buf * region = sorted_reg(mm, pos);
+        const uintptr_t reg_start = region->b_mmu.vaddr;
+        const uintptr_t reg_end = reg_start + region->b_bufsize;
 
-        if (VM_RANGE_IS_OVERLAPPING(reg_start, reg_end,
-                                    vaddr, newreg_end)) {
-            return true;
-        }
+        if (addr > addr_max)
+            return 0;
+        if (reg_start > addr && reg_start - addr >= size)
+            break;
+        if (reg_end > addr)
+            addr = (reg_end + align - 1) & ~(align - 1);
     }
 
-    return false;
+    if (addr < align || addr > addr_max || size - 1 > addr_max - addr)
+        return 0;
+
+    return addr;
 }
 
 /**
  * Get a free random address in mem space of proc and ensure it's mappable.
+ * The first free range at or above a random address is selected.
  * @note mm must be locked.
+ * @return Returns the address; 0 if there is no space left.
  */
 static uintptr_t rnd_addr(struct vm_mm_struct * mm, size_t size)
 {
     const size_t bits = NBITS(MMU_PGSIZE_SECTION);
     const uintptr_t addr_min = configEXEC_BASE_LIMIT;
     const uintptr_t addr_max = configUSER_VM_MAX;
+    uintptr_t vaddr;
+    int wrapped = 0;
 
     KASSERT(mtx_test(&mm->regions_lock), "mm should be locked\n");
 
+    vaddr = addr_min +
+            (kunirand((addr_max >> bits) - (addr_min >> bits)) << bits);
     do {
-        uintptr_t vaddr;
-        vaddr = addr_min +
-                (kunirand((addr_max >> bits) - (addr_min >> bits)) << bits);
-        vaddr &= ~(MMU_PGSIZE_COARSE - 1);
-
-        /* TODO What if there is no space left? */
-        if (is_overlaping_current_regions(mm, vaddr, size)) {
+        vaddr = find_gap(mm, vaddr, size);
+        if (!vaddr) {
+            if (wrapped)
+                return 0;
+            wrapped = 1;
+            vaddr = addr_min;
             continue;
         }
 
@@ -315,11 +509,10 @@ static uintptr_t rnd_addr(struct vm_mm_struct * mm, size_t size)
          * Create the page tables early to ensure it's possible to map the
          * selected address range.
          */
-        if (!ptlist_get_pt(mm, vaddr, size, VM_PT_CREAT)) {
-            continue;
-        }
+        if (ptlist_get_pt(mm, vaddr, size, VM_PT_CREAT))
+            return vaddr;
 
-        return vaddr;
+        vaddr += MMU_PGSIZE_SECTION;
     } while (true);
 }
 
@@ -337,6 +530,8 @@ struct buf * vm_rndsect(struct proc_info * proc, size_t size, int prot,
     mtx_lock(&proc->mm.regions_lock);
     vaddr = rnd_addr(&proc->mm, size);
     mtx_unlock(&proc->mm.regions_lock);
+    if (!vaddr)
+        return NULL;
 
     if (old_bp) {
         bp = old_bp;
@@ -362,12 +557,18 @@ struct buf * vm_new_userstack_curproc(size_t size)
     struct buf * vmstack;
     uintptr_t vaddr;
 
-    vmstack = geteblk(size);
+    vmstack = geteblk_lazy(size);
     if (!vmstack)
         return NULL;
 
     mtx_lock(&curproc->mm.regions_lock);
     vaddr = rnd_addr(&curproc->mm, vmstack->b_bufsize);
+    if (!vaddr) {
+        mtx_unlock(&curproc->mm.regions_lock);
+        if (vmstack->vm_ops->rfree)
+            vmstack->vm_ops->rfree(vmstack);
+        return NULL;
+    }
 
     vmstack->b_uflags = VM_PROT_READ | VM_PROT_WRITE;
     vmstack->b_mmu.vaddr = vaddr;
@@ -453,6 +654,9 @@ int vm_mm_init(struct vm_mm_struct * mm, int nr_regions)
     mm->mpt.nr_tables = 1;
     mm->mpt.pt_type = MMU_PTT_MASTER;
     mm->mpt.pt_dom = MMU_DOM_USER;
+    /* A forked mm must never share the ASID of its parent. */
+    mm->asid = (struct mmu_asid){ 0 };
+    mm->mpt.pt_asid = &mm->asid;
 
     if (ptmapper_alloc(&mm->mpt))
         return -ENOMEM;
@@ -460,6 +664,9 @@ int vm_mm_init(struct vm_mm_struct * mm, int nr_regions)
     /* Allocate an array for regions. */
     mm->regions = NULL;
     mm->nr_regions = 0;
+    mm->regions_sorted = NULL;
+    mm->nr_sorted = 0;
+    mm->regions_hit = -1;
     realloc_mm_regions(mm, nr_regions);
     if (!mm->regions)
         return -ENOMEM;
@@ -493,6 +700,9 @@ void vm_mm_destroy(struct vm_mm_struct * mm)
         /* Free regions array. */
         kfree(mm->regions);
         mm->regions = NULL;
+        kfree(mm->regions_sorted);
+        mm->regions_sorted = NULL;
+        mm->nr_sorted = 0;
     }
 
     /* Free the mpt. */
@@ -503,6 +713,7 @@ void vm_mm_destroy(struct vm_mm_struct * mm)
 static int realloc_mm_regions_locked(struct vm_mm_struct * mm, int new_count)
 {
     struct buf * (*new_regions)[];
+    int * new_sorted;
     int i = mm->nr_regions;
 
     KERROR_DBG("realloc_mm_regions(mm %p, new_count %d), old %d\n",
@@ -516,6 +727,11 @@ static int realloc_mm_regions_locked(struct vm_mm_struct * mm, int new_count)
         return 0;
     }
 
+    new_sorted = krealloc(mm->regions_sorted, new_count * sizeof(int));
+    if (!new_sorted)
+        return -ENOMEM;
+    mm->regions_sorted = new_sorted;
+
     new_regions = krealloc(mm->regions, new_count * sizeof(struct buf *));
     if (!new_regions)
         return -ENOMEM;
@@ -573,11 +789,13 @@ static int vm_insert_region_ref(struct vm_mm_struct * mm, struct buf * region)
 
         slot = nr_regions;
         err = realloc_mm_regions_locked(mm, nr_regions + 1);
-        if (err)
+        if (err) {
+            mtx_unlock(&mm->regions_lock);
             return err;
+        }
     }
 
-    (*mm->regions)[slot] = region;
+    vm_set_region_locked(mm, slot, region);
     mtx_unlock(&mm->regions_lock);
 
     return slot;
@@ -619,7 +837,7 @@ int vm_replace_region(struct proc_info * proc, struct buf * region,
 
     mtx_lock(&mm->regions_lock);
     old_region = (*mm->regions)[region_nr];
-    (*mm->regions)[region_nr] = NULL;
+    vm_set_region_locked(mm, region_nr, NULL);
     mtx_unlock(&mm->regions_lock);
 
     if (old_region) {
@@ -661,7 +879,7 @@ int vm_replace_region(struct proc_info * proc, struct buf * region,
     }
 
     mtx_lock(&mm->regions_lock);
-    (*mm->regions)[region_nr] = region;
+    vm_set_region_locked(mm, region_nr, region);
     mtx_unlock(&mm->regions_lock);
 
     if (region) {
@@ -698,6 +916,51 @@ int vm_mapproc_region(struct proc_info * proc, struct buf * region)
     return vm_map_region(region, vpt);
 }
 
+int vm_populate_region(struct proc_info * proc, struct buf * region,
+                       uintptr_t uaddr, size_t len)
+{
+    const uintptr_t rend = region->b_mmu.vaddr + region->b_bufsize;
+    struct vm_pt * vpt;
+    uintptr_t end;
+
+    if (!region->vm_ops->rpopulate || len == 0)
+        return 0;
+
+    vpt = ptlist_get_pt(&proc->mm, region->b_mmu.vaddr,
+                        region->b_bufsize, VM_PT_CREAT);
+    if (!vpt)
+        return -ENOMEM;
+
+    end = (len > rend - uaddr) ? rend : uaddr + len;
+    for (uintptr_t page = uaddr & ~(MMU_PGSIZE_COARSE - 1); page < end;
+         page += MMU_PGSIZE_COARSE) {
+        int err;
+
+        if (mmu_translate_vaddr(&vpt->pt, page))
+            continue; /* Already populated and mapped. */
+
+        err = region->vm_ops->rpopulate(region, vpt, page);
+        if (err)
+            return err;
+    }
+
+    return 0;
+}
+
+size_t vm_region_rss(struct buf * region)
+{
+    size_t rss;
+
+    if (!region->b_pages)
+        return region->b_data ? region->b_bufsize : 0;
+
+    mtx_lock(&region->lock);
+    rss = region->b_rss * MMU_PGSIZE_COARSE;
+    mtx_unlock(&region->lock);
+
+    return rss;
+}
+
 int vm_unmapproc_region(struct proc_info * proc, struct buf * region)
 {
     struct vm_pt * vpt;
@@ -887,42 +1150,71 @@ int useracc(__user const void * addr, size_t len, int rw)
     return useracc_proc(addr, len, curproc, rw);
 }
 
-int useracc_proc(__user const void * addr, size_t len, struct proc_info * proc,
-                 int rw)
+static uintptr_t useracc_end(struct buf * region)
 {
-    /* TODO Currently we don't allow addr + len to span over multiple regions */
-
-    struct buf * region;
-    uintptr_t uaddr, start, end;
-
-    if (addr == NULL)
-        return 0;
-
-    uaddr = (uintptr_t)addr;
-    if (vm_find_reg(proc, uaddr, &region) == -1)
-        return 0;
-
-    start = region->b_mmu.vaddr;
+    size_t size;
 
     /*
      * Unfortunately sometimes the b_count is invalid.
      */
     if (unlikely(region->b_bcount == 0)) {
         /* TODO and this is probably wrong too */
-        end = mmu_sizeof_region(&region->b_mmu);
+        size = mmu_sizeof_region(&region->b_mmu);
     } else {
-        end = region->b_bcount;
+        size = region->b_bcount;
     }
-    end += region->b_mmu.vaddr - 1;
+
+    return region->b_mmu.vaddr + size - 1;
+}
+
+static size_t useracc_chunk(struct proc_info * proc, uintptr_t uaddr, int rw,
+                            struct buf ** regionp)
+{
+    struct buf * region;
+    uintptr_t end;
+
+    if (vm_find_reg(proc, uaddr, &region) == -1)
+        return 0;
+    if (regionp)
+        *regionp = region;
+
+    end = useracc_end(region);
+    if (!VM_ADDR_IS_IN_RANGE(uaddr, region->b_mmu.vaddr, end))
+        return 0;
 
     if ((rw & VM_PROT_WRITE) && (region->b_uflags & VM_PROT_COW)) {
         /* FIXME We should inform the called */
         KERROR(KERROR_WARN, "VMPROT_WRITE tested for COW region\n");
     }
 
-    if (VM_ADDR_IS_IN_RANGE(uaddr, start, end))
-        return test_ap_user(rw, region);
-    return 0;
+    if (!test_ap_user(rw, region))
+        return 0;
+
+    return end - uaddr + 1;
+}
+
+int useracc_proc(__user const void * addr, size_t len, struct proc_info * proc,
+                 int rw)
+{
+    uintptr_t uaddr = (uintptr_t)addr;
+
+    if (addr == NULL)
+        return 0;
+
+    /*
+     * The range may span over multiple consecutive regions.
+     */
+    do {
+        const size_t n = useracc_chunk(proc, uaddr, rw, NULL);
+
+        if (n == 0)
+            return 0;
+        if (n >= len)
+            return 1;
+
+        uaddr += n;
+        len -= n;
+    } while (1);
 }
 
 void vm_get_uapstring(char str[5], struct buf * bp)
@@ -166,6 +166,7 @@ struct vm_pt * ptlist_get_pt(struct vm_mm_struct * mm, uintptr_t vaddr,
 
         vpt->pt.vaddr = MMU_CPT_VADDR(vaddr);
         vpt->pt.master_pt_addr = mpt->pt_addr;
+        vpt->pt.pt_asid = mpt->pt_asid;
 
         /* Insert vpt (L2 page table) to the process. */
         RB_INSERT(ptlist, ptlist_head, vpt);
@@ -212,6 +213,7 @@ static struct vm_pt * vm_pt_clone_attach(struct vm_pt * old_vpt,
     new_vpt->pt.vaddr = old_vpt->pt.vaddr;
     new_vpt->pt.nr_tables = old_vpt->pt.nr_tables;
     new_vpt->pt.master_pt_addr = mpt->pt_addr;
+    new_vpt->pt.pt_asid = mpt->pt_asid;
     new_vpt->pt.pt_dom = old_vpt->pt.pt_dom;
 
     mmu_ptcpy(&new_vpt->pt, &old_vpt->pt);
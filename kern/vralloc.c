@@ -87,11 +87,16 @@ struct vregion {
 static struct vregion * vreg_alloc_node(size_t count);
 static void vrref(struct buf * region);
 static struct buf * vr_rclone(struct buf * old_region);
+static struct buf * vr_lazy_rclone(struct buf * old_region);
+static int vr_lazy_mmap(struct buf * region, struct vm_pt * pt);
+static int vr_lazy_populate(struct buf * region, struct vm_pt * pt,
+                            uintptr_t vaddr);
 
 /** List of all allocations done by vralloc. */
 static LIST_HEAD(vrlisthead, vregion) vrlist_head =
     LIST_HEAD_INITIALIZER(vrlisthead);
 static mtx_t vr_big_lock = MTX_INITIALIZER(MTX_TYPE_TICKET, MTX_OPT_DINT);
+LOCKSTAT_MTX(vr_big_lock);
 
 SYSCTL_DECL(_vm_vralloc);
 SYSCTL_NODE(_vm, OID_AUTO, vralloc, CTLFLAG_RW, 0,
@@ -115,6 +120,17 @@ static const vm_ops_t vra_ops = {
     .rmmap = vrmmap,
 };
 
+/**
+ * VRA operations for on-demand populated vm regions.
+ */
+static const vm_ops_t vra_lazy_ops = {
+    .rref = vrref,
+    .rclone = vr_lazy_rclone,
+    .rfree = vrfree,
+    .rmmap = vr_lazy_mmap,
+    .rpopulate = vr_lazy_populate,
+};
+
 
 /**
  * Initializes vregion allocator data structures.
@@ -215,14 +231,12 @@ out:
 }
 
 /**
- * vregion free callback.
- * This function is called by kobj.
+ * Release pcount pages starting from kaddr back to vreg.
+ * The vregion node is freed if it becomes empty.
  */
-static void vreg_free_callback(struct kobj * obj)
+static void vreg_unreserve(struct vregion * vreg, uintptr_t kaddr,
+                           size_t pcount)
 {
-    struct buf * bp = containerof(obj, struct buf, b_obj);
-    struct vregion * vreg = (struct vregion *)(bp->allocator_data);
-    const size_t bcount = VREG_PCOUNT(bp->b_bufsize);
     size_t iblock;
     int err;
 
@@ -233,13 +247,13 @@ static void vreg_free_callback(struct kobj * obj)
 #endif
 
     /* Get the iblock no. */
-    iblock = VREG_ADDR2I(vreg, bp->b_data);
+    iblock = VREG_ADDR2I(vreg, kaddr);
 
-    err = bitmap_block_update(vreg->map, 0, iblock, bcount, vreg->size);
+    err = bitmap_block_update(vreg->map, 0, iblock, pcount, vreg->size);
     KASSERT(err == 0, "vreg map update OOB");
-    vreg->count -= bcount;
+    vreg->count -= pcount;
 
-    vralloc_used -= bp->b_bufsize; /* Update stats */
+    vralloc_used -= VREG_BYTESIZE(pcount); /* Update stats */
 
     if (vreg->count == 0) { /* Free the vregion node */
         LIST_REMOVE(vreg, _entry);
@@ -252,11 +266,78 @@ static void vreg_free_callback(struct kobj * obj)
     } else {
         mtx_unlock(&vr_big_lock);
     }
+}
 
+/**
+ * vregion free callback.
+ * This function is called by kobj.
+ */
+static void vreg_free_callback(struct kobj * obj)
+{
+    struct buf * bp = containerof(obj, struct buf, b_obj);
+    struct vregion * vreg = (struct vregion *)(bp->allocator_data);
+
+    vreg_unreserve(vreg, bp->b_data, VREG_PCOUNT(bp->b_bufsize));
     kfree(bp);
 }
 
-struct buf * geteblk(size_t size)
+/**
+ * Allocate a single page for an on-demand region.
+ * @return Returns the kernel address of the page; Otherwise 0.
+ */
+static uintptr_t vr_allocpage(void)
+{
+    struct vregion * vreg;
+    size_t iblock;
+
+    vreg = get_iblocks(&iblock, 1);
+    if (!vreg)
+        return 0;
+
+    return VREG_I2ADDR(vreg, iblock);
+}
+
+/**
+ * Free a page allocated with vr_allocpage().
+ */
+static void vr_freepage(uintptr_t kaddr)
+{
+    struct vregion * vreg;
+
+    mtx_lock(&vr_big_lock);
+    LIST_FOREACH(vreg, &vrlist_head, _entry) {
+        if (kaddr >= vreg->kaddr &&
+            kaddr < vreg->kaddr + VREG_BYTESIZE(vreg->size * 8))
+            break;
+    }
+    mtx_unlock(&vr_big_lock);
+    KASSERT(vreg, "page must belong to a vregion");
+
+    /* The page itself keeps the node alive. */
+    vreg_unreserve(vreg, kaddr, 1);
+}
+
+/**
+ * On-demand vregion free callback.
+ * This function is called by kobj.
+ */
+static void vr_lazy_free_callback(struct kobj * obj)
+{
+    struct buf * bp = containerof(obj, struct buf, b_obj);
+
+    for (size_t i = 0; i < bp->b_mmu.num_pages; i++) {
+        if (bp->b_pages[i])
+            vr_freepage(bp->b_pages[i]);
+    }
+
+    kfree(bp->b_pages);
+    kfree(bp);
+}
+
+/**
+ * Allocate a new vregion buffer without clearing it.
+ */
+static struct buf * vr_getblk(size_t size)
 {
     size_t iblock; /* Block index of the allocation */
     const size_t orig_size = size;
@@ -295,12 +376,74 @@ struct buf * geteblk(size_t size)
     bp->b_uflags = VM_PROT_READ | VM_PROT_WRITE;
     vm_updateusr_ap(bp);
 
+    return bp;
+}
+
+struct buf * geteblk(size_t size)
+{
+    struct buf * bp;
+
+    bp = vr_getblk(size);
+    if (!bp)
+        return NULL;
+
     /* Clear allocated pages. */
     memset((void *)bp->b_data, 0, bp->b_bufsize);
 
     return bp;
 }
 
+struct buf * geteblk_lazy(size_t size)
+{
+    const size_t orig_size = size;
+    size = memalign_size(size, MMU_PGSIZE_COARSE);
+    const size_t pcount = VREG_PCOUNT(size);
+    struct buf * bp;
+
+    bp = kzalloc(sizeof(struct buf));
+    if (!bp) {
+        KERROR_DBG("%s: Can't allocate vm_region struct\n", __func__);
+        return NULL;
+    }
+
+    /* Pages are allocated and cleared when populated. */
+    bp->b_pages = kzalloc(pcount * sizeof(uintptr_t));
+    if (!bp->b_pages) {
+        kfree(bp);
+        return NULL;
+    }
+
+    mtx_init(&bp->lock, MTX_TYPE_TICKET, 0);
+
+    /* b_data and b_mmu.paddr are left unset as the pages are scattered. */
+    bp->b_mmu.num_pages = pcount;
+    bp->b_bufsize = VREG_BYTESIZE(pcount);
+    bp->b_bcount = orig_size;
+    bp->b_flags = B_BUSY;
+    kobj_init(&bp->b_obj, vr_lazy_free_callback);
+    bp->vm_ops = &vra_lazy_ops;
+    bp->b_uflags = VM_PROT_READ | VM_PROT_WRITE;
+    vm_updateusr_ap(bp);
+
+    return bp;
+}
+
+uintptr_t vr_pageaddr(struct buf * bp, size_t i)
+{
+    uintptr_t kaddr;
+
+    KASSERT(i < bp->b_mmu.num_pages, "page index OOB");
+
+    if (!bp->b_pages)
+        return bp->b_data ? bp->b_data + VREG_BYTESIZE(i) : 0;
+
+    mtx_lock(&bp->lock);
+    kaddr = bp->b_pages[i];
+    mtx_unlock(&bp->lock);
+
+    return kaddr;
+}
+
 /**
  * Increment reference count of a vr allocated vm_region.
  * @param region is a pointer to the vregion.
@@ -353,6 +496,56 @@ static struct buf * vr_rclone(struct buf * old_region)
     return new_region;
 }
 
+/**
+ * Clone an on-demand vregion.
+ * Only the populated pages are copied and the rest of the pages of the new
+ * region are left to be populated on-demand.
+ */
+static struct buf * vr_lazy_rclone(struct buf * old_region)
+{
+    struct buf * new_region;
+    const size_t rsize = old_region->b_bufsize;
+
+    new_region = geteblk_lazy(rsize);
+    if (!new_region) {
+        KERROR(KERROR_ERR, "%s: Out of memory, tried to allocate %d bytes\n",
+               __func__, (unsigned)rsize);
+        return NULL;
+    }
+
+    mtx_lock(&old_region->lock);
+    for (size_t i = 0; i < old_region->b_mmu.num_pages; i++) {
+        uintptr_t kaddr;
+
+        if (!old_region->b_pages[i])
+            continue;
+
+        kaddr = vr_allocpage();
+        if (!kaddr) {
+            mtx_unlock(&old_region->lock);
+            KERROR(KERROR_ERR, "%s: Out of memory while copying pages\n",
+                   __func__);
+            vrfree(new_region);
+            return NULL;
+        }
+
+        memcpy((void *)kaddr, (void *)old_region->b_pages[i],
+               MMU_PGSIZE_COARSE);
+        new_region->b_pages[i] = kaddr;
+        new_region->b_rss++;
+    }
+    mtx_unlock(&old_region->lock);
+
+    new_region->b_uflags = ~(VM_PROT_COW | VM_PROT_COR) & old_region->b_uflags;
+    new_region->b_mmu.vaddr = old_region->b_mmu.vaddr;
+    new_region->b_mmu.ap = old_region->b_mmu.ap;
+    new_region->b_mmu.control = old_region->b_mmu.control;
+    new_region->b_mmu.pt = old_region->b_mmu.pt;
+    vm_updateusr_ap(new_region);
+
+    return new_region;
+}
+
 void allocbuf(struct buf * bp, size_t size)
 {
     const size_t orig_size = size;
@@ -363,6 +556,7 @@ void allocbuf(struct buf * bp, size_t size)
     size_t bcount = VREG_PCOUNT(bp->b_bufsize);
     struct vregion * vreg = bp->allocator_data;
 
+    KASSERT(!bp->b_pages, "on-demand regions can't be resized");
     KASSERT(vreg, "bp->allocator_data should be always set");
 
     if (bp->b_bufsize == new_size)
@@ -455,6 +649,93 @@ int vrmmap(struct buf * region, struct vm_pt * pt)
     return mmu_map_region(&mmu_region);
 }
 
+/**
+ * Map the populated pages of an on-demand vregion.
+ * The rest of the pages are mapped by vr_lazy_populate() on the first touch.
+ */
+static int vr_lazy_mmap(struct buf * region, struct vm_pt * pt)
+{
+    const uintptr_t * pages = region->b_pages;
+    const size_t num_pages = region->b_mmu.num_pages;
+    mmu_region_t mmu_region;
+    size_t i = 0;
+    int err = 0;
+
+    vm_updateusr_ap(region);
+    mtx_lock(&region->lock);
+
+    while (i < num_pages) {
+        size_t n = 1;
+
+        if (!pages[i]) {
+            i++;
+            continue;
+        }
+
+        /* Map physically contiguous pages with a single call. */
+        while (i + n < num_pages &&
+               pages[i + n] == pages[i] + VREG_BYTESIZE(n)) {
+            n++;
+        }
+
+        mmu_region = region->b_mmu;
+        mmu_region.vaddr += VREG_BYTESIZE(i);
+        mmu_region.paddr = pages[i];
+        mmu_region.num_pages = n;
+        mmu_region.pt = &(pt->pt);
+
+        err = mmu_map_region(&mmu_region);
+        if (err)
+            break;
+        i += n;
+    }
+
+    mtx_unlock(&region->lock);
+
+    return err;
+}
+
+static int vr_lazy_populate(struct buf * region, struct vm_pt * pt,
+                            uintptr_t vaddr)
+{
+    mmu_region_t mmu_region;
+    size_t i;
+
+    if (vaddr < region->b_mmu.vaddr ||
+        vaddr - region->b_mmu.vaddr >= region->b_bufsize)
+        return -EFAULT;
+    i = VREG_PCOUNT(vaddr - region->b_mmu.vaddr);
+
+    vm_updateusr_ap(region);
+    mtx_lock(&region->lock);
+
+    if (!region->b_pages[i]) {
+        const uintptr_t kaddr = vr_allocpage();
+
+        if (!kaddr) {
+            mtx_unlock(&region->lock);
+            return -ENOMEM;
+        }
+
+        memset((void *)kaddr, 0, MMU_PGSIZE_COARSE);
+        region->b_pages[i] = kaddr;
+        region->b_rss++;
+    }
+
+    mmu_region = region->b_mmu;
+    mmu_region.vaddr += VREG_BYTESIZE(i);
+    mmu_region.paddr = region->b_pages[i];
+    mmu_region.num_pages = 1;
+
+    mtx_unlock(&region->lock);
+
+    if (!pt)
+        return 0;
+
+    mmu_region.pt = &(pt->pt);
+    return mmu_map_region(&mmu_region);
+}
+
 int clone2vr(struct buf * src, struct buf ** out)
 {
     struct buf * new;
@@ -462,7 +743,8 @@ int clone2vr(struct buf * src, struct buf ** out)
     KASSERT(src != NULL, "src arg must be set");
     KASSERT(out != NULL, "out arg must be set");
 
-    if (src->vm_ops == &vra_ops && src->vm_ops->rclone) {
+    if ((src->vm_ops == &vra_ops || src->vm_ops == &vra_lazy_ops) &&
+        src->vm_ops->rclone) {
         /* If the buffer is vrallocated already we can just call rclone(). */
         new = src->vm_ops->rclone(src);
         if (!new) {
@@ -36,19 +36,23 @@
 
 struct dirent * readdir(DIR * dirp)
 {
-    int count;
+    struct dirent * d;
+
+    if (dirp->dd_loc >= dirp->dd_count) {
+        int count;
 
-    if (dirp->dd_count == 0 || dirp->dd_loc >= dirp->dd_count) {
         count = getdents(dirp->dd_fd, (char *)(dirp->dd_buf),
                          member_size(DIR, dd_buf));
+        if (count <= 0)
+            return NULL;
+
         dirp->dd_count = count;
         dirp->dd_loc = 0;
-    } else {
-        count = dirp->dd_count;
     }
 
-    if (count <= 0)
-        return NULL;
+    /* dd_count and dd_loc are in bytes as the entries vary in length. */
+    d = (struct dirent *)((char *)dirp->dd_buf + dirp->dd_loc);
+    dirp->dd_loc += d->d_reclen;
 
-    return &dirp->dd_buf[dirp->dd_loc++];
+    return d;
 }
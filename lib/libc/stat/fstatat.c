@@ -44,7 +44,7 @@ int fstatat(int fd, const char * restrict path,
         .path = path,
         .path_len = strlen(path) + 1,
         .buf = buf,
-        .flags = AT_FDARG | flag
+        .flags = (fd == AT_FDCWD) ? flag : AT_FDARG | flag
     };
 
     return syscall(SYSCALL_FS_STAT, &args);
@@ -38,6 +38,7 @@
 
 static struct _proc_getbreak_args ds_brk;
 static void * curr_break;
+static void * max_break; /* Highest break set so far. */
 
 static int getbrk(void)
 {
@@ -55,6 +56,7 @@ static int getbrk(void)
             return -1;
         }
         curr_break = ds_brk.start;
+        max_break = ds_brk.start;
 
         if (ds_brk.start == 0)
             return -1;
@@ -63,10 +65,25 @@ static int getbrk(void)
     return 0;
 }
 
-int brk(void * addr)
+/*
+ * The kernel gives the break area zeroed, so only the memory that was
+ * released by lowering the break needs to be cleared when it's reused.
+ */
+static void set_break(void * addr)
 {
-    intptr_t alloc_size;
+    if (addr > curr_break && curr_break < max_break) {
+        void * end = (addr < max_break) ? addr : max_break;
+
+        memset(curr_break, 0, (size_t)((char *)end - (char *)curr_break));
+    }
+    if (addr > max_break)
+        max_break = addr;
+
+    curr_break = addr;
+}
 
+int brk(void * addr)
+{
     if (getbrk())
         return -1;
 
@@ -75,11 +92,7 @@ int brk(void * addr)
         return -1;
     }
 
-    alloc_size = ((intptr_t)addr - (intptr_t)curr_break);
-    if (alloc_size > 0)
-        memset(curr_break, 0, (size_t)alloc_size);
-
-    curr_break = addr;
+    set_break(addr);
     return 0;
 }
 
@@ -99,9 +112,6 @@ void * sbrk(intptr_t incr)
         return (void *)-1;
     }
 
-    if (incr > 0)
-        memset(old_break, 0, (size_t)incr);
-
-    curr_break = new_break;
+    set_break(new_break);
     return old_break;
 }
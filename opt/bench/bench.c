@@ -0,0 +1,82 @@
+/**
+ * @file bench.c
+ * @brief Helpers for userspace benchmarks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bench.h"
+
+uint64_t bench_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_samples(const void * a, const void * b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+void bench_report(const char * name, uint64_t * samples, size_t n,
+                  const char * unit)
+{
+    qsort(samples, n, sizeof(uint64_t), cmp_samples);
+    printf("bench,%s,%u,%llu,%llu,%llu,%s\n", name, (unsigned)n,
+           (unsigned long long)samples[0],
+           (unsigned long long)samples[n / 2],
+           (unsigned long long)samples[(n * 99) / 100],
+           unit);
+    fflush(stdout);
+}
+
+void bench_latency(const char * name, bench_fn_t * fn, void * arg,
+                   size_t batch)
+{
+    uint64_t samples[BENCH_SAMPLES];
+
+    fn(arg); /* Warm up. */
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        uint64_t start = bench_time_ns();
+
+        for (size_t j = 0; j < batch; j++) {
+            fn(arg);
+        }
+        samples[i] = (bench_time_ns() - start) / batch;
+    }
+
+    bench_report(name, samples, BENCH_SAMPLES, "ns");
+}
+
+void bench_throughput(const char * name, bench_fn_t * fn, void * arg,
+                      size_t bytes)
+{
+    uint64_t samples[BENCH_SAMPLES];
+
+    fn(arg); /* Warm up. */
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        uint64_t start = bench_time_ns();
+        uint64_t elapsed;
+
+        fn(arg);
+        elapsed = bench_time_ns() - start;
+        if (elapsed == 0)
+            elapsed = 1;
+        samples[i] = ((uint64_t)bytes * 1000000000ull / 1024) / elapsed;
+    }
+
+    bench_report(name, samples, BENCH_SAMPLES, "KiB/s");
+}
+
+void bench_fail(const char * msg)
+{
+    perror(msg);
+    exit(EXIT_FAILURE);
+}
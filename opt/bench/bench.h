@@ -0,0 +1,60 @@
+/**
+ * @file bench.h
+ * @brief Helpers for userspace benchmarks.
+ *
+ * Results are printed to stdout as CSV rows:
+ * bench,<name>,<samples>,<min>,<median>,<p99>,<unit>
+ * The CSV header is printed by run.sh.
+ */
+
+#pragma once
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Number of samples collected by a benchmark.
+ */
+#define BENCH_SAMPLES 50
+
+typedef void bench_fn_t(void * arg);
+
+/**
+ * Get a monotonic timestamp in nanoseconds.
+ */
+uint64_t bench_time_ns(void);
+
+/**
+ * Sort samples and print min, median and p99 as a CSV row.
+ * @param name      is the name of the benchmark.
+ * @param samples   is an array of samples, sorted in place.
+ * @param n         is the number of samples.
+ * @param unit      is the unit of the samples.
+ */
+void bench_report(const char * name, uint64_t * samples, size_t n,
+                  const char * unit);
+
+/**
+ * Measure the latency of fn.
+ * Each sample times batch calls to fn, the results are reported in
+ * nanoseconds per call.
+ */
+void bench_latency(const char * name, bench_fn_t * fn, void * arg,
+                   size_t batch);
+
+/**
+ * Measure the throughput of fn.
+ * fn is expected to transfer bytes bytes per call, the results are reported
+ * in KiB/s.
+ */
+void bench_throughput(const char * name, bench_fn_t * fn, void * arg,
+                      size_t bytes);
+
+/**
+ * Print an error message and exit.
+ */
+void bench_fail(const char * msg);
+
+#endif /* BENCH_H */
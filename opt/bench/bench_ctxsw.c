@@ -0,0 +1,67 @@
+/**
+ * @file bench_ctxsw.c
+ * @brief Benchmark context switches between two processes.
+ *
+ * Two processes pass a byte back and forth over a pair of pipes, so every
+ * round trip includes two switches.
+ */
+
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define ROUND_TRIPS 100
+
+static int ping[2];
+static int pong[2];
+
+static void round_trip(void * arg)
+{
+    char c = 0;
+
+    if (write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1)
+        bench_fail("ping-pong");
+}
+
+int main(void)
+{
+    uint64_t samples[BENCH_SAMPLES];
+    pid_t pid;
+
+    if (pipe(ping) || pipe(pong))
+        bench_fail("pipe");
+
+    pid = fork();
+    if (pid == -1)
+        bench_fail("fork");
+    if (pid == 0) {
+        char c;
+
+        close(ping[1]);
+        close(pong[0]);
+        while (read(ping[0], &c, 1) == 1) {
+            if (write(pong[1], &c, 1) != 1)
+                break;
+        }
+        _exit(0);
+    }
+    close(ping[0]);
+    close(pong[1]);
+
+    round_trip(NULL); /* Warm up. */
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        uint64_t start = bench_time_ns();
+
+        for (size_t j = 0; j < ROUND_TRIPS; j++) {
+            round_trip(NULL);
+        }
+        samples[i] = (bench_time_ns() - start) / (2 * ROUND_TRIPS);
+    }
+    bench_report("ctxsw_pipe", samples, BENCH_SAMPLES, "ns");
+
+    close(ping[1]);
+    waitpid(pid, NULL, 0);
+
+    return 0;
+}
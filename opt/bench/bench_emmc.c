@@ -0,0 +1,59 @@
+/**
+ * @file bench_emmc.c
+ * @brief Benchmark raw sequential reads from the SD card.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define EMMC_DEV    "/dev/emmc0"
+#define BLOCK_SIZE  512
+#define READ_SIZE   (1024 * 1024)
+#define MAX_CHUNK   (64 * 1024)
+
+struct emmc_bench {
+    int fd;
+    size_t chunk;   /*!< Bytes per read() call. */
+};
+
+/*
+ * Aligned to a page so the driver can use DMA for the transfers.
+ */
+static char buf[MAX_CHUNK] __attribute__((aligned(4096)));
+
+static void emmc_read(void * arg)
+{
+    struct emmc_bench * eb = arg;
+
+    for (size_t done = 0; done < READ_SIZE; done += eb->chunk) {
+        /* The seek offset of a block device is in blocks. */
+        if (lseek(eb->fd, done / BLOCK_SIZE, SEEK_SET) == -1)
+            bench_fail("lseek");
+        if (read(eb->fd, buf, eb->chunk) != (ssize_t)eb->chunk)
+            bench_fail("read");
+    }
+}
+
+int main(void)
+{
+    const size_t chunks[] = { BLOCK_SIZE, 4096, MAX_CHUNK };
+    struct emmc_bench eb;
+
+    eb.fd = open(EMMC_DEV, O_RDONLY);
+    if (eb.fd == -1)
+        bench_fail(EMMC_DEV);
+
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        char name[40];
+
+        eb.chunk = chunks[i];
+        snprintf(name, sizeof(name), "emmc_read_%u", (unsigned)eb.chunk);
+        bench_throughput(name, emmc_read, &eb, READ_SIZE);
+    }
+
+    close(eb.fd);
+
+    return 0;
+}
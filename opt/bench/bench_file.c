@@ -0,0 +1,71 @@
+/**
+ * @file bench_file.c
+ * @brief Benchmark sequential file I/O on ramfs and FAT.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define CHUNK_SIZE  4096
+#define FILE_SIZE   (256 * 1024)
+
+struct file_bench {
+    const char * fs;    /*!< Name of the file system. */
+    const char * path;  /*!< Path of the file used. */
+};
+
+static char buf[CHUNK_SIZE];
+
+static void file_write(void * arg)
+{
+    struct file_bench * fb = arg;
+    int fd;
+
+    fd = open(fb->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        bench_fail(fb->path);
+    for (size_t done = 0; done < FILE_SIZE; done += sizeof(buf)) {
+        if (write(fd, buf, sizeof(buf)) != sizeof(buf))
+            bench_fail("write");
+    }
+    close(fd);
+}
+
+static void file_read(void * arg)
+{
+    struct file_bench * fb = arg;
+    int fd;
+
+    fd = open(fb->path, O_RDONLY);
+    if (fd == -1)
+        bench_fail(fb->path);
+    while (read(fd, buf, sizeof(buf)) > 0);
+    close(fd);
+}
+
+int main(void)
+{
+    struct file_bench benches[] = {
+        { .fs = "ramfs", .path = "/tmp/bench_file.tmp" },
+        { .fs = "fat",   .path = "/home/bench_file.tmp" },
+    };
+
+    memset(buf, 0xa5, sizeof(buf));
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        struct file_bench * fb = &benches[i];
+        char name[40];
+
+        snprintf(name, sizeof(name), "file_write_%s", fb->fs);
+        bench_throughput(name, file_write, fb, FILE_SIZE);
+        snprintf(name, sizeof(name), "file_read_%s", fb->fs);
+        bench_throughput(name, file_read, fb, FILE_SIZE);
+
+        unlink(fb->path);
+    }
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file bench_fork.c
+ * @brief Benchmark process creation.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define CHILD_ARG "--child"
+
+static char * self;
+
+static void fork_wait(void * arg)
+{
+    pid_t pid;
+
+    pid = fork();
+    if (pid == -1)
+        bench_fail("fork");
+    if (pid == 0)
+        _exit(0);
+    waitpid(pid, NULL, 0);
+}
+
+static void fork_exec_wait(void * arg)
+{
+    pid_t pid;
+
+    pid = fork();
+    if (pid == -1)
+        bench_fail("fork");
+    if (pid == 0) {
+        execl(self, self, CHILD_ARG, NULL);
+        _exit(1);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc > 1 && !strcmp(argv[1], CHILD_ARG))
+        return 0;
+
+    self = argv[0];
+
+    bench_latency("fork_wait", fork_wait, NULL, 1);
+    bench_latency("fork_exec_wait", fork_exec_wait, NULL, 1);
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file bench_malloc.c
+ * @brief Benchmark malloc() and free().
+ */
+
+#include <stdlib.h>
+#include "bench.h"
+
+#define NR_ALLOCS 64
+
+static void * ptrs[NR_ALLOCS];
+
+static void malloc_small(void * arg)
+{
+    void * p = malloc(32);
+
+    free(p);
+}
+
+/*
+ * Allocate a set of mixed size blocks and free them, similar to what a
+ * short lived parser would do.
+ */
+static void malloc_mixed(void * arg)
+{
+    for (size_t i = 0; i < NR_ALLOCS; i++) {
+        ptrs[i] = malloc(16 << (i % 8));
+        if (!ptrs[i])
+            bench_fail("malloc");
+    }
+    for (size_t i = 0; i < NR_ALLOCS; i++) {
+        free(ptrs[i]);
+    }
+}
+
+int main(void)
+{
+    bench_latency("malloc_free_32", malloc_small, NULL, 100);
+    bench_latency("malloc_free_mixed64", malloc_mixed, NULL, 1);
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file bench_mmap.c
+ * @brief Benchmark the cost of faulting in anonymous memory.
+ */
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define MAP_PAGES 64
+#define ARENA_SIZE (1024 * 1024)
+
+/*
+ * Reserve a large arena and touch only its first page, the cost shouldn't
+ * depend on the size of the arena.
+ */
+static void mmap_sparse(void * arg)
+{
+    volatile uint8_t * p;
+
+    p = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (p == MAP_FAILED)
+        bench_fail("mmap");
+    p[0] = 1;
+    munmap((void *)p, ARENA_SIZE);
+}
+
+int main(void)
+{
+    const size_t pgsize = sysconf(_SC_PAGESIZE);
+    uint64_t samples[BENCH_SAMPLES];
+
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        volatile uint8_t * p;
+        uint64_t start;
+
+        p = mmap(NULL, MAP_PAGES * pgsize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANON, -1, 0);
+        if (p == MAP_FAILED)
+            bench_fail("mmap");
+
+        start = bench_time_ns();
+        for (size_t j = 0; j < MAP_PAGES; j++) {
+            p[j * pgsize] = 1;
+        }
+        samples[i] = (bench_time_ns() - start) / MAP_PAGES;
+
+        munmap((void *)p, MAP_PAGES * pgsize);
+    }
+    bench_report("mmap_fault", samples, BENCH_SAMPLES, "ns");
+
+    bench_latency("mmap_sparse_1m", mmap_sparse, NULL, 1);
+
+    return 0;
+}
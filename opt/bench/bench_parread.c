@@ -0,0 +1,108 @@
+/**
+ * @file bench_parread.c
+ * @brief Benchmark parallel readers on FAT.
+ *
+ * Each reader thread reads a whole file, either its own file or a file
+ * shared by all readers. Readers of different files shouldn't serialize on
+ * the volume.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define NR_READERS  4
+#define CHUNK_SIZE  4096
+#define FILE_SIZE   (256 * 1024)
+#define STACK_SIZE  8192
+
+struct parread_bench {
+    int nr_readers;
+    int shared;         /*!< All readers read the same file. */
+};
+
+struct reader {
+    const char * path;
+    char buf[CHUNK_SIZE];
+    char stack[STACK_SIZE];
+};
+
+static char paths[NR_READERS][40];
+static struct reader readers[NR_READERS];
+
+static void * reader(void * arg)
+{
+    struct reader * r = arg;
+    int fd;
+
+    fd = open(r->path, O_RDONLY);
+    if (fd == -1)
+        bench_fail(r->path);
+    while (read(fd, r->buf, sizeof(r->buf)) > 0);
+    close(fd);
+
+    return NULL;
+}
+
+static void parread(void * arg)
+{
+    struct parread_bench * pb = arg;
+    pthread_t tid[NR_READERS];
+
+    for (int i = 0; i < pb->nr_readers; i++) {
+        struct reader * r = &readers[i];
+        pthread_attr_t attr;
+
+        r->path = paths[(pb->shared) ? 0 : i];
+        pthread_attr_init(&attr);
+        pthread_attr_setstack(&attr, r->stack, sizeof(r->stack));
+        if (pthread_create(&tid[i], &attr, reader, r))
+            bench_fail("pthread_create");
+    }
+    for (int i = 0; i < pb->nr_readers; i++) {
+        pthread_join(tid[i], NULL);
+    }
+}
+
+int main(void)
+{
+    struct parread_bench benches[] = {
+        { .nr_readers = 1,          .shared = 0 },
+        { .nr_readers = NR_READERS, .shared = 0 },
+        { .nr_readers = NR_READERS, .shared = 1 },
+    };
+
+    memset(readers[0].buf, 0xa5, sizeof(readers[0].buf));
+
+    for (int i = 0; i < NR_READERS; i++) {
+        int fd;
+
+        snprintf(paths[i], sizeof(paths[i]), "/home/bench_parread%d.tmp", i);
+        fd = open(paths[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1)
+            bench_fail(paths[i]);
+        for (size_t done = 0; done < FILE_SIZE; done += CHUNK_SIZE) {
+            if (write(fd, readers[0].buf, CHUNK_SIZE) != CHUNK_SIZE)
+                bench_fail("write");
+        }
+        close(fd);
+    }
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        struct parread_bench * pb = &benches[i];
+        char name[40];
+
+        snprintf(name, sizeof(name), "parread_fat_%d%s",
+                 pb->nr_readers, (pb->shared) ? "_shared" : "");
+        bench_throughput(name, parread, pb, pb->nr_readers * FILE_SIZE);
+    }
+
+    for (int i = 0; i < NR_READERS; i++) {
+        unlink(paths[i]);
+    }
+
+    return 0;
+}
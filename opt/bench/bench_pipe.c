@@ -0,0 +1,53 @@
+/**
+ * @file bench_pipe.c
+ * @brief Benchmark pipe throughput between two processes.
+ */
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define CHUNK_SIZE  4096
+#define XFER_SIZE   (256 * 1024)
+
+static int fds[2];
+static char buf[CHUNK_SIZE];
+
+static void pipe_write(void * arg)
+{
+    for (size_t done = 0; done < XFER_SIZE;) {
+        ssize_t n;
+
+        n = write(fds[1], buf, sizeof(buf));
+        if (n <= 0)
+            bench_fail("write");
+        done += n;
+    }
+}
+
+int main(void)
+{
+    pid_t pid;
+
+    if (pipe(fds))
+        bench_fail("pipe");
+
+    pid = fork();
+    if (pid == -1)
+        bench_fail("fork");
+    if (pid == 0) {
+        close(fds[1]);
+        while (read(fds[0], buf, sizeof(buf)) > 0);
+        _exit(0);
+    }
+    close(fds[0]);
+
+    bench_throughput("pipe_throughput", pipe_write, NULL, XFER_SIZE);
+
+    close(fds[1]);
+    waitpid(pid, NULL, 0);
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file bench_randread.c
+ * @brief Benchmark random reads from a large FAT file.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define TMP_PATH    "/home/bench_randread.tmp"
+#define CHUNK_SIZE  (64 * 1024)
+#define READ_SIZE   4096
+#define FILE_SIZE   (64 * 1024 * 1024)
+
+static char buf[CHUNK_SIZE];
+
+/*
+ * Reading from a random offset near the end of the file must not follow the
+ * whole cluster chain.
+ */
+static void rand_read(void * arg)
+{
+    int fd = *(int *)arg;
+    off_t off = (off_t)(rand() % (FILE_SIZE / READ_SIZE)) * READ_SIZE;
+
+    if (lseek(fd, off, SEEK_SET) == -1)
+        bench_fail("lseek");
+    if (read(fd, buf, READ_SIZE) != READ_SIZE)
+        bench_fail("read");
+}
+
+int main(void)
+{
+    int fd;
+
+    memset(buf, 0xa5, sizeof(buf));
+
+    fd = open(TMP_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        bench_fail(TMP_PATH);
+    for (size_t done = 0; done < FILE_SIZE; done += sizeof(buf)) {
+        if (write(fd, buf, sizeof(buf)) != sizeof(buf))
+            bench_fail("write");
+    }
+    close(fd);
+
+    fd = open(TMP_PATH, O_RDONLY);
+    if (fd == -1)
+        bench_fail(TMP_PATH);
+    srand(1);
+    bench_latency("randread_fat_4k", rand_read, &fd, 10);
+
+    close(fd);
+    unlink(TMP_PATH);
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file bench_readdir.c
+ * @brief Benchmark listing a large directory on ramfs and FAT.
+ */
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define NR_FILES    1000
+
+struct readdir_bench {
+    const char * fs;    /*!< Name of the file system. */
+    const char * path;  /*!< Path of the directory used. */
+};
+
+static void populate(const char * path)
+{
+    char name[80];
+
+    if (mkdir(path, 0755) && access(path, F_OK))
+        bench_fail(path);
+    for (int i = 0; i < NR_FILES; i++) {
+        int fd;
+
+        snprintf(name, sizeof(name), "%s/f%04d", path, i);
+        fd = open(name, O_WRONLY | O_CREAT, 0644);
+        if (fd == -1)
+            bench_fail(name);
+        close(fd);
+    }
+}
+
+static void cleanup(const char * path)
+{
+    char name[80];
+
+    for (int i = 0; i < NR_FILES; i++) {
+        snprintf(name, sizeof(name), "%s/f%04d", path, i);
+        unlink(name);
+    }
+    rmdir(path);
+}
+
+static void list_dir(void * arg)
+{
+    struct readdir_bench * rb = arg;
+    DIR * dirp;
+    int n = 0;
+
+    dirp = opendir(rb->path);
+    if (!dirp)
+        bench_fail(rb->path);
+    while (readdir(dirp)) {
+        n++;
+    }
+    closedir(dirp);
+
+    if (n < NR_FILES)
+        bench_fail("readdir");
+}
+
+int main(void)
+{
+    struct readdir_bench benches[] = {
+        { .fs = "ramfs", .path = "/tmp/bench_readdir" },
+        { .fs = "fat",   .path = "/home/bench_readdir" },
+    };
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        struct readdir_bench * rb = &benches[i];
+        char name[40];
+
+        populate(rb->path);
+        snprintf(name, sizeof(name), "readdir_%d_%s", NR_FILES, rb->fs);
+        bench_latency(name, list_dir, rb, 1);
+        cleanup(rb->path);
+    }
+
+    return 0;
+}
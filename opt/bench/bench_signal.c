@@ -0,0 +1,38 @@
+/**
+ * @file bench_signal.c
+ * @brief Benchmark signal delivery.
+ */
+
+#include <signal.h>
+#include <unistd.h>
+#include "bench.h"
+
+static volatile int caught;
+
+static void handler(int signo)
+{
+    caught++;
+}
+
+static void signal_self(void * arg)
+{
+    const int prev = caught;
+
+    kill(getpid(), SIGUSR1);
+    while (caught == prev);
+}
+
+int main(void)
+{
+    struct sigaction action = {
+        .sa_handler = handler,
+    };
+
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGUSR1, &action, NULL))
+        bench_fail("sigaction");
+
+    bench_latency("signal_round_trip", signal_self, NULL, 10);
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file bench_syscall.c
+ * @brief Benchmark the cost of copying syscall arguments.
+ */
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define TMP_PATH    "/tmp/bench_syscall.tmp"
+#define PAGE        4096
+
+struct span_bench {
+    int fd;
+    char * buf;     /*!< Spans over two adjacent mappings. */
+};
+
+/*
+ * getpid() copies out a single pid_t while getrlimit() copies in and out an
+ * args struct, the difference is roughly the cost of the argument copy.
+ */
+static void syscall_getpid(void * arg)
+{
+    (void)getpid();
+}
+
+static void syscall_getrlimit(void * arg)
+{
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl))
+        bench_fail("getrlimit");
+}
+
+static void copy_span(void * arg)
+{
+    struct span_bench * sb = arg;
+
+    if (lseek(sb->fd, 0, SEEK_SET) == -1)
+        bench_fail("lseek");
+    if (write(sb->fd, sb->buf, PAGE) != PAGE)
+        bench_fail("write");
+    if (lseek(sb->fd, 0, SEEK_SET) == -1)
+        bench_fail("lseek");
+    if (read(sb->fd, sb->buf, PAGE) != PAGE)
+        bench_fail("read");
+}
+
+int main(void)
+{
+    struct span_bench sb;
+    char * p;
+
+    bench_latency("syscall_getpid", syscall_getpid, NULL, 100);
+    bench_latency("syscall_getrlimit", syscall_getrlimit, NULL, 100);
+
+    p = mmap(NULL, PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+             -1, 0);
+    if (p == MAP_FAILED)
+        bench_fail("mmap");
+    if (mmap(p + PAGE, PAGE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0) == MAP_FAILED)
+        bench_fail("mmap");
+    memset(p, 0xa5, 2 * PAGE);
+    sb.buf = p + PAGE / 2;
+
+    sb.fd = open(TMP_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (sb.fd == -1)
+        bench_fail(TMP_PATH);
+    bench_latency("copy_span_4k", copy_span, &sb, 10);
+
+    close(sb.fd);
+    unlink(TMP_PATH);
+    munmap(p + PAGE, PAGE);
+    munmap(p, PAGE);
+
+    return 0;
+}
@@ -0,0 +1,14 @@
+#!/bin/sh
+echo "bench,name,samples,min,median,p99,unit"
+./bench_ctxsw
+./bench_pipe
+./bench_fork
+./bench_signal
+./bench_mmap
+./bench_malloc
+./bench_file
+./bench_emmc
+./bench_randread
+./bench_parread
+./bench_readdir
+./bench_syscall
@@ -2,6 +2,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <string.h>
+#include <unistd.h>
 #include "punit.h"
 
 char * data;
@@ -99,12 +101,51 @@ static char * test_mmap_anon_huge(void)
     return NULL;
 }
 
+static char * test_mmap_span_copy(void)
+{
+    const char * path = "/tmp/test_mmap_span";
+    char * next;
+    int fd;
+    ssize_t n;
+
+    data = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_ANON, -1, 0);
+    pu_assert("a new memory region returned", data != MAP_FAILED);
+    next = mmap(data + 4096, 4096, PROT_READ | PROT_WRITE,
+                MAP_ANON | MAP_FIXED, -1, 0);
+    pu_assert("an adjacent memory region returned", next == data + 4096);
+
+    memset(data, 'a', 4096);
+    memset(next, 'b', 4096);
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    pu_assert("file opened", fd != -1);
+
+    /* Both writing and reading copy over the boundary of the regions. */
+    n = write(fd, data + 2048, 4096);
+    pu_assert_equal("written over the region boundary", (int)n, 4096);
+    memset(data, 0, 4096);
+    memset(next, 0, 4096);
+    lseek(fd, 0, SEEK_SET);
+    n = read(fd, data + 2048, 4096);
+    pu_assert_equal("read over the region boundary", (int)n, 4096);
+
+    close(fd);
+    unlink(path);
+
+    pu_assert("first region data", data[2048] == 'a' && data[4095] == 'a');
+    pu_assert("second region data", next[0] == 'b' && next[2047] == 'b');
+    munmap(next, 4096);
+
+    return NULL;
+}
+
 static void all_tests()
 {
     pu_def_test(test_mmap_anon, PU_RUN);
     pu_def_test(test_mmap_anon_fixed, PU_RUN);
     pu_def_test(test_mmap_file, PU_RUN);
     pu_def_test(test_mmap_anon_huge, PU_RUN);
+    pu_def_test(test_mmap_span_copy, PU_RUN);
 }
 
 int main(int argc, char **argv)
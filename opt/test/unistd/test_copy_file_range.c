@@ -0,0 +1,243 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include "punit.h"
+
+#define SRC_FILE    "/tmp/test_cfr_src.tmp"
+#define DST_FILE    "/tmp/test_cfr_dst.tmp"
+#define FAT_DIR     "/home"
+#define FAT_SRC     FAT_DIR "/test_cfr_src.tmp"
+#define FAT_DST     FAT_DIR "/test_cfr_dst.tmp"
+
+#define BENCH_SIZE  (1024 * 1024)
+
+static char buf[4096];
+
+static void setup(void)
+{
+    unlink(SRC_FILE);
+    unlink(DST_FILE);
+}
+
+static void teardown(void)
+{
+    unlink(SRC_FILE);
+    unlink(DST_FILE);
+}
+
+static int create_file(const char * path, size_t size)
+{
+    int fd;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+
+    for (size_t i = 0; i < size; i += sizeof(buf)) {
+        const size_t n = (size - i < sizeof(buf)) ? size - i : sizeof(buf);
+
+        memset(buf, 'a' + (i / sizeof(buf)) % 26, n);
+        if (write(fd, buf, n) != (ssize_t)n) {
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+
+    return 0;
+}
+
+static unsigned long elapsed_usec(struct timespec * start,
+                                  struct timespec * end)
+{
+    unsigned long usec;
+
+    usec = (end->tv_sec - start->tv_sec) * 1000000 +
+           (end->tv_nsec - start->tv_nsec) / 1000;
+
+    return (usec > 0) ? usec : 1;
+}
+
+static char * test_copy(void)
+{
+    static char rbuf[sizeof(buf)];
+    int fd_in, fd_out;
+    ssize_t n;
+
+    pu_assert_equal("create src", create_file(SRC_FILE, 3 * sizeof(buf)), 0);
+
+    fd_in = open(SRC_FILE, O_RDONLY);
+    pu_assert("open src", fd_in >= 0);
+    fd_out = open(DST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    pu_assert("open dst", fd_out >= 0);
+
+    n = copy_file_range(fd_in, NULL, fd_out, NULL, 3 * sizeof(buf), 0);
+    pu_assert_equal("All bytes copied", n, 3 * sizeof(buf));
+    pu_assert_equal("EOF", copy_file_range(fd_in, NULL, fd_out, NULL, 1, 0),
+                    0);
+
+    lseek(fd_out, sizeof(buf), SEEK_SET);
+    pu_assert_equal("read dst", read(fd_out, rbuf, sizeof(rbuf)),
+                    sizeof(rbuf));
+    memset(buf, 'b', sizeof(buf));
+    pu_assert("data copied", !memcmp(buf, rbuf, sizeof(rbuf)));
+
+    close(fd_in);
+    close(fd_out);
+
+    return NULL;
+}
+
+static char * test_copy_offset(void)
+{
+    int fd_in, fd_out;
+    off_t off_in = sizeof(buf);
+    off_t off_out = 0;
+    char c;
+
+    pu_assert_equal("create src", create_file(SRC_FILE, 2 * sizeof(buf)), 0);
+
+    fd_in = open(SRC_FILE, O_RDONLY);
+    pu_assert("open src", fd_in >= 0);
+    fd_out = open(DST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    pu_assert("open dst", fd_out >= 0);
+
+    pu_assert_equal("copied",
+                    copy_file_range(fd_in, &off_in, fd_out, &off_out, 1, 0),
+                    1);
+    pu_assert_equal("off_in updated", off_in, sizeof(buf) + 1);
+    pu_assert_equal("off_out updated", off_out, 1);
+    pu_assert_equal("file offset not changed",
+                    lseek(fd_in, 0, SEEK_CUR), 0);
+
+    pu_assert_equal("read dst", read(fd_out, &c, 1), 1);
+    pu_assert_equal("correct byte", c, 'b');
+
+    close(fd_in);
+    close(fd_out);
+
+    return NULL;
+}
+
+static char * test_copy_zero(void)
+{
+    int fd_in, fd_out;
+
+    pu_assert_equal("create src", create_file(SRC_FILE, 1), 0);
+
+    fd_in = open(SRC_FILE, O_RDONLY);
+    pu_assert("open src", fd_in >= 0);
+    fd_out = open(DST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    pu_assert("open dst", fd_out >= 0);
+
+    pu_assert_equal("nothing copied",
+                    copy_file_range(fd_in, NULL, fd_out, NULL, 0, 0), 0);
+
+    close(fd_in);
+    close(fd_out);
+
+    return NULL;
+}
+
+static char * test_copy_ebadf(void)
+{
+    int fd_in;
+
+    pu_assert_equal("create src", create_file(SRC_FILE, 1), 0);
+
+    fd_in = open(SRC_FILE, O_RDONLY);
+    pu_assert("open src", fd_in >= 0);
+
+    errno = 0;
+    pu_assert_equal("fails",
+                    copy_file_range(fd_in, NULL, fd_in, NULL, 1, 0), -1);
+    pu_assert_equal("errno", errno, EBADF);
+
+    close(fd_in);
+
+    return NULL;
+}
+
+/**
+ * Compare copy_file_range() to a read()/write() loop.
+ */
+static char * bench_copy(const char * src, const char * dst)
+{
+    struct timespec start, end;
+    int fd_in, fd_out;
+    ssize_t n;
+    unsigned long usec_rw, usec_cfr;
+
+    pu_assert_equal("create src", create_file(src, BENCH_SIZE), 0);
+
+    fd_in = open(src, O_RDONLY);
+    pu_assert("open src", fd_in >= 0);
+    fd_out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    pu_assert("open dst", fd_out >= 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((n = read(fd_in, buf, sizeof(buf))) > 0) {
+        pu_assert_equal("write", write(fd_out, buf, n), n);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    usec_rw = elapsed_usec(&start, &end);
+
+    lseek(fd_in, 0, SEEK_SET);
+    lseek(fd_out, 0, SEEK_SET);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((n = copy_file_range(fd_in, NULL, fd_out, NULL, BENCH_SIZE, 0)) > 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    usec_cfr = elapsed_usec(&start, &end);
+    pu_assert_equal("copy_file_range ok", n, 0);
+
+    printf("%s: read/write: %lu kB/s copy_file_range: %lu kB/s\n", src,
+           (unsigned long)((unsigned long long)BENCH_SIZE * 1000 / usec_rw),
+           (unsigned long)((unsigned long long)BENCH_SIZE * 1000 / usec_cfr));
+
+    close(fd_in);
+    close(fd_out);
+    unlink(src);
+    unlink(dst);
+
+    return NULL;
+}
+
+static char * test_bench_ramfs(void)
+{
+    return bench_copy(SRC_FILE, DST_FILE);
+}
+
+static char * test_bench_fat(void)
+{
+    struct stat st;
+
+    if (stat(FAT_DIR, &st) || !S_ISDIR(st.st_mode)) {
+        printf("No FAT file system mounted at " FAT_DIR "\n");
+        return NULL;
+    }
+
+    return bench_copy(FAT_SRC, FAT_DST);
+}
+
+static void all_tests(void)
+{
+    pu_def_test(test_copy, PU_RUN);
+    pu_def_test(test_copy_offset, PU_RUN);
+    pu_def_test(test_copy_zero, PU_RUN);
+    pu_def_test(test_copy_ebadf, PU_RUN);
+    pu_def_test(test_bench_ramfs, PU_RUN);
+    pu_def_test(test_bench_fat, PU_RUN);
+}
+
+int main(int argc, char **argv)
+{
+    return pu_run_tests(&all_tests);
+}
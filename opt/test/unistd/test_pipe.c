@@ -1,8 +1,14 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #include "punit.h"
 
@@ -115,12 +121,186 @@ static char * test_pipe_after_fork(void)
     return NULL;
 }
 
+static char * test_nonblock_empty(void)
+{
+    char c;
+
+    pu_assert_equal("pipe creation ok", pipe(fd), 0);
+    pu_assert_equal("set O_NONBLOCK", fcntl(fd[0], F_SETFL, O_NONBLOCK), 0);
+
+    errno = 0;
+    pu_assert_equal("read() fails", read(fd[0], &c, sizeof(c)), -1);
+    pu_assert_equal("errno is EAGAIN", errno, EAGAIN);
+
+    return NULL;
+}
+
+static int sig_received;
+
+static void catch_sig(int signum)
+{
+    sig_received = signum;
+}
+
+static char * test_read_interrupted(void)
+{
+    char c;
+    pid_t pid;
+    ssize_t n;
+
+    pu_assert_equal("pipe creation ok", pipe(fd), 0);
+
+    sig_received = 0;
+    signal(SIGUSR1, catch_sig);
+
+    pid = fork();
+    pu_assert("PID OK\n", pid != -1);
+    if (pid == 0) {
+        sleep(1);
+        kill(getppid(), SIGUSR1);
+        _exit(0);
+    }
+
+    /* The write end is still open so read() blocks until the signal. */
+    errno = 0;
+    n = read(fd[0], &c, sizeof(c));
+    waitpid(pid, NULL, 0);
+    signal(SIGUSR1, SIG_DFL);
+
+    pu_assert_equal("read() fails", n, -1);
+    pu_assert_equal("errno is EINTR", errno, EINTR);
+    pu_assert_equal("Signal handler was called", sig_received, SIGUSR1);
+
+    return NULL;
+}
+
+static char * test_atomic_write(void)
+{
+#define NR_WRITERS  4
+#define NR_RECORDS  32
+    static char rbuf[PIPE_BUF];
+    size_t nr_records = 0;
+    pid_t pid[NR_WRITERS];
+
+    pu_assert_equal("pipe creation ok", pipe(fd), 0);
+
+    /*
+     * Concurrent writers each write records of PIPE_BUF bytes filled with
+     * a writer specific byte, no record may contain data of another writer.
+     */
+    for (int i = 0; i < NR_WRITERS; i++) {
+        pid[i] = fork();
+        pu_assert("PID OK\n", pid[i] != -1);
+        if (pid[i] == 0) {
+            static char wbuf[PIPE_BUF];
+
+            close(fd[0]);
+            memset(wbuf, 'a' + i, sizeof(wbuf));
+            for (int j = 0; j < NR_RECORDS; j++) {
+                if (write(fd[1], wbuf, sizeof(wbuf)) != sizeof(wbuf))
+                    _exit(1);
+            }
+
+            _exit(0);
+        }
+    }
+
+    close(fd[1]);
+    fd[1] = 0;
+    while (1) {
+        ssize_t n = 0;
+
+        while (n < (ssize_t)sizeof(rbuf)) {
+            ssize_t ret = read(fd[0], rbuf + n, sizeof(rbuf) - n);
+
+            if (ret <= 0)
+                break;
+            n += ret;
+        }
+        if (n == 0)
+            break;
+        pu_assert_equal("full record read", n, sizeof(rbuf));
+
+        for (size_t i = 1; i < sizeof(rbuf); i++) {
+            pu_assert("record not interleaved", rbuf[i] == rbuf[0]);
+        }
+        nr_records++;
+    }
+
+    for (int i = 0; i < NR_WRITERS; i++) {
+        int status;
+
+        pu_assert_equal("writer exited", waitpid(pid[i], &status, 0), pid[i]);
+        pu_assert("writer ok", WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    pu_assert_equal("all records read", nr_records, NR_WRITERS * NR_RECORDS);
+
+    return NULL;
+#undef NR_WRITERS
+#undef NR_RECORDS
+}
+
+static char * test_throughput(void)
+{
+#define TOTAL_BYTES (4 * 1024 * 1024)
+    static char buf[4096];
+    struct timespec start, end;
+    size_t total = 0;
+    unsigned long usec;
+    pid_t pid;
+
+    pu_assert_equal("pipe creation ok", pipe(fd), 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid = fork();
+    pu_assert("PID OK\n", pid != -1);
+    if (pid == 0) {
+        close(fd[0]);
+        for (size_t i = 0; i < TOTAL_BYTES; i += sizeof(buf)) {
+            if (write(fd[1], buf, sizeof(buf)) != sizeof(buf))
+                _exit(1);
+        }
+
+        _exit(0);
+    }
+
+    close(fd[1]);
+    fd[1] = 0;
+    while (total < TOTAL_BYTES) {
+        ssize_t n = read(fd[0], buf, sizeof(buf));
+
+        if (n <= 0)
+            break;
+        total += n;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    wait(NULL);
+
+    pu_assert_equal("All data was received", total, TOTAL_BYTES);
+
+    usec = (end.tv_sec - start.tv_sec) * 1000000 +
+           (end.tv_nsec - start.tv_nsec) / 1000;
+    if (usec == 0)
+        usec = 1;
+    printf("pipe throughput: %lu kB/s\n",
+           (unsigned long)((unsigned long long)TOTAL_BYTES * 1000 / usec));
+
+#undef TOTAL_BYTES
+    return NULL;
+}
+
 static void all_tests(void)
 {
     pu_def_test(test_simple, PU_RUN);
     pu_def_test(test_eof, PU_RUN);
     pu_def_test(test_eof_remaining, PU_RUN);
     pu_def_test(test_pipe_after_fork, PU_RUN);
+    pu_def_test(test_nonblock_empty, PU_RUN);
+    pu_def_test(test_read_interrupted, PU_RUN);
+    pu_def_test(test_atomic_write, PU_RUN);
+    pu_def_test(test_throughput, PU_RUN);
 }
 
 int main(int argc, char **argv)
@@ -0,0 +1,101 @@
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include "punit.h"
+
+#define TEST_FILE   "/tmp/test_ramfs.tmp"
+#define BENCH_SIZE  (2 * 1024 * 1024)
+
+static char buf[64 * 1024];
+static int fd;
+
+static void setup(void)
+{
+    fd = open(TEST_FILE, O_RDWR | O_CREAT, 0644);
+}
+
+static void teardown(void)
+{
+    if (fd >= 0)
+        close(fd);
+    unlink(TEST_FILE);
+}
+
+static unsigned long kbps(struct timespec * start, struct timespec * end,
+                          size_t bytes)
+{
+    unsigned long usec;
+
+    usec = (end->tv_sec - start->tv_sec) * 1000000 +
+           (end->tv_nsec - start->tv_nsec) / 1000;
+    if (usec == 0)
+        usec = 1;
+
+    return (unsigned long)((unsigned long long)bytes * 1000 / usec);
+}
+
+static char * test_hole(void)
+{
+    char c = 'x';
+
+    pu_assert("open ok", fd >= 0);
+    pu_assert_equal("seek past EOF", lseek(fd, 3 * 4096 + 10, SEEK_SET),
+                    3 * 4096 + 10);
+    pu_assert_equal("write", write(fd, &c, 1), 1);
+
+    lseek(fd, 0, SEEK_SET);
+    pu_assert_equal("read", read(fd, buf, 3 * 4096 + 11), 3 * 4096 + 11);
+    for (size_t i = 0; i < 3 * 4096 + 10; i++) {
+        pu_assert_equal("hole is zeroed", buf[i], 0);
+    }
+    pu_assert_equal("data", buf[3 * 4096 + 10], 'x');
+    pu_assert_equal("EOF", read(fd, buf, 1), 0);
+
+    return NULL;
+}
+
+static char * test_bench_seq(void)
+{
+    struct timespec start, end;
+    ssize_t n;
+    size_t total = 0;
+
+    pu_assert("open ok", fd >= 0);
+
+    memset(buf, 'a', sizeof(buf));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < BENCH_SIZE; i += sizeof(buf)) {
+        pu_assert_equal("write", write(fd, buf, sizeof(buf)), sizeof(buf));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("ramfs seq write: %lu kB/s\n", kbps(&start, &end, BENCH_SIZE));
+
+    lseek(fd, 0, SEEK_SET);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        total += n;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("ramfs seq read: %lu kB/s\n", kbps(&start, &end, total));
+
+    pu_assert_equal("All data read", total, BENCH_SIZE);
+
+    return NULL;
+}
+
+static void all_tests(void)
+{
+    pu_def_test(test_hole, PU_RUN);
+    pu_def_test(test_bench_seq, PU_RUN);
+}
+
+int main(int argc, char **argv)
+{
+    return pu_run_tests(&all_tests);
+}
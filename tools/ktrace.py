@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Decode a Zeke kernel trace dump.
+
+The input is the contents of /proc/ktrace, either copied from the target or
+captured from the console. Lines that are not trace entries are ignored so
+a whole console log can be given as input.
+
+Usage: ktrace.py [--summary] [file]
+"""
+
+import re
+import sys
+from collections import defaultdict
+
+# Keep in sync with enum ktrace_event in kern/include/ktrace.h
+EVENTS = [
+    ('none', ()),
+    ('sched_switch', ('prev', 'next')),
+    ('syscall_enter', ('type', 'pid', 'tid')),
+    ('syscall_exit', ('type', 'retval', 'tid')),
+    ('abo', ('far', 'fsr', 'pid')),
+    ('bio_read', ('vnode', 'blkno', 'bcount')),
+    ('bio_write', ('vnode', 'blkno', 'bcount')),
+    ('irq', ('irq',)),
+]
+
+HEX_ARGS = {'far', 'fsr', 'type'}
+
+ENTRY_RE = re.compile(r'^\s*(\d+) (\d+) (\d+) (\d+) (\d+) (\d+)\s*$')
+
+
+def parse(f):
+    entries = []
+    for line in f:
+        m = ENTRY_RE.match(line)
+        if m:
+            entries.append(tuple(int(x) for x in m.groups()))
+    # The buffer is dumped in ring order, sort it by the timestamp.
+    entries.sort(key=lambda e: (e[1], e[0]))
+    return entries
+
+
+def to_signed(v):
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def format_args(names, args):
+    out = []
+    for name, v in zip(names, args):
+        if name in HEX_ARGS:
+            out.append('%s=%#x' % (name, v))
+        else:
+            out.append('%s=%d' % (name, to_signed(v)))
+    return ' '.join(out)
+
+
+def print_trace(entries):
+    if not entries:
+        return
+    t0 = entries[0][1]
+    for cpu, ts, ev, a0, a1, a2 in entries:
+        if ev < len(EVENTS):
+            name, argnames = EVENTS[ev]
+        else:
+            name, argnames = 'event%d' % ev, ('a0', 'a1', 'a2')
+        print('%12.6f cpu%d %-14s %s' % ((ts - t0) / 1e6, cpu, name,
+                                         format_args(argnames,
+                                                     (a0, a1, a2))))
+
+
+def print_summary(entries):
+    counts = defaultdict(int)
+    syscall_time = defaultdict(int)
+    syscall_count = defaultdict(int)
+    pending = {}
+
+    for cpu, ts, ev, a0, a1, a2 in entries:
+        counts[ev] += 1
+        if ev == 2:
+            pending[a2] = (a0, ts)
+        elif ev == 3 and a2 in pending and pending[a2][0] == a0:
+            syscall_time[a0] += ts - pending.pop(a2)[1]
+            syscall_count[a0] += 1
+
+    print('event           count')
+    for ev in sorted(counts):
+        name = EVENTS[ev][0] if ev < len(EVENTS) else 'event%d' % ev
+        print('%-15s %d' % (name, counts[ev]))
+
+    if syscall_count:
+        print('\nsyscall         count    avg us')
+        for t in sorted(syscall_count, key=lambda t: -syscall_time[t]):
+            print('%#-15x %-8d %.1f' % (t, syscall_count[t],
+                                        syscall_time[t] / syscall_count[t]))
+
+
+def main(argv):
+    summary = '--summary' in argv
+    args = [a for a in argv[1:] if a != '--summary']
+
+    if args:
+        with open(args[0], errors='replace') as f:
+            entries = parse(f)
+    else:
+        entries = parse(sys.stdin)
+
+    if summary:
+        print_summary(entries)
+    else:
+        print_trace(entries)
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Symbolize Zeke sampling profiler output into folded stacks.
+
+The input is the contents of /proc/sched_prof, either copied from the target
+or captured from the console. The output is in the folded stack format
+understood by flamegraph.pl:
+
+    pid;caller;function count
+
+Kernel mode frames are suffixed with _[k].
+
+Usage: sprof.py -k kernel.elf [-u PID=ELF]... [-U ELF] [file]
+
+  -k ELF      kernel image, usually kernel.elf.
+  -u PID=ELF  user binary of the process PID.
+  -U ELF      user binary for the processes not given with -u.
+
+The nm used can be changed with the NM environment variable, by default
+arm-none-eabi-nm is used.
+"""
+
+import bisect
+import os
+import re
+import subprocess
+import sys
+from collections import defaultdict
+
+SAMPLE_RE = re.compile(
+    r'^\s*(\d+) (-?\d+) (-?\d+) ([01]) (0x[0-9a-fA-F]+) (0x[0-9a-fA-F]+)\s*$')
+
+
+class SymbolTable:
+    def __init__(self, elf):
+        nm = os.environ.get('NM', 'arm-none-eabi-nm')
+        out = subprocess.check_output([nm, '-n', '--defined-only', elf],
+                                      universal_newlines=True)
+        self.addrs = []
+        self.names = []
+        for line in out.splitlines():
+            fields = line.split()
+            if len(fields) != 3 or fields[1] not in 'tTwW':
+                continue
+            self.addrs.append(int(fields[0], 16))
+            self.names.append(fields[2])
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return '%#x' % addr
+        return self.names[i]
+
+
+def parse_args(argv):
+    kernel = None
+    user = {}
+    default_user = None
+    files = []
+
+    it = iter(argv)
+    for arg in it:
+        if arg == '-k':
+            kernel = next(it)
+        elif arg == '-u':
+            pid, elf = next(it).split('=', 1)
+            user[int(pid)] = elf
+        elif arg == '-U':
+            default_user = next(it)
+        elif arg in ('-h', '--help'):
+            print(__doc__)
+            sys.exit(0)
+        else:
+            files.append(arg)
+
+    if not kernel:
+        print(__doc__, file=sys.stderr)
+        sys.exit(1)
+
+    return kernel, user, default_user, files
+
+
+def main(argv):
+    kernel, user, default_user, files = parse_args(argv[1:])
+    tables = {}
+
+    def table(elf):
+        if elf not in tables:
+            tables[elf] = SymbolTable(elf)
+        return tables[elf]
+
+    f = open(files[0], errors='replace') if files else sys.stdin
+    stacks = defaultdict(int)
+    for line in f:
+        m = SAMPLE_RE.match(line)
+        if not m:
+            continue
+        pid = int(m.group(2))
+        is_user = m.group(4) == '1'
+        pc = int(m.group(5), 16)
+        lr = int(m.group(6), 16)
+
+        if is_user:
+            elf = user.get(pid, default_user)
+            if elf is None:
+                frames = ['%#x' % pc]
+            else:
+                sym = table(elf)
+                frames = [sym.lookup(lr), sym.lookup(pc)]
+        else:
+            sym = table(kernel)
+            frames = [sym.lookup(lr) + '_[k]', sym.lookup(pc) + '_[k]']
+
+        # LR of a leaf function points to the caller, otherwise it may be
+        # the function itself.
+        if len(frames) == 2 and frames[0] == frames[1]:
+            frames = frames[1:]
+        stacks[';'.join(['pid%d' % pid] + frames)] += 1
+
+    for stack, count in sorted(stacks.items()):
+        print('%s %d' % (stack, count))
+
+
+if __name__ == '__main__':
+    main(sys.argv)